@@ -0,0 +1,63 @@
+#!/bin/bash
+# Build one firmware profile and write its size report
+#
+# Usage: ./build_profile.sh <prod|field-debug|lab> [all]
+#
+# Each profile builds into build-<profile>/ with its own sdkconfig, so
+# profiles never overwrite each other. The size report (flash, IRAM, DRAM)
+# is written to build-<profile>/size-report.json and summarised on stdout,
+# after the list of optional features the profile compiles in.
+# Pass "all" instead of a profile to build and compare every profile.
+#
+# Boot time is measured on the device: the boot waterfall records when
+# connect_nbiot() starts (ms since reset), see host/waterfall_report.
+
+set -e
+
+PROFILES="prod field-debug lab"
+
+if [ -z "$IDF_PATH" ]; then
+    echo "ESP-IDF environment not found. Run: source ~/esp/esp-idf/export.sh"
+    exit 1
+fi
+
+build_profile() {
+    local profile="$1"
+    local build_dir="build-$profile"
+
+    if [ ! -f "sdkconfig.$profile" ]; then
+        echo "Unknown profile: $profile (expected one of: $PROFILES)"
+        exit 1
+    fi
+
+    echo "=========================================="
+    echo "Building profile: $profile"
+    echo "=========================================="
+
+    idf.py -B "$build_dir" \
+        -D SDKCONFIG="$build_dir/sdkconfig" \
+        -D SDKCONFIG_DEFAULTS="sdkconfig.defaults;sdkconfig.$profile" \
+        build
+
+    idf.py -B "$build_dir" -D SDKCONFIG="$build_dir/sdkconfig" \
+        size --format json2 --output-file "$build_dir/size-report.json"
+
+    local bin
+    bin=$(ls "$build_dir"/*.bin | grep -v -e bootloader -e partition | head -1)
+    echo "$profile: app image $(stat -c %s "$bin" 2>/dev/null || stat -f %z "$bin") bytes"
+    echo "$profile: features $(sed -n 's/^CONFIG_WALTER_\([A-Z_]*\)=y$/\1/p' "$build_dir/sdkconfig" \
+        | grep -v '^PROFILE_' | tr 'A-Z_\n' 'a-z- ')"
+    idf.py -B "$build_dir" -D SDKCONFIG="$build_dir/sdkconfig" size | grep -E "Flash|IRAM|DRAM|Total"
+    echo ""
+}
+
+if [ "$1" = "all" ]; then
+    for profile in $PROFILES; do
+        build_profile "$profile"
+    done
+elif [ -n "$1" ]; then
+    build_profile "$1"
+else
+    echo "Usage: $0 <prod|field-debug|lab|all>"
+    exit 1
+fi
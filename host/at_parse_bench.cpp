@@ -0,0 +1,159 @@
+/**
+ * AT Response Parser Benchmark
+ *
+ * Builds main/at_response.h natively and reports nanoseconds per line for
+ * capture (tokenizing raw RX bytes into lines) and for each typed parser.
+ * A second pass feeds randomly mutated lines through every parser to
+ * measure the cost of rejecting garbage; build with
+ * -DCMAKE_CXX_FLAGS=-fsanitize=address,undefined to use it as a
+ * robustness run.
+ *
+ * Usage: at_parse_bench [iterations] [seed]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include "at_response.h"
+
+typedef std::chrono::steady_clock bench_clock;
+
+// Representative responses captured from a Sequans GM02S
+static const char *const CORPUS[] = {
+    "+CEREG: 2,1,\"00C3\",\"0102A8F1\",9",
+    "+CEREG: 5,\"0031\",\"0A0B\",7",
+    "+CEREG: 0,2",
+    "+SQNMONI: Orange F Cc:208 Nc:01 RSRP:-95.27 CINR:-0.50 RSRQ:-10.40 TAC:49 Id:15962 EARFCN:6300 PWR:-68.98 PAGING:128",
+    "+CGDCONT: 1,\"IP\",\"soracom.io\",\"10.0.0.1\",0,0",
+    "+CGACT: 1,1",
+    "+CESQ: 99,99,255,255,20,45",
+    "+SQNMODEACTIVE: 2",
+    "OK",
+};
+#define CORPUS_SIZE (sizeof(CORPUS) / sizeof(CORPUS[0]))
+
+static volatile uint32_t g_sink;
+
+/**
+ * Run every parser on a line; returns how many accepted it
+ */
+static int parse_all(at_view_t line) {
+    int accepted = 0;
+    at_cereg_t cereg;
+    at_sqnmoni_t moni;
+    at_cgdcont_t cgdcont;
+    at_cgact_t cgact;
+    at_cesq_t cesq;
+    at_sqnmodeactive_t mode;
+    accepted += at_parse_cereg(line, &cereg);
+    accepted += at_parse_sqnmoni(line, &moni);
+    accepted += at_parse_cgdcont(line, &cgdcont);
+    accepted += at_parse_cgact(line, &cgact);
+    accepted += at_parse_cesq(line, &cesq);
+    accepted += at_parse_sqnmodeactive(line, &mode);
+    return accepted;
+}
+
+/**
+ * Dispatch on the line prefix the way firmware code does
+ */
+static bool parse_dispatch(at_view_t line) {
+    if (at_view_starts_with(line, "+CEREG")) {
+        at_cereg_t r = {}; bool ok = at_parse_cereg(line, &r); g_sink += r.stat; return ok;
+    } else if (at_view_starts_with(line, "+SQNMONI")) {
+        at_sqnmoni_t r = {}; bool ok = at_parse_sqnmoni(line, &r); g_sink += r.fields; return ok;
+    } else if (at_view_starts_with(line, "+CGDCONT")) {
+        at_cgdcont_t r = {}; bool ok = at_parse_cgdcont(line, &r); g_sink += r.cid; return ok;
+    } else if (at_view_starts_with(line, "+CGACT")) {
+        at_cgact_t r = {}; bool ok = at_parse_cgact(line, &r); g_sink += r.active; return ok;
+    } else if (at_view_starts_with(line, "+CESQ")) {
+        at_cesq_t r = {}; bool ok = at_parse_cesq(line, &r); g_sink += r.rsrp; return ok;
+    } else if (at_view_starts_with(line, "+SQNMODEACTIVE")) {
+        at_sqnmodeactive_t r = {}; bool ok = at_parse_sqnmodeactive(line, &r); g_sink += r.mode; return ok;
+    }
+    return at_classify(line) == AT_LINE_OK;
+}
+
+static double elapsed_ns(bench_clock::time_point start) {
+    return std::chrono::duration<double, std::nano>(bench_clock::now() - start).count();
+}
+
+int main(int argc, char **argv) {
+    long iterations = argc > 1 ? atol(argv[1]) : 200000;
+    unsigned seed = argc > 2 ? (unsigned)atoi(argv[2]) : 1;
+    if (iterations <= 0) {
+        fprintf(stderr, "Usage: %s [iterations] [seed]\n", argv[0]);
+        return 1;
+    }
+
+    // Raw RX stream as it arrives from the UART
+    std::string rx;
+    for (size_t i = 0; i < CORPUS_SIZE; i++) {
+        rx += "\r\n";
+        rx += CORPUS[i];
+        rx += "\r\n";
+    }
+
+    printf("%-16s %10s\n", "stage", "ns/line");
+
+    // Capture: bytes -> line table
+    static at_capture_t cap;
+    auto start = bench_clock::now();
+    for (long i = 0; i < iterations; i++) {
+        at_capture_reset(&cap);
+        at_capture_feed(&cap, rx.data(), rx.size());
+        g_sink += cap.count;
+    }
+    printf("%-16s %10.1f\n", "capture", elapsed_ns(start) / (iterations * (double)CORPUS_SIZE));
+
+    // Each parser on its own line type
+    for (size_t c = 0; c < CORPUS_SIZE; c++) {
+        at_view_t line = at_view_str(CORPUS[c]);
+        if (!parse_dispatch(line)) {
+            fprintf(stderr, "Corpus line %zu failed to parse: %s\n", c, CORPUS[c]);
+            return 1;
+        }
+        start = bench_clock::now();
+        for (long i = 0; i < iterations; i++) {
+            g_sink += parse_dispatch(line);
+        }
+        char name[17];
+        snprintf(name, sizeof(name), "%.16s", CORPUS[c]);
+        for (char *p = name; *p; p++) {
+            if (*p == ':') { *p = '\0'; break; }
+        }
+        printf("%-16s %10.1f\n", name, elapsed_ns(start) / iterations);
+    }
+
+    // Mutated lines through every parser
+    std::mt19937 rng(seed);
+    std::vector<std::string> mutated;
+    for (int m = 0; m < 4096; m++) {
+        std::string s = CORPUS[rng() % CORPUS_SIZE];
+        int edits = 1 + rng() % 4;
+        for (int e = 0; e < edits && !s.empty(); e++) {
+            size_t pos = rng() % s.size();
+            switch (rng() % 3) {
+                case 0: s[pos] = (char)(rng() % 256); break;
+                case 1: s.erase(pos, 1 + rng() % 8); break;
+                case 2: s.insert(pos, 1, ",\":.-9"[rng() % 6]); break;
+            }
+        }
+        mutated.push_back(s);
+    }
+    long accepted = 0;
+    long runs = std::max(1L, iterations / 50);
+    start = bench_clock::now();
+    for (long i = 0; i < runs; i++) {
+        for (const std::string &s : mutated) {
+            accepted += parse_all(at_view(s.data(), s.size()));
+        }
+    }
+    printf("%-16s %10.1f  (%ld of %ld accepted)\n", "mutated/all",
+           elapsed_ns(start) / (runs * (double)mutated.size()),
+           accepted / runs, (long)mutated.size());
+    return 0;
+}
@@ -0,0 +1,271 @@
+/**
+ * Connect Deadline Simulation
+ *
+ * Runs many boots of the connect_nbiot() command sequence against the
+ * modem simulator with hangs injected, and compares:
+ *
+ *   blocking   the old code: each call waits for its answer, one connect
+ *              attempt per boot; a hung call costs MODEM_SIM_HANG_MS
+ *   deadline   main/modem_deadline.h: class budgets, reset after
+ *              MODEM_DEADLINE_RESET_AFTER overruns in a row, up to
+ *              CONNECT_ATTEMPTS attempts per boot
+ *
+ * Half of the injected hangs are transient (only that call is lost), the
+ * other half wedge the modem until it is reset. Registration is not
+ * injected: it is polled from cached state, not a modem command.
+ *
+ * Before the boots it walks the call slots through a modem that stops
+ * answering altogether: every slot abandoned, the reset itself timing
+ * out, and answers arriving for slots that were taken back. The exit
+ * status is non-zero if the slots do not recover.
+ *
+ * Usage: connect_deadline_sim [boots] [seed]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+#include "modem_deadline.h"
+#include "modem_sim.h"
+
+#define CONNECT_ATTEMPTS 3          // As in main.cpp
+#define NETWORK_TIMEOUT_MS 180000   // As in main.cpp
+#define CONNECT_FIXED_DELAY_MS 19500 // Sum of the vTaskDelay()s in connect_nbiot()
+#define SIM_RESET_MS 4000           // Modem reset until it answers AT again
+#define SIM_WEDGE_P 0.5             // Share of hangs that persist until a reset
+
+typedef struct {
+    const char *name;
+    modem_op_t op;
+    modem_class_t cls;
+} connect_step_t;
+
+// connect_nbiot() in call order; MODEM_OP_REGISTER is the registration wait
+static const connect_step_t CONNECT_STEPS[] = {
+    { "checkComm",                 MODEM_OP_AT,        MODEM_CLASS_QUERY },
+    { "getIdentity",               MODEM_OP_AT,        MODEM_CLASS_QUERY },
+    { "getOpState",                MODEM_OP_AT,        MODEM_CLASS_QUERY },
+    { "getRAT",                    MODEM_OP_AT,        MODEM_CLASS_QUERY },
+    { "getRadioBands",             MODEM_OP_AT,        MODEM_CLASS_QUERY },
+    { "setOpState(MINIMUM)",       MODEM_OP_OPSTATE,   MODEM_CLASS_RADIO },
+    { "setRAT(NB-IoT)",            MODEM_OP_RAT,       MODEM_CLASS_RADIO },
+    { "setOpState(FULL)",          MODEM_OP_OPSTATE,   MODEM_CLASS_RADIO },
+    { "getSIMState",               MODEM_OP_AT,        MODEM_CLASS_QUERY },
+    { "setNetworkSelectionMode",   MODEM_OP_AT,        MODEM_CLASS_CONFIG },
+    { "registration",              MODEM_OP_REGISTER,  MODEM_CLASS_COUNT },
+    { "getCellInformation",        MODEM_OP_CELL_INFO, MODEM_CLASS_QUERY },
+    { "definePDPContext",          MODEM_OP_AT,        MODEM_CLASS_CONFIG },
+    { "setPDPContextActive",       MODEM_OP_PDP,       MODEM_CLASS_PDP },
+    { "setNetworkAttachmentState", MODEM_OP_PDP,       MODEM_CLASS_PDP },
+    { "getPDPAddress",             MODEM_OP_AT,        MODEM_CLASS_QUERY },
+};
+#define CONNECT_STEP_COUNT (sizeof(CONNECT_STEPS) / sizeof(CONNECT_STEPS[0]))
+
+typedef enum { POLICY_BLOCKING, POLICY_DEADLINE, POLICY_COUNT } policy_t;
+
+static const char *const POLICY_NAMES[POLICY_COUNT] = { "blocking", "deadline" };
+
+struct SimResult {
+    uint32_t boots;
+    uint32_t connected;
+    uint32_t resets;
+    std::vector<double> connect_ms;     // Boot until connected or given up
+    modem_latency_t latency[MODEM_CLASS_COUNT];
+};
+
+static double percentile(std::vector<double> v, double p) {
+    if (v.empty()) return 0;
+    std::sort(v.begin(), v.end());
+    return v[std::min(v.size() - 1, (size_t)(p * (v.size() - 1) + 0.5))];
+}
+
+/**
+ * One connect_nbiot() attempt; returns true if connected
+ */
+static bool run_attempt(ModemSim *modem, policy_t policy, bool *wedged, uint32_t *overruns_in_row,
+                        SimResult *res) {
+    for (size_t i = 0; i < CONNECT_STEP_COUNT; i++) {
+        const connect_step_t &step = CONNECT_STEPS[i];
+        if (step.op == MODEM_OP_REGISTER) {
+            if (!modem->run(MODEM_OP_REGISTER, NETWORK_TIMEOUT_MS).ok) {
+                return false;
+            }
+            continue;
+        }
+
+        double budget = policy == POLICY_DEADLINE ? MODEM_CLASS_BUDGET_MS[step.cls] : 0;
+        modem_sim_result_t r;
+        if (*wedged) {
+            r = {};
+            r.hung = true;
+            r.ms = budget > 0 ? budget : MODEM_SIM_HANG_MS;
+            modem->advance(r.ms);
+        } else {
+            r = modem->run(step.op, budget);
+            if (r.hung && modem->uniform() < SIM_WEDGE_P) {
+                *wedged = true;
+            }
+        }
+
+        if (policy == POLICY_BLOCKING) {
+            if (r.hung) {
+                // Nothing bounds the wait; model it as MODEM_SIM_HANG_MS
+                // until a watchdog or operator power-cycles the board
+                *wedged = false;
+                return false;
+            }
+            if (!r.ok) return false;
+            continue;
+        }
+
+        modem_latency_record(&res->latency[step.cls], (uint32_t)r.ms, r.ok, r.hung);
+        if (r.hung) {
+            if (++*overruns_in_row >= MODEM_DEADLINE_RESET_AFTER) {
+                *overruns_in_row = 0;
+                modem->advance(SIM_RESET_MS);
+                *wedged = false;
+                res->resets++;
+            }
+            return false;
+        }
+        *overruns_in_row = 0;
+        if (!r.ok) return false;
+    }
+    return true;
+}
+
+static SimResult run(policy_t policy, double hang_p, int boots, uint64_t seed) {
+    SimResult res = {};
+    ModemSim modem(seed);
+    for (int op = 0; op < MODEM_OP_COUNT; op++) {
+        if (op != MODEM_OP_REGISTER) {
+            modem.model[op].hang_p = hang_p;
+        }
+    }
+
+    int attempts = policy == POLICY_DEADLINE ? CONNECT_ATTEMPTS : 1;
+    for (int b = 0; b < boots; b++) {
+        double start = modem.now_ms;
+        bool wedged = false;
+        uint32_t overruns_in_row = 0;
+        bool ok = false;
+        for (int a = 0; a < attempts && !ok; a++) {
+            modem.advance(CONNECT_FIXED_DELAY_MS);
+            ok = run_attempt(&modem, policy, &wedged, &overruns_in_row, &res);
+        }
+        res.boots++;
+        if (ok) res.connected++;
+        res.connect_ms.push_back(modem.now_ms - start);
+    }
+    return res;
+}
+
+static int g_slot_failures = 0;
+
+static void expect_slots(bool ok, const char *what) {
+    printf("  %-52s %s\n", what, ok ? "ok" : "FAIL");
+    if (!ok) {
+        g_slot_failures++;
+    }
+}
+
+/**
+ * Call slots through a reset with every slot abandoned, the way
+ * modem_call() and modem_deadline_abort() drive them
+ */
+static void check_slot_recovery(void) {
+    printf("call slots, modem not answering at all\n");
+    modem_slot_t slots[MODEM_CALL_SLOTS] = {};
+    uintptr_t tags[MODEM_CALL_SLOTS];
+
+    // Every call misses its deadline and keeps its slot
+    for (int n = 0; n < MODEM_CALL_SLOTS; n++) {
+        int i = modem_slot_take(slots);
+        tags[n] = modem_slot_tag(i, slots[i].gen);
+        slots[i].state = MODEM_SLOT_ABANDONED;
+    }
+    expect_slots(modem_slot_take(slots) < 0, "no free slot with every call abandoned");
+
+    // No free slot -> abort: the reset takes the abandoned slots back
+    expect_slots(modem_slot_reclaim(slots) == MODEM_CALL_SLOTS, "reset takes back every abandoned slot");
+    int reset = modem_slot_take(slots);
+    expect_slots(reset >= 0, "slot left for the reset itself");
+
+    // The reset times out as well
+    uintptr_t reset_tag = modem_slot_tag(reset, slots[reset].gen);
+    slots[reset].state = MODEM_SLOT_ABANDONED;
+    int i = modem_slot_take(slots);
+    expect_slots(i >= 0, "calls get slots after a reset that timed out");
+
+    // Answers for commands the reset dropped arrive after all
+    bool stale = true;
+    for (int n = 0; n < MODEM_CALL_SLOTS; n++) {
+        stale &= modem_slot_answer(slots, tags[n]) == MODEM_ANSWER_STALE;
+    }
+    expect_slots(stale && slots[i].state == MODEM_SLOT_PENDING, "answers for taken-back slots ignored");
+    slots[i].state = MODEM_SLOT_FREE;
+
+    // Next abort takes the reset's slot back; its late answer is ignored
+    expect_slots(modem_slot_reclaim(slots) == 1, "next reset takes back the timed-out reset");
+    int again = modem_slot_take(slots);
+    expect_slots(modem_slot_answer(slots, reset_tag) == MODEM_ANSWER_STALE &&
+                 modem_slot_answer(slots, modem_slot_tag(again, slots[again].gen)) == MODEM_ANSWER_WAKE,
+                 "current call answered, old reset answer ignored");
+
+    int taken = 0;
+    slots[again].state = MODEM_SLOT_FREE;
+    while (modem_slot_take(slots) >= 0) {
+        taken++;
+    }
+    expect_slots(taken == MODEM_CALL_SLOTS, "every slot usable again");
+    printf("\n");
+}
+
+static void print_latency(const char *label, uint32_t v) {
+    if (v == UINT32_MAX) {
+        printf(" %s=overrun", label);
+    } else {
+        printf(" %s<=%lu", label, (unsigned long)v);
+    }
+}
+
+int main(int argc, char **argv) {
+    int boots = argc > 1 ? atoi(argv[1]) : 20000;
+    uint64_t seed = argc > 2 ? strtoull(argv[2], NULL, 10) : 1;
+    static const double HANG_P[] = { 0.0, 0.005, 0.02 };
+
+    check_slot_recovery();
+
+    printf("%d boots, %zu modem calls per connect attempt, seed %llu\n\n", boots,
+           CONNECT_STEP_COUNT - 1, (unsigned long long)seed);
+    printf("%-8s %-9s %9s %9s %9s %9s %9s %7s\n", "hang_p", "policy", "connected",
+           "p50 s", "p95 s", "p99 s", "max s", "resets");
+
+    SimResult worst = {};
+    for (double hang_p : HANG_P) {
+        for (int p = 0; p < POLICY_COUNT; p++) {
+            SimResult r = run((policy_t)p, hang_p, boots, seed);
+            printf("%-8.3f %-9s %8.2f%% %9.1f %9.1f %9.1f %9.1f %7lu\n", hang_p, POLICY_NAMES[p],
+                   100.0 * r.connected / r.boots, percentile(r.connect_ms, 0.50) / 1000,
+                   percentile(r.connect_ms, 0.95) / 1000, percentile(r.connect_ms, 0.99) / 1000,
+                   percentile(r.connect_ms, 1.0) / 1000, (unsigned long)r.resets);
+            if (p == POLICY_DEADLINE) {
+                worst = r;
+            }
+        }
+    }
+
+    printf("\nper-class call latency, deadline policy at hang_p=%.3f (ms):\n", HANG_P[2]);
+    for (int c = 0; c < MODEM_CLASS_COUNT; c++) {
+        const modem_latency_t *lat = &worst.latency[c];
+        if (lat->calls == 0) continue;
+        printf("  %-6s budget=%-6lu calls=%-7lu overruns=%-5lu", MODEM_CLASS_NAMES[c],
+               (unsigned long)MODEM_CLASS_BUDGET_MS[c], (unsigned long)lat->calls,
+               (unsigned long)lat->overruns);
+        print_latency("p50", modem_latency_percentile(lat, 50));
+        print_latency("p99", modem_latency_percentile(lat, 99));
+        printf(" max=%lu\n", (unsigned long)lat->max_ms);
+    }
+    return g_slot_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,101 @@
+/**
+ * Synthetic Connect Trace
+ *
+ * WMT1 trace (main/modem_trace.h) of the connect_nbiot() sequence as the
+ * library sends it to a Sequans GM02S, with modem_sim.h timing and RX
+ * split into uneven UART reads. Shared by `modem_trace synth` and the
+ * connect-path benchmarks in host_bench.
+ */
+
+#ifndef CONNECT_TRACE_H
+#define CONNECT_TRACE_H
+
+#include <stdint.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "modem_sim.h"
+#include "modem_trace.h"
+
+struct SynthStep {
+    const char *command;
+    modem_op_t op;
+    const char *response;           // Lines before the final OK
+};
+
+static const SynthStep SYNTH_CONNECT[] = {
+    { "AT",                          MODEM_OP_AT,        NULL },
+    { "AT+CGSN=1",                   MODEM_OP_AT,        "+CGSN: \"351234567890123\"" },
+    { "AT+CFUN?",                    MODEM_OP_AT,        "+CFUN: 0" },
+    { "AT+SQNMODEACTIVE?",           MODEM_OP_AT,        "+SQNMODEACTIVE: 2" },
+    { "AT+SQNBANDSEL?",              MODEM_OP_AT,        "+SQNBANDSEL: 0,standard,\"3,8,20\"" },
+    { "AT+CFUN=0",                   MODEM_OP_OPSTATE,   NULL },
+    { "AT+SQNMODEACTIVE=2",          MODEM_OP_RAT,       NULL },
+    { "AT+CFUN=1",                   MODEM_OP_OPSTATE,   NULL },
+    { "AT+CPIN?",                    MODEM_OP_AT,        "+CPIN: READY" },
+    { "AT+COPS=0",                   MODEM_OP_AT,        NULL },
+    { NULL,                          MODEM_OP_REGISTER,  "+CEREG: 1,\"00C3\",\"0102A8F1\",9" },
+    { "AT+SQNMONI=9",                MODEM_OP_CELL_INFO, "+SQNMONI: Orange F Cc:208 Nc:01 RSRP:-95.27 CINR:-0.50 RSRQ:-10.40 TAC:49 Id:15962 EARFCN:6300 PWR:-68.98 PAGING:128" },
+    { "AT+CGDCONT=1,\"IP\",\"soracom.io\"", MODEM_OP_AT, NULL },
+    { "AT+CGACT=1,1",                MODEM_OP_PDP,       NULL },
+    { "AT+CGATT=1",                  MODEM_OP_PDP,       NULL },
+    { "AT+CGPADDR=1",                MODEM_OP_AT,        "+CGPADDR: 1,\"10.0.0.1\"" },
+};
+
+static bool connect_trace_sink(void *ctx, uint32_t offset, const uint8_t *data, size_t len) {
+    std::vector<uint8_t> *out = (std::vector<uint8_t> *)ctx;
+    out->resize(offset);
+    out->insert(out->end(), data, data + len);
+    return true;
+}
+
+/**
+ * Deliver RX bytes the way UART reads return them: in uneven pieces
+ */
+static void connect_trace_rx(modem_trace_writer_t *w, ModemSim *sim, const std::string &text) {
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t n = std::min(text.size() - pos, (size_t)(8 + sim->rng()() % 120));
+        modem_trace_append(w, MODEM_TRACE_RX, (uint32_t)sim->now_ms, text.data() + pos, n);
+        pos += n;
+        sim->advance(n * 10.0 / 115.2);     // 115200 baud, 10 bits per byte
+    }
+}
+
+/**
+ * Write one connect sequence into out
+ *
+ * @return Records written; the simulated duration is left in sim->now_ms
+ */
+static uint32_t connect_trace_synth(ModemSim *sim, std::vector<uint8_t> *out) {
+    out->clear();
+    modem_trace_writer_t *w = new modem_trace_writer_t;
+    modem_trace_writer_init(w, connect_trace_sink, out, UINT32_MAX, 0);
+    modem_trace_append(w, MODEM_TRACE_MARK, 0, "synth", 5);
+    sim->advance(1000);
+
+    for (const SynthStep &step : SYNTH_CONNECT) {
+        if (step.command == NULL) {
+            connect_trace_rx(w, sim, "\r\n+CEREG: 2\r\n");
+            modem_sim_result_t r = sim->run(step.op);
+            connect_trace_rx(w, sim, r.ok ? std::string("\r\n") + step.response + "\r\n"
+                                          : std::string("\r\n+CEREG: 3\r\n"));
+            sim->advance(5000);             // Registration poll interval
+            continue;
+        }
+        std::string cmd = std::string(step.command) + "\r";
+        modem_trace_append(w, MODEM_TRACE_TX, (uint32_t)sim->now_ms, cmd.data(), cmd.size());
+        modem_sim_result_t r = sim->run(step.op);
+        std::string rsp;
+        if (r.ok && step.response != NULL) rsp += std::string("\r\n") + step.response + "\r\n";
+        rsp += r.ok ? "\r\nOK\r\n" : "\r\n+CME ERROR: 3\r\n";
+        connect_trace_rx(w, sim, rsp);
+        sim->advance(500);                  // vTaskDelay between steps
+    }
+    modem_trace_flush(w);
+    uint32_t records = w->records;
+    delete w;
+    return records;
+}
+
+#endif // CONNECT_TRACE_H
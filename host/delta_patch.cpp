@@ -0,0 +1,513 @@
+/**
+ * Delta Patch Generator and Applier Check
+ *
+ * Makes firmware delta patches in the format main/delta_ota.h applies,
+ * and runs that applier against file-backed "partitions":
+ *
+ *   delta_patch diff <old.bin> <new.bin> <patch>   write a patch
+ *   delta_patch apply <old.bin> <patch> <out.bin>  apply it like the device
+ *   delta_patch check [old.bin new.bin]            round trip + fault cases
+ *
+ * The generator matches 8-byte anchors of the new image against the old
+ * one and extends each match forward while it mostly agrees (bsdiff
+ * style), so code that only moved, or only had addresses shifted, turns
+ * into mostly-zero diff bytes that the ADD op run-length codes.
+ *
+ * "check" without files synthesizes a firmware-like pair: code with
+ * embedded absolute addresses, a function inserted in the middle (which
+ * shifts every later address), an edited function and a new version
+ * string. It applies the patch in random chunk sizes, interrupts and
+ * resumes from checkpoints, and checks that corrupted or mismatched
+ * patches are rejected.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+#include "delta_ota.h"
+#include "sha256.h"
+
+typedef std::vector<uint8_t> Bytes;
+
+#define DIFF_ANCHOR 8               // Bytes hashed to find match candidates
+#define DIFF_MIN_MATCH 16           // Exact bytes needed to start an ADD
+#define DIFF_MAX_CANDIDATES 64      // Hash chain entries tried per position
+#define DIFF_SLACK 24               // Mismatch budget when extending a match
+#define DIFF_HASH_BITS 20
+
+// ----------------------------------------------------------------------------
+// Generator
+// ----------------------------------------------------------------------------
+
+static void put_varint(Bytes *out, uint32_t v) {
+    while (v >= 0x80) {
+        out->push_back((uint8_t)(v | 0x80));
+        v >>= 7;
+    }
+    out->push_back((uint8_t)v);
+}
+
+static void put_u32(Bytes *out, uint32_t v) {
+    for (int i = 0; i < 4; i++) out->push_back((uint8_t)(v >> (8 * i)));
+}
+
+static inline uint32_t anchor_hash(const uint8_t *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return (uint32_t)((v * 0x9E3779B97F4A7C15ull) >> (64 - DIFF_HASH_BITS));
+}
+
+static void emit_insert(Bytes *patch, const uint8_t *data, size_t len) {
+    if (len == 0) return;
+    patch->push_back(DELTA_OP_INSERT);
+    put_varint(patch, (uint32_t)len);
+    patch->insert(patch->end(), data, data + len);
+}
+
+/**
+ * ADD op: zero runs and literal diff bytes, alternating
+ */
+static void emit_add(Bytes *patch, const Bytes &oldi, const Bytes &newi, size_t src,
+                     size_t dst, size_t len, uint32_t *old_cursor) {
+    patch->push_back(DELTA_OP_ADD);
+    put_varint(patch, (uint32_t)len);
+    int32_t delta = (int32_t)(src - *old_cursor);
+    put_varint(patch, ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31));
+    size_t k = 0;
+    while (k < len) {
+        size_t zeros = 0;
+        while (k + zeros < len && oldi[src + k + zeros] == newi[dst + k + zeros]) zeros++;
+        put_varint(patch, (uint32_t)zeros);
+        k += zeros;
+        if (k == len) break;
+        // Literal run ends at the first stretch of 4 unchanged bytes
+        size_t lits = 0;
+        while (k + lits < len) {
+            size_t same = 0;
+            while (same < 4 && k + lits + same < len &&
+                   oldi[src + k + lits + same] == newi[dst + k + lits + same]) same++;
+            if (same == 4) break;
+            lits += same + 1;
+        }
+        lits = std::min(lits, len - k);
+        put_varint(patch, (uint32_t)lits);
+        for (size_t j = 0; j < lits; j++) {
+            patch->push_back((uint8_t)(newi[dst + k + j] - oldi[src + k + j]));
+        }
+        k += lits;
+    }
+    *old_cursor = (uint32_t)(src + len);
+}
+
+static Bytes make_patch(const Bytes &oldi, const Bytes &newi) {
+    Bytes patch(DELTA_MAGIC, DELTA_MAGIC + 4);
+    uint8_t hash[DELTA_SHA256_SIZE];
+    put_u32(&patch, (uint32_t)oldi.size());
+    sha256(oldi.data(), oldi.size(), hash);
+    patch.insert(patch.end(), hash, hash + sizeof(hash));
+    put_u32(&patch, (uint32_t)newi.size());
+    sha256(newi.data(), newi.size(), hash);
+    patch.insert(patch.end(), hash, hash + sizeof(hash));
+
+    // Hash chains over every anchor position of the old image
+    std::vector<int32_t> head(1u << DIFF_HASH_BITS, -1);
+    std::vector<int32_t> prev(oldi.size(), -1);
+    for (size_t p = 0; p + DIFF_ANCHOR <= oldi.size(); p++) {
+        uint32_t h = anchor_hash(&oldi[p]);
+        prev[p] = head[h];
+        head[h] = (int32_t)p;
+    }
+
+    uint32_t old_cursor = 0;
+    int64_t last_shift = 0;         // old - new offset of the previous match
+    size_t lit_start = 0;
+    size_t i = 0;
+    while (i < newi.size()) {
+        size_t best_len = 0, best_pos = 0;
+        auto try_candidate = [&](size_t p) {
+            size_t n = 0;
+            while (p + n < oldi.size() && i + n < newi.size() && oldi[p + n] == newi[i + n]) n++;
+            if (n > best_len) {
+                best_len = n;
+                best_pos = p;
+            }
+        };
+        int64_t aligned = (int64_t)i + last_shift;
+        if (aligned >= 0 && (size_t)aligned < oldi.size()) {
+            try_candidate((size_t)aligned);
+        }
+        if (i + DIFF_ANCHOR <= newi.size()) {
+            int32_t p = head[anchor_hash(&newi[i])];
+            for (int n = 0; p >= 0 && n < DIFF_MAX_CANDIDATES; n++, p = prev[p]) {
+                try_candidate((size_t)p);
+            }
+        }
+        if (best_len < DIFF_MIN_MATCH) {
+            i++;
+            continue;
+        }
+
+        // Extend through small differences while matches outweigh them
+        size_t len = best_len;
+        int score = 0, best_score = 0;
+        for (size_t k = best_len; best_pos + k < oldi.size() && i + k < newi.size(); k++) {
+            score += oldi[best_pos + k] == newi[i + k] ? 1 : -1;
+            if (score > best_score) {
+                best_score = score;
+                len = k + 1;
+            } else if (score < best_score - DIFF_SLACK) {
+                break;
+            }
+        }
+        emit_insert(&patch, &newi[lit_start], i - lit_start);
+        emit_add(&patch, oldi, newi, best_pos, i, len, &old_cursor);
+        last_shift = (int64_t)best_pos - (int64_t)i;
+        i += len;
+        lit_start = i;
+    }
+    emit_insert(&patch, &newi[lit_start], newi.size() - lit_start);
+    patch.push_back(DELTA_OP_END);
+    return patch;
+}
+
+// ----------------------------------------------------------------------------
+// File-backed partitions for the applier
+// ----------------------------------------------------------------------------
+
+struct FlashFiles {
+    FILE *old_file;
+    FILE *target;
+    uint32_t sectors_written;
+};
+
+static bool file_header(void *ctx, const delta_header_t *h) {
+    FlashFiles *f = (FlashFiles *)ctx;
+    sha256_ctx_t sha;
+    sha256_init(&sha);
+    uint8_t buf[4096];
+    fseek(f->old_file, 0, SEEK_SET);
+    uint32_t left = h->old_size;
+    while (left > 0) {
+        size_t n = fread(buf, 1, std::min<size_t>(left, sizeof(buf)), f->old_file);
+        if (n == 0) return false;
+        sha256_update(&sha, buf, n);
+        left -= (uint32_t)n;
+    }
+    uint8_t hash[DELTA_SHA256_SIZE];
+    sha256_final(&sha, hash);
+    return memcmp(hash, h->old_sha256, sizeof(hash)) == 0;
+}
+
+static bool file_read_old(void *ctx, uint32_t offset, uint8_t *buf, size_t len) {
+    FlashFiles *f = (FlashFiles *)ctx;
+    return fseek(f->old_file, offset, SEEK_SET) == 0 && fread(buf, 1, len, f->old_file) == len;
+}
+
+static bool file_write_sector(void *ctx, uint32_t offset, const uint8_t *buf, size_t len) {
+    FlashFiles *f = (FlashFiles *)ctx;
+    if (offset % DELTA_SECTOR_SIZE != 0 || len > DELTA_SECTOR_SIZE) return false;
+    // Erase (0xFF) then program, like NOR flash
+    uint8_t sector[DELTA_SECTOR_SIZE];
+    memset(sector, 0xff, sizeof(sector));
+    memcpy(sector, buf, len);
+    f->sectors_written++;
+    return fseek(f->target, offset, SEEK_SET) == 0 &&
+           fwrite(sector, 1, sizeof(sector), f->target) == sizeof(sector) && fflush(f->target) == 0;
+}
+
+static bool read_file(const char *path, Bytes *out) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) return false;
+    uint8_t buf[65536];
+    size_t n;
+    out->clear();
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) out->insert(out->end(), buf, buf + n);
+    fclose(f);
+    return true;
+}
+
+static bool write_file(const char *path, const Bytes &data) {
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) return false;
+    bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+    return fclose(f) == 0 && ok;
+}
+
+/**
+ * Apply through the firmware applier in chunks of up to max_chunk bytes
+ *
+ * If interrupt_at is set, the run stops once that many patch bytes were
+ * fed (like a dropped connection or power loss) and continues from the
+ * last checkpoint with a fresh applier.
+ */
+static delta_status_t apply_files(const char *old_path, const Bytes &patch, const char *out_path,
+                                  std::mt19937 *rng, size_t max_chunk,
+                                  const std::vector<size_t> &interrupt_at, Bytes *result,
+                                  uint32_t *sectors, uint32_t *resumes) {
+    FlashFiles files = { fopen(old_path, "rb"), fopen(out_path, "w+b"), 0 };
+    if (files.old_file == NULL || files.target == NULL) return DELTA_ERR_IO;
+    delta_io_t io = { &files, file_header, file_read_old, file_write_sector };
+
+    static delta_applier_t ap;      // Same footprint as on the device
+    delta_applier_init(&ap, &io);
+    delta_status_t st = DELTA_OK;
+    size_t next_interrupt = 0;
+    size_t pos = 0;
+    *resumes = 0;
+    while (st == DELTA_OK && pos < patch.size()) {
+        size_t n = std::min(patch.size() - pos, 1 + (size_t)((*rng)() % max_chunk));
+        if (next_interrupt < interrupt_at.size() && pos + n > interrupt_at[next_interrupt]) {
+            n = interrupt_at[next_interrupt] - pos;
+        }
+        st = delta_feed(&ap, &patch[pos], n);
+        pos += n;
+        if (st == DELTA_OK && next_interrupt < interrupt_at.size() &&
+            pos == interrupt_at[next_interrupt]) {
+            next_interrupt++;
+            delta_cursor_t ckpt = ap.checkpoint;       // What NVS would hold
+            if (!delta_applier_resume(&ap, &io, &ckpt)) {
+                st = DELTA_ERR_FORMAT;
+                break;
+            }
+            pos = ckpt.patch_pos;
+            (*resumes)++;
+        }
+    }
+    if (st == DELTA_DONE && result != NULL) {
+        result->resize(ap.header.new_size);
+        fseek(files.target, 0, SEEK_SET);
+        if (fread(result->data(), 1, result->size(), files.target) != result->size()) {
+            st = DELTA_ERR_IO;
+        }
+    }
+    *sectors = files.sectors_written;
+    fclose(files.old_file);
+    fclose(files.target);
+    return st;
+}
+
+// ----------------------------------------------------------------------------
+// Synthetic firmware
+// ----------------------------------------------------------------------------
+
+#define SYN_IMAGE_SIZE (1200 * 1024)
+#define SYN_BASE_ADDR 0x42000020u
+
+/**
+ * Code-like bytes with a 32-bit absolute address every 12-40 bytes
+ *
+ * Addresses are stored as offsets first and resolved by relocate().
+ */
+static void synth_code(std::mt19937 *rng, size_t size, Bytes *code, std::vector<size_t> *relocs,
+                       size_t image_size) {
+    static const uint8_t ops[] = { 0x36, 0x41, 0x00, 0x0c, 0x1d, 0xf0, 0x81, 0xa5, 0x20,
+                                   0x82, 0x92, 0xe0, 0x08, 0x00, 0xc1, 0x06, 0x22, 0x2d };
+    size_t start = code->size();
+    while (code->size() - start < size) {
+        size_t n = 12 + (*rng)() % 28;
+        for (size_t k = 0; k < n; k++) code->push_back(ops[(*rng)() % sizeof(ops)]);
+        relocs->push_back(code->size());
+        uint32_t target = (uint32_t)((*rng)() % image_size);
+        for (int k = 0; k < 4; k++) code->push_back((uint8_t)(target >> (8 * k)));
+    }
+}
+
+static void relocate(Bytes *image, const std::vector<size_t> &relocs, size_t insert_at,
+                     size_t inserted) {
+    for (size_t r : relocs) {
+        uint32_t target;
+        memcpy(&target, &(*image)[r], 4);
+        if (target >= insert_at) target += (uint32_t)inserted;
+        target += SYN_BASE_ADDR;
+        memcpy(&(*image)[r], &target, 4);
+    }
+}
+
+static void synth_pair(Bytes *oldi, Bytes *newi) {
+    std::mt19937 rng(7);
+    Bytes code;
+    std::vector<size_t> relocs;
+    synth_code(&rng, SYN_IMAGE_SIZE - 64 * 1024, &code, &relocs, SYN_IMAGE_SIZE);
+    Bytes rodata(64 * 1024);
+    for (size_t k = 0; k < rodata.size(); k++) rodata[k] = "walter modem ok\n"[k % 16];
+
+    // Old: code + rodata with "v1.4.0"
+    Bytes old_code = code;
+    relocate(&old_code, relocs, SIZE_MAX, 0);
+    *oldi = old_code;
+    oldi->insert(oldi->end(), rodata.begin(), rodata.end());
+    memcpy(&(*oldi)[oldi->size() - 4096], "v1.4.0", 6);
+
+    // New: 3 KB function inserted at 40%, addresses behind it shift,
+    // a 600-byte function at 70% rewritten, version bumped
+    size_t insert_at = code.size() * 2 / 5;
+    Bytes func;
+    std::vector<size_t> func_relocs;
+    synth_code(&rng, 3 * 1024, &func, &func_relocs, SYN_IMAGE_SIZE);
+    for (size_t &r : relocs) if (r >= insert_at) r += func.size();
+    for (size_t r : func_relocs) relocs.push_back(r + insert_at);
+    Bytes new_code = code;
+    new_code.insert(new_code.begin() + insert_at, func.begin(), func.end());
+    size_t edit_at = new_code.size() * 7 / 10;
+    for (size_t k = 0; k < 600; k++) new_code[edit_at + k] ^= (uint8_t)(rng() | 1);
+    relocs.erase(std::remove_if(relocs.begin(), relocs.end(), [&](size_t r) {
+        return r + 4 > edit_at && r < edit_at + 600;
+    }), relocs.end());
+    relocate(&new_code, relocs, insert_at, func.size());
+    *newi = new_code;
+    newi->insert(newi->end(), rodata.begin(), rodata.end());
+    memcpy(&(*newi)[newi->size() - 4096], "v1.5.0", 6);
+}
+
+// ----------------------------------------------------------------------------
+// Commands
+// ----------------------------------------------------------------------------
+
+static void print_sizes(const Bytes &oldi, const Bytes &newi, const Bytes &patch) {
+    printf("old image   %8zu B\n", oldi.size());
+    printf("new image   %8zu B\n", newi.size());
+    printf("patch       %8zu B  (%.2f%% of the new image, %.1fx smaller)\n", patch.size(),
+           100.0 * patch.size() / newi.size(), (double)newi.size() / patch.size());
+}
+
+static int cmd_diff(const char *old_path, const char *new_path, const char *patch_path) {
+    Bytes oldi, newi;
+    if (!read_file(old_path, &oldi) || !read_file(new_path, &newi)) {
+        fprintf(stderr, "cannot read input images\n");
+        return 1;
+    }
+    Bytes patch = make_patch(oldi, newi);
+    if (!write_file(patch_path, patch)) {
+        fprintf(stderr, "cannot write %s\n", patch_path);
+        return 1;
+    }
+    print_sizes(oldi, newi, patch);
+    return 0;
+}
+
+static int cmd_apply(const char *old_path, const char *patch_path, const char *out_path) {
+    Bytes patch;
+    if (!read_file(patch_path, &patch)) {
+        fprintf(stderr, "cannot read %s\n", patch_path);
+        return 1;
+    }
+    std::mt19937 rng(1);
+    Bytes result;
+    uint32_t sectors, resumes;
+    delta_status_t st = apply_files(old_path, patch, out_path, &rng, DELTA_SECTOR_SIZE, {},
+                                    &result, &sectors, &resumes);
+    if (st != DELTA_DONE) {
+        fprintf(stderr, "apply failed: %s\n", delta_status_str(st));
+        return 1;
+    }
+    uint8_t hash[DELTA_SHA256_SIZE];
+    sha256(result.data(), result.size(), hash);
+    if (memcmp(hash, patch.data() + 44, sizeof(hash)) != 0) {
+        fprintf(stderr, "new image hash mismatch\n");
+        return 1;
+    }
+    // Partition files are sector padded; trim to the image
+    if (!write_file(out_path, result)) return 1;
+    printf("applied: %zu B image, %u sectors written, hash OK\n", result.size(), sectors);
+    return 0;
+}
+
+static int failures = 0;
+
+static void expect(bool ok, const char *what) {
+    printf("  %-52s %s\n", what, ok ? "ok" : "FAIL");
+    if (!ok) failures++;
+}
+
+static int cmd_check(const char *old_path, const char *new_path) {
+    Bytes oldi, newi;
+    if (old_path != NULL) {
+        if (!read_file(old_path, &oldi) || !read_file(new_path, &newi)) {
+            fprintf(stderr, "cannot read input images\n");
+            return 1;
+        }
+    } else {
+        synth_pair(&oldi, &newi);
+        printf("synthetic firmware: 3 KB function inserted, 600 B edited, addresses shifted\n");
+    }
+    std::string tmp = "/tmp/delta_patch_check_" + std::to_string(getpid());
+    std::string old_file = tmp + ".old", out_file = tmp + ".out";
+    write_file(old_file.c_str(), oldi);
+
+    Bytes patch = make_patch(oldi, newi);
+    print_sizes(oldi, newi, patch);
+    printf("applier RAM %8zu B\n\n", sizeof(delta_applier_t));
+
+    std::mt19937 rng(42);
+    Bytes result;
+    uint32_t sectors, resumes;
+    delta_status_t st;
+
+    st = apply_files(old_file.c_str(), patch, out_file.c_str(), &rng, 1500, {}, &result,
+                     &sectors, &resumes);
+    expect(st == DELTA_DONE && result == newi, "random chunks up to 1500 B");
+
+    st = apply_files(old_file.c_str(), patch, out_file.c_str(), &rng, 1, {}, &result,
+                     &sectors, &resumes);
+    expect(st == DELTA_DONE && result == newi, "one byte at a time");
+
+    std::vector<size_t> cuts;
+    for (int k = 1; k <= 5; k++) cuts.push_back(patch.size() * k / 6 + (size_t)k * 7);
+    st = apply_files(old_file.c_str(), patch, out_file.c_str(), &rng, 1024, cuts, &result,
+                     &sectors, &resumes);
+    expect(st == DELTA_DONE && result == newi && resumes == cuts.size(),
+           "5 interruptions, resumed from checkpoints");
+
+    Bytes other = oldi;
+    other[other.size() / 2] ^= 1;
+    write_file(old_file.c_str(), other);
+    st = apply_files(old_file.c_str(), patch, out_file.c_str(), &rng, 1024, {}, &result,
+                     &sectors, &resumes);
+    expect(st == DELTA_ERR_BASE, "rejects a different base image");
+    write_file(old_file.c_str(), oldi);
+
+    Bytes corrupt = patch;
+    corrupt[DELTA_HEADER_SIZE + corrupt.size() / 3] ^= 0x5a;
+    st = apply_files(old_file.c_str(), corrupt, out_file.c_str(), &rng, 1024, {}, &result,
+                     &sectors, &resumes);
+    bool caught = st != DELTA_DONE;
+    if (!caught) {
+        uint8_t hash[DELTA_SHA256_SIZE];
+        sha256(result.data(), result.size(), hash);
+        caught = memcmp(hash, patch.data() + 44, sizeof(hash)) != 0;
+    }
+    expect(caught, "corrupted patch caught (format or final hash)");
+
+    Bytes truncated(patch.begin(), patch.end() - 1);
+    st = apply_files(old_file.c_str(), truncated, out_file.c_str(), &rng, 1024, {}, &result,
+                     &sectors, &resumes);
+    expect(st == DELTA_OK, "truncated patch does not complete");
+
+    remove(old_file.c_str());
+    remove(out_file.c_str());
+    printf("\n%s\n", failures == 0 ? "all checks passed" : "CHECKS FAILED");
+    return failures == 0 ? 0 : 1;
+}
+
+static int usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s diff <old.bin> <new.bin> <patch>\n"
+            "       %s apply <old.bin> <patch> <out.bin>\n"
+            "       %s check [old.bin new.bin]\n", prog, prog, prog);
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) return usage(argv[0]);
+    std::string cmd = argv[1];
+    if (cmd == "diff" && argc == 5) return cmd_diff(argv[2], argv[3], argv[4]);
+    if (cmd == "apply" && argc == 5) return cmd_apply(argv[2], argv[3], argv[4]);
+    if (cmd == "check" && argc == 2) return cmd_check(NULL, NULL);
+    if (cmd == "check" && argc == 4) return cmd_check(argv[2], argv[3]);
+    return usage(argv[0]);
+}
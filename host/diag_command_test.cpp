@@ -0,0 +1,139 @@
+/**
+ * Console Command Parser Check
+ *
+ * Runs main/diag_command.h, which has no ESP-IDF dependencies, over valid
+ * commands, unknown commands, wrong argument counts, bad arguments and
+ * lines longer than any of the parser's buffers. Every line is parsed from
+ * a heap copy of exactly its length, so an overrun shows up under ASan or
+ * valgrind.
+ *
+ * Built by this plain CMake project rather than as an ESP-IDF Linux
+ * target app: the main component (WalterModem, the UART tap, partitions)
+ * does not build for the Linux target, and the parser needs none of it.
+ *
+ *   diag_command_test    exit status 0 if all checks pass
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include "diag_command.h"
+
+static int failures = 0;
+
+static void expect(bool ok, const char *what) {
+    printf("  %-52s %s\n", what, ok ? "ok" : "FAIL");
+    if (!ok) {
+        failures++;
+    }
+}
+
+static diag_parse_result_t parse(const std::string &line, diag_command_t *out) {
+    char *copy = (char *)malloc(line.size() + 1);
+    memcpy(copy, line.c_str(), line.size() + 1);
+    diag_parse_result_t result = diag_command_parse_line(copy, out);
+    free(copy);
+    return result;
+}
+
+static void expect_result(const std::string &line, diag_parse_result_t expected) {
+    diag_command_t cmd;
+    diag_parse_result_t result = parse(line, &cmd);
+    std::string shown = line.size() > 30 ? line.substr(0, 30) + "..." : line;
+    for (char &c : shown) {
+        c = isprint((unsigned char)c) ? c : '.';
+    }
+    char what[128];
+    snprintf(what, sizeof(what), "\"%s\" -> %s", shown.c_str(), diag_parse_result_str(expected));
+    expect(result == expected, what);
+}
+
+static void check_valid(void) {
+    printf("valid commands\n");
+    diag_command_t cmd;
+    expect(parse("diag", &cmd) == DIAG_PARSE_OK && cmd.id == DIAG_CMD_DIAG, "diag");
+    expect(parse("diag full", &cmd) == DIAG_PARSE_OK && cmd.id == DIAG_CMD_DIAG_FULL, "diag full");
+    expect(parse("rat", &cmd) == DIAG_PARSE_OK && cmd.id == DIAG_CMD_RAT, "rat");
+    expect(parse("coverage", &cmd) == DIAG_PARSE_OK && cmd.id == DIAG_CMD_COVERAGE, "coverage");
+    expect(parse("setrat nbiot", &cmd) == DIAG_PARSE_OK && cmd.id == DIAG_CMD_SET_RAT &&
+           cmd.rat == DIAG_RAT_NBIOT, "setrat nbiot");
+    expect(parse("setrat ltem", &cmd) == DIAG_PARSE_OK && cmd.id == DIAG_CMD_SET_RAT &&
+           cmd.rat == DIAG_RAT_LTEM, "setrat ltem");
+    expect(parse("at AT+CEREG?", &cmd) == DIAG_PARSE_OK && cmd.id == DIAG_CMD_AT &&
+           strcmp(cmd.at, "AT+CEREG?") == 0, "at AT+CEREG?");
+    expect(parse("stats", &cmd) == DIAG_PARSE_OK && cmd.id == DIAG_CMD_STATS, "stats");
+    expect(parse("ota https://example.com/u.wdp", &cmd) == DIAG_PARSE_OK && cmd.id == DIAG_CMD_OTA &&
+           strcmp(cmd.url, "https://example.com/u.wdp") == 0, "ota <url>");
+    expect(parse("trace start", &cmd) == DIAG_PARSE_OK && cmd.trace == DIAG_TRACE_START, "trace start");
+    expect(parse("trace stop", &cmd) == DIAG_PARSE_OK && cmd.trace == DIAG_TRACE_STOP, "trace stop");
+    expect(parse("trace dump", &cmd) == DIAG_PARSE_OK && cmd.id == DIAG_CMD_TRACE &&
+           cmd.trace == DIAG_TRACE_DUMP, "trace dump");
+    expect(parse("  \tsetrat\t ltem \r\n", &cmd) == DIAG_PARSE_OK && cmd.rat == DIAG_RAT_LTEM,
+           "surrounding and repeated whitespace");
+
+    // Every table entry is handled (a new entry without a parse branch
+    // would come back OK with id NONE)
+    bool all = true;
+    for (size_t i = 0; i < DIAG_COMMAND_COUNT; i++) {
+        diag_parse_result_t result = parse(DIAG_COMMANDS[i].name, &cmd);
+        all &= result != DIAG_PARSE_UNKNOWN && (result != DIAG_PARSE_OK || cmd.id != DIAG_CMD_NONE);
+    }
+    expect(all, "every table entry parses to a command");
+}
+
+static void check_rejected(void) {
+    printf("rejected commands\n");
+    expect_result("", DIAG_PARSE_EMPTY);
+    expect_result(" \t\r\n", DIAG_PARSE_EMPTY);
+    expect_result("reboot", DIAG_PARSE_UNKNOWN);
+    expect_result("DIAG", DIAG_PARSE_UNKNOWN);
+    expect_result("diagfull", DIAG_PARSE_UNKNOWN);
+    expect_result("setrat", DIAG_PARSE_MISSING_ARG);
+    expect_result("at", DIAG_PARSE_MISSING_ARG);
+    expect_result("ota", DIAG_PARSE_MISSING_ARG);
+    expect_result("trace", DIAG_PARSE_MISSING_ARG);
+    expect_result("rat now", DIAG_PARSE_TOO_MANY_ARGS);
+    expect_result("stats all", DIAG_PARSE_TOO_MANY_ARGS);
+    expect_result("diag full now", DIAG_PARSE_TOO_MANY_ARGS);
+    expect_result("at AT+COPS=1, 2", DIAG_PARSE_TOO_MANY_ARGS);
+    expect_result("diag a b c d e f g", DIAG_PARSE_TOO_MANY_ARGS);
+    expect_result("diag quick", DIAG_PARSE_BAD_ARG);
+    expect_result("setrat gsm", DIAG_PARSE_BAD_ARG);
+    expect_result("at +CEREG?", DIAG_PARSE_BAD_ARG);
+    expect_result("at A", DIAG_PARSE_BAD_ARG);
+    expect_result("at AT\x01", DIAG_PARSE_BAD_ARG);
+    expect_result("ota ftp://example.com/u.wdp", DIAG_PARSE_BAD_ARG);
+    expect_result("trace pause", DIAG_PARSE_BAD_ARG);
+}
+
+static void check_oversized(void) {
+    printf("oversized lines\n");
+    diag_command_t cmd;
+    std::string at = "AT+" + std::string(DIAG_AT_CMD_MAX - 4, 'X');
+    expect(parse("at " + at, &cmd) == DIAG_PARSE_OK && strcmp(cmd.at, at.c_str()) == 0,
+           "AT command filling the buffer");
+    expect_result("at " + at + "X", DIAG_PARSE_BAD_ARG);
+    expect_result("at AT+" + std::string(4096, 'X'), DIAG_PARSE_BAD_ARG);
+
+    std::string url = "http://" + std::string(DIAG_URL_MAX - 8, 'u');
+    expect(parse("ota " + url, &cmd) == DIAG_PARSE_OK && strcmp(cmd.url, url.c_str()) == 0,
+           "URL filling the buffer");
+    expect_result("ota " + url + "u", DIAG_PARSE_BAD_ARG);
+
+    expect_result(std::string(4096, 'd'), DIAG_PARSE_UNKNOWN);
+    std::string many;
+    for (int i = 0; i < 1000; i++) {
+        many += "x ";
+    }
+    expect_result("diag " + many, DIAG_PARSE_TOO_MANY_ARGS);
+}
+
+int main(void) {
+    check_valid();
+    check_rejected();
+    check_oversized();
+
+    printf("%s\n", failures == 0 ? "all checks passed" : "CHECKS FAILED");
+    return failures == 0 ? 0 : 1;
+}
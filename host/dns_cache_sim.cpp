@@ -0,0 +1,155 @@
+/**
+ * DNS Cache Simulation
+ *
+ * Replays days of uploads against the modem simulator and compares how
+ * the upload server gets resolved:
+ *
+ *   none        modem resolves the host name on every upload
+ *   ram         in-memory cache, lost on every reboot, blocking refresh
+ *   persistent  main/dns_cache.h: NVS-backed, stale entries are served
+ *               and refreshed after the session
+ *
+ * Reboots are cold (no network time), so persisted entries come back as
+ * "due for refresh", exactly as dns_cache_init() loads them. Latency is
+ * per upload: DNS time on the upload path plus the HTTP post.
+ *
+ * Usage: dns_cache_sim [days] [uploads_per_day] [reboots_per_day] [seed]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+#include "dns_cache.h"
+#include "modem_sim.h"
+
+#define SIM_HOST "upload.example"
+#define SIM_HOST_IP 0xC0000201u     // 192.0.2.1
+
+typedef enum { POLICY_NONE, POLICY_RAM, POLICY_PERSISTENT, POLICY_COUNT } policy_t;
+
+static const char *const POLICY_NAMES[POLICY_COUNT] = { "none", "ram", "persistent" };
+
+struct SimResult {
+    uint32_t uploads;
+    uint32_t lookups;           // All AT+SQNDNSLKUP sent
+    uint32_t blocking;          // Lookups on the upload path
+    uint32_t failed_uploads;    // Upload aborted because the name did not resolve
+    std::vector<double> upload_ms;
+};
+
+static double percentile(std::vector<double> v, double p) {
+    if (v.empty()) return 0;
+    std::sort(v.begin(), v.end());
+    return v[std::min(v.size() - 1, (size_t)(p * (v.size() - 1) + 0.5))];
+}
+
+/**
+ * Resolve through the simulated modem; returns false on lookup failure
+ */
+static bool sim_lookup(ModemSim *modem, SimResult *res, bool blocking, double *path_ms) {
+    modem_sim_result_t r = modem->run(MODEM_OP_DNS, 15000);
+    res->lookups++;
+    if (blocking) {
+        res->blocking++;
+        *path_ms += r.ms;
+    }
+    return r.ok;
+}
+
+static SimResult run(policy_t policy, int days, int uploads_per_day, int reboots_per_day,
+                     uint64_t seed) {
+    SimResult res = {};
+    ModemSim modem(seed);
+    dns_cache_t cache = {};
+    double interval_ms = 86400000.0 / uploads_per_day;
+    double reboot_every_ms = reboots_per_day > 0 ? 86400000.0 / reboots_per_day : 0;
+    double next_reboot = reboot_every_ms;
+    int total = days * uploads_per_day;
+
+    for (int i = 0; i < total; i++) {
+        double start = i * interval_ms;
+        if (modem.now_ms < start) {
+            modem.advance(start - modem.now_ms);
+        }
+        if (reboot_every_ms > 0 && modem.now_ms >= next_reboot) {
+            next_reboot += reboot_every_ms;
+            if (policy == POLICY_RAM) {
+                cache = {};
+            } else if (policy == POLICY_PERSISTENT) {
+                // Age unknown after a cold boot: usable, refresh due
+                for (dns_entry_t &e : cache.entries) {
+                    if (e.ipv4 != 0) {
+                        e.resolved_ms = (int64_t)modem.now_ms -
+                                        (int64_t)e.ttl_s * 10 * DNS_REFRESH_PCT;
+                    }
+                }
+            }
+        }
+
+        int64_t now = (int64_t)modem.now_ms;
+        double path_ms = 0;
+        bool resolved = true;
+        if (policy == POLICY_NONE) {
+            resolved = sim_lookup(&modem, &res, true, &path_ms);
+        } else {
+            dns_entry_t *e = dns_cache_find(&cache, SIM_HOST);
+            dns_state_t state = dns_entry_state(e, now);
+            bool usable = state == DNS_STATE_FRESH ||
+                          (policy == POLICY_PERSISTENT && state == DNS_STATE_STALE);
+            if (!usable) {
+                resolved = sim_lookup(&modem, &res, true, &path_ms);
+                if (resolved) {
+                    dns_cache_store(&cache, SIM_HOST, SIM_HOST_IP, DNS_DEFAULT_TTL_S,
+                                    (int64_t)modem.now_ms);
+                } else if (e != NULL) {
+                    resolved = true;    // Keep using the old address
+                }
+            }
+        }
+
+        res.uploads++;
+        if (!resolved) {
+            res.failed_uploads++;
+            continue;
+        }
+        path_ms += modem.run(MODEM_OP_HTTP_POST).ms;
+        res.upload_ms.push_back(path_ms);
+
+        if (policy == POLICY_PERSISTENT && dns_cache_due(&cache, (int64_t)modem.now_ms)) {
+            double ignored = 0;
+            if (sim_lookup(&modem, &res, false, &ignored)) {
+                dns_cache_store(&cache, SIM_HOST, SIM_HOST_IP, DNS_DEFAULT_TTL_S,
+                                (int64_t)modem.now_ms);
+            }
+        }
+    }
+    return res;
+}
+
+int main(int argc, char **argv) {
+    int days = argc > 1 ? atoi(argv[1]) : 7;
+    int uploads_per_day = argc > 2 ? atoi(argv[2]) : 64;
+    int reboots_per_day = argc > 3 ? atoi(argv[3]) : 2;
+    uint64_t seed = argc > 4 ? strtoull(argv[4], NULL, 10) : 1;
+    if (days <= 0 || uploads_per_day <= 0 || reboots_per_day < 0) {
+        fprintf(stderr, "usage: %s [days] [uploads_per_day] [reboots_per_day] [seed]\n",
+                argv[0]);
+        return 1;
+    }
+
+    printf("%d days, %d uploads/day, %d reboots/day, TTL %d s, refresh at %d%%\n\n", days,
+           uploads_per_day, reboots_per_day, DNS_DEFAULT_TTL_S, DNS_REFRESH_PCT);
+    printf("%-11s %10s %11s %8s %8s %8s %8s\n", "policy", "lookups/d", "blocking/d",
+           "failed", "p50 ms", "p95 ms", "mean ms");
+    for (int p = 0; p < POLICY_COUNT; p++) {
+        SimResult res = run((policy_t)p, days, uploads_per_day, reboots_per_day, seed);
+        double sum = 0;
+        for (double ms : res.upload_ms) sum += ms;
+        printf("%-11s %10.1f %11.1f %8u %8.0f %8.0f %8.0f\n", POLICY_NAMES[p],
+               (double)res.lookups / days, (double)res.blocking / days, res.failed_uploads,
+               percentile(res.upload_ms, 0.50), percentile(res.upload_ms, 0.95),
+               res.upload_ms.empty() ? 0 : sum / res.upload_ms.size());
+    }
+    return 0;
+}
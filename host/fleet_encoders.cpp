@@ -0,0 +1,49 @@
+/**
+ * Payload Encoders for fleet_load
+ *
+ * The firmware encoders from http_json_example.h, built with ESP_PLATFORM
+ * against host/idf_stub like host_bench_encoders.cpp. Every simulated
+ * device calls in from its own thread with its own device ID and samples;
+ * process-wide firmware state (network time anchor, energy account,
+ * runtime config) is shared by all of them.
+ */
+
+#include "http_json_example.h"
+
+/**
+ * Network time, energy account and runtime config, once per process
+ */
+void fleet_encoders_setup(void) {
+    time_service_init();
+    time_anchor_update(&g_time_anchor, 1760000000000LL, time_service_mono_us());
+    energy_init(NULL);
+    device_config_init("", "", "");
+}
+
+/**
+ * create_batch_json()
+ *
+ * @return JSON string, free with fleet_encoders_free()
+ */
+char *fleet_encode_batch(const char *device_id, const sensor_sample_t *samples, size_t count,
+                         const sampler_stats_t *stats) {
+    return create_batch_json(device_id, samples, count, stats);
+}
+
+/**
+ * create_sensor_json()
+ */
+char *fleet_encode_sensor(const char *device_id) {
+    return create_sensor_json(device_id);
+}
+
+/**
+ * create_custom_json()
+ */
+char *fleet_encode_custom(const char *device_id, float temperature, float humidity) {
+    return create_custom_json(device_id, temperature, humidity);
+}
+
+void fleet_encoders_free(char *json) {
+    cJSON_free(json);
+}
@@ -0,0 +1,734 @@
+/**
+ * Fleet Load Generator
+ *
+ * Runs N simulated Walter devices as threads against an ingestion
+ * stand-in on the loopback interface (or a real backend with --url), so
+ * fleet-scale changes to the encoders or the backend can be checked on
+ * one Linux box. Each device, every --interval-ms:
+ *
+ *   reads its synthetic sensor and encodes with the firmware encoders
+ *   (host/fleet_encoders.cpp) under its own device ID
+ *   runs the modem side of the upload in modem_sim.h: POST latency,
+ *   failures and hangs, the HTTP deadline (MODEM_CLASS_BUDGET_MS) and
+ *   up to MULTI_UPLINK_MAX_TRIES attempts; simulated time is slept
+ *   scaled by --time-scale (0 = not at all, 1 = real NB-IoT pacing)
+ *   POSTs the payload over HTTP/1.1 keep-alive
+ *
+ * The ingestion stand-in decodes every payload format the firmware sends
+ * (batch, sensor, custom) with cJSON and counts per device; its workers
+ * share the port through SO_REUSEPORT, one epoll loop each. At the end
+ * every acknowledged upload must have been decoded.
+ *
+ * Usage: fleet_load [--devices N] [--seconds S] [--interval-ms MS]
+ *                   [--format batch|sensor|custom|mix] [--batch N]
+ *                   [--time-scale F] [--ingest-threads N] [--url URL]
+ *                   [--seed N]
+ */
+
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <cJSON.h>
+#include "modem_deadline.h"
+#include "modem_sim.h"
+#include "multi_uplink.h"
+#include "sensor_sampler.h"
+#include "tls_profile.h"
+
+// host/fleet_encoders.cpp
+void fleet_encoders_setup(void);
+char *fleet_encode_batch(const char *device_id, const sensor_sample_t *samples, size_t count,
+                         const sampler_stats_t *stats);
+char *fleet_encode_sensor(const char *device_id);
+char *fleet_encode_custom(const char *device_id, float temperature, float humidity);
+void fleet_encoders_free(char *json);
+
+#define FLEET_BATCH_MAX 64
+#define FLEET_BATCH_DEFAULT 16          // PIPELINE_BATCH_MAX
+#define FLEET_HTTP_MAX 4096             // Largest request or response accepted
+#define FLEET_BASELINE_ENCODES 1000     // Single-threaded encodes before the fleet starts
+
+typedef std::chrono::steady_clock Clock;
+
+enum Format {
+    FORMAT_BATCH = 0,                   // create_batch_json(), the pipeline upload
+    FORMAT_SENSOR,                      // create_sensor_json()
+    FORMAT_CUSTOM,                      // create_custom_json()
+    FORMAT_COUNT
+};
+
+static const char *const FORMAT_NAMES[FORMAT_COUNT] = { "batch", "sensor", "custom" };
+
+struct Options {
+    int devices = 100;
+    double seconds = 10;
+    int interval_ms = 1000;
+    int format = -1;                    // -1 = mix, device i sends format i % FORMAT_COUNT
+    int batch = FLEET_BATCH_DEFAULT;
+    double time_scale = 0;
+    int ingest_threads = 2;
+    const char *url = NULL;
+    uint64_t seed = 1;
+};
+
+struct Device {
+    char id[24];
+    int index;
+    Format format;
+    std::vector<float> latency_ms;      // Encoded -> acknowledged, wall time
+    std::vector<float> encode_us;
+    uint64_t sent = 0;
+    uint64_t bytes = 0;
+    uint64_t retries = 0;
+    uint64_t failed = 0;                // Out of tries
+    double modem_ms = 0;                // Simulated, before scaling
+};
+
+// ----------------------------------------------------------------------------
+// Ingestion stand-in
+// ----------------------------------------------------------------------------
+
+struct IngestStats {
+    uint64_t decoded[FORMAT_COUNT] = {};
+    uint64_t rejected = 0;
+    uint64_t samples = 0;
+    uint64_t bytes = 0;
+    std::unordered_map<std::string, uint64_t> per_device;
+};
+
+static bool json_number(const cJSON *obj, const char *key) {
+    return cJSON_IsNumber(cJSON_GetObjectItemCaseSensitive(obj, key));
+}
+
+static const char *json_string(const cJSON *obj, const char *key) {
+    const cJSON *item = cJSON_GetObjectItemCaseSensitive(obj, key);
+    return cJSON_IsString(item) ? item->valuestring : NULL;
+}
+
+/**
+ * Decode one uploaded payload, whichever encoder produced it
+ *
+ * Times are either network time ("t0", "timestamp", "time") or uptime
+ * before the first sync ("t0_up", ...), see time_service_add_to_json().
+ *
+ * @return Format, or -1 if the payload is not valid
+ */
+static int ingest_decode(const char *body, size_t len, std::string *device, uint32_t *samples) {
+    cJSON *root = cJSON_ParseWithLength(body, len);
+    if (!cJSON_IsObject(root)) {
+        cJSON_Delete(root);
+        return -1;
+    }
+    int format = -1;
+    const char *id = NULL;
+    const cJSON *rows = cJSON_GetObjectItemCaseSensitive(root, "samples");
+    const cJSON *sensors = cJSON_GetObjectItemCaseSensitive(root, "sensors");
+
+    if (cJSON_IsArray(rows)) {
+        id = json_string(root, "device");
+        int count = cJSON_GetArraySize(rows);
+        bool ok = count == 0 || json_number(root, "t0") || json_number(root, "t0_up");
+        const cJSON *row;
+        cJSON_ArrayForEach(row, rows) {
+            // [offset_ms, temperature, humidity, pressure]
+            ok = ok && cJSON_IsArray(row) && cJSON_GetArraySize(row) == 4;
+            for (int i = 0; ok && i < 4; i++) {
+                ok = cJSON_IsNumber(cJSON_GetArrayItem(row, i));
+            }
+        }
+        if (ok) {
+            format = FORMAT_BATCH;
+            *samples = (uint32_t)count;
+        }
+    } else if (cJSON_IsObject(sensors)) {
+        id = json_string(root, "device_id");
+        if (json_number(sensors, "temperature") && json_number(sensors, "humidity") &&
+            json_number(sensors, "pressure") &&
+            (json_number(root, "timestamp") || json_number(root, "timestamp_up"))) {
+            format = FORMAT_SENSOR;
+            *samples = 1;
+        }
+    } else if (json_number(root, "temp") && json_number(root, "hum")) {
+        id = json_string(root, "device");
+        if (json_number(root, "time") || json_number(root, "time_up")) {
+            format = FORMAT_CUSTOM;
+            *samples = 1;
+        }
+    }
+
+    if (id == NULL || *id == '\0') {
+        format = -1;
+    } else {
+        device->assign(id);
+    }
+    cJSON_Delete(root);
+    return format;
+}
+
+/**
+ * Content-Length of a request or response header block, -1 if missing
+ */
+static long http_content_length(const char *head, size_t len) {
+    static const char KEY[] = "\r\ncontent-length:";
+    for (size_t i = 0; i + sizeof(KEY) - 1 <= len; i++) {
+        if (strncasecmp(head + i, KEY, sizeof(KEY) - 1) == 0) {
+            return strtol(head + i + sizeof(KEY) - 1, NULL, 10);
+        }
+    }
+    return -1;
+}
+
+static bool send_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+/**
+ * Answer every complete request in buf
+ *
+ * @return false if the connection should be closed
+ */
+static bool ingest_process(int fd, std::string *buf, IngestStats *stats) {
+    static const char OK[] = "HTTP/1.1 200 OK\r\nContent-Length: 0\r\n\r\n";
+    static const char BAD[] = "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\n\r\n";
+    while (true) {
+        size_t head = buf->find("\r\n\r\n");
+        if (head == std::string::npos) {
+            return buf->size() < FLEET_HTTP_MAX;
+        }
+        long clen = http_content_length(buf->data(), head + 2);
+        if (buf->compare(0, 5, "POST ") != 0 || clen < 0 || clen > FLEET_HTTP_MAX) {
+            send_all(fd, BAD, sizeof(BAD) - 1);
+            return false;
+        }
+        size_t total = head + 4 + (size_t)clen;
+        if (buf->size() < total) {
+            return true;
+        }
+
+        std::string device;
+        uint32_t samples = 0;
+        int format = ingest_decode(buf->data() + head + 4, (size_t)clen, &device, &samples);
+        if (format < 0) {
+            stats->rejected++;
+        } else {
+            stats->decoded[format]++;
+            stats->samples += samples;
+            stats->bytes += (uint64_t)clen;
+            stats->per_device[device]++;
+        }
+        if (!send_all(fd, format < 0 ? BAD : OK, format < 0 ? sizeof(BAD) - 1 : sizeof(OK) - 1)) {
+            return false;
+        }
+        buf->erase(0, total);
+    }
+}
+
+static void ingest_worker(int listen_fd, const std::atomic<bool> *stop, IngestStats *stats) {
+    int ep = epoll_create1(0);
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.fd = listen_fd;
+    epoll_ctl(ep, EPOLL_CTL_ADD, listen_fd, &ev);
+    std::unordered_map<int, std::string> conns;
+    epoll_event events[64];
+    char chunk[FLEET_HTTP_MAX];
+
+    while (!stop->load(std::memory_order_relaxed)) {
+        int n = epoll_wait(ep, events, 64, 100);
+        for (int i = 0; i < n; i++) {
+            int fd = events[i].data.fd;
+            if (fd == listen_fd) {
+                int c;
+                while ((c = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK)) >= 0) {
+                    int one = 1;
+                    setsockopt(c, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                    ev.events = EPOLLIN;
+                    ev.data.fd = c;
+                    epoll_ctl(ep, EPOLL_CTL_ADD, c, &ev);
+                    conns[c];
+                }
+                continue;
+            }
+            std::string &buf = conns[fd];
+            bool open = true;
+            while (true) {
+                ssize_t got = recv(fd, chunk, sizeof(chunk), 0);
+                if (got > 0) {
+                    buf.append(chunk, (size_t)got);
+                    continue;
+                }
+                open = got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR);
+                break;
+            }
+            if (!open || !ingest_process(fd, &buf, stats)) {
+                epoll_ctl(ep, EPOLL_CTL_DEL, fd, NULL);
+                close(fd);
+                conns.erase(fd);
+            }
+        }
+    }
+    for (auto &c : conns) {
+        close(c.first);
+    }
+    close(ep);
+}
+
+/**
+ * Listening socket on 127.0.0.1:port, shared by every worker
+ *
+ * @param port 0 for any free port, updated with the port bound
+ */
+static int ingest_listen(uint16_t *port) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(*port);
+    socklen_t len = sizeof(addr);
+    if (bind(fd, (sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 4096) != 0 ||
+        getsockname(fd, (sockaddr *)&addr, &len) != 0) {
+        perror("ingestion socket");
+        exit(1);
+    }
+    *port = ntohs(addr.sin_port);
+    return fd;
+}
+
+// ----------------------------------------------------------------------------
+// Devices
+// ----------------------------------------------------------------------------
+
+struct Target {
+    sockaddr_storage addr;
+    socklen_t addr_len;
+    std::string host;
+    std::string path;
+};
+
+static int http_connect(const Target &t) {
+    int fd = socket(t.addr.ss_family, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (connect(fd, (const sockaddr *)&t.addr, t.addr_len) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * POST body on the device's keep-alive connection, reconnecting if needed
+ *
+ * @return HTTP status, 0 on a transport error
+ */
+static int http_post(int *fd, const Target &t, const char *body, size_t len) {
+    if (*fd < 0 && (*fd = http_connect(t)) < 0) {
+        return 0;
+    }
+    char head[256];
+    int head_len = snprintf(head, sizeof(head),
+                            "POST %s HTTP/1.1\r\nHost: %s\r\nContent-Type: application/json\r\n"
+                            "Content-Length: %zu\r\n\r\n", t.path.c_str(), t.host.c_str(), len);
+    iovec iov[2] = { { head, (size_t)head_len }, { (void *)body, len } };
+    msghdr msg = {};
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+    ssize_t sent = sendmsg(*fd, &msg, MSG_NOSIGNAL);
+    bool ok = sent == (ssize_t)(head_len + len) ||
+              (sent >= head_len && send_all(*fd, body + (sent - head_len), len - (sent - head_len)));
+
+    // Status line and headers, then skip the body
+    std::string rsp;
+    char chunk[1024];
+    size_t end = std::string::npos;
+    while (ok && (end = rsp.find("\r\n\r\n")) == std::string::npos && rsp.size() < FLEET_HTTP_MAX) {
+        ssize_t got = recv(*fd, chunk, sizeof(chunk), 0);
+        ok = got > 0;
+        if (ok) {
+            rsp.append(chunk, (size_t)got);
+        }
+    }
+    int status = 0;
+    if (ok && end != std::string::npos && sscanf(rsp.c_str(), "HTTP/1.%*d %d", &status) == 1) {
+        long clen = http_content_length(rsp.data(), end + 2);
+        size_t have = rsp.size() - (end + 4);
+        while (clen > 0 && have < (size_t)clen) {
+            ssize_t got = recv(*fd, chunk, std::min(sizeof(chunk), (size_t)clen - have), 0);
+            if (got <= 0) {
+                status = 0;
+                break;
+            }
+            have += (size_t)got;
+        }
+    }
+    if (status == 0) {
+        close(*fd);
+        *fd = -1;
+    }
+    return status;
+}
+
+/**
+ * Encode this device's next payload
+ */
+static char *device_encode(Device *d, synthetic_sensor_t *sensor, sampler_stats_t *stats,
+                           int batch, int64_t now_us) {
+    sensor_sample_t samples[FLEET_BATCH_MAX] = {};
+    int count = d->format == FORMAT_BATCH ? batch : 1;
+    for (int i = 0; i < count; i++) {
+        synthetic_sensor_read(sensor, &samples[i]);
+        samples[i].timestamp_us = now_us - (int64_t)(count - 1 - i) * SAMPLER_PERIOD_MS * 1000;
+        samples[i].seq = stats->samples++;
+    }
+    switch (d->format) {
+        case FORMAT_BATCH:
+            return fleet_encode_batch(d->id, samples, (size_t)count, stats);
+        case FORMAT_SENSOR:
+            return fleet_encode_sensor(d->id);
+        default:
+            return fleet_encode_custom(d->id, samples[0].temperature, samples[0].humidity);
+    }
+}
+
+/**
+ * Encode time on one thread, before the device threads start
+ *
+ * All devices share the firmware's process-wide state (time anchor,
+ * energy account, runtime config) and the portMUX locks around it, so
+ * their encode times include waiting for each other. This measures the
+ * same encoders, over the same formats, without that.
+ */
+static std::vector<float> encode_baseline(std::vector<Device> &devices, int batch) {
+    std::vector<float> us;
+    synthetic_sensor_t sensor = {};
+    sampler_stats_t stats = {};
+    size_t formats = std::min<size_t>(devices.size(), FORMAT_COUNT);
+    for (int i = 0; formats > 0 && i < FLEET_BASELINE_ENCODES; i++) {
+        Clock::time_point t0 = Clock::now();
+        char *json = device_encode(&devices[i % formats], &sensor, &stats, batch,
+                                   (int64_t)i * SAMPLER_PERIOD_MS * 1000);
+        us.push_back(std::chrono::duration<float, std::micro>(Clock::now() - t0).count());
+        fleet_encoders_free(json);
+    }
+    return us;
+}
+
+static void device_run(Device *d, const Options &opt, const Target &target,
+                       Clock::time_point start, const std::atomic<bool> *stop) {
+    ModemSim sim(opt.seed * 1000003 + (uint64_t)d->index);
+    synthetic_sensor_t sensor = {};
+    sensor.reads = (uint32_t)d->index * 37;     // Devices at different points of the waveform
+    sampler_stats_t stats = {};
+    int fd = -1;
+
+    // Spread the fleet evenly over the first interval
+    Clock::time_point next = start + std::chrono::microseconds(
+        opt.devices > 0 ? (int64_t)opt.interval_ms * 1000 * d->index / opt.devices : 0);
+    while (!stop->load(std::memory_order_relaxed)) {
+        std::this_thread::sleep_until(next);
+        if (stop->load(std::memory_order_relaxed)) {
+            break;
+        }
+        Clock::time_point t0 = Clock::now();
+        next = opt.interval_ms > 0 ? next + std::chrono::milliseconds(opt.interval_ms) : t0;
+
+        int64_t now_us = std::chrono::duration_cast<std::chrono::microseconds>(t0 - start).count();
+        char *json = device_encode(d, &sensor, &stats, opt.batch, now_us);
+        Clock::time_point encoded = Clock::now();
+        d->encode_us.push_back(std::chrono::duration<float, std::micro>(encoded - t0).count());
+        size_t len = strlen(json);
+
+        bool ok = false;
+        for (int attempt = 1; attempt <= MULTI_UPLINK_MAX_TRIES && !ok; attempt++) {
+            if (attempt > 1) {
+                d->retries++;
+            }
+            modem_sim_result_t r = sim.run(MODEM_OP_HTTP_POST,
+                                           MODEM_CLASS_BUDGET_MS[MODEM_CLASS_HTTP]);
+            d->modem_ms += r.ms;
+            if (opt.time_scale > 0) {
+                std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(r.ms * opt.time_scale));
+            }
+            if (!r.ok) {
+                continue;               // Lost on the radio side, the server never sees it
+            }
+            ok = http_post(&fd, target, json, len) == 200;
+        }
+        fleet_encoders_free(json);
+
+        if (ok) {
+            d->sent++;
+            d->bytes += len;
+            d->latency_ms.push_back(std::chrono::duration<float, std::milli>(Clock::now() - encoded).count());
+        } else {
+            d->failed++;
+        }
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Report
+// ----------------------------------------------------------------------------
+
+static float percentile(std::vector<float> *v, double p) {
+    if (v->empty()) {
+        return 0;
+    }
+    size_t k = std::min(v->size() - 1, (size_t)(p * (v->size() - 1) + 0.5));
+    std::nth_element(v->begin(), v->begin() + k, v->end());
+    return (*v)[k];
+}
+
+static bool parse_args(int argc, char **argv, Options *opt) {
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        const char *v = i + 1 < argc ? argv[i + 1] : NULL;
+        if (v == NULL) {
+            return false;
+        }
+        if (strcmp(a, "--devices") == 0) {
+            opt->devices = atoi(v);
+        } else if (strcmp(a, "--seconds") == 0) {
+            opt->seconds = atof(v);
+        } else if (strcmp(a, "--interval-ms") == 0) {
+            opt->interval_ms = atoi(v);
+        } else if (strcmp(a, "--batch") == 0) {
+            opt->batch = std::max(1, std::min(FLEET_BATCH_MAX, atoi(v)));
+        } else if (strcmp(a, "--time-scale") == 0) {
+            opt->time_scale = atof(v);
+        } else if (strcmp(a, "--ingest-threads") == 0) {
+            opt->ingest_threads = std::max(1, atoi(v));
+        } else if (strcmp(a, "--url") == 0) {
+            opt->url = v;
+        } else if (strcmp(a, "--seed") == 0) {
+            opt->seed = strtoull(v, NULL, 10);
+        } else if (strcmp(a, "--format") == 0) {
+            opt->format = -2;
+            for (int f = 0; f < FORMAT_COUNT; f++) {
+                if (strcmp(v, FORMAT_NAMES[f]) == 0) opt->format = f;
+            }
+            if (strcmp(v, "mix") == 0) opt->format = -1;
+            if (opt->format == -2) return false;
+        } else {
+            return false;
+        }
+        i++;
+    }
+    return opt->devices > 0 && opt->seconds > 0 && opt->interval_ms >= 0;
+}
+
+static bool resolve_target(const char *url, Target *t) {
+    http_url_t u;
+    if (!http_url_parse(url, &u) || u.https) {
+        fprintf(stderr, "%s: only http:// URLs are supported\n", url);
+        return false;
+    }
+    addrinfo hints = {};
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *res = NULL;
+    char port[8];
+    snprintf(port, sizeof(port), "%u", (unsigned)u.port);
+    if (getaddrinfo(u.host, port, &hints, &res) != 0 || res == NULL) {
+        fprintf(stderr, "%s: cannot resolve %s\n", url, u.host);
+        return false;
+    }
+    memcpy(&t->addr, res->ai_addr, res->ai_addrlen);
+    t->addr_len = res->ai_addrlen;
+    freeaddrinfo(res);
+    t->host = u.host;
+    t->path = u.path;
+    return true;
+}
+
+int main(int argc, char **argv) {
+    Options opt;
+    if (!parse_args(argc, argv, &opt)) {
+        fprintf(stderr, "usage: %s [--devices N] [--seconds S] [--interval-ms MS]\n"
+                        "       [--format batch|sensor|custom|mix] [--batch N] [--time-scale F]\n"
+                        "       [--ingest-threads N] [--url http://host:port/path] [--seed N]\n",
+                argv[0]);
+        return 2;
+    }
+
+    // Each device keeps a connection open, and so does the ingestion side
+    rlimit lim;
+    if (getrlimit(RLIMIT_NOFILE, &lim) == 0) {
+        lim.rlim_cur = lim.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &lim);
+        if (lim.rlim_cur < (rlim_t)opt.devices * 2 + 64) {
+            fprintf(stderr, "warning: open file limit %lu is low for %d devices\n",
+                    (unsigned long)lim.rlim_cur, opt.devices);
+        }
+    }
+
+    fleet_encoders_setup();
+
+    std::atomic<bool> stop_ingest(false);
+    std::vector<IngestStats> ingest(opt.url == NULL ? opt.ingest_threads : 0);
+    std::vector<std::thread> ingest_threads;
+    std::vector<int> listeners;
+    Target target;
+    if (opt.url == NULL) {
+        uint16_t port = 0;
+        for (int i = 0; i < opt.ingest_threads; i++) {
+            listeners.push_back(ingest_listen(&port));
+        }
+        for (int i = 0; i < opt.ingest_threads; i++) {
+            ingest_threads.emplace_back(ingest_worker, listeners[i], &stop_ingest, &ingest[i]);
+        }
+        char url[64];
+        snprintf(url, sizeof(url), "http://127.0.0.1:%u/ingest", (unsigned)port);
+        if (!resolve_target(url, &target)) {
+            return 1;
+        }
+    } else if (!resolve_target(opt.url, &target)) {
+        return 1;
+    }
+
+    printf("%d devices, %.1f s, every %d ms, format %s, batch %d, modem time x%g, %s\n\n",
+           opt.devices, opt.seconds, opt.interval_ms,
+           opt.format < 0 ? "mix" : FORMAT_NAMES[opt.format], opt.batch, opt.time_scale,
+           opt.url != NULL ? opt.url : "local ingestion");
+
+    std::vector<Device> devices(opt.devices);
+    for (int i = 0; i < opt.devices; i++) {
+        Device &d = devices[i];
+        snprintf(d.id, sizeof(d.id), "walter-%05d", i + 1);
+        d.index = i;
+        d.format = (Format)(opt.format < 0 ? i % FORMAT_COUNT : opt.format);
+    }
+    std::vector<float> baseline = encode_baseline(devices, opt.batch);
+
+    std::atomic<bool> stop_devices(false);
+    Clock::time_point start = Clock::now();
+    std::vector<std::thread> threads;
+    for (Device &d : devices) {
+        threads.emplace_back(device_run, &d, std::cref(opt), std::cref(target), start,
+                             &stop_devices);
+    }
+    std::this_thread::sleep_for(std::chrono::duration<double>(opt.seconds));
+    stop_devices = true;
+    for (std::thread &t : threads) {
+        t.join();
+    }
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    stop_ingest = true;
+    for (std::thread &t : ingest_threads) {
+        t.join();
+    }
+    for (int fd : listeners) {
+        close(fd);
+    }
+
+    // Device side
+    uint64_t sent = 0, bytes = 0, retries = 0, failed = 0;
+    double modem_ms = 0;
+    std::vector<float> latency, encode, dev_p50, dev_p99;
+    for (Device &d : devices) {
+        sent += d.sent;
+        bytes += d.bytes;
+        retries += d.retries;
+        failed += d.failed;
+        modem_ms += d.modem_ms;
+        latency.insert(latency.end(), d.latency_ms.begin(), d.latency_ms.end());
+        encode.insert(encode.end(), d.encode_us.begin(), d.encode_us.end());
+        if (!d.latency_ms.empty()) {
+            dev_p50.push_back(percentile(&d.latency_ms, 0.50));
+            dev_p99.push_back(percentile(&d.latency_ms, 0.99));
+        }
+    }
+    printf("%10s %10s %12s %8s %8s %14s\n", "uploads", "msgs/s", "bytes/s", "retries", "failed",
+           "modem s/upload");
+    printf("%10llu %10.1f %12.0f %8llu %8llu %14.2f\n\n", (unsigned long long)sent,
+           sent / elapsed, bytes / elapsed, (unsigned long long)retries,
+           (unsigned long long)failed, sent + failed ? modem_ms / 1000 / (sent + failed) : 0.0);
+
+    printf("%-26s %9s %9s %9s %9s\n", "", "p50", "p95", "p99", "max");
+    printf("%-26s %9.1f %9.1f %9.1f %9.1f\n", "encode us", percentile(&encode, 0.50),
+           percentile(&encode, 0.95), percentile(&encode, 0.99), percentile(&encode, 1.0));
+    printf("%-26s %9.1f %9.1f %9.1f %9.1f\n", "  1 thread, no sharing", percentile(&baseline, 0.50),
+           percentile(&baseline, 0.95), percentile(&baseline, 0.99), percentile(&baseline, 1.0));
+    printf("%-26s %9.2f %9.2f %9.2f %9.2f\n", "latency ms (all uploads)",
+           percentile(&latency, 0.50), percentile(&latency, 0.95), percentile(&latency, 0.99),
+           percentile(&latency, 1.0));
+    printf("%-26s %9.2f %9.2f %9.2f %9.2f\n", "  per-device p50", percentile(&dev_p50, 0.50),
+           percentile(&dev_p50, 0.95), percentile(&dev_p50, 0.99), percentile(&dev_p50, 1.0));
+    printf("%-26s %9.2f %9.2f %9.2f %9.2f\n", "  per-device p99", percentile(&dev_p99, 0.50),
+           percentile(&dev_p99, 0.95), percentile(&dev_p99, 0.99), percentile(&dev_p99, 1.0));
+
+    if (opt.url != NULL) {
+        return 0;
+    }
+
+    // Ingestion side: every acknowledged upload decoded, from the device that sent it
+    IngestStats total;
+    for (IngestStats &s : ingest) {
+        for (int f = 0; f < FORMAT_COUNT; f++) total.decoded[f] += s.decoded[f];
+        total.rejected += s.rejected;
+        total.samples += s.samples;
+        total.bytes += s.bytes;
+        for (auto &p : s.per_device) total.per_device[p.first] += p.second;
+    }
+    uint64_t decoded = total.decoded[FORMAT_BATCH] + total.decoded[FORMAT_SENSOR] +
+                       total.decoded[FORMAT_CUSTOM];
+    printf("\ningestion: batch=%llu sensor=%llu custom=%llu rejected=%llu samples=%llu "
+           "(%.0f/s) devices=%zu\n",
+           (unsigned long long)total.decoded[FORMAT_BATCH],
+           (unsigned long long)total.decoded[FORMAT_SENSOR],
+           (unsigned long long)total.decoded[FORMAT_CUSTOM], (unsigned long long)total.rejected,
+           (unsigned long long)total.samples, total.samples / elapsed, total.per_device.size());
+
+    int errors = 0;
+    if (decoded != sent || total.bytes != bytes || total.rejected != 0) {
+        fprintf(stderr, "acknowledged %llu uploads (%llu B), decoded %llu (%llu B), rejected %llu\n",
+                (unsigned long long)sent, (unsigned long long)bytes, (unsigned long long)decoded,
+                (unsigned long long)total.bytes, (unsigned long long)total.rejected);
+        errors++;
+    }
+    for (const Device &d : devices) {
+        auto it = total.per_device.find(d.id);
+        uint64_t got = it != total.per_device.end() ? it->second : 0;
+        if (got != d.sent && errors++ < 10) {
+            fprintf(stderr, "%s: sent %llu, decoded %llu\n", d.id, (unsigned long long)d.sent,
+                    (unsigned long long)got);
+        }
+    }
+    return errors == 0 ? 0 : 1;
+}
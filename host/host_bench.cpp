@@ -0,0 +1,546 @@
+/**
+ * Host Benchmark Suite
+ *
+ * Builds the firmware's payload encoders, AT parsers, queues, console
+ * command parser and connect-path bookkeeping natively and times each one
+ * as a single operation. The encoders (http_json_example.h) are compiled
+ * with ESP_PLATFORM against the ESP-IDF stand-ins in host/idf_stub, so the
+ * same create_batch_json() that runs on the device runs here; they are
+ * only built when a cJSON source is available (see host/CMakeLists.txt).
+ *
+ * For every benchmark it reports:
+ *
+ *   ns_op      mean time per operation
+ *   p50/p99    percentiles of the per-operation time over timed batches
+ *   ops_s      operations per second
+ *   mb_s       payload throughput, for operations that consume or produce bytes
+ *   allocs_op  heap allocations per operation (operator new and cJSON)
+ *   bytes_op   heap bytes allocated per operation
+ *
+ * --json prints one JSON object per benchmark instead of the table.
+ * --compare reads a saved --json run and exits 1 if a benchmark got more
+ * than --threshold percent slower (p50) or allocates more than before.
+ *
+ * Usage: host_bench [--json] [--filter <text>] [--min-ms <ms>]
+ *                   [--compare <baseline.jsonl>] [--threshold <pct>]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <new>
+#include <string>
+#include <vector>
+#include "at_response.h"
+#include "connect_trace.h"
+#include "diag_command.h"
+#include "energy_model.h"
+#include "modem_deadline.h"
+#include "modem_trace.h"
+#include "multi_uplink.h"
+#include "sensor_driver.h"
+#include "spsc_queue.h"
+#include "upload_scheduler.h"
+
+typedef std::chrono::steady_clock bench_clock;
+
+#define BENCH_BATCH_NS 200000       // Target length of one timed batch
+#define BENCH_MIN_MS 300            // Default timed run per benchmark
+#define BENCH_THRESHOLD_PCT 10.0
+
+// ----------------------------------------------------------------------------
+// Allocation counting
+// ----------------------------------------------------------------------------
+
+static uint64_t g_allocs;
+static uint64_t g_alloc_bytes;
+
+static void *counted_malloc(size_t size) {
+    g_allocs++;
+    g_alloc_bytes += size;
+    return malloc(size);
+}
+
+void *operator new(size_t size) {
+    void *p = counted_malloc(size);
+    if (p == NULL) throw std::bad_alloc();
+    return p;
+}
+
+void *operator new[](size_t size) {
+    void *p = counted_malloc(size);
+    if (p == NULL) throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+
+// ----------------------------------------------------------------------------
+// Benchmarks: each op returns the payload bytes it handled (0 = none)
+// ----------------------------------------------------------------------------
+
+static volatile uint32_t g_sink;
+
+static size_t bench_diag_parse(void) {
+    static const char *const LINES[] = {
+        "stats", "diag full", "setrat ltem", "at AT+CEREG?",
+        "trace dump", "ota https://updates.example.com/walter/1.4.2.patch", "bogus", "",
+    };
+    static size_t i = 0;
+    char line[DIAG_URL_MAX + 16];
+    const char *src = LINES[i++ % (sizeof(LINES) / sizeof(LINES[0]))];
+    size_t len = strlen(src);
+    memcpy(line, src, len + 1);
+    diag_command_t cmd;
+    g_sink += diag_command_parse_line(line, &cmd);
+    return len;
+}
+
+static const char *const AT_CEREG = "+CEREG: 2,1,\"00C3\",\"0102A8F1\",9";
+static const char *const AT_SQNMONI =
+    "+SQNMONI: Orange F Cc:208 Nc:01 RSRP:-95.27 CINR:-0.50 RSRQ:-10.40 TAC:49 Id:15962 EARFCN:6300 PWR:-68.98 PAGING:128";
+static const char *const AT_CESQ = "+CESQ: 99,99,255,255,20,45";
+
+static size_t bench_parse_cereg(void) {
+    at_cereg_t out;
+    at_view_t line = at_view_str(AT_CEREG);
+    g_sink += at_parse_cereg(line, &out);
+    return line.len;
+}
+
+static size_t bench_parse_sqnmoni(void) {
+    at_sqnmoni_t out;
+    at_view_t line = at_view_str(AT_SQNMONI);
+    g_sink += at_parse_sqnmoni(line, &out);
+    return line.len;
+}
+
+static size_t bench_parse_cesq(void) {
+    at_cesq_t out;
+    at_view_t line = at_view_str(AT_CESQ);
+    g_sink += at_parse_cesq(line, &out);
+    return line.len;
+}
+
+static size_t bench_at_capture(void) {
+    static const char RX[] = "\r\n+SQNMONI: Orange F Cc:208 Nc:01 RSRP:-95.27 CINR:-0.50 RSRQ:-10.40 "
+                             "TAC:49 Id:15962 EARFCN:6300 PWR:-68.98 PAGING:128\r\n\r\nOK\r\n";
+    static at_capture_t cap;
+    at_capture_reset(&cap);
+    // Two uneven UART reads
+    at_capture_feed(&cap, RX, 37);
+    at_capture_feed(&cap, RX + 37, sizeof(RX) - 1 - 37);
+    g_sink += cap.count + cap.final_seen;
+    return sizeof(RX) - 1;
+}
+
+static size_t bench_spsc_sample(void) {
+    static SpscQueue<sensor_sample_t, 256> queue;
+    static sensor_sample_t sample;
+    sensor_sample_t out = {};
+    sample.seq++;
+    queue.push(sample);
+    queue.pop(&out);
+    g_sink += out.seq;
+    return sizeof(sample);
+}
+
+typedef struct {
+    uint16_t len;
+    char data[2432];  // PIPELINE_PAYLOAD_MAX
+} bench_payload_t;
+
+static size_t bench_spsc_payload(void) {
+    static SpscQueue<bench_payload_t, 8> queue;
+    static const char JSON[] = "{\"device\":\"walter-001\",\"t0\":1760000000000,\"samples\":"
+                               "[[0,23.5,65.2,1013.25],[1000,23.53,65.19,1013.26]]}";
+    bench_payload_t *slot = queue.claim();
+    slot->len = sizeof(JSON) - 1;
+    memcpy(slot->data, JSON, slot->len);
+    queue.commit();
+    const bench_payload_t *head = queue.peek();
+    g_sink += head->len;
+    queue.release();
+    return sizeof(JSON) - 1;
+}
+
+static size_t bench_uplink_window(void) {
+    // One window's worth: start 4, finish them out of order, release in order
+    uplink_window_t w;
+    uplink_window_init(&w);
+    uint32_t ids[MULTI_UPLINK_WINDOW];
+    int n = 0;
+    while (n < MULTI_UPLINK_WINDOW && uplink_window_take(&w, MULTI_UPLINK_WINDOW, &ids[n])) {
+        n++;
+    }
+    for (int i = n - 1; i >= 0; i--) {
+        uplink_window_finish(&w, ids[i], true);
+    }
+    while (uplink_window_release(&w)) {
+        g_sink++;
+    }
+    return 0;
+}
+
+static size_t bench_upload_sched(void) {
+    static upload_sched_t s;
+    static int64_t now_ms = -1;
+    if (now_ms < 0) {
+        upload_sched_init(&s, NULL, 0);
+        now_ms = 0;
+    }
+    now_ms += 1000;
+    upload_sched_note_record(&s, SENSOR_URGENCY_BULK, now_ms);
+    upload_reason_t reason;
+    if (upload_sched_next_flush_ms(&s, now_ms, 64, 192, &reason) <= now_ms) {
+        upload_sched_flushed(&s, now_ms, reason);
+    }
+    g_sink += reason;
+    return 0;
+}
+
+static size_t bench_energy_account(void) {
+    static energy_account_t acc;
+    static int64_t now_us = -1;
+    if (now_us < 0) {
+        energy_account_init(&acc, NULL, 0);
+        now_us = 0;
+    }
+    now_us += 250000;
+    energy_account_set_modem(&acc, (energy_modem_state_t)((now_us / 250000) % ENERGY_MODEM_STATE_COUNT),
+                             now_us);
+    g_sink += (uint32_t)energy_account_total(&acc);
+    return 0;
+}
+
+// ----------------------------------------------------------------------------
+// Connect path: one connect_nbiot() sequence as the modem task sees it
+// ----------------------------------------------------------------------------
+
+static std::vector<uint8_t> g_connect_trace;
+static size_t g_connect_rx_bytes;
+
+static void connect_setup(void) {
+    if (!g_connect_trace.empty()) {
+        return;
+    }
+    ModemSim sim(1);
+    connect_trace_synth(&sim, &g_connect_trace);
+    modem_trace_reader_t r;
+    modem_trace_record_t rec;
+    modem_trace_reader_init(&r, g_connect_trace.data(), g_connect_trace.size());
+    while (modem_trace_next(&r, &rec)) {
+        if (rec.kind == MODEM_TRACE_RX) g_connect_rx_bytes += rec.len;
+    }
+}
+
+/**
+ * Every response byte through the UART tap's capture, every complete
+ * line through the typed parsers, every command into the latency histogram
+ */
+static size_t bench_connect_parse(void) {
+    static at_capture_t cap;
+    modem_latency_t lat = {};
+    modem_trace_reader_t r;
+    modem_trace_record_t rec;
+    modem_trace_reader_init(&r, g_connect_trace.data(), g_connect_trace.size());
+    at_capture_reset(&cap);
+    uint32_t command_ms = 0;
+    int processed = 0;
+    while (modem_trace_next(&r, &rec)) {
+        if (rec.kind == MODEM_TRACE_TX) {
+            at_capture_reset(&cap);
+            processed = 0;
+            command_ms = rec.t_ms;
+            continue;
+        }
+        if (rec.kind != MODEM_TRACE_RX) {
+            continue;
+        }
+        at_capture_feed(&cap, (const char *)rec.data, rec.len);
+        for (; processed < cap.count; processed++) {
+            at_view_t line = at_capture_line(&cap, processed);
+            at_cereg_t cereg;
+            at_sqnmoni_t moni;
+            at_cgact_t cgact;
+            at_sqnmodeactive_t mode;
+            g_sink += at_parse_cereg(line, &cereg) || at_parse_sqnmoni(line, &moni) ||
+                      at_parse_cgact(line, &cgact) || at_parse_sqnmodeactive(line, &mode);
+        }
+        if (cap.final_seen) {
+            bool ok = at_classify(at_capture_line(&cap, cap.count - 1)) == AT_LINE_OK;
+            modem_latency_record(&lat, rec.t_ms - command_ms, ok, false);
+            at_capture_reset(&cap);
+            processed = 0;
+        }
+    }
+    g_sink += modem_latency_percentile(&lat, 99);
+    return g_connect_rx_bytes;
+}
+
+static bool bench_trace_sink(void *ctx, uint32_t offset, const uint8_t *data, size_t len) {
+    (void)ctx;
+    (void)offset;
+    g_sink += data[len - 1];
+    return true;
+}
+
+/**
+ * The trace recorder's share: every UART read and write appended to a
+ * WMT1 writer, as with CONFIG_WALTER_MODEM_TRACE_BOOT
+ */
+static size_t bench_connect_trace(void) {
+    static modem_trace_writer_t w;
+    modem_trace_writer_init(&w, bench_trace_sink, NULL, UINT32_MAX, 0);
+    modem_trace_reader_t r;
+    modem_trace_record_t rec;
+    modem_trace_reader_init(&r, g_connect_trace.data(), g_connect_trace.size());
+    size_t bytes = 0;
+    while (modem_trace_next(&r, &rec)) {
+        modem_trace_append(&w, rec.kind, rec.t_ms, rec.data, rec.len);
+        bytes += rec.len;
+    }
+    modem_trace_flush(&w);
+    return bytes;
+}
+
+// ----------------------------------------------------------------------------
+// Encoders (built separately, see host_bench_encoders.cpp)
+// ----------------------------------------------------------------------------
+
+#ifdef HOST_BENCH_ENCODERS
+
+// host_bench_encoders.cpp
+void bench_encoders_setup(void *(*malloc_fn)(size_t));
+size_t bench_encode_batch(size_t count);
+size_t bench_encode_sensor(void);
+
+static void encoder_setup(void) {
+    bench_encoders_setup(counted_malloc);
+}
+
+static size_t bench_encode_batch_16(void) {
+    return bench_encode_batch(16);
+}
+
+static size_t bench_encode_batch_64(void) {
+    return bench_encode_batch(64);
+}
+
+#endif // HOST_BENCH_ENCODERS
+
+// ----------------------------------------------------------------------------
+// Harness
+// ----------------------------------------------------------------------------
+
+struct Bench {
+    const char *name;
+    size_t (*op)(void);
+    void (*setup)(void);
+};
+
+static const Bench BENCHES[] = {
+#ifdef HOST_BENCH_ENCODERS
+    { "encode.batch_json_16", bench_encode_batch_16, encoder_setup },
+    { "encode.batch_json_64", bench_encode_batch_64, encoder_setup },
+    { "encode.sensor_json", bench_encode_sensor, encoder_setup },
+#endif
+    { "parse.cereg", bench_parse_cereg, NULL },
+    { "parse.sqnmoni", bench_parse_sqnmoni, NULL },
+    { "parse.cesq", bench_parse_cesq, NULL },
+    { "parse.at_capture", bench_at_capture, NULL },
+    { "diag.parse_line", bench_diag_parse, NULL },
+    { "queue.spsc_sample", bench_spsc_sample, NULL },
+    { "queue.spsc_payload", bench_spsc_payload, NULL },
+    { "uplink.window_cycle", bench_uplink_window, NULL },
+    { "sched.upload_next", bench_upload_sched, NULL },
+    { "energy.set_modem", bench_energy_account, NULL },
+    { "connect.parse", bench_connect_parse, connect_setup },
+    { "connect.trace_record", bench_connect_trace, connect_setup },
+};
+
+struct BenchResult {
+    std::string name;
+    uint64_t ops = 0;
+    double ns_op = 0;
+    double p50_ns = 0;
+    double p99_ns = 0;
+    double ops_s = 0;
+    double mb_s = 0;
+    double allocs_op = 0;
+    double bytes_op = 0;
+};
+
+static double elapsed_ns(bench_clock::time_point start) {
+    return std::chrono::duration<double, std::nano>(bench_clock::now() - start).count();
+}
+
+static BenchResult run_bench(const Bench &b, int min_ms) {
+    if (b.setup != NULL) b.setup();
+
+    // Size batches so the clock is read rarely compared to the work
+    uint64_t batch = 1;
+    for (;;) {
+        bench_clock::time_point t = bench_clock::now();
+        for (uint64_t i = 0; i < batch; i++) b.op();
+        if (elapsed_ns(t) >= BENCH_BATCH_NS / 4 || batch >= (1u << 24)) break;
+        batch *= 2;
+    }
+
+    std::vector<double> per_op;
+    uint64_t ops = 0, bytes = 0, allocs = 0, alloc_bytes = 0;
+    double total_ns = 0;
+    while (total_ns < min_ms * 1e6) {
+        uint64_t allocs0 = g_allocs, alloc_bytes0 = g_alloc_bytes;
+        bench_clock::time_point t = bench_clock::now();
+        for (uint64_t i = 0; i < batch; i++) bytes += b.op();
+        double ns = elapsed_ns(t);
+        // Only the ops' own allocations, not the harness's
+        allocs += g_allocs - allocs0;
+        alloc_bytes += g_alloc_bytes - alloc_bytes0;
+        per_op.push_back(ns / batch);
+        total_ns += ns;
+        ops += batch;
+    }
+
+    std::sort(per_op.begin(), per_op.end());
+    BenchResult r;
+    r.name = b.name;
+    r.ops = ops;
+    r.ns_op = total_ns / ops;
+    r.p50_ns = per_op[per_op.size() / 2];
+    r.p99_ns = per_op[std::min(per_op.size() - 1, per_op.size() * 99 / 100)];
+    r.ops_s = ops / (total_ns / 1e9);
+    r.mb_s = bytes / (total_ns / 1e9) / 1e6;
+    r.allocs_op = (double)allocs / ops;
+    r.bytes_op = (double)alloc_bytes / ops;
+    return r;
+}
+
+static void print_json(const BenchResult &r) {
+    printf("{\"bench\":\"%s\",\"ops\":%llu,\"ns_op\":%.1f,\"p50_ns\":%.1f,\"p99_ns\":%.1f,"
+           "\"ops_s\":%.0f,\"mb_s\":%.2f,\"allocs_op\":%.2f,\"bytes_op\":%.1f}\n",
+           r.name.c_str(), (unsigned long long)r.ops, r.ns_op, r.p50_ns, r.p99_ns, r.ops_s,
+           r.mb_s, r.allocs_op, r.bytes_op);
+}
+
+static void print_row(const BenchResult &r) {
+    printf("%-24s %10.1f %10.1f %10.1f %12.0f %8.2f %9.2f %9.1f\n", r.name.c_str(), r.ns_op,
+           r.p50_ns, r.p99_ns, r.ops_s, r.mb_s, r.allocs_op, r.bytes_op);
+}
+
+/**
+ * Read a --json run back (only the fields --compare needs)
+ */
+static std::vector<BenchResult> load_baseline(const char *path) {
+    std::vector<BenchResult> out;
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        perror(path);
+        exit(2);
+    }
+    char line[512];
+    while (fgets(line, sizeof(line), f) != NULL) {
+        char name[64];
+        BenchResult r;
+        if (sscanf(line, "{\"bench\":\"%63[^\"]\",\"ops\":%*u,\"ns_op\":%lf,\"p50_ns\":%lf,"
+                         "\"p99_ns\":%lf,\"ops_s\":%*f,\"mb_s\":%*f,\"allocs_op\":%lf,\"bytes_op\":%lf",
+                   name, &r.ns_op, &r.p50_ns, &r.p99_ns, &r.allocs_op, &r.bytes_op) == 6) {
+            r.name = name;
+            out.push_back(r);
+        }
+    }
+    fclose(f);
+    return out;
+}
+
+/**
+ * @return Number of regressions
+ */
+static int compare(const std::vector<BenchResult> &base, const std::vector<BenchResult> &now,
+                   double threshold_pct) {
+    int regressions = 0;
+    fprintf(stderr, "\n%-24s %10s %10s %8s %11s %10s\n", "bench", "base p50", "p50", "change",
+            "base allocs", "allocs");
+    for (const BenchResult &r : now) {
+        auto it = std::find_if(base.begin(), base.end(),
+                               [&](const BenchResult &b) { return b.name == r.name; });
+        if (it == base.end()) {
+            fprintf(stderr, "%-24s %10s %10.1f %8s %11s %10.2f  new\n", r.name.c_str(), "-",
+                    r.p50_ns, "-", "-", r.allocs_op);
+            continue;
+        }
+        double change = (r.p50_ns - it->p50_ns) / it->p50_ns * 100;
+        bool slower = change > threshold_pct;
+        bool allocs = r.allocs_op > it->allocs_op + 0.005;
+        regressions += slower || allocs;
+        fprintf(stderr, "%-24s %10.1f %10.1f %+7.1f%% %11.2f %10.2f%s%s\n", r.name.c_str(),
+                it->p50_ns, r.p50_ns, change, it->allocs_op, r.allocs_op,
+                slower ? "  SLOWER" : "", allocs ? "  MORE ALLOCS" : "");
+    }
+    fprintf(stderr, "%d regression(s) at a %.0f%% threshold\n", regressions, threshold_pct);
+    return regressions;
+}
+
+static void usage(void) {
+    fprintf(stderr,
+            "usage: host_bench [--json] [--filter <text>] [--min-ms <ms>]\n"
+            "                  [--compare <baseline.jsonl>] [--threshold <pct>]\n");
+}
+
+int main(int argc, char **argv) {
+    bool json = false;
+    const char *filter = NULL;
+    const char *baseline = NULL;
+    int min_ms = BENCH_MIN_MS;
+    double threshold = BENCH_THRESHOLD_PCT;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--json") == 0) {
+            json = true;
+        } else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (strcmp(argv[i], "--min-ms") == 0 && i + 1 < argc) {
+            min_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--compare") == 0 && i + 1 < argc) {
+            baseline = argv[++i];
+        } else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) {
+            threshold = atof(argv[++i]);
+        } else {
+            usage();
+            return 2;
+        }
+    }
+
+    std::vector<BenchResult> base;
+    if (baseline != NULL) {
+        base = load_baseline(baseline);
+    }
+
+    if (!json) {
+#ifndef HOST_BENCH_ENCODERS
+        printf("(encoder benchmarks not built: no cJSON source found)\n\n");
+#endif
+        printf("%-24s %10s %10s %10s %12s %8s %9s %9s\n", "bench", "ns_op", "p50_ns", "p99_ns",
+               "ops_s", "mb_s", "allocs_op", "bytes_op");
+    }
+    std::vector<BenchResult> results;
+    for (const Bench &b : BENCHES) {
+        if (filter != NULL && strstr(b.name, filter) == NULL) {
+            continue;
+        }
+        BenchResult r = run_bench(b, min_ms);
+        json ? print_json(r) : print_row(r);
+        fflush(stdout);
+        results.push_back(r);
+    }
+
+    if (baseline != NULL && compare(base, results, threshold) > 0) {
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,67 @@
+/**
+ * Encoder Benchmarks for host_bench
+ *
+ * Compiled with ESP_PLATFORM against host/idf_stub so http_json_example.h
+ * and everything it pulls in (time service, energy account, boot
+ * waterfall) builds exactly as on the device. Kept out of host_bench.cpp,
+ * whose headers are built without ESP_PLATFORM.
+ */
+
+#include <string.h>
+#include "http_json_example.h"
+
+static sensor_sample_t g_batch[64];
+static sampler_stats_t g_batch_stats;
+
+/**
+ * Prepare samples, network time and the energy account
+ *
+ * @param malloc_fn Allocator cJSON should use (lets the harness count)
+ */
+void bench_encoders_setup(void *(*malloc_fn)(size_t)) {
+    static bool done = false;
+    if (done) {
+        return;
+    }
+    done = true;
+    cJSON_Hooks hooks = { malloc_fn, free };
+    cJSON_InitHooks(&hooks);
+
+    // Network time known, as on every upload after the first connect
+    time_service_init();
+    time_anchor_update(&g_time_anchor, 1760000000000LL, time_service_mono_us());
+    energy_init(NULL);
+
+    synthetic_sensor_t sensor = {};
+    for (size_t i = 0; i < sizeof(g_batch) / sizeof(g_batch[0]); i++) {
+        synthetic_sensor_read(&sensor, &g_batch[i]);
+        g_batch[i].timestamp_us = (int64_t)i * 1000000;
+        g_batch[i].seq = (uint32_t)i;
+    }
+    g_batch_stats.samples = 64;
+    g_batch_stats.jitter_max_us = 180;
+}
+
+/**
+ * create_batch_json() for count samples (at most 64)
+ *
+ * @return Payload length
+ */
+size_t bench_encode_batch(size_t count) {
+    char *json = create_batch_json(HTTP_DEVICE_ID, g_batch, count, &g_batch_stats);
+    size_t len = strlen(json);
+    cJSON_free(json);
+    return len;
+}
+
+/**
+ * create_sensor_json()
+ *
+ * @return Payload length
+ */
+size_t bench_encode_sensor(void) {
+    char *json = create_sensor_json(HTTP_DEVICE_ID);
+    size_t len = strlen(json);
+    cJSON_free(json);
+    return len;
+}
@@ -0,0 +1,81 @@
+/**
+ * Host stand-in for the WalterModem library header
+ *
+ * Declares only what the firmware headers the host tools include refer
+ * to, and defines none of it: a benchmark or check that reaches into the
+ * modem fails to link instead of exercising a fake.
+ */
+
+#ifndef IDF_STUB_WALTER_MODEM_H
+#define IDF_STUB_WALTER_MODEM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum {
+    WALTER_MODEM_STATE_OK = 0,
+    WALTER_MODEM_STATE_ERROR,
+    WALTER_MODEM_STATE_TIMEOUT,
+} WalterModemState;
+
+typedef enum {
+    WALTER_MODEM_TLS_VALIDATION_NONE,
+    WALTER_MODEM_TLS_VALIDATION_CA,
+} WalterModemTlsValidation;
+
+typedef enum {
+    WALTER_MODEM_TLS_VERSION_12,
+} WalterModemTlsVersion;
+
+typedef enum {
+    WALTER_MODEM_HTTP_SEND_CMD_POST,
+} WalterModemHttpSendCmdType;
+
+typedef enum {
+    WALTER_MODEM_HTTP_POST_PARAM_JSON,
+} WalterModemHttpPostParam;
+
+typedef struct {
+    WalterModemState result;
+    union {
+        int64_t clock;
+        struct {
+            int16_t rsrp;
+            int16_t rsrq;
+        } signalQuality;
+        struct {
+            uint16_t httpStatus;
+            uint16_t contentLength;
+        } httpResponse;
+    } data;
+} WalterModemRsp;
+
+typedef void (*walterModemCb)(const WalterModemRsp *rsp, void *args);
+
+class WalterModem {
+public:
+    static bool sendCmd(const char *cmd, void *at_rsp, WalterModemRsp *rsp);
+    static bool getClock(WalterModemRsp *rsp = NULL, walterModemCb cb = NULL, void *args = NULL);
+    static bool getSignalQuality(WalterModemRsp *rsp = NULL, walterModemCb cb = NULL,
+                                 void *args = NULL);
+    static bool reset(WalterModemRsp *rsp = NULL, walterModemCb cb = NULL, void *args = NULL);
+    static bool tlsWriteCredential(bool is_private_key, uint8_t slot, const char *credential);
+    static bool tlsConfigProfile(uint8_t profile_id, WalterModemTlsValidation validation,
+                                 WalterModemTlsVersion version, uint8_t ca_slot,
+                                 uint8_t cert_slot = 0xff, uint8_t key_slot = 0xff,
+                                 WalterModemRsp *rsp = NULL, walterModemCb cb = NULL,
+                                 void *args = NULL);
+    static bool httpConfigProfile(uint8_t profile_id, const char *server, uint16_t port,
+                                  uint8_t tls_profile_id, bool use_basic_auth, const char *user,
+                                  const char *password, uint16_t max_timeout,
+                                  uint16_t cnx_timeout, uint8_t in_activity_timeout,
+                                  WalterModemRsp *rsp = NULL, walterModemCb cb = NULL,
+                                  void *args = NULL);
+    static bool httpSend(uint8_t profile_id, const char *uri, uint8_t *data, uint16_t data_size,
+                         WalterModemHttpSendCmdType cmd, WalterModemHttpPostParam param,
+                         WalterModemRsp *rsp = NULL, walterModemCb cb = NULL, void *args = NULL);
+    static bool httpDidRing(uint8_t profile_id, uint8_t *target, uint16_t target_size,
+                            WalterModemRsp *rsp = NULL);
+};
+
+#endif // IDF_STUB_WALTER_MODEM_H
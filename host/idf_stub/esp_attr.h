@@ -0,0 +1,12 @@
+/**
+ * Host stand-in for ESP-IDF esp_attr.h: placement attributes are no-ops
+ */
+
+#ifndef IDF_STUB_ESP_ATTR_H
+#define IDF_STUB_ESP_ATTR_H
+
+#define RTC_DATA_ATTR
+#define RTC_NOINIT_ATTR
+#define IRAM_ATTR
+
+#endif // IDF_STUB_ESP_ATTR_H
@@ -0,0 +1,23 @@
+/**
+ * Host stand-in for ESP-IDF esp_err.h (see idf_stub.cpp)
+ */
+
+#ifndef IDF_STUB_ESP_ERR_H
+#define IDF_STUB_ESP_ERR_H
+
+typedef int esp_err_t;
+
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_NO_MEM 0x101
+#define ESP_ERR_INVALID_ARG 0x102
+#define ESP_ERR_INVALID_SIZE 0x104
+#define ESP_ERR_NVS_NO_FREE_PAGES 0x110d
+#define ESP_ERR_NVS_NOT_FOUND 0x1102
+#define ESP_ERR_NVS_NEW_VERSION_FOUND 0x1110
+
+#define ESP_ERROR_CHECK(x) (void)(x)
+
+const char *esp_err_to_name(esp_err_t err);
+
+#endif // IDF_STUB_ESP_ERR_H
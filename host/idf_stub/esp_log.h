@@ -0,0 +1,38 @@
+/**
+ * Host stand-in for ESP-IDF esp_log.h
+ *
+ * Log calls are type-checked against their format but print nothing, so
+ * logging on a benchmarked path costs what the argument evaluation costs.
+ */
+
+#ifndef IDF_STUB_ESP_LOG_H
+#define IDF_STUB_ESP_LOG_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define IDF_STUB_LOG(tag, format, ...)            \
+    do {                                          \
+        (void)(tag);                              \
+        if (0) printf(format, ##__VA_ARGS__);     \
+    } while (0)
+
+#define ESP_LOGE(tag, format, ...) IDF_STUB_LOG(tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) IDF_STUB_LOG(tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) IDF_STUB_LOG(tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) IDF_STUB_LOG(tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...) IDF_STUB_LOG(tag, format, ##__VA_ARGS__)
+
+typedef enum {
+    ESP_LOG_NONE,
+    ESP_LOG_ERROR,
+    ESP_LOG_WARN,
+    ESP_LOG_INFO,
+    ESP_LOG_DEBUG,
+    ESP_LOG_VERBOSE,
+} esp_log_level_t;
+
+uint32_t esp_log_timestamp(void);
+void esp_log_level_set(const char *tag, esp_log_level_t level);
+
+#endif // IDF_STUB_ESP_LOG_H
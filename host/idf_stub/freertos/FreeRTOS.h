@@ -0,0 +1,36 @@
+/**
+ * Host stand-in for FreeRTOS.h: one tick per millisecond, each portMUX is
+ * its own lock (fleet_load calls the encoders from many threads). C++ only.
+ */
+
+#ifndef IDF_STUB_FREERTOS_H
+#define IDF_STUB_FREERTOS_H
+
+#include <stdint.h>
+#include <mutex>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+typedef void *TaskHandle_t;
+typedef void *SemaphoreHandle_t;
+typedef struct {
+    std::recursive_mutex lock;
+} portMUX_TYPE;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define portMAX_DELAY 0xffffffffu
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define tskNO_AFFINITY 0x7fffffff
+
+#define portMUX_INITIALIZER_UNLOCKED {}
+#define taskENTER_CRITICAL(mux) idf_stub_critical_enter(mux)
+#define taskEXIT_CRITICAL(mux) idf_stub_critical_exit(mux)
+
+void idf_stub_critical_enter(portMUX_TYPE *mux);
+void idf_stub_critical_exit(portMUX_TYPE *mux);
+
+#endif // IDF_STUB_FREERTOS_H
@@ -0,0 +1,15 @@
+/**
+ * Host stand-in for FreeRTOS semphr.h (defined in idf_stub.cpp)
+ */
+
+#ifndef IDF_STUB_FREERTOS_SEMPHR_H
+#define IDF_STUB_FREERTOS_SEMPHR_H
+
+#include "FreeRTOS.h"
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem);
+
+#endif // IDF_STUB_FREERTOS_SEMPHR_H
@@ -0,0 +1,33 @@
+/**
+ * Host stand-in for FreeRTOS task.h (declarations only)
+ */
+
+#ifndef IDF_STUB_FREERTOS_TASK_H
+#define IDF_STUB_FREERTOS_TASK_H
+
+#include "FreeRTOS.h"
+
+typedef void (*TaskFunction_t)(void *arg);
+
+typedef enum {
+    eNoAction,
+    eSetBits,
+    eIncrement,
+    eSetValueWithOverwrite,
+} eNotifyAction;
+
+void vTaskDelay(TickType_t ticks);
+void vTaskDelayUntil(TickType_t *previous, TickType_t period);
+TickType_t xTaskGetTickCount(void);
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack,
+                                   void *arg, UBaseType_t prio, TaskHandle_t *out,
+                                   BaseType_t core);
+void vTaskDelete(TaskHandle_t task);
+BaseType_t xPortGetCoreID(void);
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks);
+void xTaskNotifyGive(TaskHandle_t task);
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action);
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit, uint32_t *value,
+                           TickType_t ticks);
+
+#endif // IDF_STUB_FREERTOS_TASK_H
@@ -0,0 +1,209 @@
+/**
+ * Host Implementations of the ESP-IDF Stand-ins
+ *
+ * Just enough of ESP-IDF for firmware headers built with ESP_PLATFORM to
+ * run on the host: a monotonic esp_timer, a log level setter that does
+ * nothing, critical sections, semaphores and an in-memory NVS. Anything
+ * declared in this directory but not defined here (FreeRTOS tasks, the
+ * modem) is deliberately left unresolved.
+ */
+
+#include <string.h>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "nvs.h"
+
+int64_t esp_timer_get_time(void) {
+    static const auto start = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now() - start).count();
+}
+
+uint32_t esp_log_timestamp(void) {
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+void esp_log_level_set(const char *tag, esp_log_level_t level) {
+    (void)tag;
+    (void)level;
+}
+
+// One lock per portMUX, as the spinlock behind each one on the device:
+// threads touching different firmware state do not wait for each other
+void idf_stub_critical_enter(portMUX_TYPE *mux) {
+    mux->lock.lock();
+}
+
+void idf_stub_critical_exit(portMUX_TYPE *mux) {
+    mux->lock.unlock();
+}
+
+// Semaphores: a count behind a condition variable (never freed, as on the
+// device, where they live for the whole run)
+struct idf_stub_semaphore {
+    std::mutex lock;
+    std::condition_variable given;
+    uint32_t count;
+};
+
+static SemaphoreHandle_t idf_stub_semaphore_create(uint32_t count) {
+    idf_stub_semaphore *sem = new idf_stub_semaphore;
+    sem->count = count;
+    return sem;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+    return idf_stub_semaphore_create(1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void) {
+    return idf_stub_semaphore_create(0);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t handle, TickType_t ticks) {
+    idf_stub_semaphore *sem = (idf_stub_semaphore *)handle;
+    std::unique_lock<std::mutex> hold(sem->lock);
+    auto ready = [sem] { return sem->count > 0; };
+    if (ticks == portMAX_DELAY) {
+        sem->given.wait(hold, ready);
+    } else if (!sem->given.wait_for(hold, std::chrono::milliseconds(ticks), ready)) {
+        return pdFALSE;
+    }
+    sem->count--;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t handle) {
+    idf_stub_semaphore *sem = (idf_stub_semaphore *)handle;
+    std::lock_guard<std::mutex> hold(sem->lock);
+    sem->count++;
+    sem->given.notify_one();
+    return pdTRUE;
+}
+
+const char *esp_err_to_name(esp_err_t err) {
+    switch (err) {
+    case ESP_OK: return "ESP_OK";
+    case ESP_FAIL: return "ESP_FAIL";
+    case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_SIZE: return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NVS_NOT_FOUND: return "ESP_ERR_NVS_NOT_FOUND";
+    default: return "ESP_ERR_UNKNOWN";
+    }
+}
+
+// ----------------------------------------------------------------------------
+// NVS: one map per namespace, handles are namespace indices + 1
+// ----------------------------------------------------------------------------
+
+typedef std::map<std::string, std::vector<uint8_t>> nvs_namespace_t;
+
+static std::vector<std::string> g_nvs_names;
+static std::map<std::string, nvs_namespace_t> g_nvs;
+
+static nvs_namespace_t *nvs_ns(nvs_handle_t handle) {
+    if (handle == 0 || handle > g_nvs_names.size()) {
+        return NULL;
+    }
+    return &g_nvs[g_nvs_names[handle - 1]];
+}
+
+static esp_err_t nvs_get(nvs_handle_t handle, const char *key, std::vector<uint8_t> **out) {
+    nvs_namespace_t *ns = nvs_ns(handle);
+    if (ns == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    auto it = ns->find(key);
+    if (it == ns->end()) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    *out = &it->second;
+    return ESP_OK;
+}
+
+static esp_err_t nvs_set(nvs_handle_t handle, const char *key, const void *value, size_t len) {
+    nvs_namespace_t *ns = nvs_ns(handle);
+    if (ns == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    (*ns)[key].assign((const uint8_t *)value, (const uint8_t *)value + len);
+    return ESP_OK;
+}
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t mode, nvs_handle_t *out) {
+    (void)mode;
+    for (size_t i = 0; i < g_nvs_names.size(); i++) {
+        if (g_nvs_names[i] == name) {
+            *out = (nvs_handle_t)(i + 1);
+            return ESP_OK;
+        }
+    }
+    g_nvs_names.push_back(name);
+    *out = (nvs_handle_t)g_nvs_names.size();
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out, size_t *len) {
+    std::vector<uint8_t> *value;
+    esp_err_t err = nvs_get(handle, key, &value);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (out == NULL) {
+        *len = value->size();
+        return ESP_OK;
+    }
+    if (*len < value->size()) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(out, value->data(), value->size());
+    *len = value->size();
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t len) {
+    return nvs_set(handle, key, value, len);
+}
+
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char *key, uint32_t *out) {
+    size_t len = sizeof(*out);
+    return nvs_get_blob(handle, key, out, &len);
+}
+
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char *key, uint32_t value) {
+    return nvs_set(handle, key, &value, sizeof(value));
+}
+
+esp_err_t nvs_get_str(nvs_handle_t handle, const char *key, char *out, size_t *len) {
+    return nvs_get_blob(handle, key, out, len);
+}
+
+esp_err_t nvs_set_str(nvs_handle_t handle, const char *key, const char *value) {
+    return nvs_set(handle, key, value, strlen(value) + 1);
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key) {
+    nvs_namespace_t *ns = nvs_ns(handle);
+    if (ns == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return ns->erase(key) ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle) {
+    return nvs_ns(handle) != NULL ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+void nvs_close(nvs_handle_t handle) {
+    (void)handle;
+}
@@ -0,0 +1,11 @@
+/**
+ * Host stand-in for the generated sdkconfig.h
+ *
+ * The CONFIG_WALTER_* options a host build needs are set as compile
+ * definitions in host/CMakeLists.txt.
+ */
+
+#ifndef IDF_STUB_SDKCONFIG_H
+#define IDF_STUB_SDKCONFIG_H
+
+#endif // IDF_STUB_SDKCONFIG_H
@@ -0,0 +1,110 @@
+/**
+ * Modem Latency Simulator
+ *
+ * Virtual-clock stand-in for the Walter modem used by the host-side
+ * simulations. Each operation class has a lognormal latency (median and
+ * spread), a failure probability and a hang probability; a hung operation
+ * only returns when the caller's timeout expires. Numbers are typical for
+ * NB-IoT in normal coverage and can be overridden per run.
+ *
+ * Everything is driven by one seeded RNG, so runs are reproducible.
+ */
+
+#ifndef MODEM_SIM_H
+#define MODEM_SIM_H
+
+#include <math.h>
+#include <stdint.h>
+#include <random>
+
+typedef enum {
+    MODEM_OP_AT = 0,            // Plain AT command round trip
+    MODEM_OP_OPSTATE,           // AT+CFUN
+    MODEM_OP_RAT,               // Set radio access technology
+    MODEM_OP_REGISTER,          // Network attach until CEREG registered
+    MODEM_OP_PDP,               // PDP context activation
+    MODEM_OP_CELL_INFO,         // AT+SQNMONI
+    MODEM_OP_DNS,               // AT+SQNDNSLKUP
+    MODEM_OP_HTTP_POST,         // Request + response, connection already set up
+    MODEM_OP_TLS_FULL,          // Full TLS handshake
+    MODEM_OP_TLS_RESUMED,       // Abbreviated handshake
+    MODEM_OP_COUNT
+} modem_op_t;
+
+typedef struct {
+    const char *name;
+    double median_ms;
+    double sigma;               // Lognormal shape; ~0.5 means p95 is ~2.3x the median
+    double fail_p;              // Returns an error after the sampled latency
+    double hang_p;              // Never answers; costs the caller's full timeout
+} modem_op_model_t;
+
+static const modem_op_model_t MODEM_SIM_DEFAULT[MODEM_OP_COUNT] = {
+    { "at",          30,   0.3, 0.000, 0.000 },
+    { "opstate",     250,  0.4, 0.000, 0.000 },
+    { "rat",         600,  0.4, 0.000, 0.000 },
+    { "register",    9000, 0.8, 0.020, 0.000 },
+    { "pdp",         1500, 0.5, 0.010, 0.000 },
+    { "cell_info",   350,  0.4, 0.000, 0.000 },
+    { "dns",         1800, 0.6, 0.030, 0.000 },
+    { "http_post",   2500, 0.5, 0.020, 0.000 },
+    { "tls_full",    4200, 0.5, 0.010, 0.000 },
+    { "tls_resumed", 2100, 0.4, 0.005, 0.000 },
+};
+
+// Time a hung operation takes when the caller gives no timeout
+#define MODEM_SIM_HANG_MS 300000.0
+
+typedef struct {
+    bool ok;
+    bool hung;
+    double ms;                  // Time the call took, already added to the clock
+} modem_sim_result_t;
+
+class ModemSim {
+public:
+    modem_op_model_t model[MODEM_OP_COUNT];
+    double now_ms = 0;
+
+    explicit ModemSim(uint64_t seed) : rng_(seed) {
+        for (int i = 0; i < MODEM_OP_COUNT; i++) {
+            model[i] = MODEM_SIM_DEFAULT[i];
+        }
+    }
+
+    /**
+     * Run one operation and advance the clock
+     *
+     * @param timeout_ms Caller's deadline for the call, 0 = none
+     */
+    modem_sim_result_t run(modem_op_t op, double timeout_ms = 0) {
+        const modem_op_model_t &m = model[op];
+        modem_sim_result_t res = {};
+        if (uniform() < m.hang_p) {
+            res.hung = true;
+            res.ms = timeout_ms > 0 ? timeout_ms : MODEM_SIM_HANG_MS;
+        } else {
+            res.ms = m.median_ms * exp(m.sigma * normal_(rng_));
+            res.ok = uniform() >= m.fail_p;
+            if (timeout_ms > 0 && res.ms > timeout_ms) {
+                res.ms = timeout_ms;
+                res.ok = false;
+            }
+        }
+        now_ms += res.ms;
+        return res;
+    }
+
+    void advance(double ms) { now_ms += ms; }
+
+    double uniform() { return uniform_(rng_); }
+
+    std::mt19937_64 &rng() { return rng_; }
+
+private:
+    std::mt19937_64 rng_;
+    std::normal_distribution<double> normal_{0.0, 1.0};
+    std::uniform_real_distribution<double> uniform_{0.0, 1.0};
+};
+
+#endif // MODEM_SIM_H
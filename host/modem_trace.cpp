@@ -0,0 +1,415 @@
+/**
+ * Modem Trace Tool
+ *
+ * Works on WMT1 traces recorded by main/modem_trace.h:
+ *
+ *   import <console.log> <out.wmt>   Rebuild a trace from 'trace dump' output
+ *   decode <trace.wmt>               Print every record as text
+ *   replay <trace.wmt> [speed]       Feed the trace through the firmware's
+ *                                    AT capture and parsers; speed 1 = the
+ *                                    recorded timing, 10 = ten times faster,
+ *                                    0 = no waiting (default)
+ *   synth <out.wmt> [seed]           Write a connect sequence with modem_sim.h
+ *                                    timing, for trying the tool without a
+ *                                    device
+ *
+ * replay reports per-command response times as recorded, the connect
+ * milestones (registered, PDP active), how the response lines parsed, and
+ * the host-side cost of capturing and parsing them. Everything except the
+ * cost figures is a pure function of the trace, so two runs over the same
+ * trace must print the same table; a parser change that alters it shows
+ * up as a diff.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+#include "at_response.h"
+#include "connect_trace.h"
+#include "modem_sim.h"
+#include "modem_trace.h"
+
+typedef std::chrono::steady_clock replay_clock;
+
+static bool read_file(const char *path, std::vector<uint8_t> *out) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        perror(path);
+        return false;
+    }
+    uint8_t buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        out->insert(out->end(), buf, buf + n);
+    }
+    fclose(f);
+    return true;
+}
+
+static bool write_file(const char *path, const std::vector<uint8_t> &data) {
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) {
+        perror(path);
+        return false;
+    }
+    bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+    fclose(f);
+    return ok;
+}
+
+static bool load_trace(const char *path, std::vector<uint8_t> *data, modem_trace_reader_t *r) {
+    if (!read_file(path, data)) {
+        return false;
+    }
+    if (!modem_trace_reader_init(r, data->data(), data->size())) {
+        fprintf(stderr, "%s: not a WMT1 trace\n", path);
+        return false;
+    }
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// import
+// ----------------------------------------------------------------------------
+
+static int hex_digit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+/**
+ * Collect "WMT <offset> <hex>" lines; log prefixes before "WMT" are skipped
+ */
+static int cmd_import(const char *log_path, const char *out_path) {
+    FILE *f = fopen(log_path, "r");
+    if (f == NULL) {
+        perror(log_path);
+        return 1;
+    }
+    std::vector<uint8_t> trace;
+    char line[512];
+    int lines = 0;
+    while (fgets(line, sizeof(line), f) != NULL) {
+        const char *p = strstr(line, "WMT ");
+        if (p == NULL) continue;
+        char *end;
+        unsigned long off = strtoul(p + 4, &end, 16);
+        if (end == p + 4 || *end != ' ') continue;
+        std::vector<uint8_t> bytes;
+        for (p = end + 1; hex_digit(p[0]) >= 0 && hex_digit(p[1]) >= 0; p += 2) {
+            bytes.push_back((uint8_t)(hex_digit(p[0]) << 4 | hex_digit(p[1])));
+        }
+        if (trace.size() < off + bytes.size()) {
+            trace.resize(off + bytes.size(), MODEM_TRACE_END);
+        }
+        std::copy(bytes.begin(), bytes.end(), trace.begin() + off);
+        lines++;
+    }
+    fclose(f);
+
+    modem_trace_reader_t r;
+    if (!modem_trace_reader_init(&r, trace.data(), trace.size())) {
+        fprintf(stderr, "%s: no trace dump found\n", log_path);
+        return 1;
+    }
+    if (!write_file(out_path, trace)) {
+        return 1;
+    }
+    printf("%d dump lines, %zu bytes -> %s\n", lines, trace.size(), out_path);
+    return 0;
+}
+
+// ----------------------------------------------------------------------------
+// decode
+// ----------------------------------------------------------------------------
+
+static std::string escape(const uint8_t *data, size_t len) {
+    std::string s;
+    for (size_t i = 0; i < len; i++) {
+        uint8_t c = data[i];
+        if (c == '\r') s += "\\r";
+        else if (c == '\n') s += "\\n";
+        else if (c == '\\') s += "\\\\";
+        else if (c >= 0x20 && c < 0x7F) s += (char)c;
+        else {
+            char hex[5];
+            snprintf(hex, sizeof(hex), "\\x%02x", c);
+            s += hex;
+        }
+    }
+    return s;
+}
+
+static int cmd_decode(const char *path) {
+    std::vector<uint8_t> data;
+    modem_trace_reader_t r;
+    if (!load_trace(path, &data, &r)) {
+        return 1;
+    }
+    static const char *const KIND[] = { "RX", "TX", "--" };
+    printf("# recording started at uptime %lu ms\n", (unsigned long)r.start_ms);
+    modem_trace_record_t rec;
+    while (modem_trace_next(&r, &rec)) {
+        printf("%10.3f %s %s\n", rec.t_ms / 1000.0, KIND[rec.kind],
+               escape(rec.data, rec.len).c_str());
+    }
+    if (r.truncated) {
+        printf("# trace truncated at byte %zu\n", r.pos);
+    }
+    return 0;
+}
+
+// ----------------------------------------------------------------------------
+// replay
+// ----------------------------------------------------------------------------
+
+struct CommandStats {
+    uint32_t count = 0;
+    uint32_t errors = 0;
+    uint32_t unanswered = 0;
+    std::vector<uint32_t> ms;
+};
+
+struct ReplayState {
+    at_capture_t cap;
+    int processed = 0;              // Capture lines already looked at
+    bool in_command = false;
+    std::string command;            // Command name, e.g. "AT+CFUN="
+    uint32_t command_ms = 0;
+    std::map<std::string, CommandStats> commands;
+    std::map<std::string, uint32_t> urcs;
+    uint32_t lines = 0;
+    uint32_t parsed = 0;            // Accepted by one of the typed parsers
+    uint32_t info_unparsed = 0;     // +NAME lines no parser handles
+    uint32_t dropped_lines = 0;
+    uint32_t payload_bytes = 0;     // TX that is not a command (data after '>')
+    int64_t registered_ms = -1;
+    int64_t pdp_active_ms = -1;
+    int64_t first_tx_ms = -1;
+};
+
+/**
+ * "AT+CFUN=1" -> "AT+CFUN=", "AT+CEREG?" -> "AT+CEREG?", "AT" -> "AT"
+ */
+static std::string command_name(const uint8_t *data, size_t len) {
+    std::string s;
+    for (size_t i = 0; i < len && data[i] != '\r' && data[i] != '\n'; i++) {
+        s += (char)data[i];
+        if (data[i] == '=' || data[i] == '?') break;
+    }
+    return s;
+}
+
+static void replay_line(ReplayState *st, at_view_t line, uint32_t t_ms) {
+    st->lines++;
+    at_cereg_t cereg;
+    at_sqnmoni_t moni;
+    at_cgdcont_t cgdcont;
+    at_cgact_t cgact;
+    at_cesq_t cesq;
+    at_sqnmodeactive_t mode;
+    at_sqndnslkup_t dns;
+    bool ok = false;
+    if (at_parse_cereg(line, &cereg)) {
+        ok = true;
+        if ((cereg.stat == 1 || cereg.stat == 5) && st->registered_ms < 0) {
+            st->registered_ms = t_ms;
+        }
+    } else {
+        ok = at_parse_sqnmoni(line, &moni) || at_parse_cgdcont(line, &cgdcont) ||
+             at_parse_cgact(line, &cgact) || at_parse_cesq(line, &cesq) ||
+             at_parse_sqnmodeactive(line, &mode) || at_parse_sqndnslkup(line, &dns);
+    }
+    st->parsed += ok;
+    if (!ok && at_classify(line) == AT_LINE_INFO) {
+        st->info_unparsed++;
+    }
+    if (!st->in_command && at_classify(line) == AT_LINE_INFO) {
+        const char *colon = (const char *)memchr(line.ptr, ':', line.len);
+        st->urcs[std::string(line.ptr, colon ? (size_t)(colon - line.ptr) : line.len)]++;
+    }
+}
+
+static void replay_close_command(ReplayState *st, uint32_t t_ms, bool answered) {
+    CommandStats &cs = st->commands[st->command];
+    cs.count++;
+    if (!answered) {
+        cs.unanswered++;
+    } else {
+        bool error = false;
+        for (int i = 0; i < st->cap.count; i++) {
+            error = error || at_classify(at_capture_line(&st->cap, i)) == AT_LINE_ERROR;
+        }
+        cs.errors += error;
+        cs.ms.push_back(t_ms - st->command_ms);
+        if (!error && st->command.rfind("AT+CGACT=", 0) == 0 && st->pdp_active_ms < 0) {
+            st->pdp_active_ms = t_ms;
+        }
+    }
+    st->in_command = false;
+    st->dropped_lines += st->cap.dropped_lines;
+    at_capture_reset(&st->cap);
+    st->processed = 0;
+}
+
+static void replay_record(ReplayState *st, const modem_trace_record_t &rec) {
+    if (rec.kind == MODEM_TRACE_TX) {
+        if (rec.len >= 2 && (rec.data[0] == 'A' || rec.data[0] == 'a') &&
+            (rec.data[1] == 'T' || rec.data[1] == 't')) {
+            if (st->first_tx_ms < 0) st->first_tx_ms = rec.t_ms;
+            if (st->in_command) replay_close_command(st, rec.t_ms, false);
+            for (int i = st->processed; i < st->cap.count; i++) {
+                replay_line(st, at_capture_line(&st->cap, i), rec.t_ms);
+            }
+            st->dropped_lines += st->cap.dropped_lines;
+            at_capture_reset(&st->cap);
+            st->processed = 0;
+            st->in_command = true;
+            st->command = command_name(rec.data, rec.len);
+            st->command_ms = rec.t_ms;
+        } else {
+            st->payload_bytes += rec.len;
+        }
+        return;
+    }
+    if (rec.kind != MODEM_TRACE_RX) {
+        return;
+    }
+
+    at_capture_feed(&st->cap, (const char *)rec.data, rec.len);
+    for (; st->processed < st->cap.count; st->processed++) {
+        replay_line(st, at_capture_line(&st->cap, st->processed), rec.t_ms);
+    }
+    if (st->in_command && st->cap.final_seen) {
+        replay_close_command(st, rec.t_ms, true);
+    } else if (!st->in_command && st->cap.used == st->cap.line_start) {
+        // Between commands: URC lines are done with once complete
+        st->dropped_lines += st->cap.dropped_lines;
+        at_capture_reset(&st->cap);
+        st->processed = 0;
+    }
+}
+
+static uint32_t percentile(std::vector<uint32_t> v, double p) {
+    if (v.empty()) return 0;
+    std::sort(v.begin(), v.end());
+    return v[std::min(v.size() - 1, (size_t)(p * (v.size() - 1) + 0.5))];
+}
+
+static int cmd_replay(const char *path, double speed) {
+    std::vector<uint8_t> data;
+    modem_trace_reader_t r;
+    if (!load_trace(path, &data, &r)) {
+        return 1;
+    }
+    std::vector<modem_trace_record_t> records;
+    modem_trace_record_t rec;
+    size_t rx_bytes = 0;
+    while (modem_trace_next(&r, &rec)) {
+        records.push_back(rec);
+        if (rec.kind == MODEM_TRACE_RX) rx_bytes += rec.len;
+    }
+    if (r.truncated) {
+        fprintf(stderr, "warning: trace truncated at byte %zu\n", r.pos);
+    }
+
+    ReplayState st;
+    at_capture_reset(&st.cap);
+    replay_clock::duration parse_time{};
+    replay_clock::time_point start = replay_clock::now();
+    for (const modem_trace_record_t &rr : records) {
+        if (speed > 0) {
+            std::this_thread::sleep_until(start + std::chrono::microseconds(
+                (int64_t)(rr.t_ms * 1000.0 / speed)));
+        }
+        replay_clock::time_point t0 = replay_clock::now();
+        replay_record(&st, rr);
+        parse_time += replay_clock::now() - t0;
+    }
+    if (st.in_command) {
+        replay_close_command(&st, records.back().t_ms, false);
+    }
+    double wall_s = std::chrono::duration<double>(replay_clock::now() - start).count();
+    uint32_t span_ms = records.empty() ? 0 : records.back().t_ms;
+
+    printf("trace: %zu records, %zu bytes, %.1f s recorded\n\n", records.size(), data.size(),
+           span_ms / 1000.0);
+    printf("%-22s %6s %6s %6s %9s %9s %9s\n", "command", "count", "error", "no-ans",
+           "p50 ms", "p95 ms", "max ms");
+    for (const auto &kv : st.commands) {
+        const CommandStats &cs = kv.second;
+        printf("%-22s %6u %6u %6u %9u %9u %9u\n", kv.first.c_str(), cs.count, cs.errors,
+               cs.unanswered, percentile(cs.ms, 0.50), percentile(cs.ms, 0.95),
+               percentile(cs.ms, 1.0));
+    }
+    if (!st.urcs.empty()) {
+        printf("\nunsolicited:");
+        for (const auto &kv : st.urcs) printf(" %s=%u", kv.first.c_str(), kv.second);
+        printf("\n");
+    }
+    printf("\nmilestones (s since first command):");
+    if (st.first_tx_ms < 0) {
+        printf(" no commands\n");
+    } else {
+        if (st.registered_ms >= 0) printf(" registered=%.1f", (st.registered_ms - st.first_tx_ms) / 1000.0);
+        else printf(" registered=never");
+        if (st.pdp_active_ms >= 0) printf(" pdp_active=%.1f", (st.pdp_active_ms - st.first_tx_ms) / 1000.0);
+        else printf(" pdp_active=never");
+        printf("\n");
+    }
+    printf("lines: %u, parsed %u, unparsed +info %u, dropped %u; tx payload %u bytes\n",
+           st.lines, st.parsed, st.info_unparsed, st.dropped_lines, st.payload_bytes);
+
+    double parse_ns = std::chrono::duration<double, std::nano>(parse_time).count();
+    char speed_str[16];
+    snprintf(speed_str, sizeof(speed_str), speed > 0 ? "%gx" : "max", speed);
+    printf("\nreplay: %.3f s wall (speed %s), capture+parse %.1f ns/RX byte\n", wall_s,
+           speed_str, rx_bytes ? parse_ns / rx_bytes : 0.0);
+    return 0;
+}
+
+// ----------------------------------------------------------------------------
+// synth
+// ----------------------------------------------------------------------------
+
+static int cmd_synth(const char *out_path, uint64_t seed) {
+    ModemSim sim(seed);
+    std::vector<uint8_t> out;
+    uint32_t records = connect_trace_synth(&sim, &out);
+    printf("%lu records, %zu bytes, %.1f s -> %s\n", (unsigned long)records, out.size(),
+           sim.now_ms / 1000.0, out_path);
+    return write_file(out_path, out) ? 0 : 1;
+}
+
+static void usage(void) {
+    fprintf(stderr,
+            "usage: modem_trace import <console.log> <out.wmt>\n"
+            "       modem_trace decode <trace.wmt>\n"
+            "       modem_trace replay <trace.wmt> [speed]\n"
+            "       modem_trace synth <out.wmt> [seed]\n");
+}
+
+int main(int argc, char **argv) {
+    if (argc >= 4 && strcmp(argv[1], "import") == 0) {
+        return cmd_import(argv[2], argv[3]);
+    }
+    if (argc >= 3 && strcmp(argv[1], "decode") == 0) {
+        return cmd_decode(argv[2]);
+    }
+    if (argc >= 3 && strcmp(argv[1], "replay") == 0) {
+        return cmd_replay(argv[2], argc > 3 ? atof(argv[3]) : 0);
+    }
+    if (argc >= 3 && strcmp(argv[1], "synth") == 0) {
+        return cmd_synth(argv[2], argc > 3 ? strtoull(argv[3], NULL, 10) : 1);
+    }
+    usage();
+    return 2;
+}
@@ -0,0 +1,294 @@
+/**
+ * Sampler Ring and Batch Encoder Check
+ *
+ * Builds main/uplink_pipeline.h with ESP_PLATFORM against idf_stub/, fills
+ * the sample ring through sampler_take() with the synthetic driver and
+ * encodes it with pipeline_encode_batch(), as the sensor task does. Checks
+ * that every sample read is accounted for: still in the ring, in a queued
+ * payload, or counted as dropped, and that samples survive a failed encode
+ * or a full uplink queue. Also encodes the widest full batch possible and
+ * checks that it fits PIPELINE_PAYLOAD_MAX, and that a payload the server
+ * refuses for good is released while a transient failure stays queued.
+ *
+ *   pipeline_test    exit status 0 if all checks pass
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "uplink_pipeline.h"
+
+#define TEST_BATCH 6   // Samples per flushed batch
+
+static int failures = 0;
+static uint32_t g_notified_bits = 0;
+static bool g_fail_alloc = false;
+
+// The sampler notifies its listener; record the bits instead of waking a task
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action) {
+    (void)task;
+    (void)action;
+    g_notified_bits |= value;
+    return pdPASS;
+}
+
+static void *test_malloc(size_t size) {
+    return g_fail_alloc ? NULL : malloc(size);
+}
+
+static void expect(bool ok, const char *what) {
+    printf("  %-52s %s\n", what, ok ? "ok" : "FAIL");
+    if (!ok) {
+        failures++;
+    }
+}
+
+/**
+ * Empty both queues and zero the counters between checks
+ */
+static void pipeline_reset(void) {
+    sensor_sample_t sample;
+    while (g_sample_queue.pop(&sample)) {
+    }
+    pipeline_payload_t payload;
+    while (g_uplink_queue.pop(&payload)) {
+    }
+    g_sampler_stats = {};
+    g_pipeline_stats = {};
+    g_pipeline_queued_samples = 0;
+    g_synthetic_sensor = {};
+}
+
+static uint32_t take_samples(uint32_t count, uint32_t *tick) {
+    for (uint32_t i = 0; i < count; i++) {
+        sampler_take((int64_t)*tick * 1000000, *tick);
+        (*tick)++;
+    }
+    return count;
+}
+
+/**
+ * Samples read == samples in the ring + samples in queued payloads + dropped
+ */
+static bool accounted(uint32_t taken) {
+    uint32_t ring = (uint32_t)g_sample_queue.size();
+    return taken == ring + g_pipeline_queued_samples + g_sampler_stats.dropped + g_sampler_stats.queue_overruns;
+}
+
+/**
+ * Parse a queued payload
+ *
+ * @return Number of sample rows, or -1 if the payload does not parse
+ */
+static int payload_rows(const pipeline_payload_t *payload) {
+    cJSON *root = cJSON_ParseWithLength(payload->data, payload->len);
+    if (root == NULL) {
+        return -1;
+    }
+    cJSON *samples = cJSON_GetObjectItemCaseSensitive(root, "samples");
+    int rows = cJSON_IsArray(samples) ? cJSON_GetArraySize(samples) : -1;
+    cJSON_Delete(root);
+    return rows;
+}
+
+static void check_batches(void) {
+    printf("batches\n");
+    pipeline_reset();
+    uint32_t tick = 0;
+    uint32_t taken = take_samples(TEST_BATCH, &tick);
+    expect(g_notified_bits == (1u << SENSOR_URGENCY_BULK), "listener notified with the sample urgency");
+
+    expect(!pipeline_encode_batch(0, true), "partial batch held between sessions");
+    expect(pipeline_encode_batch(0, false), "partial batch encoded on flush");
+    taken += take_samples(TEST_BATCH, &tick);
+    expect(pipeline_encode_batch(1, false), "next batch encoded");
+    expect(g_sample_queue.size() == 0, "ring emptied");
+    expect(g_sampler_stats.dropped == 0, "no samples dropped");
+    expect(accounted(taken), "every sample accounted for");
+
+    bool rows_ok = true;
+    pipeline_payload_t payload;
+    for (uint32_t i = 0; i < 2; i++) {
+        rows_ok &= g_uplink_queue.pop(&payload) && payload.seq == i && payload.samples == TEST_BATCH &&
+                   payload_rows(&payload) == TEST_BATCH && payload.len == strlen(payload.data);
+    }
+    expect(rows_ok, "payloads parse with one row per sample");
+}
+
+/**
+ * Sensor readings whose float -> double conversion prints with all 17
+ * significant digits, at the sign and magnitude limits of each field
+ */
+static bool worst_case_read(void *ctx, sensor_sample_t *out) {
+    uint32_t *reads = (uint32_t *)ctx;
+    float step = (float)(*reads)++ * 0.01f;
+    out->temperature = -39.9f - step;
+    out->humidity = 99.9f - step;
+    out->pressure = 1099.9f - step;
+    return true;
+}
+
+static void check_worst_case(void) {
+    printf("worst-case payload\n");
+    pipeline_reset();
+
+    // Every counter and field at the widest value it can print as: ten
+    // years of uptime, the longest sample period, both boot waterfalls
+    boot_waterfall_t *waterfalls[] = { &g_boot_wf, &g_boot_wf_prev };
+    for (boot_waterfall_t *wf : waterfalls) {
+        wf->version = UINT8_MAX;
+        wf->completed = 1;
+        wf->failed_stage = BOOT_STAGE_COUNT;
+        wf->uploaded = 0;
+        wf->boot_count = UINT32_MAX;
+        for (int i = 0; i < BOOT_STAGE_COUNT; i++) {
+            wf->start_ms[i] = UINT32_MAX;
+            wf->end_ms[i] = UINT32_MAX;
+        }
+    }
+    g_boot_wf_prev_pending = true;
+    const uint64_t ten_years_ms = 10ULL * 366 * 24 * 3600 * 1000;
+    for (int i = 0; i < ENERGY_MODEM_STATE_COUNT; i++) {
+        g_energy.modem_ms[i] = ten_years_ms;
+        g_energy.modem_charge[i] = ten_years_ms * 150000;
+    }
+    for (int i = 0; i < ENERGY_ACT_COUNT; i++) {
+        g_energy.activity_charge[i] = ten_years_ms * 150000;
+    }
+    g_energy.uploaded_bytes = 1;
+    g_device_config.version = UINT32_MAX;
+    g_device_config.last_cmd = UINT32_MAX;
+
+    uint32_t reads = 0;
+    sensor_driver_t saved = g_sampler_driver;
+    g_sampler_driver = { "worst-case", NULL, worst_case_read, &reads };
+    const int64_t period_us = 3600000LL * 1000;   // Longest sample period the config allows
+    for (uint32_t i = 0; i < PIPELINE_BATCH_MAX; i++) {
+        sampler_take((int64_t)i * period_us, i);
+    }
+    g_sampler_driver = saved;
+    g_sampler_stats = { UINT32_MAX, UINT32_MAX, UINT32_MAX, UINT32_MAX, UINT32_MAX, UINT32_MAX,
+                        UINT64_MAX, 1 };
+
+    expect(pipeline_encode_batch(0, true), "full batch encoded");
+    pipeline_payload_t payload;
+    bool queued = g_uplink_queue.pop(&payload);
+    printf("  worst case %u of %u bytes\n", queued ? (unsigned)payload.len : 0, (unsigned)PIPELINE_PAYLOAD_MAX);
+    expect(queued && payload.samples == PIPELINE_BATCH_MAX && payload_rows(&payload) == PIPELINE_BATCH_MAX,
+           "all samples in one payload");
+    expect(g_sampler_stats.dropped == UINT32_MAX && g_pipeline_stats.split_too_big == 0, "nothing dropped or split");
+
+    g_boot_wf = {};
+    g_boot_wf_prev = {};
+    g_boot_wf_prev_pending = false;
+    energy_init(NULL);
+    g_device_config = {};
+}
+
+static void check_encode_failure(void) {
+    printf("encode failure\n");
+    pipeline_reset();
+    uint32_t tick = 0;
+    uint32_t taken = take_samples(TEST_BATCH, &tick);
+
+    g_fail_alloc = true;
+    bool encoded = pipeline_encode_batch(0, false);
+    g_fail_alloc = false;
+    expect(!encoded, "encode reports failure");
+    expect(g_sample_queue.size() == TEST_BATCH, "samples kept in the ring");
+    expect(g_uplink_queue.size() == 0, "nothing queued");
+    expect(accounted(taken), "every sample accounted for");
+
+    const sensor_sample_t *first = g_sample_queue.peek();
+    expect(first != NULL && first->seq == 0, "retry starts at the first sample");
+    expect(pipeline_encode_batch(0, false), "retry encodes");
+    expect(g_sample_queue.size() == 0 && g_pipeline_queued_samples == TEST_BATCH, "retried batch queued");
+}
+
+static void check_queue_full(void) {
+    printf("uplink queue full\n");
+    pipeline_reset();
+    uint32_t tick = 0;
+    uint32_t taken = 0;
+    uint32_t seq = 0;
+    for (size_t i = 0; i < g_uplink_queue.capacity(); i++) {
+        taken += take_samples(TEST_BATCH, &tick);
+        if (pipeline_encode_batch(seq, false)) {
+            seq++;
+        }
+    }
+    taken += take_samples(TEST_BATCH, &tick);
+    expect(!pipeline_encode_batch(seq, false), "no slot to encode into");
+    expect(g_pipeline_stats.deferred_full == 1, "deferral counted");
+    expect(g_sample_queue.size() == TEST_BATCH, "deferred batch kept in the ring");
+    expect(accounted(taken), "every sample accounted for");
+}
+
+static void check_ring_overrun(void) {
+    printf("ring overrun\n");
+    pipeline_reset();
+    uint32_t tick = 0;
+    uint32_t taken = take_samples(SAMPLER_QUEUE_DEPTH + 5, &tick);
+    expect(g_sample_queue.size() == SAMPLER_QUEUE_DEPTH, "ring full");
+    expect(g_sampler_stats.queue_overruns == 5, "overruns counted");
+    expect(accounted(taken), "every sample accounted for");
+}
+
+static void check_rejected(void) {
+    printf("server responses\n");
+    expect(http_status_ok(200) && http_status_ok(204) && !http_status_ok(0) && !http_status_ok(302),
+           "2xx is delivered");
+    expect(http_status_permanent(400) && http_status_permanent(413) && http_status_permanent(404),
+           "400, 404, 413 are permanent");
+    expect(!http_status_permanent(0) && !http_status_permanent(408) && !http_status_permanent(429) &&
+           !http_status_permanent(500) && !http_status_permanent(503), "no response, 408, 429, 5xx retried");
+
+    pipeline_reset();
+    uint32_t tick = 0;
+    uint32_t taken = 0;
+    for (uint32_t seq = 0; seq < 3; seq++) {
+        taken += take_samples(TEST_BATCH, &tick);
+        pipeline_encode_batch(seq, false);
+    }
+
+    // The modem core's view: 503 on the head, then 413 on the same payload
+    pipeline_result_t result = {};
+    result.ok = http_status_ok(503);
+    result.rejected = http_status_permanent(503);
+    pipeline_complete(&result);
+    expect(g_uplink_queue.size() == 3 && g_uplink_queue.peek()->seq == 0, "5xx keeps the payload at the head");
+
+    result = {};
+    result.ok = http_status_ok(413);
+    result.rejected = http_status_permanent(413);
+    pipeline_complete(&result);
+    expect(g_uplink_queue.size() == 2 && g_uplink_queue.peek()->seq == 1, "413 releases it, the next one is up");
+    expect(g_pipeline_stats.rejected == 1 && g_pipeline_stats.failed == 1 && g_pipeline_stats.sent == 0,
+           "refusal and failure counted");
+
+    // The sensor core's view: the refused samples are gone, not queued
+    pipeline_drain_results(0);
+    expect(g_pipeline_queued_samples == 2 * TEST_BATCH, "refused samples no longer counted as queued");
+    expect(taken == g_sample_queue.size() + g_pipeline_queued_samples + TEST_BATCH,
+           "every sample queued or refused");
+}
+
+int main(void) {
+    cJSON_Hooks hooks = { test_malloc, free };
+    cJSON_InitHooks(&hooks);
+    time_service_init();
+    time_anchor_update(&g_time_anchor, 1760000000000LL, time_service_mono_us());
+    energy_init(NULL);
+    g_sampler_driver = synthetic_sensor_driver(&g_synthetic_sensor);
+    g_sampler_listener = (TaskHandle_t)&g_notified_bits;
+
+    check_batches();
+    check_worst_case();
+    check_encode_failure();
+    check_queue_full();
+    check_ring_overrun();
+    check_rejected();
+
+    printf("%s\n", failures == 0 ? "all checks passed" : "CHECKS FAILED");
+    return failures == 0 ? 0 : 1;
+}
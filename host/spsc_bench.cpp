@@ -0,0 +1,136 @@
+/**
+ * SPSC Queue Benchmark
+ *
+ * Builds main/spsc_queue.h natively and measures throughput and
+ * enqueue->dequeue latency between two threads, against a mutex-guarded
+ * std::deque baseline. Threads are pinned to separate CPUs when possible
+ * to mirror the sensor/modem core split on the ESP32-S3.
+ *
+ * Usage: spsc_bench [items]
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "spsc_queue.h"
+
+typedef std::chrono::steady_clock bench_clock;
+
+// Roughly the size of a typed sensor sample
+struct BenchItem {
+    uint64_t seq;
+    int64_t enqueued_ns;
+    uint8_t payload[48];
+};
+
+static int64_t now_ns(void) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        bench_clock::now().time_since_epoch()).count();
+}
+
+static void pin_to_cpu(int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu % std::max(1u, std::thread::hardware_concurrency()), &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+struct BenchResult {
+    double seconds;
+    std::vector<int64_t> latency_ns;
+};
+
+/**
+ * Mutex baseline with the same push/pop shape as SpscQueue
+ */
+class MutexQueue {
+public:
+    explicit MutexQueue(size_t capacity) : capacity_(capacity) {}
+    bool push(const BenchItem &item) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (items_.size() == capacity_) return false;
+        items_.push_back(item);
+        return true;
+    }
+    bool pop(BenchItem *item) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (items_.empty()) return false;
+        *item = items_.front();
+        items_.pop_front();
+        return true;
+    }
+private:
+    std::mutex mutex_;
+    std::deque<BenchItem> items_;
+    size_t capacity_;
+};
+
+template <typename Queue>
+static BenchResult run_bench(Queue &queue, uint64_t items) {
+    BenchResult result;
+    result.latency_ns.reserve(items);
+
+    auto start = bench_clock::now();
+    std::thread consumer([&]() {
+        pin_to_cpu(1);
+        BenchItem item;
+        for (uint64_t received = 0; received < items;) {
+            if (queue.pop(&item)) {
+                result.latency_ns.push_back(now_ns() - item.enqueued_ns);
+                received++;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    pin_to_cpu(0);
+    BenchItem item = {};
+    for (uint64_t seq = 0; seq < items; seq++) {
+        item.seq = seq;
+        item.enqueued_ns = now_ns();
+        while (!queue.push(item)) {
+            std::this_thread::yield();
+            item.enqueued_ns = now_ns();
+        }
+    }
+    consumer.join();
+    result.seconds = std::chrono::duration<double>(bench_clock::now() - start).count();
+    return result;
+}
+
+static void report(const char *name, BenchResult &r, uint64_t items) {
+    std::sort(r.latency_ns.begin(), r.latency_ns.end());
+    size_t n = r.latency_ns.size();
+    printf("%-8s %12.0f %10lld %10lld %10lld %10lld\n", name, items / r.seconds,
+           (long long)r.latency_ns[n / 2], (long long)r.latency_ns[n * 90 / 100],
+           (long long)r.latency_ns[n * 99 / 100], (long long)r.latency_ns[n - 1]);
+}
+
+int main(int argc, char **argv) {
+    uint64_t items = argc > 1 ? strtoull(argv[1], NULL, 10) : 2000000;
+    if (items == 0) {
+        fprintf(stderr, "Usage: %s [items]\n", argv[0]);
+        return 1;
+    }
+
+    static SpscQueue<BenchItem, 1024> spsc;
+    MutexQueue mutex_queue(1024);
+
+    printf("%llu items of %zu bytes, queue depth 1024\n\n",
+           (unsigned long long)items, sizeof(BenchItem));
+    printf("%-8s %12s %10s %10s %10s %10s\n", "queue", "items/s", "p50_ns", "p90_ns", "p99_ns", "max_ns");
+
+    BenchResult r = run_bench(spsc, items);
+    report("spsc", r, items);
+    r = run_bench(mutex_queue, items);
+    report("mutex", r, items);
+    return 0;
+}
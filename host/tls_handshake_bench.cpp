@@ -0,0 +1,262 @@
+/**
+ * TLS Handshake Cost Benchmark
+ *
+ * Runs full and resumed TLS handshakes between an in-process OpenSSL
+ * client and a local stand-in server (memory BIOs, nothing leaves the
+ * process) and reports what each costs on an NB-IoT link: bytes in each
+ * direction, number of flights (direction changes) and the resulting
+ * latency on a modeled link, plus local CPU time.
+ *
+ * The server certificate is generated at start-up, so the chain is a
+ * single certificate; real chains add their extra certificates' size to
+ * every full handshake but not to resumed ones. For TLS 1.3 the
+ * post-handshake NewSessionTicket is counted as a (final) flight.
+ *
+ * Usage: tls_handshake_bench [rtt_ms] [uplink_kbps] [downlink_kbps]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <vector>
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+
+// NB-IoT defaults (Cat-NB1, normal coverage)
+#define BENCH_RTT_MS 600
+#define BENCH_UPLINK_KBPS 20
+#define BENCH_DOWNLINK_KBPS 25
+#define BENCH_ROUNDS 20
+
+struct Flight {
+    bool to_server;
+    size_t bytes;
+};
+
+struct HandshakeResult {
+    bool ok;
+    bool resumed;
+    size_t up_bytes;
+    size_t down_bytes;
+    std::vector<Flight> flights;
+    double cpu_ms;
+};
+
+struct LinkModel {
+    double rtt_ms;
+    double up_kbps;
+    double down_kbps;
+};
+
+static void die(const char *what) {
+    fprintf(stderr, "%s failed\n", what);
+    ERR_print_errors_fp(stderr);
+    exit(1);
+}
+
+static EVP_PKEY *make_key(bool rsa) {
+    EVP_PKEY *key = rsa ? EVP_RSA_gen(2048) : EVP_EC_gen("P-256");
+    if (key == NULL) die("key generation");
+    return key;
+}
+
+static X509 *make_cert(EVP_PKEY *key) {
+    X509 *cert = X509_new();
+    X509_set_version(cert, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+    X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+    X509_gmtime_adj(X509_getm_notAfter(cert), 365L * 24 * 3600);
+    X509_NAME *name = X509_get_subject_name(cert);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+                               (const unsigned char *)"upload.example", -1, -1, 0);
+    X509_set_issuer_name(cert, name);
+    X509_set_pubkey(cert, key);
+    if (X509_sign(cert, key, EVP_sha256()) == 0) die("certificate signing");
+    return cert;
+}
+
+static void record(HandshakeResult *res, bool to_server, size_t bytes) {
+    if (to_server) {
+        res->up_bytes += bytes;
+    } else {
+        res->down_bytes += bytes;
+    }
+    if (!res->flights.empty() && res->flights.back().to_server == to_server) {
+        res->flights.back().bytes += bytes;
+    } else {
+        res->flights.push_back({ to_server, bytes });
+    }
+}
+
+/**
+ * Move whatever one side wrote to the other side's input
+ */
+static size_t pump(BIO *from, BIO *to) {
+    char buf[4096];
+    size_t total = 0;
+    int n;
+    while ((n = BIO_read(from, buf, sizeof(buf))) > 0) {
+        BIO_write(to, buf, n);
+        total += (size_t)n;
+    }
+    return total;
+}
+
+/**
+ * One handshake; *session is used for resumption and replaced with the new one
+ */
+static HandshakeResult handshake(SSL_CTX *client_ctx, SSL_CTX *server_ctx,
+                                 SSL_SESSION **session) {
+    HandshakeResult res = {};
+    SSL *client = SSL_new(client_ctx);
+    SSL *server = SSL_new(server_ctx);
+    BIO *c_in = BIO_new(BIO_s_mem()), *c_out = BIO_new(BIO_s_mem());
+    BIO *s_in = BIO_new(BIO_s_mem()), *s_out = BIO_new(BIO_s_mem());
+    SSL_set_bio(client, c_in, c_out);
+    SSL_set_bio(server, s_in, s_out);
+    SSL_set_connect_state(client);
+    SSL_set_accept_state(server);
+    SSL_set_tlsext_host_name(client, "upload.example");
+    if (*session != NULL) {
+        SSL_set_session(client, *session);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < 32; i++) {
+        SSL_do_handshake(client);
+        size_t up = pump(c_out, s_in);
+        if (up > 0) record(&res, true, up);
+        SSL_do_handshake(server);
+        size_t down = pump(s_out, c_in);
+        if (down > 0) record(&res, false, down);
+        if (SSL_is_init_finished(client) && SSL_is_init_finished(server) && up == 0 && down == 0) {
+            break;
+        }
+    }
+    // TLS 1.3 tickets arrive after the handshake; let the client process them
+    char byte;
+    SSL_read(client, &byte, 1);
+    res.cpu_ms = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+
+    res.ok = SSL_is_init_finished(client) && SSL_is_init_finished(server);
+    res.resumed = SSL_session_reused(client);
+    if (*session != NULL) {
+        SSL_SESSION_free(*session);
+    }
+    *session = SSL_get1_session(client);
+
+    // Close quietly: an unclean close would evict the session from the cache
+    SSL_set_quiet_shutdown(client, 1);
+    SSL_set_quiet_shutdown(server, 1);
+    SSL_shutdown(client);
+    SSL_shutdown(server);
+    SSL_free(client);
+    SSL_free(server);
+    return res;
+}
+
+/**
+ * Time on the modeled link: each flight costs half an RTT plus serialization
+ */
+static double link_ms(const HandshakeResult &res, const LinkModel &link) {
+    double ms = 0;
+    for (const Flight &f : res.flights) {
+        double kbps = f.to_server ? link.up_kbps : link.down_kbps;
+        ms += link.rtt_ms / 2 + (double)f.bytes * 8 / kbps;
+    }
+    return ms;
+}
+
+struct Scenario {
+    const char *name;
+    int version;            // TLS1_2_VERSION / TLS1_3_VERSION
+    bool rsa;
+    bool tickets;           // false: session ID cache only
+};
+
+static void run(const Scenario &sc, const LinkModel &link) {
+    EVP_PKEY *key = make_key(sc.rsa);
+    X509 *cert = make_cert(key);
+
+    SSL_CTX *server_ctx = SSL_CTX_new(TLS_server_method());
+    SSL_CTX_set_min_proto_version(server_ctx, sc.version);
+    SSL_CTX_set_max_proto_version(server_ctx, sc.version);
+    SSL_CTX_use_certificate(server_ctx, cert);
+    SSL_CTX_use_PrivateKey(server_ctx, key);
+    SSL_CTX_set_session_id_context(server_ctx, (const unsigned char *)"walter", 6);
+    if (!sc.tickets) {
+        SSL_CTX_set_options(server_ctx, SSL_OP_NO_TICKET);
+    }
+    if (sc.version == TLS1_3_VERSION) {
+        SSL_CTX_set_num_tickets(server_ctx, 1);
+    }
+
+    SSL_CTX *client_ctx = SSL_CTX_new(TLS_client_method());
+    SSL_CTX_set_min_proto_version(client_ctx, sc.version);
+    SSL_CTX_set_max_proto_version(client_ctx, sc.version);
+    SSL_CTX_set_verify(client_ctx, SSL_VERIFY_PEER, NULL);
+    X509_STORE_add_cert(SSL_CTX_get_cert_store(client_ctx), cert);
+    if (!sc.tickets) {
+        SSL_CTX_set_options(client_ctx, SSL_OP_NO_TICKET);
+    }
+
+    SSL_SESSION *session = NULL;
+    HandshakeResult full = handshake(client_ctx, server_ctx, &session);
+    HandshakeResult resumed = {};
+    double resumed_cpu = 0;
+    for (int i = 0; i < BENCH_ROUNDS; i++) {
+        resumed = handshake(client_ctx, server_ctx, &session);
+        resumed_cpu += resumed.cpu_ms;
+    }
+    resumed.cpu_ms = resumed_cpu / BENCH_ROUNDS;
+
+    if (!full.ok || !resumed.ok) {
+        printf("%-26s handshake failed\n", sc.name);
+    } else {
+        printf("%-26s %-7s %6zu %6zu %7zu %10.0f %8.2f\n", sc.name, "full", full.up_bytes,
+               full.down_bytes, full.flights.size(), link_ms(full, link), full.cpu_ms);
+        printf("%-26s %-7s %6zu %6zu %7zu %10.0f %8.2f  (%s, %.0f%% fewer bytes)\n", "",
+               "resumed", resumed.up_bytes, resumed.down_bytes, resumed.flights.size(),
+               link_ms(resumed, link), resumed.cpu_ms,
+               resumed.resumed ? "reused" : "NOT reused",
+               100.0 * (1.0 - (double)(resumed.up_bytes + resumed.down_bytes) /
+                                  (double)(full.up_bytes + full.down_bytes)));
+    }
+
+    SSL_SESSION_free(session);
+    SSL_CTX_free(client_ctx);
+    SSL_CTX_free(server_ctx);
+    X509_free(cert);
+    EVP_PKEY_free(key);
+}
+
+int main(int argc, char **argv) {
+    LinkModel link = {
+        argc > 1 ? atof(argv[1]) : BENCH_RTT_MS,
+        argc > 2 ? atof(argv[2]) : BENCH_UPLINK_KBPS,
+        argc > 3 ? atof(argv[3]) : BENCH_DOWNLINK_KBPS,
+    };
+    if (link.rtt_ms < 0 || link.up_kbps <= 0 || link.down_kbps <= 0) {
+        fprintf(stderr, "usage: %s [rtt_ms] [uplink_kbps] [downlink_kbps]\n", argv[0]);
+        return 1;
+    }
+
+    static const Scenario scenarios[] = {
+        { "TLS1.2 ECDSA, session ID", TLS1_2_VERSION, false, false },
+        { "TLS1.2 ECDSA, ticket",     TLS1_2_VERSION, false, true },
+        { "TLS1.2 RSA-2048, ticket",  TLS1_2_VERSION, true,  true },
+        { "TLS1.3 ECDSA, PSK ticket", TLS1_3_VERSION, false, true },
+    };
+
+    printf("link: RTT %.0f ms, up %.0f kbit/s, down %.0f kbit/s\n\n", link.rtt_ms,
+           link.up_kbps, link.down_kbps);
+    printf("%-26s %-7s %6s %6s %7s %10s %8s\n", "scenario", "type", "up B", "down B",
+           "flights", "link ms", "cpu ms");
+    for (const Scenario &sc : scenarios) {
+        run(sc, link);
+    }
+    return 0;
+}
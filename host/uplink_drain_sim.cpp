@@ -0,0 +1,181 @@
+/**
+ * Backlog Drain Simulation
+ *
+ * Drains a backlog of ~1 KB batch payloads (100 KB by default) through
+ * the window logic of main/multi_uplink.h, with 1 lane (the single-stream
+ * loop in uplink_pipeline.h) and with several modem HTTP profiles in
+ * parallel. One POST on a lane costs:
+ *
+ *   AT+SQNHTTPSEND + payload over the modem UART   shared by all lanes
+ *   payload over the NB-IoT uplink                 shared by all lanes
+ *   server round trip (modem_sim.h "http_post")    per lane, overlaps
+ *   response ring noticed at the next poll          MULTI_UPLINK_POLL_MS
+ *
+ * Failures (modem_sim.h failure rate) are retried through the window. A
+ * payload given up on stalls the window; the in-flight POSTs finish and
+ * the drain resumes from that payload, like the next session would.
+ * Every drain checks that payloads are released strictly in order.
+ *
+ * Usage: uplink_drain_sim [backlog_kb] [runs] [uplink_kbps] [seed]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+#include "modem_sim.h"
+#include "multi_uplink.h"
+
+#define SIM_UART_BAUD 115200.0
+#define SIM_AT_OVERHEAD_MS 40.0     // Command echo + OK per AT exchange
+#define SIM_POLL_MS 200.0           // MULTI_UPLINK_POLL_MS
+#define SIM_PAYLOAD_MIN 1150        // create_batch_json() with 16 samples
+#define SIM_PAYLOAD_MAX 1500        // ... with a boot waterfall attached
+
+struct DrainConfig {
+    const char *name;
+    int lanes;
+    uint32_t window;
+};
+
+static const DrainConfig CONFIGS[] = {
+    { "single stream", 1, 1 },
+    { "2 lanes, window 2", 2, 2 },
+    { "2 lanes, window 4", 2, 4 },      // Firmware default
+    { "3 lanes, window 6", 3, 6 },      // All three HTTP profiles
+};
+
+struct DrainResult {
+    double ms;
+    uint32_t retries;
+    uint32_t given_up;
+    uint32_t held;
+    uint32_t stalls;
+};
+
+struct Lane {
+    bool busy;
+    uint32_t id;
+    double done_ms;
+    bool ok;
+};
+
+static double uart_ms(size_t bytes) {
+    return SIM_AT_OVERHEAD_MS + bytes * 10.0 * 1000.0 / SIM_UART_BAUD;
+}
+
+static DrainResult drain(const DrainConfig &cfg, const std::vector<uint16_t> &payloads,
+                         double uplink_kbps, uint64_t seed) {
+    ModemSim sim(seed);
+    uplink_window_t win;
+    uplink_window_init(&win, cfg.window);
+    std::vector<Lane> lanes(cfg.lanes);
+    double now = 0;
+    double uart_free = 0;           // One AT exchange at a time
+    double link_free = 0;           // Uplink radio bearer
+    uint32_t released = 0;
+    uint32_t total = (uint32_t)payloads.size();
+    std::vector<bool> finished(total);
+    uint32_t retries = 0, given_up = 0, held = 0, stalls = 0;
+
+    while (released < total) {
+        for (Lane &lane : lanes) {
+            if (lane.busy || !uplink_window_take(&win, total - win.base, &lane.id)) {
+                continue;
+            }
+            uint16_t len = payloads[lane.id];
+            uart_free = std::max(now, uart_free) + uart_ms(len + 40);
+            link_free = std::max(uart_free, link_free) + len * 8.0 / uplink_kbps;
+            modem_sim_result_t r = sim.run(MODEM_OP_HTTP_POST);
+            lane.busy = true;
+            lane.done_ms = link_free + r.ms;
+            lane.ok = r.ok;
+        }
+
+        // Next poll at which a response has arrived
+        double next = 1e300;
+        for (const Lane &lane : lanes) {
+            if (lane.busy) next = std::min(next, lane.done_ms);
+        }
+        now = std::max(now + SIM_POLL_MS, ceil(next / SIM_POLL_MS) * SIM_POLL_MS);
+        for (Lane &lane : lanes) {
+            if (lane.busy && lane.done_ms <= now) {
+                // AT+SQNHTTPRCV for the response
+                uart_free = std::max(now, uart_free) + uart_ms(64);
+                lane.busy = false;
+                uplink_window_finish(&win, lane.id, lane.ok);
+                finished[lane.id] = (win.done_mask >> (lane.id - win.base)) & 1u;
+            }
+        }
+        while (uplink_window_release(&win)) {
+            // win.base - 1 is the payload just released
+            if (win.base - 1 != released || !finished[released]) {
+                fprintf(stderr, "payload %u released out of order\n", released);
+                exit(1);
+            }
+            released++;
+        }
+        now = std::max(now, uart_free);
+
+        bool busy = false;
+        for (const Lane &lane : lanes) busy = busy || lane.busy;
+        if (win.stalled && !busy) {
+            // The given-up payload is still queued; start over from it
+            retries += win.retries;
+            given_up += win.given_up;
+            held += win.held;
+            stalls++;
+            uplink_window_init(&win, cfg.window);
+            win.base = win.next = released;
+            for (uint32_t i = released; i < total; i++) finished[i] = false;
+        }
+    }
+    return { now, retries + win.retries, given_up + win.given_up, held + win.held, stalls };
+}
+
+static double percentile(std::vector<double> v, double p) {
+    std::sort(v.begin(), v.end());
+    return v[std::min(v.size() - 1, (size_t)(p * (v.size() - 1) + 0.5))];
+}
+
+int main(int argc, char **argv) {
+    int backlog_kb = argc > 1 ? atoi(argv[1]) : 100;
+    int runs = argc > 2 ? atoi(argv[2]) : 500;
+    double uplink_kbps = argc > 3 ? atof(argv[3]) : 20.0;
+    uint64_t seed = argc > 4 ? strtoull(argv[4], NULL, 10) : 1;
+
+    printf("%d KB backlog, %d runs, %.0f kbit/s uplink, HTTP round trip median %.0f ms\n\n",
+           backlog_kb, runs, uplink_kbps, MODEM_SIM_DEFAULT[MODEM_OP_HTTP_POST].median_ms);
+    printf("%-20s %9s %9s %10s %8s %8s %8s %8s\n", "mode", "p50 s", "p95 s", "goodput", "speedup",
+           "retries", "held", "stalls");
+
+    double base_p50 = 0;
+    for (const DrainConfig &cfg : CONFIGS) {
+        std::vector<double> ms;
+        double retries = 0, held = 0, stalls = 0, bytes = 0, total_ms = 0;
+        for (int r = 0; r < runs; r++) {
+            // Same backlog and modem randomness for every mode
+            std::mt19937_64 rng(seed + r);
+            std::vector<uint16_t> payloads;
+            size_t sum = 0;
+            while (sum < (size_t)backlog_kb * 1024) {
+                uint16_t len = (uint16_t)(SIM_PAYLOAD_MIN + rng() % (SIM_PAYLOAD_MAX - SIM_PAYLOAD_MIN + 1));
+                payloads.push_back(len);
+                sum += len;
+            }
+            DrainResult res = drain(cfg, payloads, uplink_kbps, seed + r);
+            ms.push_back(res.ms);
+            retries += res.retries;
+            held += res.held;
+            stalls += res.stalls;
+            bytes += sum;
+            total_ms += res.ms;
+        }
+        double p50 = percentile(ms, 0.50);
+        if (base_p50 == 0) base_p50 = p50;
+        printf("%-20s %9.1f %9.1f %7.0f B/s %7.2fx %8.1f %8.1f %8.2f\n", cfg.name, p50 / 1000,
+               percentile(ms, 0.95) / 1000, bytes / (total_ms / 1000), base_p50 / p50,
+               retries / runs, held / runs, stalls / runs);
+    }
+    return 0;
+}
@@ -0,0 +1,172 @@
+/**
+ * Upload Scheduler Simulation
+ *
+ * Drives main/upload_scheduler.h with simulated time over several days
+ * and compares it with the fixed 60 s upload period the pipeline used
+ * before. Samples arrive every SAMPLER_PERIOD_MS with a deterministic mix
+ * of urgency classes, and signal quality follows a daily cycle. Sessions
+ * are charged with the scheduler's own cost model.
+ *
+ * Usage: upload_sched_sim [days] [daily_budget_uah] [buffer_records]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <deque>
+#include <math.h>
+#include "upload_scheduler.h"
+
+#define SIM_SAMPLE_PERIOD_MS 10000      // SAMPLER_PERIOD_MS
+#define SIM_FIXED_PERIOD_MS 60000       // Old PIPELINE_ENCODE_INTERVAL_MS
+#define SIM_URGENT_ONE_IN 2000          // ~4 alarms a day
+#define SIM_NORMAL_ONE_IN 500           // ~17 notable readings a day
+
+struct SimRecord {
+    int64_t t_ms;
+    sensor_urgency_t urgency;
+};
+
+struct SimResult {
+    uint32_t sessions;
+    uint64_t charge_uah;
+    uint32_t overflows;
+    int64_t max_age_ms[SENSOR_URGENCY_COUNT];
+    uint32_t by_reason[UPLOAD_REASON_COUNT];
+};
+
+static uint32_t g_buffer_records = 64 + 8 * 16;  // PIPELINE_BUFFER_RECORDS
+static uint32_t g_lcg = 12345;
+
+static uint32_t sim_rand(void) {
+    g_lcg = g_lcg * 1664525u + 1013904223u;
+    return g_lcg >> 8;
+}
+
+/**
+ * RSRP over the day: good in the afternoon, poor at night
+ */
+static int16_t sim_rsrp(int64_t t_ms) {
+    double day = (double)(t_ms % UPLOAD_DAY_MS) / UPLOAD_DAY_MS;
+    return (int16_t)lround(-97.0 + 18.0 * sin(2 * M_PI * (day - 0.25)));
+}
+
+static sensor_urgency_t sim_urgency(void) {
+    uint32_t r = sim_rand();
+    if (r % SIM_URGENT_ONE_IN == 0) return SENSOR_URGENCY_URGENT;
+    if (r % SIM_NORMAL_ONE_IN == 1) return SENSOR_URGENCY_NORMAL;
+    return SENSOR_URGENCY_BULK;
+}
+
+/**
+ * Send everything buffered at t_ms; the session is charged at the current signal
+ */
+static void sim_session(SimResult *res, std::deque<SimRecord> *buffer, upload_sched_t *cost_model,
+                        int64_t t_ms) {
+    upload_sched_note_signal(cost_model, sim_rsrp(t_ms));
+    uint32_t cost = upload_sched_session_cost(cost_model);
+    for (const SimRecord &rec : *buffer) {
+        res->max_age_ms[rec.urgency] = std::max(res->max_age_ms[rec.urgency], t_ms - rec.t_ms);
+    }
+    buffer->clear();
+    res->sessions++;
+    res->charge_uah += cost;
+}
+
+static SimResult run_fixed(int64_t end_ms, const upload_sched_config_t *config) {
+    SimResult res = {};
+    std::deque<SimRecord> buffer;
+    upload_sched_t cost_model;
+    upload_sched_init(&cost_model, config, 0);
+    g_lcg = 12345;
+
+    for (int64_t t = 0; t < end_ms; t += SIM_SAMPLE_PERIOD_MS) {
+        buffer.push_back({ t, sim_urgency() });
+        if ((t + SIM_SAMPLE_PERIOD_MS) % SIM_FIXED_PERIOD_MS == 0) {
+            sim_session(&res, &buffer, &cost_model, t);
+        }
+    }
+    return res;
+}
+
+static SimResult run_adaptive(int64_t end_ms, const upload_sched_config_t *config) {
+    SimResult res = {};
+    std::deque<SimRecord> buffer;
+    upload_sched_t sched;
+    upload_sched_t cost_model;
+    upload_sched_init(&sched, config, 0);
+    upload_sched_init(&cost_model, config, 0);
+    g_lcg = 12345;
+
+    int64_t t = 0;
+    int64_t next_sample = 0;
+    while (t < end_ms) {
+        if (t == next_sample) {
+            if (buffer.size() >= g_buffer_records) {
+                res.overflows++;
+            } else {
+                SimRecord rec = { t, sim_urgency() };
+                buffer.push_back(rec);
+                upload_sched_note_record(&sched, rec.urgency, t);
+            }
+            next_sample += SIM_SAMPLE_PERIOD_MS;
+        }
+
+        upload_reason_t reason;
+        int64_t next_flush = upload_sched_next_flush_ms(&sched, t, (uint32_t)buffer.size(),
+                                                        g_buffer_records, &reason);
+        if (next_flush <= t && reason != UPLOAD_REASON_NONE) {
+            uint64_t before = res.charge_uah;
+            sim_session(&res, &buffer, &cost_model, t);
+            upload_sched_flushed(&sched, t, reason);
+            upload_sched_note_signal(&sched, sim_rsrp(t));
+            upload_sched_note_charge(&sched, t, (uint32_t)(res.charge_uah - before));
+            res.by_reason[reason]++;
+        }
+        t = std::min(next_sample, std::max(next_flush, t + 1));
+    }
+    return res;
+}
+
+static void print_result(const char *name, const SimResult &res, double days) {
+    printf("%-10s %10.1f %12.1f %9.0f %9.1f %9.1f %8u\n", name, res.sessions / days,
+           res.charge_uah / days / 1000.0, res.max_age_ms[SENSOR_URGENCY_URGENT] / 1000.0,
+           res.max_age_ms[SENSOR_URGENCY_NORMAL] / 60000.0,
+           res.max_age_ms[SENSOR_URGENCY_BULK] / 60000.0, res.overflows);
+}
+
+int main(int argc, char **argv) {
+    int days = argc > 1 ? atoi(argv[1]) : 7;
+    upload_sched_config_t config = UPLOAD_SCHED_DEFAULT;
+    if (argc > 2) {
+        config.daily_budget_uah = (uint32_t)strtoul(argv[2], NULL, 10);
+    }
+    if (argc > 3) {
+        g_buffer_records = (uint32_t)strtoul(argv[3], NULL, 10);
+    }
+    if (days <= 0 || g_buffer_records == 0) {
+        fprintf(stderr, "usage: %s [days] [daily_budget_uah] [buffer_records]\n", argv[0]);
+        return 1;
+    }
+    int64_t end_ms = days * UPLOAD_DAY_MS;
+
+    SimResult fixed = run_fixed(end_ms, &config);
+    SimResult adaptive = run_adaptive(end_ms, &config);
+
+    printf("%d days, %u samples/day, buffer %u records, budget %u uAh/day\n\n", days,
+           (unsigned)(UPLOAD_DAY_MS / SIM_SAMPLE_PERIOD_MS), (unsigned)g_buffer_records,
+           (unsigned)config.daily_budget_uah);
+    printf("%-10s %10s %12s %9s %9s %9s %8s\n", "policy", "sessions/d", "radio mAh/d",
+           "urgent s", "normal m", "bulk m", "overflow");
+    print_result("fixed-60s", fixed, days);
+    print_result("adaptive", adaptive, days);
+
+    printf("\nsessions by reason:");
+    for (int i = 1; i < UPLOAD_REASON_COUNT; i++) {
+        printf(" %s=%u", UPLOAD_REASON_NAMES[i], adaptive.by_reason[i]);
+    }
+    printf("\nradio sessions per day reduced by %.1f%% (%.1fx fewer)\n",
+           100.0 * (1.0 - (double)adaptive.sessions / fixed.sessions),
+           (double)fixed.sessions / std::max(1u, adaptive.sessions));
+    return 0;
+}
@@ -0,0 +1,195 @@
+/**
+ * Boot Waterfall Report
+ *
+ * Reads uploaded telemetry (one JSON document per line, from files or
+ * stdin), extracts every "boot_wf"/"boot_wf_prev" object and prints
+ * per-stage percentiles across all devices.
+ *
+ * Usage: waterfall_report [file ...]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "boot_waterfall.h"
+
+struct StageSamples {
+    std::vector<uint32_t> ms[BOOT_STAGE_COUNT];
+    std::vector<uint32_t> total_ms;
+    std::vector<uint32_t> app_start_ms;     // Reset -> connect_nbiot() start
+    unsigned failed_at[BOOT_STAGE_COUNT + 1] = {};
+    unsigned waterfalls = 0;
+    unsigned completed = 0;
+    unsigned retried = 0;                   // Needed more than one connect attempt
+};
+
+/**
+ * Read the integer following "key": inside [obj, end)
+ */
+static bool find_number(const char *obj, const char *end, const char *key, long *out) {
+    std::string pattern = std::string("\"") + key + "\":";
+    const char *p = strstr(obj, pattern.c_str());
+    if (p == NULL || p >= end) {
+        return false;
+    }
+    *out = strtol(p + pattern.size(), NULL, 10);
+    return true;
+}
+
+/**
+ * Decode one waterfall object starting at obj
+ */
+static bool parse_waterfall(const char *obj, boot_waterfall_t *wf) {
+    const char *end = strchr(obj, '}');
+    if (end == NULL) {
+        return false;
+    }
+
+    long value = 0;
+    memset(wf, 0, sizeof(*wf));
+    if (find_number(obj, end, "v", &value)) wf->version = (uint8_t)value;
+    if (find_number(obj, end, "boot", &value)) wf->boot_count = (uint32_t)value;
+    if (find_number(obj, end, "ok", &value)) wf->completed = (uint8_t)value;
+    if (find_number(obj, end, "fail", &value)) wf->failed_stage = (uint8_t)value;
+    wf->attempt = 1;                        // Version 1 did not record it
+    if (find_number(obj, end, "att", &value)) wf->attempt = (uint8_t)value;
+
+    const char *st = strstr(obj, "\"st\":[");
+    if (st == NULL || st >= end) {
+        return false;
+    }
+    const char *p = st + 6;
+    for (int i = 0; i < BOOT_STAGE_COUNT * 2; i++) {
+        char *next = NULL;
+        unsigned long v = strtoul(p, &next, 10);
+        if (next == p) {
+            return false;
+        }
+        if (i % 2 == 0) {
+            wf->start_ms[i / 2] = (uint32_t)v;
+        } else {
+            wf->end_ms[i / 2] = (uint32_t)v;
+        }
+        p = next;
+        while (*p == ',' || *p == ' ') p++;
+    }
+    return wf->version >= 1 && wf->version <= BOOT_WATERFALL_VERSION;
+}
+
+static void add_waterfall(StageSamples *s, const boot_waterfall_t *wf) {
+    s->waterfalls++;
+    if (wf->attempt > 1) {
+        s->retried++;
+    }
+    if (wf->start_ms[BOOT_STAGE_MODEM_INIT] != 0) {
+        s->app_start_ms.push_back(wf->start_ms[BOOT_STAGE_MODEM_INIT]);
+    }
+    uint32_t total = 0;
+    for (int i = 0; i < BOOT_STAGE_COUNT; i++) {
+        uint32_t ms = boot_waterfall_stage_ms(wf, i);
+        if (wf->end_ms[i] != 0) {
+            s->ms[i].push_back(ms);
+        }
+        total += ms;
+    }
+    if (wf->completed) {
+        s->completed++;
+        s->total_ms.push_back(total);
+    } else {
+        s->failed_at[std::min<int>(wf->failed_stage, BOOT_STAGE_COUNT)]++;
+    }
+}
+
+static void scan_line(StageSamples *s, const char *line) {
+    const char *p = line;
+    while ((p = strstr(p, "\"boot_wf")) != NULL) {
+        const char *obj = strchr(p, '{');
+        if (obj == NULL) {
+            return;
+        }
+        boot_waterfall_t wf;
+        if (parse_waterfall(obj, &wf)) {
+            add_waterfall(s, &wf);
+        }
+        p = obj + 1;
+    }
+}
+
+static void scan_file(StageSamples *s, FILE *f) {
+    std::string line;
+    int c;
+    while ((c = fgetc(f)) != EOF) {
+        if (c == '\n') {
+            scan_line(s, line.c_str());
+            line.clear();
+        } else {
+            line.push_back((char)c);
+        }
+    }
+    if (!line.empty()) {
+        scan_line(s, line.c_str());
+    }
+}
+
+/**
+ * Nearest-rank percentile of a sorted vector
+ */
+static uint32_t percentile(const std::vector<uint32_t> &sorted, double pct) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t rank = (size_t)(pct / 100.0 * sorted.size() + 0.999999);
+    rank = std::max<size_t>(1, std::min(rank, sorted.size()));
+    return sorted[rank - 1];
+}
+
+static void print_row(const char *name, std::vector<uint32_t> &v) {
+    std::sort(v.begin(), v.end());
+    printf("%-14s %6zu %8u %8u %8u %8u\n", name, v.size(),
+           percentile(v, 50), percentile(v, 90), percentile(v, 99),
+           v.empty() ? 0 : v.back());
+}
+
+int main(int argc, char **argv) {
+    StageSamples samples;
+
+    if (argc < 2) {
+        scan_file(&samples, stdin);
+    }
+    for (int i = 1; i < argc; i++) {
+        FILE *f = fopen(argv[i], "r");
+        if (f == NULL) {
+            fprintf(stderr, "Cannot open %s\n", argv[i]);
+            return 1;
+        }
+        scan_file(&samples, f);
+        fclose(f);
+    }
+
+    printf("Waterfalls: %u (%u connected, %u failed)\n", samples.waterfalls,
+           samples.completed, samples.waterfalls - samples.completed);
+    printf("Needed a connect retry: %u (stages below are from the last attempt)\n\n",
+           samples.retried);
+    printf("%-14s %6s %8s %8s %8s %8s\n", "stage", "n", "p50_ms", "p90_ms", "p99_ms", "max_ms");
+    print_row("app_start", samples.app_start_ms);
+    for (int i = 0; i < BOOT_STAGE_COUNT; i++) {
+        if (i != BOOT_STAGE_RESERVED_2) {
+            print_row(BOOT_STAGE_NAMES[i], samples.ms[i]);
+        }
+    }
+    print_row("boot_to_ip", samples.total_ms);
+
+    if (samples.waterfalls > samples.completed) {
+        printf("\nFailures by stage:\n");
+        for (int i = 0; i <= BOOT_STAGE_COUNT; i++) {
+            if (samples.failed_at[i] > 0) {
+                printf("  %-14s %u\n", i < BOOT_STAGE_COUNT ? BOOT_STAGE_NAMES[i] : "unknown",
+                       samples.failed_at[i]);
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,658 @@
+/**
+ * Zero-Copy AT Response Tokenizer for Walter Modem
+ *
+ * Captures raw modem response lines into one fixed buffer and parses the
+ * information responses we care about (+CEREG, +SQNMONI, +CGDCONT, +CGACT,
+ * +CESQ, +SQNMODEACTIVE, +SQNDNSLKUP) into typed structs. Nothing is allocated or
+ * copied: strings in the parsed structs are views into the captured line,
+ * valid until the capture buffer is reset.
+ *
+ * Has no ESP-IDF dependencies; host/at_parse_bench.cpp builds it natively.
+ */
+
+#ifndef AT_RESPONSE_H
+#define AT_RESPONSE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define AT_CAPTURE_BUF_SIZE 1024
+#define AT_CAPTURE_MAX_LINES 24
+
+/**
+ * Non-owning view of part of a line (not NUL terminated)
+ */
+typedef struct {
+    const char *ptr;
+    uint16_t len;
+} at_view_t;
+
+static inline at_view_t at_view(const char *ptr, size_t len) {
+    at_view_t v;
+    v.ptr = ptr;
+    v.len = (uint16_t)len;
+    return v;
+}
+
+static inline at_view_t at_view_str(const char *str) {
+    return at_view(str, strlen(str));
+}
+
+static inline bool at_view_eq(at_view_t v, const char *str) {
+    size_t n = strlen(str);
+    return v.len == n && memcmp(v.ptr, str, n) == 0;
+}
+
+static inline bool at_view_starts_with(at_view_t v, const char *prefix) {
+    size_t n = strlen(prefix);
+    return v.len >= n && memcmp(v.ptr, prefix, n) == 0;
+}
+
+static inline at_view_t at_view_trim(at_view_t v) {
+    while (v.len > 0 && (v.ptr[0] == ' ' || v.ptr[0] == '\t')) {
+        v.ptr++;
+        v.len--;
+    }
+    while (v.len > 0 && (v.ptr[v.len - 1] == ' ' || v.ptr[v.len - 1] == '\t')) {
+        v.len--;
+    }
+    return v;
+}
+
+/**
+ * Parse a signed decimal integer; the whole view must be consumed
+ */
+static bool at_view_to_int(at_view_t v, int32_t *out) {
+    v = at_view_trim(v);
+    if (v.len == 0 || v.len > 11) {
+        return false;
+    }
+    size_t i = 0;
+    bool neg = false;
+    if (v.ptr[0] == '-' || v.ptr[0] == '+') {
+        neg = v.ptr[0] == '-';
+        i = 1;
+        if (v.len == 1) {
+            return false;
+        }
+    }
+    int64_t value = 0;
+    for (; i < v.len; i++) {
+        char c = v.ptr[i];
+        if (c < '0' || c > '9') {
+            return false;
+        }
+        value = value * 10 + (c - '0');
+    }
+    if (neg) {
+        value = -value;
+    }
+    if (value < INT32_MIN || value > INT32_MAX) {
+        return false;
+    }
+    *out = (int32_t)value;
+    return true;
+}
+
+/**
+ * Parse an unsigned hexadecimal value (as used for TAC and cell ID)
+ */
+static bool at_view_to_hex(at_view_t v, uint32_t *out) {
+    v = at_view_trim(v);
+    if (v.len == 0 || v.len > 8) {
+        return false;
+    }
+    uint32_t value = 0;
+    for (size_t i = 0; i < v.len; i++) {
+        char c = v.ptr[i];
+        uint32_t digit;
+        if (c >= '0' && c <= '9') {
+            digit = (uint32_t)(c - '0');
+        } else if (c >= 'a' && c <= 'f') {
+            digit = (uint32_t)(c - 'a' + 10);
+        } else if (c >= 'A' && c <= 'F') {
+            digit = (uint32_t)(c - 'A' + 10);
+        } else {
+            return false;
+        }
+        value = (value << 4) | digit;
+    }
+    *out = value;
+    return true;
+}
+
+/**
+ * Parse a decimal with optional fraction into tenths ("-95.27" -> -952)
+ */
+static bool at_view_to_tenths(at_view_t v, int32_t *out) {
+    v = at_view_trim(v);
+    size_t dot = v.len;
+    for (size_t i = 0; i < v.len; i++) {
+        if (v.ptr[i] == '.') {
+            dot = i;
+            break;
+        }
+    }
+    int32_t whole = 0;
+    if (!at_view_to_int(at_view(v.ptr, dot), &whole)) {
+        return false;
+    }
+    int32_t tenth = 0;
+    if (dot + 1 < v.len) {
+        char c = v.ptr[dot + 1];
+        if (c < '0' || c > '9') {
+            return false;
+        }
+        tenth = c - '0';
+    }
+    bool neg = v.len > 0 && v.ptr[0] == '-';
+    *out = whole * 10 + (neg ? -tenth : tenth);
+    return true;
+}
+
+/**
+ * One comma separated field, with surrounding quotes removed
+ */
+typedef struct {
+    at_view_t value;
+    bool quoted;
+} at_field_t;
+
+/**
+ * Split the next comma separated field off rest (commas inside quotes are kept)
+ *
+ * @return false when rest is exhausted
+ */
+static bool at_next_field(at_view_t *rest, at_field_t *field) {
+    if (rest->ptr == NULL) {
+        return false;
+    }
+    size_t i = 0;
+    bool in_quotes = false;
+    while (i < rest->len && (in_quotes || rest->ptr[i] != ',')) {
+        if (rest->ptr[i] == '"') {
+            in_quotes = !in_quotes;
+        }
+        i++;
+    }
+
+    at_view_t raw = at_view_trim(at_view(rest->ptr, i));
+    field->quoted = raw.len >= 2 && raw.ptr[0] == '"' && raw.ptr[raw.len - 1] == '"';
+    field->value = field->quoted ? at_view(raw.ptr + 1, raw.len - 2) : raw;
+
+    if (i < rest->len) {
+        rest->ptr += i + 1;
+        rest->len = (uint16_t)(rest->len - i - 1);
+    } else {
+        rest->ptr = NULL;
+        rest->len = 0;
+    }
+    return true;
+}
+
+typedef enum {
+    AT_LINE_OK,
+    AT_LINE_ERROR,          // ERROR, +CME ERROR, +CMS ERROR
+    AT_LINE_INFO,           // +NAME: payload
+    AT_LINE_PROMPT,         // '>' data prompt
+    AT_LINE_ECHO,           // Command echo (AT...)
+    AT_LINE_OTHER,
+} at_line_type_t;
+
+static at_line_type_t at_classify(at_view_t line) {
+    if (at_view_eq(line, "OK")) {
+        return AT_LINE_OK;
+    }
+    if (at_view_eq(line, "ERROR") || at_view_starts_with(line, "+CME ERROR") ||
+        at_view_starts_with(line, "+CMS ERROR")) {
+        return AT_LINE_ERROR;
+    }
+    if (line.len > 0 && line.ptr[0] == '>') {
+        return AT_LINE_PROMPT;
+    }
+    if (line.len > 1 && line.ptr[0] == '+') {
+        return AT_LINE_INFO;
+    }
+    if (line.len >= 2 && (line.ptr[0] == 'A' || line.ptr[0] == 'a') &&
+        (line.ptr[1] == 'T' || line.ptr[1] == 't')) {
+        return AT_LINE_ECHO;
+    }
+    return AT_LINE_OTHER;
+}
+
+/**
+ * Match "+NAME:" at the start of a line and return the payload after it
+ */
+static bool at_info_payload(at_view_t line, const char *name, at_view_t *payload) {
+    size_t n = strlen(name);
+    if (line.len < n + 1 || memcmp(line.ptr, name, n) != 0 || line.ptr[n] != ':') {
+        return false;
+    }
+    *payload = at_view_trim(at_view(line.ptr + n + 1, line.len - n - 1));
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// Capture buffer
+// ----------------------------------------------------------------------------
+
+/**
+ * Fixed buffer holding the lines of one (or a few) AT exchanges
+ *
+ * Bytes are fed as they arrive; CR/LF end a line and empty lines are
+ * dropped. Lines that do not fit are counted in dropped_lines.
+ */
+typedef struct {
+    char buf[AT_CAPTURE_BUF_SIZE];
+    uint16_t used;
+    uint16_t line_start;
+    uint16_t line_off[AT_CAPTURE_MAX_LINES];
+    uint16_t line_len[AT_CAPTURE_MAX_LINES];
+    uint8_t count;
+    uint8_t dropped_lines;
+    bool final_seen;        // OK or ERROR line captured
+    bool truncating;        // Current line overflowed, skip to its end
+} at_capture_t;
+
+static void at_capture_reset(at_capture_t *cap) {
+    cap->used = 0;
+    cap->line_start = 0;
+    cap->count = 0;
+    cap->dropped_lines = 0;
+    cap->final_seen = false;
+    cap->truncating = false;
+}
+
+static inline at_view_t at_capture_line(const at_capture_t *cap, int index) {
+    return at_view(cap->buf + cap->line_off[index], cap->line_len[index]);
+}
+
+static void at_capture_end_line(at_capture_t *cap) {
+    uint16_t len = (uint16_t)(cap->used - cap->line_start);
+    if (cap->truncating) {
+        cap->truncating = false;
+        cap->used = cap->line_start;
+        cap->dropped_lines++;
+        return;
+    }
+    if (len == 0) {
+        return;
+    }
+    if (cap->count == AT_CAPTURE_MAX_LINES) {
+        cap->used = cap->line_start;
+        cap->dropped_lines++;
+        return;
+    }
+    cap->line_off[cap->count] = cap->line_start;
+    cap->line_len[cap->count] = len;
+    at_line_type_t type = at_classify(at_capture_line(cap, cap->count));
+    if (type == AT_LINE_OK || type == AT_LINE_ERROR) {
+        cap->final_seen = true;
+    }
+    cap->count++;
+    cap->line_start = cap->used;
+}
+
+static void at_capture_feed(at_capture_t *cap, const char *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        char c = data[i];
+        if (c == '\r' || c == '\n') {
+            at_capture_end_line(cap);
+        } else if (cap->truncating) {
+            continue;
+        } else if (cap->used < AT_CAPTURE_BUF_SIZE) {
+            cap->buf[cap->used++] = c;
+        } else {
+            cap->truncating = true;
+        }
+    }
+}
+
+/**
+ * Capture the modem RX tap writes into (NULL = none)
+ *
+ * Whoever needs the raw lines of a command points this at its capture
+ * buffer for the duration of the command.
+ */
+static at_capture_t *g_at_tap_capture = NULL;
+
+// ----------------------------------------------------------------------------
+// Typed responses
+// ----------------------------------------------------------------------------
+
+/**
+ * +CEREG (query response "<n>,<stat>[,...]" or URC "<stat>[,...]")
+ */
+typedef struct {
+    int8_t n;               // -1 for an unsolicited report
+    int8_t stat;            // 1 = home, 5 = roaming, 2 = searching, 3 = denied
+    uint16_t tac;
+    uint32_t ci;
+    int8_t act;             // 7 = LTE-M, 9 = NB-IoT, -1 = not reported
+    bool has_location;
+} at_cereg_t;
+
+static bool at_parse_cereg(at_view_t line, at_cereg_t *out) {
+    at_view_t rest;
+    if (!at_info_payload(line, "+CEREG", &rest)) {
+        return false;
+    }
+    at_field_t f[5];
+    int count = 0;
+    while (count < 5 && at_next_field(&rest, &f[count])) {
+        count++;
+    }
+    if (count == 0) {
+        return false;
+    }
+
+    // A query response has <n> first; a URC has a quoted TAC as its second field
+    int first_stat = 0;
+    int32_t value;
+    out->n = -1;
+    if (count >= 2 && !f[1].quoted) {
+        if (!at_view_to_int(f[0].value, &value)) {
+            return false;
+        }
+        out->n = (int8_t)value;
+        first_stat = 1;
+    }
+    if (!at_view_to_int(f[first_stat].value, &value)) {
+        return false;
+    }
+    out->stat = (int8_t)value;
+
+    out->has_location = false;
+    out->tac = 0;
+    out->ci = 0;
+    out->act = -1;
+    if (count >= first_stat + 3) {
+        uint32_t tac, ci;
+        if (at_view_to_hex(f[first_stat + 1].value, &tac) &&
+            at_view_to_hex(f[first_stat + 2].value, &ci)) {
+            out->tac = (uint16_t)tac;
+            out->ci = ci;
+            out->has_location = true;
+        }
+    }
+    if (count >= first_stat + 4 && at_view_to_int(f[first_stat + 3].value, &value)) {
+        out->act = (int8_t)value;
+    }
+    return true;
+}
+
+/**
+ * +SQNMONI serving cell report
+ *
+ * "+SQNMONI: <oper> Cc:<cc> Nc:<nc> RSRP:<x> CINR:<x> RSRQ:<x> TAC:<x> Id:<x>
+ *  EARFCN:<x> PWR:<x> PAGING:<x>". Signal values are in tenths of dB(m).
+ */
+typedef struct {
+    at_view_t oper;
+    uint16_t cc;
+    uint16_t nc;
+    int16_t rsrp_x10;
+    int16_t cinr_x10;
+    int16_t rsrq_x10;
+    uint32_t tac;
+    uint32_t cell_id;
+    uint32_t earfcn;
+    int16_t pwr_x10;
+    uint16_t paging;
+    uint16_t fields;        // Bitmask of keys found, in the order above (oper excluded)
+} at_sqnmoni_t;
+
+static bool at_parse_sqnmoni(at_view_t line, at_sqnmoni_t *out) {
+    at_view_t rest;
+    if (!at_info_payload(line, "+SQNMONI", &rest)) {
+        return false;
+    }
+    memset(out, 0, sizeof(*out));
+
+    static const char *const keys[] = {
+        "Cc", "Nc", "RSRP", "CINR", "RSRQ", "TAC", "Id", "EARFCN", "PWR", "PAGING",
+    };
+
+    // Operator name (may contain spaces) runs up to the first " Cc:" token
+    const char *p = rest.ptr;
+    const char *end = rest.ptr + rest.len;
+    const char *oper_end = end;
+    for (const char *q = p; q + 3 < end; q++) {
+        if (q[0] == 'C' && q[1] == 'c' && q[2] == ':' && (q == p || q[-1] == ' ')) {
+            oper_end = q;
+            break;
+        }
+    }
+    out->oper = at_view_trim(at_view(p, oper_end - p));
+    p = oper_end;
+
+    while (p < end) {
+        while (p < end && *p == ' ') p++;
+        const char *tok = p;
+        while (p < end && *p != ' ') p++;
+        at_view_t token = at_view(tok, p - tok);
+
+        const char *colon = (const char *)memchr(token.ptr, ':', token.len);
+        if (colon == NULL) {
+            continue;
+        }
+        at_view_t key = at_view(token.ptr, colon - token.ptr);
+        at_view_t val = at_view(colon + 1, token.len - (colon - token.ptr) - 1);
+
+        for (int k = 0; k < (int)(sizeof(keys) / sizeof(keys[0])); k++) {
+            if (!at_view_eq(key, keys[k])) {
+                continue;
+            }
+            int32_t v = 0;
+            bool ok;
+            if (k == 2 || k == 3 || k == 4 || k == 8) {
+                ok = at_view_to_tenths(val, &v);
+            } else {
+                ok = at_view_to_int(val, &v);
+            }
+            if (!ok) {
+                break;
+            }
+            switch (k) {
+                case 0: out->cc = (uint16_t)v; break;
+                case 1: out->nc = (uint16_t)v; break;
+                case 2: out->rsrp_x10 = (int16_t)v; break;
+                case 3: out->cinr_x10 = (int16_t)v; break;
+                case 4: out->rsrq_x10 = (int16_t)v; break;
+                case 5: out->tac = (uint32_t)v; break;
+                case 6: out->cell_id = (uint32_t)v; break;
+                case 7: out->earfcn = (uint32_t)v; break;
+                case 8: out->pwr_x10 = (int16_t)v; break;
+                case 9: out->paging = (uint16_t)v; break;
+            }
+            out->fields |= (uint16_t)(1u << k);
+            break;
+        }
+    }
+    return out->fields != 0;
+}
+
+/**
+ * +CGDCONT: <cid>,"<type>","<apn>"[,"<addr>",...]
+ */
+typedef struct {
+    uint8_t cid;
+    at_view_t pdp_type;
+    at_view_t apn;
+    at_view_t addr;
+} at_cgdcont_t;
+
+static bool at_parse_cgdcont(at_view_t line, at_cgdcont_t *out) {
+    at_view_t rest;
+    if (!at_info_payload(line, "+CGDCONT", &rest)) {
+        return false;
+    }
+    at_field_t f;
+    int32_t cid;
+    if (!at_next_field(&rest, &f) || !at_view_to_int(f.value, &cid) || cid < 0 || cid > 255) {
+        return false;
+    }
+    out->cid = (uint8_t)cid;
+    out->pdp_type = at_view(NULL, 0);
+    out->apn = at_view(NULL, 0);
+    out->addr = at_view(NULL, 0);
+    if (at_next_field(&rest, &f)) out->pdp_type = f.value;
+    if (at_next_field(&rest, &f)) out->apn = f.value;
+    if (at_next_field(&rest, &f)) out->addr = f.value;
+    return true;
+}
+
+/**
+ * +CGACT: <cid>,<state>
+ */
+typedef struct {
+    uint8_t cid;
+    bool active;
+} at_cgact_t;
+
+static bool at_parse_cgact(at_view_t line, at_cgact_t *out) {
+    at_view_t rest;
+    if (!at_info_payload(line, "+CGACT", &rest)) {
+        return false;
+    }
+    at_field_t f;
+    int32_t cid, state;
+    if (!at_next_field(&rest, &f) || !at_view_to_int(f.value, &cid) || cid < 0 || cid > 255) {
+        return false;
+    }
+    if (!at_next_field(&rest, &f) || !at_view_to_int(f.value, &state) || (state != 0 && state != 1)) {
+        return false;
+    }
+    out->cid = (uint8_t)cid;
+    out->active = state == 1;
+    return true;
+}
+
+/**
+ * +CESQ: <rxlev>,<ber>,<rscp>,<ecno>,<rsrq>,<rsrp> (raw 3GPP 27.007 indices)
+ */
+typedef struct {
+    uint8_t rxlev;
+    uint8_t ber;
+    uint8_t rscp;
+    uint8_t ecno;
+    uint8_t rsrq;           // 0..34, 255 = unknown
+    uint8_t rsrp;           // 0..97, 255 = unknown
+} at_cesq_t;
+
+static bool at_parse_cesq(at_view_t line, at_cesq_t *out) {
+    at_view_t rest;
+    if (!at_info_payload(line, "+CESQ", &rest)) {
+        return false;
+    }
+    uint8_t values[6];
+    for (int i = 0; i < 6; i++) {
+        at_field_t f;
+        int32_t v;
+        if (!at_next_field(&rest, &f) || !at_view_to_int(f.value, &v) || v < 0 || v > 255) {
+            return false;
+        }
+        values[i] = (uint8_t)v;
+    }
+    out->rxlev = values[0];
+    out->ber = values[1];
+    out->rscp = values[2];
+    out->ecno = values[3];
+    out->rsrq = values[4];
+    out->rsrp = values[5];
+    return true;
+}
+
+/**
+ * RSRP in dBm from a +CESQ index (lower bound of the range), or 0 if unknown
+ */
+static inline int16_t at_cesq_rsrp_dbm(const at_cesq_t *cesq) {
+    return cesq->rsrp <= 97 ? (int16_t)(-141 + cesq->rsrp) : 0;
+}
+
+/**
+ * RSRQ in tenths of dB from a +CESQ index, or 0 if unknown
+ */
+static inline int16_t at_cesq_rsrq_x10(const at_cesq_t *cesq) {
+    return cesq->rsrq <= 34 ? (int16_t)(-200 + cesq->rsrq * 5) : 0;
+}
+
+/**
+ * +SQNMODEACTIVE: <mode> (1 = LTE-M, 2 = NB-IoT)
+ */
+typedef struct {
+    uint8_t mode;
+} at_sqnmodeactive_t;
+
+static bool at_parse_sqnmodeactive(at_view_t line, at_sqnmodeactive_t *out) {
+    at_view_t rest;
+    if (!at_info_payload(line, "+SQNMODEACTIVE", &rest)) {
+        return false;
+    }
+    at_field_t f;
+    int32_t mode;
+    if (!at_next_field(&rest, &f) || !at_view_to_int(f.value, &mode) || mode < 0 || mode > 255) {
+        return false;
+    }
+    out->mode = (uint8_t)mode;
+    return true;
+}
+
+/**
+ * Parse a dotted IPv4 address into host byte order ("3.223.36.72")
+ */
+static bool at_view_to_ipv4(at_view_t v, uint32_t *out) {
+    uint32_t addr = 0;
+    size_t pos = 0;
+    for (int octet = 0; octet < 4; octet++) {
+        size_t start = pos;
+        uint32_t value = 0;
+        while (pos < v.len && v.ptr[pos] >= '0' && v.ptr[pos] <= '9' && pos - start < 3) {
+            value = value * 10 + (uint32_t)(v.ptr[pos++] - '0');
+        }
+        if (pos == start || value > 255) {
+            return false;
+        }
+        addr = (addr << 8) | value;
+        if (octet < 3) {
+            if (pos >= v.len || v.ptr[pos] != '.') {
+                return false;
+            }
+            pos++;
+        }
+    }
+    if (pos != v.len) {
+        return false;
+    }
+    *out = addr;
+    return true;
+}
+
+/**
+ * +SQNDNSLKUP: "<hostname>","<ip>"[,"<ip>"...] (first IPv4 address is kept)
+ */
+typedef struct {
+    at_view_t host;
+    uint32_t ipv4;
+} at_sqndnslkup_t;
+
+static bool at_parse_sqndnslkup(at_view_t line, at_sqndnslkup_t *out) {
+    at_view_t rest;
+    if (!at_info_payload(line, "+SQNDNSLKUP", &rest)) {
+        return false;
+    }
+    at_field_t f;
+    if (!at_next_field(&rest, &f) || f.value.len == 0) {
+        return false;
+    }
+    out->host = f.value;
+    while (at_next_field(&rest, &f)) {
+        if (at_view_to_ipv4(f.value, &out->ipv4)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+#endif // AT_RESPONSE_H
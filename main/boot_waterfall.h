@@ -0,0 +1,296 @@
+/**
+ * Boot-to-IP Waterfall for Walter Modem
+ *
+ * Records monotonic start/end timestamps for every stage of
+ * connect_nbiot() into a small fixed-size struct. The record is written
+ * to NVS as each stage starts, so a boot that hangs or is reset by the
+ * watchdog before reaching an IP address is still reported by the next
+ * boot, with the stage it was stuck in. It is attached to the first
+ * upload after connecting.
+ *
+ * The modem is started once per boot; a failed connect attempt is retried
+ * from the comm check. Each retry clears the later stages, so the record
+ * holds the last attempt and its number.
+ *
+ * The struct and stage names have no ESP-IDF dependencies so the host
+ * tools in host/ can decode uploaded waterfalls.
+ */
+
+#ifndef BOOT_WATERFALL_H
+#define BOOT_WATERFALL_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define BOOT_WATERFALL_VERSION 2         // 2: adds attempt
+
+/**
+ * Connection stages, in the order connect_nbiot() runs them
+ */
+typedef enum {
+    BOOT_STAGE_MODEM_INIT = 0,      // [1/10]
+    BOOT_STAGE_COMM_CHECK,          // [2/10]
+    BOOT_STAGE_RESERVED_2,          // Was boot-time diagnostics; never recorded, kept for decoding
+    BOOT_STAGE_IDENTITY,            // [3/10] .. [3.7/10]
+    BOOT_STAGE_RAT_CONFIG,          // [4/10] .. [5/10] incl. CFUN MINIMUM
+    BOOT_STAGE_OPSTATE_FULL,        // [5.5/10]
+    BOOT_STAGE_SIM,                 // [6/10] .. [6.5/10]
+    BOOT_STAGE_NET_SELECT,          // [7/10]
+    BOOT_STAGE_REGISTRATION,        // [8/10] incl. signal/cell info
+    BOOT_STAGE_PDP_DEFINE,          // [9/10] .. [9.5/10]
+    BOOT_STAGE_PDP_ACTIVATE,        // [9.6/10]
+    BOOT_STAGE_ATTACH,              // [10/10] incl. IP address query
+    BOOT_STAGE_COUNT
+} boot_stage_t;
+
+static const char *const BOOT_STAGE_NAMES[BOOT_STAGE_COUNT] = {
+    "modem_init",
+    "comm_check",
+    "reserved",
+    "identity",
+    "rat_config",
+    "opstate_full",
+    "sim",
+    "net_select",
+    "registration",
+    "pdp_define",
+    "pdp_activate",
+    "attach",
+};
+
+/**
+ * One boot's waterfall (108 bytes)
+ *
+ * Timestamps are milliseconds since boot; a stage that was never
+ * reached has end_ms == 0.
+ */
+typedef struct {
+    uint8_t  version;
+    uint8_t  completed;             // 1 if connect_nbiot() succeeded
+    uint8_t  failed_stage;          // Stage that was open on failure or reset, or BOOT_STAGE_COUNT
+    uint8_t  uploaded;              // 1 once sent to the server
+    uint8_t  attempt;               // Connect attempt the stages after modem_init are from
+    uint32_t boot_count;
+    uint32_t start_ms[BOOT_STAGE_COUNT];
+    uint32_t end_ms[BOOT_STAGE_COUNT];
+} boot_waterfall_t;
+
+/**
+ * Duration of a stage in ms, or 0 if it was not reached
+ */
+static inline uint32_t boot_waterfall_stage_ms(const boot_waterfall_t *wf, int stage) {
+    if (wf->end_ms[stage] == 0 || wf->end_ms[stage] < wf->start_ms[stage]) {
+        return 0;
+    }
+    return wf->end_ms[stage] - wf->start_ms[stage];
+}
+
+#ifdef ESP_PLATFORM
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <nvs.h>
+#include <cJSON.h>
+
+static const char *WF_TAG = "boot_wf";
+
+#define BOOT_WF_NVS_NAMESPACE "walter"
+#define BOOT_WF_NVS_KEY "boot_wf"
+
+static boot_waterfall_t g_boot_wf = {};        // This boot
+static boot_waterfall_t g_boot_wf_prev = {};   // Earlier boot not yet uploaded
+static bool g_boot_wf_prev_pending = false;
+static int g_boot_wf_open_stage = BOOT_STAGE_COUNT;
+static int g_boot_wf_failed_stage = BOOT_STAGE_COUNT;  // Closed by boot_waterfall_abort()
+
+static inline uint32_t boot_waterfall_now_ms(void) {
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+static void boot_waterfall_save(const boot_waterfall_t *wf) {
+    nvs_handle_t handle;
+    if (nvs_open(BOOT_WF_NVS_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) {
+        ESP_LOGW(WF_TAG, "Could not open NVS to store waterfall");
+        return;
+    }
+    if (nvs_set_blob(handle, BOOT_WF_NVS_KEY, wf, sizeof(*wf)) == ESP_OK) {
+        nvs_commit(handle);
+    }
+    nvs_close(handle);
+}
+
+/**
+ * Load the previous boot's waterfall and start a new one
+ *
+ * A stored record that was not finished (failed_stage set, completed 0)
+ * comes from a boot that hung or was reset in that stage. It is kept in
+ * RAM until uploaded; NVS only ever holds the latest boot.
+ *
+ * Call once after nvs_flash_init() and before connect_nbiot().
+ */
+static void boot_waterfall_init(void) {
+    boot_waterfall_t stored = {};
+    size_t len = sizeof(stored);
+    uint32_t boot_count = 0;
+
+    nvs_handle_t handle;
+    if (nvs_open(BOOT_WF_NVS_NAMESPACE, NVS_READONLY, &handle) == ESP_OK) {
+        if (nvs_get_blob(handle, BOOT_WF_NVS_KEY, &stored, &len) == ESP_OK &&
+            len == sizeof(stored) && stored.version == BOOT_WATERFALL_VERSION) {
+            boot_count = stored.boot_count;
+            if (!stored.uploaded) {
+                g_boot_wf_prev = stored;
+                g_boot_wf_prev_pending = true;
+            }
+        }
+        nvs_close(handle);
+    }
+    if (g_boot_wf_prev_pending) {
+        ESP_LOGI(WF_TAG, "Previous boot #%lu waterfall pending upload (%s)",
+                 (unsigned long)g_boot_wf_prev.boot_count,
+                 g_boot_wf_prev.completed ? "connected" :
+                 g_boot_wf_prev.failed_stage < BOOT_STAGE_COUNT ?
+                     BOOT_STAGE_NAMES[g_boot_wf_prev.failed_stage] : "no stage");
+    }
+
+    memset(&g_boot_wf, 0, sizeof(g_boot_wf));
+    g_boot_wf.version = BOOT_WATERFALL_VERSION;
+    g_boot_wf.failed_stage = BOOT_STAGE_COUNT;
+    g_boot_wf.boot_count = boot_count + 1;
+    g_boot_wf.attempt = 1;
+    g_boot_wf_open_stage = BOOT_STAGE_COUNT;
+    g_boot_wf_failed_stage = BOOT_STAGE_COUNT;
+}
+
+/**
+ * Start a stage and persist the record with it marked as open
+ *
+ * If the boot never gets past this stage (hang, watchdog, brownout), the
+ * next boot finds it as the failed stage.
+ */
+static void boot_waterfall_begin(boot_stage_t stage) {
+    g_boot_wf.start_ms[stage] = boot_waterfall_now_ms();
+    g_boot_wf.end_ms[stage] = 0;
+    g_boot_wf.failed_stage = (uint8_t)stage;
+    g_boot_wf_open_stage = stage;
+    boot_waterfall_save(&g_boot_wf);
+}
+
+static void boot_waterfall_end(boot_stage_t stage) {
+    g_boot_wf.end_ms[stage] = boot_waterfall_now_ms();
+    if (g_boot_wf.end_ms[stage] == 0) {
+        g_boot_wf.end_ms[stage] = 1;
+    }
+    g_boot_wf_open_stage = BOOT_STAGE_COUNT;
+}
+
+/**
+ * Close the open stage of a failed attempt, remembering it as the failed one
+ */
+static void boot_waterfall_abort(void) {
+    if (g_boot_wf_open_stage == BOOT_STAGE_COUNT) {
+        return;
+    }
+    g_boot_wf_failed_stage = g_boot_wf_open_stage;
+    boot_waterfall_end((boot_stage_t)g_boot_wf_open_stage);
+}
+
+/**
+ * Start connect attempt n (1-based): drops the stages of the previous one
+ *
+ * modem_init runs once per boot and is kept.
+ */
+static void boot_waterfall_attempt(int attempt) {
+    for (int i = 0; i < BOOT_STAGE_COUNT; i++) {
+        if (i != BOOT_STAGE_MODEM_INIT) {
+            g_boot_wf.start_ms[i] = 0;
+            g_boot_wf.end_ms[i] = 0;
+        }
+    }
+    g_boot_wf.attempt = (uint8_t)attempt;
+    g_boot_wf_failed_stage = BOOT_STAGE_COUNT;
+}
+
+/**
+ * Close the waterfall after connecting and persist it
+ *
+ * On failure the stage that was open (or closed by boot_waterfall_abort())
+ * is recorded, so the stored waterfall explains where a boot gave up even
+ * if it never uploads.
+ */
+static void boot_waterfall_finish(bool connected) {
+    int failed = g_boot_wf_open_stage != BOOT_STAGE_COUNT ? g_boot_wf_open_stage
+                                                          : g_boot_wf_failed_stage;
+    g_boot_wf.completed = connected ? 1 : 0;
+    g_boot_wf.failed_stage = (uint8_t)(connected ? (int)BOOT_STAGE_COUNT : failed);
+
+    uint32_t total = 0;
+    for (int i = 0; i < BOOT_STAGE_COUNT; i++) {
+        uint32_t ms = boot_waterfall_stage_ms(&g_boot_wf, i);
+        if (ms > 0) {
+            ESP_LOGI(WF_TAG, "  %-13s %6lu ms", BOOT_STAGE_NAMES[i], (unsigned long)ms);
+        }
+        total += ms;
+    }
+    ESP_LOGI(WF_TAG, "Boot #%lu: %s after %lu ms in stages (attempt %u)",
+             (unsigned long)g_boot_wf.boot_count,
+             connected ? "connected" : "failed", (unsigned long)total,
+             (unsigned)g_boot_wf.attempt);
+
+    boot_waterfall_save(&g_boot_wf);
+}
+
+static void boot_waterfall_to_json(cJSON *parent, const char *key, const boot_waterfall_t *wf) {
+    cJSON *obj = cJSON_CreateObject();
+    if (obj == NULL) {
+        return;
+    }
+    cJSON_AddNumberToObject(obj, "v", wf->version);
+    cJSON_AddNumberToObject(obj, "boot", wf->boot_count);
+    cJSON_AddNumberToObject(obj, "ok", wf->completed);
+    cJSON_AddNumberToObject(obj, "fail", wf->failed_stage);
+    cJSON_AddNumberToObject(obj, "att", wf->attempt);
+
+    // Flat [start0, end0, start1, end1, ...] keeps the payload small
+    cJSON *stages = cJSON_CreateArray();
+    for (int i = 0; i < BOOT_STAGE_COUNT; i++) {
+        cJSON_AddItemToArray(stages, cJSON_CreateNumber(wf->start_ms[i]));
+        cJSON_AddItemToArray(stages, cJSON_CreateNumber(wf->end_ms[i]));
+    }
+    cJSON_AddItemToObject(obj, "st", stages);
+    cJSON_AddItemToObject(parent, key, obj);
+}
+
+/**
+ * Attach any waterfalls that still need uploading to a JSON payload
+ *
+ * @return true if something was attached
+ */
+static bool boot_waterfall_add_to_json(cJSON *root) {
+    bool added = false;
+    if (!g_boot_wf.uploaded && g_boot_wf.boot_count != 0) {
+        boot_waterfall_to_json(root, "boot_wf", &g_boot_wf);
+        added = true;
+    }
+    if (g_boot_wf_prev_pending) {
+        boot_waterfall_to_json(root, "boot_wf_prev", &g_boot_wf_prev);
+        added = true;
+    }
+    return added;
+}
+
+/**
+ * Mark attached waterfalls as delivered (call after a successful upload)
+ */
+static void boot_waterfall_mark_uploaded(void) {
+    if (g_boot_wf.uploaded && !g_boot_wf_prev_pending) {
+        return;
+    }
+    g_boot_wf.uploaded = 1;
+    g_boot_wf_prev_pending = false;
+    boot_waterfall_save(&g_boot_wf);
+}
+
+#endif // ESP_PLATFORM
+
+#endif // BOOT_WATERFALL_H
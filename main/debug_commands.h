@@ -9,15 +9,57 @@
 #define DEBUG_COMMANDS_H
 
 #include <esp_log.h>
+#include <stdlib.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include <WalterModem.h>
+#include "at_response.h"
 
 // External reference to modem instance (defined in main.cpp)
 extern WalterModem modem;
 
 static const char *DEBUG_TAG = "walter_debug";
 
+// Raw response lines of the last debug command. WalterModem::sendCmd only
+// reports OK/ERROR, so this is filled by whoever sees the modem RX bytes
+// (through g_at_tap_capture) and decoded here after the command completes.
+static at_capture_t g_debug_capture;
+
+/**
+ * Log one captured response line, decoding the responses we know
+ */
+static void log_response_line(at_view_t line) {
+    ESP_LOGI(DEBUG_TAG, "  < %.*s", line.len, line.ptr);
+
+    at_cereg_t cereg;
+    at_sqnmoni_t moni;
+    at_cgdcont_t cgdcont;
+    at_cgact_t cgact;
+    at_cesq_t cesq;
+    at_sqnmodeactive_t mode;
+    if (at_parse_cereg(line, &cereg)) {
+        ESP_LOGI(DEBUG_TAG, "    registration stat=%d tac=0x%04X ci=0x%08lX act=%d",
+                 cereg.stat, cereg.tac, (unsigned long)cereg.ci, cereg.act);
+    } else if (at_parse_sqnmoni(line, &moni)) {
+        ESP_LOGI(DEBUG_TAG, "    cell %.*s id=%lu tac=%lu earfcn=%lu rsrp=%d.%d rsrq=%d.%d",
+                 moni.oper.len, moni.oper.ptr, (unsigned long)moni.cell_id,
+                 (unsigned long)moni.tac, (unsigned long)moni.earfcn,
+                 moni.rsrp_x10 / 10, abs(moni.rsrp_x10 % 10),
+                 moni.rsrq_x10 / 10, abs(moni.rsrq_x10 % 10));
+    } else if (at_parse_cgdcont(line, &cgdcont)) {
+        ESP_LOGI(DEBUG_TAG, "    PDP cid=%d type=%.*s apn=%.*s", cgdcont.cid,
+                 cgdcont.pdp_type.len, cgdcont.pdp_type.ptr, cgdcont.apn.len, cgdcont.apn.ptr);
+    } else if (at_parse_cgact(line, &cgact)) {
+        ESP_LOGI(DEBUG_TAG, "    PDP cid=%d %s", cgact.cid, cgact.active ? "active" : "inactive");
+    } else if (at_parse_cesq(line, &cesq)) {
+        ESP_LOGI(DEBUG_TAG, "    RSRP %d dBm, RSRQ %d dB", at_cesq_rsrp_dbm(&cesq),
+                 at_cesq_rsrq_x10(&cesq) / 10);
+    } else if (at_parse_sqnmodeactive(line, &mode)) {
+        ESP_LOGI(DEBUG_TAG, "    active mode: %s", mode.mode == 2 ? "NB-IoT" :
+                 mode.mode == 1 ? "LTE-M" : "unknown");
+    }
+}
+
 /**
  * Send a raw AT command and log the response
  */
@@ -28,12 +70,24 @@ static void send_debug_command(const char* cmd, const char* description) {
     }
     
     ESP_LOGI(DEBUG_TAG, "Sending: %s (%s)", cmd, description);
+    at_capture_reset(&g_debug_capture);
+    g_at_tap_capture = &g_debug_capture;
     WalterModemRsp rsp = {};
-    if (modem.sendCmd(cmd, NULL, &rsp)) {
+    bool ok = modem.sendCmd(cmd, NULL, &rsp);
+    g_at_tap_capture = NULL;
+    if (ok) {
         ESP_LOGI(DEBUG_TAG, "  Response OK");
     } else {
         ESP_LOGE(DEBUG_TAG, "  Response FAILED");
     }
+    
+    for (int i = 0; i < g_debug_capture.count; i++) {
+        log_response_line(at_capture_line(&g_debug_capture, i));
+    }
+    if (g_debug_capture.dropped_lines > 0) {
+        ESP_LOGW(DEBUG_TAG, "  (%d response lines did not fit the capture buffer)",
+                 g_debug_capture.dropped_lines);
+    }
 }
 
 /**
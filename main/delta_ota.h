@@ -0,0 +1,707 @@
+/**
+ * Delta Firmware Updates for Walter Modem
+ *
+ * Updates the firmware with a binary patch against the running image
+ * instead of a full image. The patch is applied as it streams in, into
+ * the inactive OTA partition, with one flash sector of RAM for output.
+ *
+ * Patch format (little-endian, made by host/delta_patch.cpp):
+ *
+ *   header   "WDP1", u32 old_size, sha256(old), u32 new_size, sha256(new)
+ *   ops      ADD    0x01, varint len, zigzag varint src_delta, then
+ *                   (varint zero_run, varint lit_count, lit_count bytes)...
+ *                   covering len bytes: new = old[src..] + diff, where zero
+ *                   runs are unchanged bytes (copied from the old image)
+ *            INSERT 0x02, varint len, len bytes of new data
+ *            END    0x00
+ *
+ * src_delta moves the old-image cursor, which otherwise advances with
+ * every ADD. Output is written a sector at a time; after each sector the
+ * applier keeps a checkpoint of its state, so an interrupted download
+ * resumes from the checkpoint's patch offset instead of the start.
+ *
+ * The patch header's hashes only check that the patch was applied to the
+ * right image, not who made it. What the device boots is authenticated
+ * by ESP-IDF's signed app images (CONFIG_SECURE_SIGNED_ON_UPDATE):
+ * esp_ota_set_boot_partition() refuses an image that was not signed with
+ * the key of the running one. Patches are only downloaded over HTTPS with
+ * the server validated, unless CONFIG_WALTER_UPLINK_TLS_NO_VERIFY is set.
+ *
+ * The applier has no ESP-IDF dependencies (flash access goes through
+ * delta_io_t) and is exercised on the host by host/delta_patch.cpp.
+ */
+
+#ifndef DELTA_OTA_H
+#define DELTA_OTA_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define DELTA_MAGIC "WDP1"
+#define DELTA_HEADER_SIZE 76
+#define DELTA_SHA256_SIZE 32
+#define DELTA_SECTOR_SIZE 4096
+
+#define DELTA_OP_END 0x00
+#define DELTA_OP_ADD 0x01
+#define DELTA_OP_INSERT 0x02
+
+typedef struct {
+    uint32_t old_size;
+    uint8_t old_sha256[DELTA_SHA256_SIZE];
+    uint32_t new_size;
+    uint8_t new_sha256[DELTA_SHA256_SIZE];
+} delta_header_t;
+
+typedef enum {
+    DELTA_OK = 0,           // Input consumed, send more
+    DELTA_DONE,             // END reached, everything written
+    DELTA_ERR_FORMAT,       // Malformed patch
+    DELTA_ERR_BASE,         // Patch is for a different old image (header callback refused)
+    DELTA_ERR_RANGE,        // Op reads or writes outside the images
+    DELTA_ERR_IO,           // Flash read/write failed
+} delta_status_t;
+
+static const char *delta_status_str(delta_status_t status) {
+    switch (status) {
+        case DELTA_OK:         return "OK";
+        case DELTA_DONE:       return "done";
+        case DELTA_ERR_FORMAT: return "malformed patch";
+        case DELTA_ERR_BASE:   return "wrong base image";
+        case DELTA_ERR_RANGE:  return "out of range";
+        case DELTA_ERR_IO:     return "flash I/O error";
+        default:               return "error";
+    }
+}
+
+/**
+ * Flash access for the applier
+ */
+typedef struct {
+    void *ctx;
+    // Called once the header is in; return false to reject the patch (optional)
+    bool (*header)(void *ctx, const delta_header_t *header);
+    bool (*read_old)(void *ctx, uint32_t offset, uint8_t *buf, size_t len);
+    // Erase the sector at offset (sector aligned) and write len <= DELTA_SECTOR_SIZE bytes
+    bool (*write_sector)(void *ctx, uint32_t offset, const uint8_t *buf, size_t len);
+} delta_io_t;
+
+typedef enum {
+    DELTA_STATE_HEADER = 0,
+    DELTA_STATE_OP,
+    DELTA_STATE_LEN,
+    DELTA_STATE_SRC,
+    DELTA_STATE_ZERO_RUN,       // Reading a zero-run length
+    DELTA_STATE_COPY,           // Copying a zero run from the old image (no input)
+    DELTA_STATE_LIT_COUNT,
+    DELTA_STATE_ADD_BYTES,
+    DELTA_STATE_INSERT_BYTES,
+    DELTA_STATE_DONE,
+} delta_state_t;
+
+/**
+ * Everything needed to continue applying a patch (plain data, can be persisted)
+ */
+typedef struct {
+    uint32_t patch_pos;         // Patch bytes consumed
+    uint32_t out_pos;           // Output bytes produced
+    uint32_t old_pos;           // Old-image cursor
+    uint32_t remaining;         // Bytes left in the current op
+    uint32_t run;               // Bytes left in the current zero run / literal run
+    uint32_t varint;
+    uint8_t shift;
+    uint8_t state;              // delta_state_t
+    uint8_t op;
+    uint8_t header_len;
+    uint8_t header_raw[DELTA_HEADER_SIZE];
+} delta_cursor_t;
+
+typedef struct {
+    delta_io_t io;
+    delta_header_t header;
+    delta_cursor_t cur;
+    delta_cursor_t checkpoint;  // State right after the last sector was written
+    uint32_t out_len;           // Bytes waiting in out[]
+    uint8_t out[DELTA_SECTOR_SIZE];
+} delta_applier_t;
+
+static inline uint32_t delta_get_u32(const uint8_t *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static bool delta_parse_header(const uint8_t *raw, delta_header_t *out) {
+    if (memcmp(raw, DELTA_MAGIC, 4) != 0) {
+        return false;
+    }
+    out->old_size = delta_get_u32(raw + 4);
+    memcpy(out->old_sha256, raw + 8, DELTA_SHA256_SIZE);
+    out->new_size = delta_get_u32(raw + 40);
+    memcpy(out->new_sha256, raw + 44, DELTA_SHA256_SIZE);
+    return true;
+}
+
+static void delta_applier_init(delta_applier_t *ap, const delta_io_t *io) {
+    memset(ap, 0, sizeof(*ap));
+    ap->io = *io;
+}
+
+/**
+ * Continue from a saved checkpoint; feed the patch from ckpt->patch_pos on
+ *
+ * The header callback runs again, so a checkpoint is not applied to a
+ * different base image.
+ */
+static bool delta_applier_resume(delta_applier_t *ap, const delta_io_t *io,
+                                 const delta_cursor_t *ckpt) {
+    delta_applier_init(ap, io);
+    if (ckpt->header_len == DELTA_HEADER_SIZE &&
+        (!delta_parse_header(ckpt->header_raw, &ap->header) ||
+         (io->header != NULL && !io->header(io->ctx, &ap->header)))) {
+        return false;
+    }
+    if (ckpt->out_pos % DELTA_SECTOR_SIZE != 0) {
+        return false;           // Checkpoints are only taken on sector boundaries
+    }
+    ap->cur = *ckpt;
+    ap->checkpoint = *ckpt;
+    return true;
+}
+
+static bool delta_flush(delta_applier_t *ap) {
+    if (ap->out_len == 0) {
+        return true;
+    }
+    if (!ap->io.write_sector(ap->io.ctx, ap->cur.out_pos - ap->out_len, ap->out, ap->out_len)) {
+        return false;
+    }
+    ap->out_len = 0;
+    ap->checkpoint = ap->cur;
+    return true;
+}
+
+/**
+ * Account for n bytes that were just produced into out[]
+ */
+static bool delta_produced(delta_applier_t *ap, uint32_t n) {
+    ap->out_len += n;
+    ap->cur.out_pos += n;
+    ap->cur.remaining -= n;
+    ap->cur.run -= n;
+    return ap->out_len < DELTA_SECTOR_SIZE || delta_flush(ap);
+}
+
+/**
+ * Start an op once its length (and source offset) are known
+ */
+static delta_status_t delta_begin_op(delta_applier_t *ap) {
+    delta_cursor_t *c = &ap->cur;
+    if (c->remaining > ap->header.new_size - c->out_pos) {
+        return DELTA_ERR_RANGE;
+    }
+    if (c->op == DELTA_OP_ADD && (c->old_pos > ap->header.old_size ||
+                                  c->remaining > ap->header.old_size - c->old_pos)) {
+        return DELTA_ERR_RANGE;
+    }
+    if (c->remaining == 0) {
+        c->state = DELTA_STATE_OP;
+    } else {
+        c->state = c->op == DELTA_OP_ADD ? DELTA_STATE_ZERO_RUN : DELTA_STATE_INSERT_BYTES;
+        c->run = c->remaining;
+    }
+    c->varint = 0;
+    c->shift = 0;
+    return DELTA_OK;
+}
+
+/**
+ * Handle a completed varint in the current state
+ */
+static delta_status_t delta_varint_done(delta_applier_t *ap) {
+    delta_cursor_t *c = &ap->cur;
+    uint32_t v = c->varint;
+    c->varint = 0;
+    c->shift = 0;
+    switch (c->state) {
+        case DELTA_STATE_LEN:
+            c->remaining = v;
+            if (c->op == DELTA_OP_ADD) {
+                c->state = DELTA_STATE_SRC;
+                return DELTA_OK;
+            }
+            return delta_begin_op(ap);
+        case DELTA_STATE_SRC: {
+            int32_t delta = (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+            c->old_pos += (uint32_t)delta;
+            return delta_begin_op(ap);
+        }
+        case DELTA_STATE_ZERO_RUN:
+            if (v > c->remaining) {
+                return DELTA_ERR_FORMAT;
+            }
+            c->run = v;
+            c->state = DELTA_STATE_COPY;
+            return DELTA_OK;
+        case DELTA_STATE_LIT_COUNT:
+            if (v == 0 || v > c->remaining) {
+                return DELTA_ERR_FORMAT;
+            }
+            c->run = v;
+            c->state = DELTA_STATE_ADD_BYTES;
+            return DELTA_OK;
+        default:
+            return DELTA_ERR_FORMAT;
+    }
+}
+
+/**
+ * Feed the next piece of the patch (any size, in order)
+ *
+ * @return DELTA_OK when more input is needed, DELTA_DONE at the end,
+ *         otherwise an error; after an error the applier must be reset
+ */
+static delta_status_t delta_feed(delta_applier_t *ap, const uint8_t *data, size_t len) {
+    delta_cursor_t *c = &ap->cur;
+    size_t i = 0;
+    while (c->state != DELTA_STATE_DONE) {
+        uint32_t space = DELTA_SECTOR_SIZE - ap->out_len;
+
+        // Zero runs are copied from the old image without consuming input
+        if (c->state == DELTA_STATE_COPY) {
+            if (c->run == 0) {
+                c->state = c->remaining == 0 ? DELTA_STATE_OP : DELTA_STATE_LIT_COUNT;
+                continue;
+            }
+            uint32_t n = c->run < space ? c->run : space;
+            if (!ap->io.read_old(ap->io.ctx, c->old_pos, ap->out + ap->out_len, n)) {
+                return DELTA_ERR_IO;
+            }
+            c->old_pos += n;
+            if (!delta_produced(ap, n)) {
+                return DELTA_ERR_IO;
+            }
+            continue;
+        }
+        if (i >= len) {
+            return DELTA_OK;
+        }
+
+        switch (c->state) {
+            case DELTA_STATE_HEADER: {
+                uint32_t n = DELTA_HEADER_SIZE - c->header_len;
+                if (n > len - i) n = (uint32_t)(len - i);
+                memcpy(c->header_raw + c->header_len, data + i, n);
+                c->header_len += (uint8_t)n;
+                c->patch_pos += n;
+                i += n;
+                if (c->header_len == DELTA_HEADER_SIZE) {
+                    if (!delta_parse_header(c->header_raw, &ap->header)) {
+                        return DELTA_ERR_FORMAT;
+                    }
+                    if (ap->io.header != NULL && !ap->io.header(ap->io.ctx, &ap->header)) {
+                        return DELTA_ERR_BASE;
+                    }
+                    c->state = DELTA_STATE_OP;
+                }
+                break;
+            }
+            case DELTA_STATE_OP:
+                c->op = data[i++];
+                c->patch_pos++;
+                if (c->op == DELTA_OP_END) {
+                    if (c->out_pos != ap->header.new_size) {
+                        return DELTA_ERR_FORMAT;
+                    }
+                    c->state = DELTA_STATE_DONE;
+                    if (!delta_flush(ap)) {
+                        return DELTA_ERR_IO;
+                    }
+                } else if (c->op == DELTA_OP_ADD || c->op == DELTA_OP_INSERT) {
+                    c->state = DELTA_STATE_LEN;
+                } else {
+                    return DELTA_ERR_FORMAT;
+                }
+                break;
+            case DELTA_STATE_LEN:
+            case DELTA_STATE_SRC:
+            case DELTA_STATE_ZERO_RUN:
+            case DELTA_STATE_LIT_COUNT: {
+                uint8_t b = data[i++];
+                c->patch_pos++;
+                if (c->shift > 28) {
+                    return DELTA_ERR_FORMAT;
+                }
+                c->varint |= (uint32_t)(b & 0x7f) << c->shift;
+                if (b & 0x80) {
+                    c->shift += 7;
+                } else {
+                    delta_status_t st = delta_varint_done(ap);
+                    if (st != DELTA_OK) {
+                        return st;
+                    }
+                }
+                break;
+            }
+            case DELTA_STATE_ADD_BYTES: {
+                uint32_t n = c->run < space ? c->run : space;
+                if (n > len - i) n = (uint32_t)(len - i);
+                uint8_t *dst = ap->out + ap->out_len;
+                if (!ap->io.read_old(ap->io.ctx, c->old_pos, dst, n)) {
+                    return DELTA_ERR_IO;
+                }
+                for (uint32_t k = 0; k < n; k++) {
+                    dst[k] = (uint8_t)(dst[k] + data[i + k]);
+                }
+                i += n;
+                c->patch_pos += n;
+                c->old_pos += n;
+                bool last = c->run == n;
+                if (!delta_produced(ap, n)) {
+                    return DELTA_ERR_IO;
+                }
+                if (last) {
+                    c->state = c->remaining == 0 ? DELTA_STATE_OP : DELTA_STATE_ZERO_RUN;
+                }
+                break;
+            }
+            case DELTA_STATE_INSERT_BYTES: {
+                uint32_t n = c->run < space ? c->run : space;
+                if (n > len - i) n = (uint32_t)(len - i);
+                memcpy(ap->out + ap->out_len, data + i, n);
+                i += n;
+                c->patch_pos += n;
+                bool last = c->run == n;
+                if (!delta_produced(ap, n)) {
+                    return DELTA_ERR_IO;
+                }
+                if (last) {
+                    c->state = DELTA_STATE_OP;
+                }
+                break;
+            }
+            default:
+                return DELTA_ERR_FORMAT;
+        }
+    }
+    return i == len ? DELTA_DONE : DELTA_ERR_FORMAT;    // Trailing bytes after END
+}
+
+#ifdef ESP_PLATFORM
+
+#include <esp_log.h>
+#include <esp_ota_ops.h>
+#include <esp_partition.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <mbedtls/sha256.h>
+#include <nvs.h>
+#include <stdio.h>
+#include <WalterModem.h>
+#include "modem_deadline.h"
+#include "tls_profile.h"
+
+#ifndef CONFIG_SECURE_SIGNED_ON_UPDATE
+#error "Delta OTA boots what it downloads: enable signed app images (see README, Delta Firmware Updates)"
+#endif
+
+extern WalterModem modem;
+
+static const char *OTA_TAG = "delta_ota";
+
+// HTTP profile for patch downloads (uploads use TLS_HTTP_PROFILE_ID)
+#define DELTA_OTA_HTTP_PROFILE_ID 1
+#define DELTA_OTA_CHUNK_SIZE 1024
+#define DELTA_OTA_FETCH_RETRIES 3
+#define DELTA_OTA_RING_TIMEOUT_MS 60000
+#define DELTA_OTA_STALE_MS 15000        // Wait for a late ring before the profile is reused
+#define DELTA_OTA_CKPT_EVERY (16 * DELTA_SECTOR_SIZE)  // Persist a checkpoint every 64 KB written
+
+#define DELTA_OTA_NVS_NAMESPACE "walter"
+#define DELTA_OTA_NVS_KEY "ota_ckpt"
+
+/**
+ * Persisted progress of a patch download
+ */
+typedef struct {
+    uint32_t url_hash;
+    uint32_t target_address;    // Partition the checkpoint belongs to
+    delta_cursor_t cursor;
+} delta_ota_ckpt_t;
+
+typedef struct {
+    const esp_partition_t *running;
+    const esp_partition_t *target;
+} delta_ota_flash_t;
+
+typedef struct {
+    uint32_t applied;
+    uint32_t resumed;
+    uint32_t patch_bytes;       // Downloaded, including retries
+    uint32_t image_bytes;       // Size of the images built from them
+} delta_ota_stats_t;
+
+static delta_ota_stats_t g_ota_stats = {};
+
+// A query that timed out may still ring; it must not be taken for the next chunk
+static bool g_ota_ring_stale = false;
+static uint32_t g_ota_ring_resets = 0;     // g_modem_deadline.resets when it went stale
+
+static bool delta_ota_sha256(const esp_partition_t *part, uint32_t size, uint8_t *hash) {
+    uint8_t buf[256];
+    mbedtls_sha256_context ctx;
+    mbedtls_sha256_init(&ctx);
+    mbedtls_sha256_starts(&ctx, 0);
+    bool ok = size <= part->size;
+    for (uint32_t off = 0; ok && off < size; off += sizeof(buf)) {
+        uint32_t n = size - off < sizeof(buf) ? size - off : sizeof(buf);
+        ok = esp_partition_read(part, off, buf, n) == ESP_OK;
+        if (ok) {
+            mbedtls_sha256_update(&ctx, buf, n);
+        }
+    }
+    mbedtls_sha256_finish(&ctx, hash);
+    mbedtls_sha256_free(&ctx);
+    return ok;
+}
+
+static bool delta_ota_check_header(void *ctx, const delta_header_t *h) {
+    delta_ota_flash_t *flash = (delta_ota_flash_t *)ctx;
+    if (h->new_size > flash->target->size) {
+        ESP_LOGE(OTA_TAG, "New image (%lu B) does not fit the partition",
+                 (unsigned long)h->new_size);
+        return false;
+    }
+    uint8_t hash[DELTA_SHA256_SIZE];
+    if (!delta_ota_sha256(flash->running, h->old_size, hash) ||
+        memcmp(hash, h->old_sha256, sizeof(hash)) != 0) {
+        ESP_LOGE(OTA_TAG, "Patch was made for a different firmware image");
+        return false;
+    }
+    return true;
+}
+
+static bool delta_ota_read_old(void *ctx, uint32_t offset, uint8_t *buf, size_t len) {
+    delta_ota_flash_t *flash = (delta_ota_flash_t *)ctx;
+    return esp_partition_read(flash->running, offset, buf, len) == ESP_OK;
+}
+
+static bool delta_ota_write_sector(void *ctx, uint32_t offset, const uint8_t *buf, size_t len) {
+    delta_ota_flash_t *flash = (delta_ota_flash_t *)ctx;
+    return esp_partition_erase_range(flash->target, offset, DELTA_SECTOR_SIZE) == ESP_OK &&
+           esp_partition_write(flash->target, offset, buf, len) == ESP_OK;
+}
+
+static bool delta_ota_load_ckpt(delta_ota_ckpt_t *ckpt) {
+    nvs_handle_t handle;
+    if (nvs_open(DELTA_OTA_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        return false;
+    }
+    size_t len = sizeof(*ckpt);
+    bool ok = nvs_get_blob(handle, DELTA_OTA_NVS_KEY, ckpt, &len) == ESP_OK &&
+              len == sizeof(*ckpt);
+    nvs_close(handle);
+    return ok;
+}
+
+static void delta_ota_store_ckpt(const delta_ota_ckpt_t *ckpt) {
+    nvs_handle_t handle;
+    if (nvs_open(DELTA_OTA_NVS_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) {
+        return;
+    }
+    esp_err_t err = ckpt != NULL ? nvs_set_blob(handle, DELTA_OTA_NVS_KEY, ckpt, sizeof(*ckpt))
+                                 : nvs_erase_key(handle, DELTA_OTA_NVS_KEY);
+    if (err == ESP_OK) {
+        nvs_commit(handle);
+    }
+    nvs_close(handle);
+}
+
+/**
+ * Wait for the ring of a query that timed out and throw it away
+ *
+ * Gives up after DELTA_OTA_STALE_MS (the answer is then taken as lost) or
+ * when the modem was reset.
+ */
+static void delta_ota_drain_stale(void) {
+    for (uint32_t waited = 0; g_ota_ring_stale; waited += 500) {
+        static uint8_t discard[16];
+        WalterModemRsp rsp = {};
+        if (modem.httpDidRing(DELTA_OTA_HTTP_PROFILE_ID, discard, sizeof(discard), &rsp)) {
+            ESP_LOGW(OTA_TAG, "Late HTTP %u discarded", (unsigned)rsp.data.httpResponse.httpStatus);
+            g_ota_ring_stale = false;
+        } else if (waited >= DELTA_OTA_STALE_MS || modem_deadline_resets() != g_ota_ring_resets) {
+            g_ota_ring_stale = false;
+        } else {
+            vTaskDelay(pdMS_TO_TICKS(500));
+        }
+    }
+}
+
+static void delta_ota_mark_stale(void) {
+    g_ota_ring_stale = true;
+    g_ota_ring_resets = modem_deadline_resets();
+}
+
+/**
+ * Download one chunk of the patch starting at offset
+ *
+ * The modem's HTTP query cannot carry a Range header, so the range is
+ * passed as query parameters; the patch server (or a CDN rule) maps
+ * "?offset=&length=" to the byte range.
+ *
+ * @return Bytes received, 0 on failure
+ */
+static uint32_t delta_ota_fetch(const http_url_t *url, uint32_t offset, uint8_t *buf,
+                                uint16_t len) {
+    char uri[160];
+    snprintf(uri, sizeof(uri), "%s%soffset=%lu&length=%u", url->path,
+             strchr(url->path, '?') != NULL ? "&" : "?", (unsigned long)offset, (unsigned)len);
+
+    delta_ota_drain_stale();
+    WalterModemRsp rsp = {};
+    static char ctype[32];     // Written by the answer, which may come after a missed deadline
+    modem_call_ticket_t abandoned;
+    if (!modem_call(MODEM_CLASS_HTTP, "httpQuery", NULL, [&](walterModemCb cb, void *arg) {
+            return modem.httpQuery(DELTA_OTA_HTTP_PROFILE_ID, uri, WALTER_MODEM_HTTP_QUERY_CMD_GET,
+                                   ctype, sizeof(ctype), NULL, cb, arg);
+        }, &abandoned)) {
+        if (abandoned.pending) {
+            delta_ota_mark_stale();
+        }
+        return 0;
+    }
+    for (uint32_t waited = 0; waited < DELTA_OTA_RING_TIMEOUT_MS; waited += 500) {
+        if (modem.httpDidRing(DELTA_OTA_HTTP_PROFILE_ID, buf, len, &rsp)) {
+            uint16_t status = rsp.data.httpResponse.httpStatus;
+            uint16_t got = rsp.data.httpResponse.contentLength;
+            if ((status != 200 && status != 206) || got == 0 || got > len) {
+                ESP_LOGW(OTA_TAG, "Chunk at %lu: HTTP %u, %u bytes", (unsigned long)offset,
+                         (unsigned)status, (unsigned)got);
+                return 0;
+            }
+            return got;
+        }
+        vTaskDelay(pdMS_TO_TICKS(500));
+    }
+    ESP_LOGW(OTA_TAG, "Chunk at %lu: no response within %d ms", (unsigned long)offset,
+             DELTA_OTA_RING_TIMEOUT_MS);
+    delta_ota_mark_stale();
+    return 0;
+}
+
+/**
+ * Download and apply a delta patch into the inactive OTA partition
+ *
+ * Resumes a previous attempt for the same URL. On success the new image
+ * is verified against the patch's SHA-256 and selected for the next boot;
+ * the caller restarts when convenient.
+ */
+static bool delta_ota_run(const char *url_str) {
+    http_url_t url;
+    if (!http_url_parse(url_str, &url)) {
+        ESP_LOGE(OTA_TAG, "Unsupported URL: %s", url_str);
+        return false;
+    }
+    uint8_t tls_profile = 0;
+    if (url.https) {
+        if (!tls_profile_ensure()) {
+            return false;
+        }
+        tls_profile = TLS_PROFILE_ID;
+    } else {
+#ifdef CONFIG_WALTER_UPLINK_TLS_NO_VERIFY
+        ESP_LOGW(OTA_TAG, "Downloading the patch over plain HTTP");
+#else
+        ESP_LOGE(OTA_TAG, "Refusing a patch over plain HTTP: %s", url_str);
+        return false;
+#endif
+    }
+    delta_ota_drain_stale();
+    if (!modem_call(MODEM_CLASS_HTTP, "httpConfigProfile", NULL, [&](walterModemCb cb, void *arg) {
+            return modem.httpConfigProfile(DELTA_OTA_HTTP_PROFILE_ID, url.host, url.port,
+                                           tls_profile, false, "", "", 30, 0, 0, NULL, cb, arg);
+        })) {
+        ESP_LOGE(OTA_TAG, "Failed to configure HTTP profile");
+        return false;
+    }
+
+    delta_ota_flash_t flash = { esp_ota_get_running_partition(),
+                                esp_ota_get_next_update_partition(NULL) };
+    if (flash.running == NULL || flash.target == NULL) {
+        ESP_LOGE(OTA_TAG, "No OTA partition to update (check the partition table)");
+        return false;
+    }
+    delta_io_t io = { &flash, delta_ota_check_header, delta_ota_read_old,
+                      delta_ota_write_sector };
+
+    // ~5 KB: one output sector plus one download chunk
+    static delta_applier_t applier;
+    static uint8_t chunk[DELTA_OTA_CHUNK_SIZE];
+
+    delta_ota_ckpt_t ckpt = {};
+    uint32_t url_hash = tls_fnv1a(url_str, strlen(url_str));
+    delta_applier_init(&applier, &io);
+    if (delta_ota_load_ckpt(&ckpt) && ckpt.url_hash == url_hash &&
+        ckpt.target_address == flash.target->address &&
+        delta_applier_resume(&applier, &io, &ckpt.cursor)) {
+        g_ota_stats.resumed++;
+        ESP_LOGI(OTA_TAG, "Resuming at patch offset %lu (%lu B written)",
+                 (unsigned long)ckpt.cursor.patch_pos, (unsigned long)ckpt.cursor.out_pos);
+    }
+    ckpt.url_hash = url_hash;
+    ckpt.target_address = flash.target->address;
+
+    delta_status_t status = DELTA_OK;
+    uint32_t saved_out = applier.checkpoint.out_pos;
+    int failures = 0;
+    while (status == DELTA_OK) {
+        uint32_t got = delta_ota_fetch(&url, applier.cur.patch_pos, chunk, sizeof(chunk));
+        if (got == 0) {
+            if (++failures >= DELTA_OTA_FETCH_RETRIES) {
+                ckpt.cursor = applier.checkpoint;
+                delta_ota_store_ckpt(&ckpt);
+                ESP_LOGW(OTA_TAG, "Download stalled at %lu, will resume from %lu",
+                         (unsigned long)applier.cur.patch_pos,
+                         (unsigned long)ckpt.cursor.patch_pos);
+                return false;
+            }
+            continue;
+        }
+        failures = 0;
+        g_ota_stats.patch_bytes += got;
+        status = delta_feed(&applier, chunk, got);
+
+        if (applier.checkpoint.out_pos - saved_out >= DELTA_OTA_CKPT_EVERY) {
+            ckpt.cursor = applier.checkpoint;
+            delta_ota_store_ckpt(&ckpt);
+            saved_out = applier.checkpoint.out_pos;
+        }
+    }
+    if (status != DELTA_DONE) {
+        ESP_LOGE(OTA_TAG, "Patch failed: %s", delta_status_str(status));
+        delta_ota_store_ckpt(NULL);
+        return false;
+    }
+
+    uint8_t hash[DELTA_SHA256_SIZE];
+    if (!delta_ota_sha256(flash.target, applier.header.new_size, hash) ||
+        memcmp(hash, applier.header.new_sha256, sizeof(hash)) != 0) {
+        ESP_LOGE(OTA_TAG, "New image hash mismatch, not switching");
+        delta_ota_store_ckpt(NULL);
+        return false;
+    }
+    delta_ota_store_ckpt(NULL);
+    esp_err_t err = esp_ota_set_boot_partition(flash.target);
+    if (err != ESP_OK) {
+        ESP_LOGE(OTA_TAG, "Image rejected: %s", esp_err_to_name(err));
+        return false;
+    }
+    g_ota_stats.applied++;
+    g_ota_stats.image_bytes += applier.header.new_size;
+    ESP_LOGI(OTA_TAG, "Update ready: %lu B image from %lu B patch, restart to boot it",
+             (unsigned long)applier.header.new_size, (unsigned long)applier.cur.patch_pos);
+    return true;
+}
+
+#endif // ESP_PLATFORM
+
+#endif // DELTA_OTA_H
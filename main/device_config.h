@@ -0,0 +1,370 @@
+/**
+ * Runtime Device Configuration for Walter Modem
+ *
+ * Settings that are changed in the field instead of by reflashing: the
+ * sampling period, the upload scheduler delays and daily budget, the APN
+ * credentials, log verbosity and whether the diagnostics console runs.
+ * Changes arrive piggybacked on upload responses (downlink.h).
+ *
+ * The configuration is versioned. A change is a delta against it,
+ *
+ *   <version> [base=<version>] key=value ...
+ *
+ * e.g. "7 base=6 smp=30000 log=4". The delta is applied to a copy and
+ * validated as a whole: one unknown key or out-of-range value rejects
+ * all of it. Only versions newer than the current one are taken, so a
+ * response that is delivered twice changes nothing the second time.
+ *
+ * The whole configuration is one NVS blob; nvs_set_blob() + nvs_commit()
+ * replaces it atomically, so a reset during an update leaves either the
+ * old or the new version, never a mix.
+ *
+ * Parsing and validation have no ESP-IDF dependencies.
+ */
+
+#ifndef DEVICE_CONFIG_H
+#define DEVICE_CONFIG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sensor_sampler.h"
+#include "upload_scheduler.h"
+
+#define DEVICE_CONFIG_MAGIC 0x57434647u         // "WCFG", guards against an old blob layout
+#define DEVICE_CONFIG_STR_MAX 32
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;               // 0 = build defaults
+    uint32_t sample_period_ms;
+    uint32_t normal_max_delay_ms;
+    uint32_t bulk_max_delay_ms;
+    uint32_t daily_budget_uah;
+    uint8_t log_level;              // esp_log_level_t applied to every tag
+    uint8_t console;                // 1 = run the diagnostics console
+    char apn[DEVICE_CONFIG_STR_MAX];
+    char apn_user[DEVICE_CONFIG_STR_MAX];
+    char apn_pass[DEVICE_CONFIG_STR_MAX];
+    uint32_t last_cmd;              // Highest downlink command id accepted (downlink.h)
+} device_config_t;
+
+typedef enum {
+    DEVICE_CONFIG_OK = 0,
+    DEVICE_CONFIG_STALE,            // Version not newer than the current one
+    DEVICE_CONFIG_BASE_MISMATCH,    // Delta was made against another version
+    DEVICE_CONFIG_BAD_FORMAT,
+    DEVICE_CONFIG_UNKNOWN_KEY,
+    DEVICE_CONFIG_BAD_VALUE,
+    DEVICE_CONFIG_INCONSISTENT,     // Values valid alone but not together
+    DEVICE_CONFIG_STORE_FAILED,     // Valid, but could not be committed to NVS
+} device_config_result_t;
+
+static const char *const DEVICE_CONFIG_RESULT_NAMES[] = {
+    "ok", "stale", "base mismatch", "bad format", "unknown key", "bad value", "inconsistent",
+    "store failed",
+};
+
+typedef enum {
+    DEVICE_FIELD_U32 = 0,
+    DEVICE_FIELD_U8,
+    DEVICE_FIELD_STR,
+} device_field_type_t;
+
+typedef struct {
+    const char *key;
+    uint8_t type;                   // device_field_type_t
+    uint16_t offset;
+    uint32_t min;                   // DEVICE_FIELD_STR: minimum length
+    uint32_t max;
+} device_config_field_t;
+
+/**
+ * Keys a delta may set
+ */
+static const device_config_field_t DEVICE_CONFIG_FIELDS[] = {
+    { "smp",     DEVICE_FIELD_U32, offsetof(device_config_t, sample_period_ms),    1000, 3600000 },
+    { "normal",  DEVICE_FIELD_U32, offsetof(device_config_t, normal_max_delay_ms), 60000, 86400000 },
+    { "bulk",    DEVICE_FIELD_U32, offsetof(device_config_t, bulk_max_delay_ms),   60000, 86400000 },
+    { "budget",  DEVICE_FIELD_U32, offsetof(device_config_t, daily_budget_uah),    1000, 10000000 },
+    { "log",     DEVICE_FIELD_U8,  offsetof(device_config_t, log_level),           0, 5 },
+    { "console", DEVICE_FIELD_U8,  offsetof(device_config_t, console),             0, 1 },
+    { "apn",     DEVICE_FIELD_STR, offsetof(device_config_t, apn),                 1, DEVICE_CONFIG_STR_MAX - 1 },
+    { "apnu",    DEVICE_FIELD_STR, offsetof(device_config_t, apn_user),            0, DEVICE_CONFIG_STR_MAX - 1 },
+    { "apnp",    DEVICE_FIELD_STR, offsetof(device_config_t, apn_pass),            0, DEVICE_CONFIG_STR_MAX - 1 },
+};
+
+#define DEVICE_CONFIG_FIELD_COUNT (sizeof(DEVICE_CONFIG_FIELDS) / sizeof(DEVICE_CONFIG_FIELDS[0]))
+
+/**
+ * Build defaults (APN left empty, the caller fills it in)
+ */
+static void device_config_defaults(device_config_t *cfg) {
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->magic = DEVICE_CONFIG_MAGIC;
+    cfg->sample_period_ms = SAMPLER_PERIOD_MS;
+    cfg->normal_max_delay_ms = UPLOAD_NORMAL_MAX_DELAY_MS;
+    cfg->bulk_max_delay_ms = UPLOAD_BULK_MAX_DELAY_MS;
+    cfg->daily_budget_uah = UPLOAD_DAILY_BUDGET_UAH;
+    cfg->log_level = 3;             // ESP_LOG_INFO
+    cfg->console = 1;
+}
+
+/**
+ * Parse a decimal uint32_t, the whole string must be digits
+ */
+static bool device_config_parse_u32(const char *s, uint32_t *out) {
+    if (*s == '\0') {
+        return false;
+    }
+    uint64_t v = 0;
+    for (; *s != '\0'; s++) {
+        if (*s < '0' || *s > '9') {
+            return false;
+        }
+        v = v * 10 + (uint64_t)(*s - '0');
+        if (v > UINT32_MAX) {
+            return false;
+        }
+    }
+    *out = (uint32_t)v;
+    return true;
+}
+
+static const device_config_field_t *device_config_find_field(const char *key) {
+    for (size_t i = 0; i < DEVICE_CONFIG_FIELD_COUNT; i++) {
+        if (strcmp(DEVICE_CONFIG_FIELDS[i].key, key) == 0) {
+            return &DEVICE_CONFIG_FIELDS[i];
+        }
+    }
+    return NULL;
+}
+
+static bool device_config_set_field(device_config_t *cfg, const device_config_field_t *f,
+                                    const char *value) {
+    uint8_t *base = (uint8_t *)cfg + f->offset;
+    if (f->type == DEVICE_FIELD_STR) {
+        size_t len = strlen(value);
+        if (len < f->min || len > f->max) {
+            return false;
+        }
+        memset(base, 0, f->max + 1);
+        memcpy(base, value, len);
+        return true;
+    }
+    uint32_t v;
+    if (!device_config_parse_u32(value, &v) || v < f->min || v > f->max) {
+        return false;
+    }
+    if (f->type == DEVICE_FIELD_U8) {
+        *base = (uint8_t)v;
+    } else {
+        memcpy(base, &v, sizeof(v));
+    }
+    return true;
+}
+
+/**
+ * Checks across fields, after every key of a delta is applied
+ */
+static bool device_config_consistent(const device_config_t *cfg) {
+    return cfg->normal_max_delay_ms <= cfg->bulk_max_delay_ms &&
+           cfg->sample_period_ms < cfg->normal_max_delay_ms;
+}
+
+/**
+ * Apply a delta to a copy of the current configuration
+ *
+ * @param delta "<version> [base=<version>] key=value ...", split in place
+ * @param out Receives the new configuration; only meaningful on DEVICE_CONFIG_OK
+ */
+static device_config_result_t device_config_apply_delta(const device_config_t *current,
+                                                        char *delta, device_config_t *out) {
+    *out = *current;
+    char *save = NULL;
+    char *tok = strtok_r(delta, " \t\r\n", &save);
+    uint32_t version;
+    if (tok == NULL || !device_config_parse_u32(tok, &version)) {
+        return DEVICE_CONFIG_BAD_FORMAT;
+    }
+    if (version <= current->version) {
+        return DEVICE_CONFIG_STALE;
+    }
+
+    while ((tok = strtok_r(NULL, " \t\r\n", &save)) != NULL) {
+        char *eq = strchr(tok, '=');
+        if (eq == NULL || eq == tok) {
+            return DEVICE_CONFIG_BAD_FORMAT;
+        }
+        *eq = '\0';
+        const char *value = eq + 1;
+        if (strcmp(tok, "base") == 0) {
+            uint32_t base;
+            if (!device_config_parse_u32(value, &base)) {
+                return DEVICE_CONFIG_BAD_FORMAT;
+            }
+            if (base != current->version) {
+                return DEVICE_CONFIG_BASE_MISMATCH;
+            }
+            continue;
+        }
+        const device_config_field_t *f = device_config_find_field(tok);
+        if (f == NULL) {
+            return DEVICE_CONFIG_UNKNOWN_KEY;
+        }
+        if (!device_config_set_field(out, f, value)) {
+            return DEVICE_CONFIG_BAD_VALUE;
+        }
+    }
+
+    if (!device_config_consistent(out)) {
+        return DEVICE_CONFIG_INCONSISTENT;
+    }
+    out->version = version;
+    return DEVICE_CONFIG_OK;
+}
+
+#ifdef ESP_PLATFORM
+
+#include <esp_log.h>
+#include <nvs.h>
+#include <cJSON.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+static const char *CONFIG_TAG = "device_config";
+
+#define DEVICE_CONFIG_NVS_NAMESPACE "walter"
+#define DEVICE_CONFIG_NVS_KEY "config"
+
+// Written on the modem core (downlink), read by every core through device_config_get()
+static device_config_t g_device_config = {};
+static volatile uint32_t g_device_config_gen = 0;   // Bumped on every change
+static portMUX_TYPE g_device_config_lock = portMUX_INITIALIZER_UNLOCKED;
+// Held by a writer from reading the current config until the new one is
+// published, so two writers cannot store one another's stale copy. The NVS
+// write cannot run inside g_device_config_lock.
+static SemaphoreHandle_t g_device_config_write = NULL;
+
+/**
+ * Consistent copy of the current configuration
+ *
+ * @return Generation of the copy (compare with g_device_config_gen)
+ */
+static uint32_t device_config_get(device_config_t *out) {
+    taskENTER_CRITICAL(&g_device_config_lock);
+    *out = g_device_config;
+    uint32_t gen = g_device_config_gen;
+    taskEXIT_CRITICAL(&g_device_config_lock);
+    return gen;
+}
+
+static bool device_config_store(const device_config_t *cfg) {
+    nvs_handle_t handle;
+    if (nvs_open(DEVICE_CONFIG_NVS_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) {
+        return false;
+    }
+    bool ok = nvs_set_blob(handle, DEVICE_CONFIG_NVS_KEY, cfg, sizeof(*cfg)) == ESP_OK &&
+              nvs_commit(handle) == ESP_OK;
+    nvs_close(handle);
+    return ok;
+}
+
+static void device_config_publish(const device_config_t *cfg) {
+    taskENTER_CRITICAL(&g_device_config_lock);
+    g_device_config = *cfg;
+    g_device_config_gen++;
+    taskEXIT_CRITICAL(&g_device_config_lock);
+    esp_log_level_set("*", (esp_log_level_t)cfg->log_level);
+}
+
+/**
+ * Load the stored configuration, or the build defaults if there is none
+ *
+ * Call after NVS is initialized and before connecting (the APN comes
+ * from here).
+ */
+static void device_config_init(const char *apn, const char *apn_user, const char *apn_pass) {
+    device_config_t cfg;
+    device_config_defaults(&cfg);
+    strncpy(cfg.apn, apn, sizeof(cfg.apn) - 1);
+    strncpy(cfg.apn_user, apn_user, sizeof(cfg.apn_user) - 1);
+    strncpy(cfg.apn_pass, apn_pass, sizeof(cfg.apn_pass) - 1);
+#ifdef CONFIG_LOG_DEFAULT_LEVEL
+    cfg.log_level = CONFIG_LOG_DEFAULT_LEVEL;
+#endif
+
+    nvs_handle_t handle;
+    if (nvs_open(DEVICE_CONFIG_NVS_NAMESPACE, NVS_READONLY, &handle) == ESP_OK) {
+        device_config_t stored;
+        size_t len = sizeof(stored);
+        if (nvs_get_blob(handle, DEVICE_CONFIG_NVS_KEY, &stored, &len) == ESP_OK &&
+            len == sizeof(stored) && stored.magic == DEVICE_CONFIG_MAGIC) {
+            cfg = stored;
+        }
+        nvs_close(handle);
+    }
+    g_device_config_write = xSemaphoreCreateMutex();
+    device_config_publish(&cfg);
+    ESP_LOGI(CONFIG_TAG, "Config version %lu: sample %lu ms, APN %s",
+             (unsigned long)cfg.version, (unsigned long)cfg.sample_period_ms, cfg.apn);
+}
+
+/**
+ * Validate, persist and publish a delta (see device_config_apply_delta)
+ *
+ * Nothing changes, in RAM or in flash, unless the delta is valid as a
+ * whole and was committed to NVS.
+ */
+static device_config_result_t device_config_update(char *delta) {
+    device_config_t current, next;
+    xSemaphoreTake(g_device_config_write, portMAX_DELAY);
+    device_config_get(&current);
+    device_config_result_t result = device_config_apply_delta(&current, delta, &next);
+    if (result == DEVICE_CONFIG_OK && !device_config_store(&next)) {
+        ESP_LOGE(CONFIG_TAG, "Failed to store config version %lu", (unsigned long)next.version);
+        result = DEVICE_CONFIG_STORE_FAILED;
+    }
+    if (result == DEVICE_CONFIG_OK) {
+        device_config_publish(&next);
+        ESP_LOGI(CONFIG_TAG, "Config version %lu -> %lu", (unsigned long)current.version,
+                 (unsigned long)next.version);
+    }
+    xSemaphoreGive(g_device_config_write);
+    return result;
+}
+
+/**
+ * Remember the newest downlink command accepted, before it runs
+ */
+static bool device_config_set_last_cmd(uint32_t id) {
+    device_config_t cfg;
+    xSemaphoreTake(g_device_config_write, portMAX_DELAY);
+    device_config_get(&cfg);
+    cfg.last_cmd = id;
+    bool ok = device_config_store(&cfg);
+    if (ok) {
+        taskENTER_CRITICAL(&g_device_config_lock);
+        g_device_config.last_cmd = id;
+        taskEXIT_CRITICAL(&g_device_config_lock);
+    }
+    xSemaphoreGive(g_device_config_write);
+    return ok;
+}
+
+/**
+ * Add "cfg": [version, last command] so the server knows what to send next
+ */
+static void device_config_add_to_json(cJSON *root) {
+    device_config_t cfg;
+    device_config_get(&cfg);
+    cJSON *ack = cJSON_CreateArray();
+    cJSON_AddItemToArray(ack, cJSON_CreateNumber(cfg.version));
+    cJSON_AddItemToArray(ack, cJSON_CreateNumber(cfg.last_cmd));
+    cJSON_AddItemToObject(root, "cfg", ack);
+}
+
+#endif // ESP_PLATFORM
+
+#endif // DEVICE_CONFIG_H
@@ -0,0 +1,223 @@
+/**
+ * Diagnostics Command Parser for Walter Modem
+ *
+ * Turns console input ("setrat nbiot", "at AT+CEREG?", ...) into a typed
+ * command. Parsing is kept separate from execution and has no ESP-IDF
+ * dependencies, so the same table serves the esp_console front end, other
+ * transports (e.g. a downlink) and a Linux-target build.
+ */
+
+#ifndef DIAG_COMMAND_H
+#define DIAG_COMMAND_H
+
+#include <ctype.h>
+#include <stddef.h>
+#include <string.h>
+
+#define DIAG_AT_CMD_MAX 64
+#define DIAG_URL_MAX 128
+#define DIAG_MAX_ARGS 4
+
+typedef enum {
+    DIAG_CMD_NONE = 0,
+    DIAG_CMD_DIAG,          // Raw AT diagnostics (debug_commands.h)
+    DIAG_CMD_DIAG_FULL,     // API diagnostics (modem_diagnostics.h)
+    DIAG_CMD_RAT,           // check_rat_support()
+    DIAG_CMD_COVERAGE,      // check_network_coverage()
+    DIAG_CMD_SET_RAT,       // debug_set_rat()
+    DIAG_CMD_AT,            // send_debug_command()
+    DIAG_CMD_STATS,         // Pipeline/sampler/energy counters
+    DIAG_CMD_OTA,           // delta_ota_run()
+    DIAG_CMD_TRACE,         // modem_trace_start/stop/dump()
+} diag_command_id_t;
+
+typedef enum {
+    DIAG_PARSE_OK = 0,
+    DIAG_PARSE_EMPTY,
+    DIAG_PARSE_UNKNOWN,
+    DIAG_PARSE_MISSING_ARG,
+    DIAG_PARSE_TOO_MANY_ARGS,
+    DIAG_PARSE_BAD_ARG,
+} diag_parse_result_t;
+
+typedef enum {
+    DIAG_RAT_NBIOT = 0,
+    DIAG_RAT_LTEM,
+} diag_rat_t;
+
+typedef enum {
+    DIAG_TRACE_START = 0,
+    DIAG_TRACE_STOP,
+    DIAG_TRACE_DUMP,
+} diag_trace_op_t;
+
+typedef struct {
+    diag_command_id_t id;
+    diag_rat_t rat;                 // DIAG_CMD_SET_RAT
+    diag_trace_op_t trace;          // DIAG_CMD_TRACE
+    char at[DIAG_AT_CMD_MAX];       // DIAG_CMD_AT
+    char url[DIAG_URL_MAX];         // DIAG_CMD_OTA
+} diag_command_t;
+
+typedef struct {
+    const char *name;
+    const char *hint;
+    const char *help;
+    int min_args;
+    int max_args;
+} diag_command_spec_t;
+
+/**
+ * Console commands (names and help text used by esp_console too)
+ */
+static const diag_command_spec_t DIAG_COMMANDS[] = {
+    { "diag",     "[full]",        "Run modem diagnostics ('full' = API diagnostics suite)", 0, 1 },
+    { "rat",      NULL,            "Show current and supported RAT",                         0, 0 },
+    { "coverage", NULL,            "Show signal quality and registration state",            0, 0 },
+    { "setrat",   "<nbiot|ltem>",  "Set the radio access technology",                       1, 1 },
+    { "at",       "<AT command>",  "Send a raw AT command",                                 1, 1 },
+    { "stats",    NULL,            "Show sampler, uplink and energy counters",              0, 0 },
+    { "ota",      "<patch URL>",   "Apply a delta firmware patch and restart",              1, 1 },
+    { "trace",    "<start|stop|dump>", "Record modem UART traffic to flash, or dump it",        1, 1 },
+};
+
+#define DIAG_COMMAND_COUNT (sizeof(DIAG_COMMANDS) / sizeof(DIAG_COMMANDS[0]))
+
+static const char *diag_parse_result_str(diag_parse_result_t result) {
+    switch (result) {
+        case DIAG_PARSE_OK:            return "OK";
+        case DIAG_PARSE_EMPTY:         return "empty command";
+        case DIAG_PARSE_UNKNOWN:       return "unknown command";
+        case DIAG_PARSE_MISSING_ARG:   return "missing argument";
+        case DIAG_PARSE_TOO_MANY_ARGS: return "too many arguments";
+        case DIAG_PARSE_BAD_ARG:       return "invalid argument";
+        default:                       return "error";
+    }
+}
+
+/**
+ * Only accept printable AT commands that fit the buffer
+ */
+static bool diag_valid_at(const char *cmd) {
+    size_t len = strlen(cmd);
+    if (len < 2 || len >= DIAG_AT_CMD_MAX) {
+        return false;
+    }
+    if (toupper((unsigned char)cmd[0]) != 'A' || toupper((unsigned char)cmd[1]) != 'T') {
+        return false;
+    }
+    for (size_t i = 0; i < len; i++) {
+        if (!isprint((unsigned char)cmd[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Parse an already tokenized command (argv[0] is the command name)
+ */
+static diag_parse_result_t diag_command_parse_args(int argc, const char *const *argv,
+                                                   diag_command_t *out) {
+    memset(out, 0, sizeof(*out));
+    if (argc < 1 || argv[0] == NULL || argv[0][0] == '\0') {
+        return DIAG_PARSE_EMPTY;
+    }
+
+    const diag_command_spec_t *spec = NULL;
+    for (size_t i = 0; i < DIAG_COMMAND_COUNT; i++) {
+        if (strcmp(argv[0], DIAG_COMMANDS[i].name) == 0) {
+            spec = &DIAG_COMMANDS[i];
+            break;
+        }
+    }
+    if (spec == NULL) {
+        return DIAG_PARSE_UNKNOWN;
+    }
+    int nargs = argc - 1;
+    if (nargs < spec->min_args) {
+        return DIAG_PARSE_MISSING_ARG;
+    }
+    if (nargs > spec->max_args) {
+        return DIAG_PARSE_TOO_MANY_ARGS;
+    }
+
+    if (strcmp(spec->name, "diag") == 0) {
+        if (nargs == 0) {
+            out->id = DIAG_CMD_DIAG;
+        } else if (strcmp(argv[1], "full") == 0) {
+            out->id = DIAG_CMD_DIAG_FULL;
+        } else {
+            return DIAG_PARSE_BAD_ARG;
+        }
+    } else if (strcmp(spec->name, "rat") == 0) {
+        out->id = DIAG_CMD_RAT;
+    } else if (strcmp(spec->name, "coverage") == 0) {
+        out->id = DIAG_CMD_COVERAGE;
+    } else if (strcmp(spec->name, "setrat") == 0) {
+        if (strcmp(argv[1], "nbiot") == 0) {
+            out->rat = DIAG_RAT_NBIOT;
+        } else if (strcmp(argv[1], "ltem") == 0) {
+            out->rat = DIAG_RAT_LTEM;
+        } else {
+            return DIAG_PARSE_BAD_ARG;
+        }
+        out->id = DIAG_CMD_SET_RAT;
+    } else if (strcmp(spec->name, "at") == 0) {
+        if (!diag_valid_at(argv[1])) {
+            return DIAG_PARSE_BAD_ARG;
+        }
+        strcpy(out->at, argv[1]);
+        out->id = DIAG_CMD_AT;
+    } else if (strcmp(spec->name, "stats") == 0) {
+        out->id = DIAG_CMD_STATS;
+    } else if (strcmp(spec->name, "ota") == 0) {
+        if (strncmp(argv[1], "http", 4) != 0 || strlen(argv[1]) >= DIAG_URL_MAX) {
+            return DIAG_PARSE_BAD_ARG;
+        }
+        strcpy(out->url, argv[1]);
+        out->id = DIAG_CMD_OTA;
+    } else if (strcmp(spec->name, "trace") == 0) {
+        if (strcmp(argv[1], "start") == 0) {
+            out->trace = DIAG_TRACE_START;
+        } else if (strcmp(argv[1], "stop") == 0) {
+            out->trace = DIAG_TRACE_STOP;
+        } else if (strcmp(argv[1], "dump") == 0) {
+            out->trace = DIAG_TRACE_DUMP;
+        } else {
+            return DIAG_PARSE_BAD_ARG;
+        }
+        out->id = DIAG_CMD_TRACE;
+    }
+    return DIAG_PARSE_OK;
+}
+
+/**
+ * Tokenize a command line in place and parse it
+ *
+ * Splits on spaces/tabs; the line buffer is modified.
+ */
+static diag_parse_result_t diag_command_parse_line(char *line, diag_command_t *out) {
+    const char *argv[DIAG_MAX_ARGS];
+    int argc = 0;
+    char *p = line;
+
+    while (*p != '\0') {
+        while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') {
+            *p++ = '\0';
+        }
+        if (*p == '\0') {
+            break;
+        }
+        if (argc == DIAG_MAX_ARGS) {
+            return DIAG_PARSE_TOO_MANY_ARGS;
+        }
+        argv[argc++] = p;
+        while (*p != '\0' && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') {
+            p++;
+        }
+    }
+    return diag_command_parse_args(argc, argv, out);
+}
+
+#endif // DIAG_COMMAND_H
@@ -0,0 +1,277 @@
+/**
+ * On-Demand Diagnostics Console for Walter Modem
+ *
+ * Exposes the diagnostics helpers as esp_console commands so they run only
+ * when asked for, while the device stays connected, instead of on every
+ * boot. Which commands do something depends on the build profile: helpers
+ * that were compiled out answer "not in this build".
+ *
+ * diag_console_execute() takes a parsed command, so other front ends (for
+ * example a downlink) can trigger the same actions.
+ */
+
+#ifndef DIAG_CONSOLE_H
+#define DIAG_CONSOLE_H
+
+#include <esp_console.h>
+#include <esp_log.h>
+#include <sdkconfig.h>
+#include <WalterModem.h>
+#include "diag_command.h"
+#include "dns_cache.h"
+#include "energy_model.h"
+#include "modem_deadline.h"
+#include "modem_trace.h"
+#include "sensor_sampler.h"
+#include "uplink_pipeline.h"
+#ifdef CONFIG_WALTER_DEBUG_MODE
+#include "debug_commands.h"
+#endif
+#ifdef CONFIG_WALTER_FULL_DIAGNOSTICS
+#include "modem_diagnostics.h"
+#endif
+#ifdef CONFIG_WALTER_DELTA_OTA
+#include <esp_system.h>
+#include "delta_ota.h"
+#endif
+
+static const char *CONSOLE_TAG = "diag_console";
+
+#define DIAG_CONSOLE_PROMPT "walter> "
+
+// The REPL cannot be torn down safely while its task is blocked reading the
+// console, so turning the console off makes it refuse every command instead
+static volatile bool g_diag_console_enabled = false;
+
+static void diag_console_not_built(const char *what) {
+    ESP_LOGW(CONSOLE_TAG, "%s is not in this build (see build profiles)", what);
+}
+
+/**
+ * Run a parsed diagnostics command
+ *
+ * @return true if the command ran
+ */
+static bool diag_console_execute(const diag_command_t *cmd) {
+    switch (cmd->id) {
+        case DIAG_CMD_DIAG:
+#ifdef CONFIG_WALTER_DEBUG_MODE
+            run_modem_diagnostics();
+            return true;
+#else
+            diag_console_not_built("Raw AT diagnostics");
+            return false;
+#endif
+        case DIAG_CMD_DIAG_FULL:
+#ifdef CONFIG_WALTER_FULL_DIAGNOSTICS
+            run_complete_diagnostics();
+            return true;
+#else
+            diag_console_not_built("Full diagnostics");
+            return false;
+#endif
+        case DIAG_CMD_RAT:
+#ifdef CONFIG_WALTER_DEBUG_MODE
+            check_rat_support();
+            return true;
+#else
+            diag_console_not_built("RAT check");
+            return false;
+#endif
+        case DIAG_CMD_COVERAGE:
+#ifdef CONFIG_WALTER_DEBUG_MODE
+            check_network_coverage();
+            return true;
+#else
+            diag_console_not_built("Coverage check");
+            return false;
+#endif
+        case DIAG_CMD_SET_RAT:
+#ifdef CONFIG_WALTER_DEBUG_MODE
+            return debug_set_rat(cmd->rat == DIAG_RAT_NBIOT ? WALTER_MODEM_RAT_NBIOT
+                                                             : WALTER_MODEM_RAT_LTEM);
+#else
+            diag_console_not_built("setrat");
+            return false;
+#endif
+        case DIAG_CMD_AT:
+#ifdef CONFIG_WALTER_DEBUG_MODE
+            send_debug_command(cmd->at, "console");
+            return true;
+#else
+            diag_console_not_built("Raw AT commands");
+            return false;
+#endif
+        case DIAG_CMD_STATS:
+            sampler_log_stats();
+            energy_log_summary();
+            ESP_LOGI(CONSOLE_TAG, "uplink: encoded=%lu sent=%lu failed=%lu refused=%lu deferred=%lu split=%lu max_wait=%lu ms",
+                     (unsigned long)g_pipeline_stats.encoded,
+                     (unsigned long)g_pipeline_stats.sent,
+                     (unsigned long)g_pipeline_stats.failed,
+                     (unsigned long)g_pipeline_stats.rejected,
+                     (unsigned long)g_pipeline_stats.deferred_full,
+                     (unsigned long)g_pipeline_stats.split_too_big,
+                     (unsigned long)g_pipeline_stats.max_queue_wait_ms);
+            ESP_LOGI(CONSOLE_TAG, "sessions: total=%lu today=%lu (%lu uAh) urgent=%lu fill=%lu normal=%lu bulk=%lu",
+                     (unsigned long)g_upload_sched.sessions,
+                     (unsigned long)g_upload_sched.day_sessions,
+                     (unsigned long)g_upload_sched.day_spent_uah,
+                     (unsigned long)g_upload_sched.sessions_by_reason[UPLOAD_REASON_URGENT],
+                     (unsigned long)g_upload_sched.sessions_by_reason[UPLOAD_REASON_FILL],
+                     (unsigned long)g_upload_sched.sessions_by_reason[UPLOAD_REASON_NORMAL],
+                     (unsigned long)g_upload_sched.sessions_by_reason[UPLOAD_REASON_BULK]);
+            ESP_LOGI(CONSOLE_TAG, "tls: profile writes=%lu ca writes=%lu resumption=%s",
+                     (unsigned long)g_tls_stats.profile_writes,
+                     (unsigned long)g_tls_stats.ca_writes,
+                     g_tls_stats.resumption ? "on" : "off");
+            ESP_LOGI(CONSOLE_TAG, "dns: hits=%lu stale=%lu misses=%lu lookups=%lu failed=%lu",
+                     (unsigned long)g_dns_cache.hits,
+                     (unsigned long)g_dns_cache.stale_hits,
+                     (unsigned long)g_dns_cache.misses,
+                     (unsigned long)g_dns_cache.lookups,
+                     (unsigned long)g_dns_cache.lookup_failures);
+            modem_deadline_log_stats();
+#ifdef CONFIG_WALTER_MULTI_UPLINK
+            ESP_LOGI(CONSOLE_TAG, "drains: %lu sent=%lu retries=%lu failed=%lu out-of-order=%lu",
+                     (unsigned long)g_multi_uplink_stats.drains,
+                     (unsigned long)g_multi_uplink_stats.sent,
+                     (unsigned long)g_multi_uplink_stats.retries,
+                     (unsigned long)g_multi_uplink_stats.given_up,
+                     (unsigned long)g_multi_uplink_stats.held);
+#endif
+#ifdef CONFIG_WALTER_DOWNLINK
+            ESP_LOGI(CONSOLE_TAG, "downlink: cfg v%lu bodies=%lu applied=%lu rejected=%lu cmds=%lu failed=%lu "
+                     "refused=%lu untrusted=%lu",
+                     (unsigned long)g_device_config.version,
+                     (unsigned long)g_downlink_stats.bodies,
+                     (unsigned long)g_downlink_stats.configs_applied,
+                     (unsigned long)g_downlink_stats.configs_rejected,
+                     (unsigned long)g_downlink_stats.commands_run,
+                     (unsigned long)g_downlink_stats.commands_failed,
+                     (unsigned long)g_downlink_stats.commands_refused,
+                     (unsigned long)g_downlink_stats.untrusted);
+#endif
+#ifdef CONFIG_WALTER_DELTA_OTA
+            ESP_LOGI(CONSOLE_TAG, "ota: applied=%lu resumed=%lu patch=%lu B image=%lu B",
+                     (unsigned long)g_ota_stats.applied,
+                     (unsigned long)g_ota_stats.resumed,
+                     (unsigned long)g_ota_stats.patch_bytes,
+                     (unsigned long)g_ota_stats.image_bytes);
+#endif
+            return true;
+        case DIAG_CMD_OTA:
+#ifdef CONFIG_WALTER_DELTA_OTA
+            if (!delta_ota_run(cmd->url)) {
+                return false;
+            }
+            esp_restart();
+            return true;
+#else
+            diag_console_not_built("Delta OTA");
+            return false;
+#endif
+        case DIAG_CMD_TRACE:
+#ifdef CONFIG_WALTER_MODEM_TRACE
+            switch (cmd->trace) {
+                case DIAG_TRACE_START:
+                    if (!modem_trace_start()) {
+                        return false;
+                    }
+                    modem_trace_mark("console");
+                    return true;
+                case DIAG_TRACE_STOP:
+                    modem_trace_stop();
+                    return true;
+                case DIAG_TRACE_DUMP:
+                    modem_trace_dump();
+                    return true;
+            }
+            return false;
+#else
+            diag_console_not_built("Modem trace");
+            return false;
+#endif
+        default:
+            return false;
+    }
+}
+
+/**
+ * esp_console handler shared by every command
+ */
+static int diag_console_handler(int argc, char **argv) {
+    if (!g_diag_console_enabled) {
+        ESP_LOGW(CONSOLE_TAG, "Console turned off by configuration");
+        return 1;
+    }
+    diag_command_t cmd;
+    diag_parse_result_t result = diag_command_parse_args(argc, (const char *const *)argv, &cmd);
+    if (result != DIAG_PARSE_OK) {
+        ESP_LOGE(CONSOLE_TAG, "%s: %s", argv[0], diag_parse_result_str(result));
+        return 1;
+    }
+    return diag_console_execute(&cmd) ? 0 : 1;
+}
+
+/**
+ * Start the console REPL on the configured console device
+ */
+static bool diag_console_start(void) {
+    esp_console_repl_t *repl = NULL;
+    esp_console_repl_config_t repl_config = ESP_CONSOLE_REPL_CONFIG_DEFAULT();
+    repl_config.prompt = DIAG_CONSOLE_PROMPT;
+    repl_config.task_stack_size = 6144;
+
+    esp_err_t err = ESP_FAIL;
+#if defined(CONFIG_ESP_CONSOLE_UART_DEFAULT) || defined(CONFIG_ESP_CONSOLE_UART_CUSTOM)
+    esp_console_dev_uart_config_t hw_config = ESP_CONSOLE_DEV_UART_CONFIG_DEFAULT();
+    err = esp_console_new_repl_uart(&hw_config, &repl_config, &repl);
+#elif defined(CONFIG_ESP_CONSOLE_USB_CDC)
+    esp_console_dev_usb_cdc_config_t hw_config = ESP_CONSOLE_DEV_CDC_CONFIG_DEFAULT();
+    err = esp_console_new_repl_usb_cdc(&hw_config, &repl_config, &repl);
+#elif defined(CONFIG_ESP_CONSOLE_USB_SERIAL_JTAG)
+    esp_console_dev_usb_serial_jtag_config_t hw_config = ESP_CONSOLE_DEV_USB_SERIAL_JTAG_CONFIG_DEFAULT();
+    err = esp_console_new_repl_usb_serial_jtag(&hw_config, &repl_config, &repl);
+#endif
+    if (err != ESP_OK) {
+        ESP_LOGE(CONSOLE_TAG, "Failed to create console: %s", esp_err_to_name(err));
+        return false;
+    }
+
+    esp_console_register_help_command();
+    for (size_t i = 0; i < DIAG_COMMAND_COUNT; i++) {
+        esp_console_cmd_t cmd = {};
+        cmd.command = DIAG_COMMANDS[i].name;
+        cmd.help = DIAG_COMMANDS[i].help;
+        cmd.hint = DIAG_COMMANDS[i].hint;
+        cmd.func = &diag_console_handler;
+        esp_console_cmd_register(&cmd);
+    }
+
+    err = esp_console_start_repl(repl);
+    if (err != ESP_OK) {
+        ESP_LOGE(CONSOLE_TAG, "Failed to start console: %s", esp_err_to_name(err));
+        return false;
+    }
+    g_diag_console_enabled = true;
+    ESP_LOGI(CONSOLE_TAG, "Diagnostics console ready, type 'help'");
+    return true;
+}
+
+/**
+ * Follow the "console" configuration key: start the REPL on the first
+ * 0 -> 1, refuse commands while it is 0
+ *
+ * @param started In/out: whether the REPL is running
+ */
+static void diag_console_configure(bool on, bool *started) {
+    if (on && !*started) {
+        *started = diag_console_start();
+    } else if (*started && on != g_diag_console_enabled) {
+        g_diag_console_enabled = on;
+        ESP_LOGI(CONSOLE_TAG, "Diagnostics console %s", on ? "back on" : "off");
+    }
+}
+
+#endif // DIAG_CONSOLE_H
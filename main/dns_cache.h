@@ -0,0 +1,344 @@
+/**
+ * DNS Resolution Cache for Walter Modem
+ *
+ * Keeps hostname -> IPv4 mappings so an upload does not wait for a DNS
+ * round trip over the cellular link. Entries are kept in RAM and NVS, so
+ * a reboot starts with the addresses it had before:
+ *
+ *   fresh    younger than DNS_REFRESH_PCT of the TTL, used as is
+ *   stale    older, still used, and refreshed after the next upload
+ *            session (off the upload path, while the radio is still up)
+ *   expired  past TTL + DNS_MAX_STALE_S, resolved before use
+ *
+ * AT+SQNDNSLKUP does not report the record TTL, so every entry gets
+ * DNS_DEFAULT_TTL_S, an assumption; the stale window is kept to hours so
+ * a moved server is picked up the same day.
+ *
+ * Connecting to an address makes the modem send it as the Host header,
+ * which name-based virtual hosts reject, so firmware only does it with
+ * CONFIG_WALTER_DNS_CONNECT_BY_IP. Otherwise dns_resolve() declines and
+ * the profile keeps the host name.
+ *
+ * The cache logic has no ESP-IDF dependencies.
+ */
+
+#ifndef DNS_CACHE_H
+#define DNS_CACHE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define DNS_CACHE_SLOTS 4
+#define DNS_HOST_MAX 64
+#define DNS_DEFAULT_TTL_S 3600
+#define DNS_REFRESH_PCT 80
+#define DNS_MAX_STALE_S (4 * 3600)
+
+typedef enum {
+    DNS_STATE_MISS = 0,
+    DNS_STATE_FRESH,
+    DNS_STATE_STALE,        // Usable, refresh due
+    DNS_STATE_EXPIRED,      // Too old to trust
+} dns_state_t;
+
+typedef struct {
+    char host[DNS_HOST_MAX];
+    uint32_t ipv4;          // Host byte order, 0 = empty slot
+    uint32_t ttl_s;
+    int64_t resolved_ms;    // Monotonic time of the lookup
+} dns_entry_t;
+
+typedef struct {
+    dns_entry_t entries[DNS_CACHE_SLOTS];
+    uint32_t hits;
+    uint32_t stale_hits;
+    uint32_t misses;
+    uint32_t lookups;
+    uint32_t lookup_failures;
+} dns_cache_t;
+
+static inline void dns_format_ipv4(uint32_t ip, char *buf, size_t len) {
+    snprintf(buf, len, "%u.%u.%u.%u", (unsigned)(ip >> 24), (unsigned)((ip >> 16) & 0xff),
+             (unsigned)((ip >> 8) & 0xff), (unsigned)(ip & 0xff));
+}
+
+static dns_entry_t *dns_cache_find(dns_cache_t *cache, const char *host) {
+    for (int i = 0; i < DNS_CACHE_SLOTS; i++) {
+        dns_entry_t *e = &cache->entries[i];
+        if (e->ipv4 != 0 && strcmp(e->host, host) == 0) {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+static dns_state_t dns_entry_state(const dns_entry_t *e, int64_t now_ms) {
+    if (e == NULL) {
+        return DNS_STATE_MISS;
+    }
+    int64_t age_ms = now_ms - e->resolved_ms;
+    if (age_ms < (int64_t)e->ttl_s * 10 * DNS_REFRESH_PCT) {
+        return DNS_STATE_FRESH;
+    }
+    if (age_ms < ((int64_t)e->ttl_s + DNS_MAX_STALE_S) * 1000) {
+        return DNS_STATE_STALE;
+    }
+    return DNS_STATE_EXPIRED;
+}
+
+/**
+ * Insert or update a mapping, replacing the oldest entry when full
+ *
+ * @return true if the cache contents changed
+ */
+static bool dns_cache_store(dns_cache_t *cache, const char *host, uint32_t ipv4,
+                            uint32_t ttl_s, int64_t now_ms) {
+    if (strlen(host) >= DNS_HOST_MAX || ipv4 == 0) {
+        return false;
+    }
+    dns_entry_t *e = dns_cache_find(cache, host);
+    bool changed = e == NULL || e->ipv4 != ipv4;
+    if (e == NULL) {
+        e = &cache->entries[0];
+        for (int i = 0; i < DNS_CACHE_SLOTS; i++) {
+            dns_entry_t *c = &cache->entries[i];
+            if (c->ipv4 == 0) {
+                e = c;
+                break;
+            }
+            if (c->resolved_ms < e->resolved_ms) {
+                e = c;
+            }
+        }
+        strcpy(e->host, host);
+    }
+    e->ipv4 = ipv4;
+    e->ttl_s = ttl_s;
+    e->resolved_ms = now_ms;
+    return changed;
+}
+
+/**
+ * Entry that should be refreshed next, or NULL if none is due
+ */
+static dns_entry_t *dns_cache_due(dns_cache_t *cache, int64_t now_ms) {
+    dns_entry_t *due = NULL;
+    for (int i = 0; i < DNS_CACHE_SLOTS; i++) {
+        dns_entry_t *e = &cache->entries[i];
+        if (e->ipv4 != 0 && dns_entry_state(e, now_ms) != DNS_STATE_FRESH &&
+            (due == NULL || e->resolved_ms < due->resolved_ms)) {
+            due = e;
+        }
+    }
+    return due;
+}
+
+#ifdef ESP_PLATFORM
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <nvs.h>
+#include <sdkconfig.h>
+#include <WalterModem.h>
+#include "at_response.h"
+#include "modem_deadline.h"
+#include "time_service.h"
+
+extern WalterModem modem;
+
+static const char *DNS_TAG = "dns";
+
+#define DNS_NVS_NAMESPACE "walter"
+#define DNS_NVS_KEY "dns_cache"
+
+/**
+ * NVS form of an entry: monotonic time means nothing after a reboot, so
+ * the lookup time is stored as epoch seconds (0 if network time was unknown)
+ */
+typedef struct {
+    char host[DNS_HOST_MAX];
+    uint32_t ipv4;
+    uint32_t ttl_s;
+    int64_t resolved_epoch_s;
+} dns_record_t;
+
+// Used from the modem core only (uplink task, app_main)
+static dns_cache_t g_dns_cache = {};
+static at_capture_t g_dns_capture;
+
+static inline int64_t dns_now_ms(void) {
+    return esp_timer_get_time() / 1000;
+}
+
+static void dns_cache_save(void) {
+    dns_record_t records[DNS_CACHE_SLOTS] = {};
+    int64_t now_ms = dns_now_ms();
+    int64_t now_epoch_ms = time_service_now_epoch_ms();
+    for (int i = 0; i < DNS_CACHE_SLOTS; i++) {
+        const dns_entry_t *e = &g_dns_cache.entries[i];
+        memcpy(records[i].host, e->host, sizeof(records[i].host));
+        records[i].ipv4 = e->ipv4;
+        records[i].ttl_s = e->ttl_s;
+        if (now_epoch_ms != 0) {
+            records[i].resolved_epoch_s = (now_epoch_ms - (now_ms - e->resolved_ms)) / 1000;
+        }
+    }
+
+    nvs_handle_t handle;
+    if (nvs_open(DNS_NVS_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) {
+        return;
+    }
+    if (nvs_set_blob(handle, DNS_NVS_KEY, records, sizeof(records)) == ESP_OK) {
+        nvs_commit(handle);
+    }
+    nvs_close(handle);
+}
+
+/**
+ * Load the persisted cache (call after time_service_init())
+ *
+ * Entries whose age cannot be worked out (no network time yet) are
+ * treated as due for refresh but still usable.
+ */
+static void dns_cache_init(void) {
+    dns_record_t records[DNS_CACHE_SLOTS] = {};
+    size_t len = sizeof(records);
+    nvs_handle_t handle;
+    if (nvs_open(DNS_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        return;
+    }
+    bool loaded = nvs_get_blob(handle, DNS_NVS_KEY, records, &len) == ESP_OK &&
+                  len == sizeof(records);
+    nvs_close(handle);
+    if (!loaded) {
+        return;
+    }
+
+    int64_t now_ms = dns_now_ms();
+    int64_t now_epoch_ms = time_service_now_epoch_ms();
+    int count = 0;
+    for (int i = 0; i < DNS_CACHE_SLOTS; i++) {
+        const dns_record_t *r = &records[i];
+        if (r->ipv4 == 0 || r->host[DNS_HOST_MAX - 1] != '\0') {
+            continue;
+        }
+        dns_entry_t *e = &g_dns_cache.entries[i];
+        memcpy(e->host, r->host, sizeof(e->host));
+        e->ipv4 = r->ipv4;
+        e->ttl_s = r->ttl_s;
+        if (now_epoch_ms != 0 && r->resolved_epoch_s != 0) {
+            e->resolved_ms = now_ms - (now_epoch_ms - r->resolved_epoch_s * 1000);
+        } else {
+            e->resolved_ms = now_ms - (int64_t)e->ttl_s * 10 * DNS_REFRESH_PCT;
+        }
+        count++;
+    }
+    ESP_LOGI(DNS_TAG, "Loaded %d cached addresses", count);
+}
+
+/**
+ * Resolve through the modem (AT+SQNDNSLKUP)
+ *
+ * Goes through modem_call() so it takes a call slot and is counted with
+ * the other queries. sendCmd() has no callback form, so the library's
+ * own command timeout still bounds it, not the QUERY budget.
+ */
+static bool dns_modem_lookup(const char *host, uint32_t *ipv4) {
+    char cmd[32 + DNS_HOST_MAX];
+    snprintf(cmd, sizeof(cmd), "AT+SQNDNSLKUP=\"%s\"", host);
+
+    g_dns_cache.lookups++;
+    at_capture_reset(&g_dns_capture);
+    g_at_tap_capture = &g_dns_capture;
+    bool ok = modem_call(MODEM_CLASS_QUERY, "dnsLookup", NULL, [&](walterModemCb cb, void *arg) {
+        WalterModemRsp rsp = {};
+        rsp.result = modem.sendCmd(cmd, NULL, &rsp) ? WALTER_MODEM_STATE_OK
+                                                    : WALTER_MODEM_STATE_ERROR;
+        cb(&rsp, arg);
+        return true;
+    });
+    g_at_tap_capture = NULL;
+
+    for (int i = 0; ok && i < g_dns_capture.count; i++) {
+        at_sqndnslkup_t result;
+        if (at_parse_sqndnslkup(at_capture_line(&g_dns_capture, i), &result)) {
+            *ipv4 = result.ipv4;
+            return true;
+        }
+    }
+    g_dns_cache.lookup_failures++;
+    return false;
+}
+
+static bool dns_lookup_and_store(const char *host, uint32_t *ipv4) {
+    if (!dns_modem_lookup(host, ipv4)) {
+        return false;
+    }
+    if (dns_cache_store(&g_dns_cache, host, *ipv4, DNS_DEFAULT_TTL_S, dns_now_ms())) {
+        dns_cache_save();
+    }
+    return true;
+}
+
+/**
+ * Address to connect to for a host
+ *
+ * Serves fresh and stale entries from the cache and only blocks on a
+ * lookup for unknown or expired hosts.
+ *
+ * @return false if the host could not be resolved, or connecting by
+ *         address is not enabled (connect by name instead)
+ */
+static bool dns_resolve(const char *host, char *ip_buf, size_t len) {
+#ifndef CONFIG_WALTER_DNS_CONNECT_BY_IP
+    return false;
+#endif
+    dns_entry_t *e = dns_cache_find(&g_dns_cache, host);
+    uint32_t ipv4 = 0;
+    switch (dns_entry_state(e, dns_now_ms())) {
+        case DNS_STATE_FRESH:
+            g_dns_cache.hits++;
+            ipv4 = e->ipv4;
+            break;
+        case DNS_STATE_STALE:
+            g_dns_cache.stale_hits++;   // Refreshed by dns_cache_refresh()
+            ipv4 = e->ipv4;
+            break;
+        default:
+            g_dns_cache.misses++;
+            if (!dns_lookup_and_store(host, &ipv4)) {
+                ESP_LOGW(DNS_TAG, "Could not resolve %s", host);
+                return false;
+            }
+            break;
+    }
+    dns_format_ipv4(ipv4, ip_buf, len);
+    return true;
+}
+
+/**
+ * Refresh one entry that is past its refresh point
+ *
+ * Call right after a successful upload session, while the radio is still
+ * connected.
+ */
+static void dns_cache_refresh(void) {
+#ifndef CONFIG_WALTER_DNS_CONNECT_BY_IP
+    return;
+#endif
+    dns_entry_t *e = dns_cache_due(&g_dns_cache, dns_now_ms());
+    if (e == NULL) {
+        return;
+    }
+    char host[DNS_HOST_MAX];
+    strcpy(host, e->host);
+    uint32_t ipv4;
+    if (dns_lookup_and_store(host, &ipv4)) {
+        ESP_LOGI(DNS_TAG, "Refreshed %s", host);
+    }
+}
+
+#endif // ESP_PLATFORM
+
+#endif // DNS_CACHE_H
@@ -0,0 +1,228 @@
+/**
+ * Downlink Channel for Walter Modem
+ *
+ * Configuration changes and commands for the device ride on the responses
+ * to its own uploads, so they cost no extra radio session and no extra
+ * wakeup: the server answers a POST with a body like
+ *
+ *   WDL1
+ *   cfg 7 base=6 smp=30000 bulk=21600000
+ *   cmd 41 stats
+ *   cmd 42 trace start
+ *
+ * "cfg" is a configuration delta (device_config.h), applied atomically.
+ * "cmd" lines are diagnostics console commands (diag_command.h) with an
+ * increasing id; each id is accepted once, and recorded before it runs,
+ * so a response delivered twice, or a command that restarts the device,
+ * does not run it again. Every upload carries "cfg": [version, last
+ * command] (device_config_add_to_json), which is how the server learns
+ * that a change arrived.
+ *
+ * Bodies without the WDL1 first line are not downlinks and are ignored;
+ * unknown line types are skipped, so newer servers can add them.
+ *
+ * A downlink can change the APN or run "at" and "ota", so it is only
+ * taken from a server the modem authenticated (HTTPS with the CA
+ * validated); the caller says whether the response came from one.
+ * Commands also need the "console" configuration key: with console=0 they
+ * are accepted (and recorded) but not run.
+ *
+ * Parsing has no ESP-IDF dependencies.
+ */
+
+#ifndef DOWNLINK_H
+#define DOWNLINK_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "device_config.h"
+#include "diag_command.h"
+
+#define DOWNLINK_MAGIC "WDL1"
+#define DOWNLINK_BODY_MAX 256           // Largest response body looked at
+#define DOWNLINK_MAX_CMDS 4
+
+typedef struct {
+    uint32_t id;
+    char *line;                         // Console command, points into the body
+} downlink_cmd_line_t;
+
+typedef struct {
+    char *cfg;                          // Delta after "cfg ", NULL if none
+    downlink_cmd_line_t cmds[DOWNLINK_MAX_CMDS];
+    uint8_t cmd_count;
+    uint8_t skipped;                    // Unknown or surplus lines
+} downlink_t;
+
+/**
+ * Split a response body into its cfg and cmd lines
+ *
+ * @param body NUL-terminated body, split in place
+ * @return false if the body is not a downlink
+ */
+static bool downlink_parse(char *body, downlink_t *out) {
+    memset(out, 0, sizeof(*out));
+    size_t magic_len = strlen(DOWNLINK_MAGIC);
+    if (strncmp(body, DOWNLINK_MAGIC, magic_len) != 0 ||
+        (body[magic_len] != '\n' && body[magic_len] != '\r' && body[magic_len] != '\0')) {
+        return false;
+    }
+
+    char *save = NULL;
+    for (char *line = strtok_r(body + magic_len, "\r\n", &save); line != NULL;
+         line = strtok_r(NULL, "\r\n", &save)) {
+        if (strncmp(line, "cfg ", 4) == 0 && out->cfg == NULL) {
+            out->cfg = line + 4;
+        } else if (strncmp(line, "cmd ", 4) == 0 && out->cmd_count < DOWNLINK_MAX_CMDS) {
+            char *end;
+            unsigned long id = strtoul(line + 4, &end, 10);
+            if (end == line + 4 || *end != ' ' || id == 0 || id > UINT32_MAX) {
+                out->skipped++;
+                continue;
+            }
+            out->cmds[out->cmd_count].id = (uint32_t)id;
+            out->cmds[out->cmd_count].line = end + 1;
+            out->cmd_count++;
+        } else {
+            out->skipped++;
+        }
+    }
+    return true;
+}
+
+#ifdef ESP_PLATFORM
+
+#include <esp_log.h>
+#include <freertos/FreeRTOS.h>
+
+static const char *DOWNLINK_TAG = "downlink";
+
+typedef struct {
+    uint32_t bodies;                    // Responses that carried a downlink
+    uint32_t configs_applied;
+    uint32_t configs_rejected;          // Invalid deltas (stale ones are not counted)
+    uint32_t commands_run;
+    uint32_t commands_failed;           // Did not parse, or failed / not in this build
+    uint32_t commands_refused;          // Console turned off by configuration
+    uint32_t untrusted;                 // Downlinks from a server that was not authenticated
+} downlink_stats_t;
+
+static downlink_stats_t g_downlink_stats = {};
+
+// Runs a console command; set by app_main when the console is built in
+static bool (*g_downlink_executor)(const diag_command_t *cmd) = NULL;
+
+typedef struct {
+    uint32_t id;
+    diag_command_t cmd;
+} downlink_pending_t;
+
+// Accepted commands, run after the upload session (MODEM core only)
+static downlink_pending_t g_downlink_pending[DOWNLINK_MAX_CMDS];
+static uint8_t g_downlink_pending_count = 0;
+
+static void downlink_apply_cfg(char *delta) {
+    device_config_result_t result = device_config_update(delta);
+    if (result == DEVICE_CONFIG_OK) {
+        g_downlink_stats.configs_applied++;
+    } else if (result != DEVICE_CONFIG_STALE) {
+        g_downlink_stats.configs_rejected++;
+        ESP_LOGW(DOWNLINK_TAG, "Config delta rejected: %s", DEVICE_CONFIG_RESULT_NAMES[result]);
+    }
+}
+
+static void downlink_accept_cmds(const downlink_t *dl) {
+    device_config_t cfg;
+    device_config_get(&cfg);
+    uint32_t last = cfg.last_cmd;
+    for (uint8_t i = 0; i < dl->cmd_count; i++) {
+        const downlink_cmd_line_t *c = &dl->cmds[i];
+        if (c->id <= last) {
+            continue;               // Already seen, e.g. the same response again
+        }
+        last = c->id;
+        if (g_downlink_pending_count == DOWNLINK_MAX_CMDS) {
+            g_downlink_stats.commands_failed++;
+            ESP_LOGW(DOWNLINK_TAG, "Command %lu: queue full", (unsigned long)c->id);
+            continue;
+        }
+        downlink_pending_t *p = &g_downlink_pending[g_downlink_pending_count];
+        diag_parse_result_t parsed = diag_command_parse_line(c->line, &p->cmd);
+        if (parsed != DIAG_PARSE_OK) {
+            g_downlink_stats.commands_failed++;
+            ESP_LOGW(DOWNLINK_TAG, "Command %lu: %s", (unsigned long)c->id,
+                     diag_parse_result_str(parsed));
+            continue;
+        }
+        p->id = c->id;
+        g_downlink_pending_count++;
+    }
+    if (last != cfg.last_cmd && !device_config_set_last_cmd(last)) {
+        // Not recorded: running now could run them again after a reset
+        ESP_LOGE(DOWNLINK_TAG, "Failed to record command %lu, dropping", (unsigned long)last);
+        g_downlink_pending_count = 0;
+    }
+}
+
+/**
+ * Look at one upload response (MODEM core)
+ *
+ * Configuration is applied right away; commands are queued for
+ * downlink_run_commands() so they do not run in the middle of a session.
+ *
+ * @param trusted The response came over a CA-validated HTTPS session
+ */
+static void downlink_feed(const uint8_t *body, size_t len, bool trusted) {
+    static char buf[DOWNLINK_BODY_MAX + 1];
+    if (body == NULL || len == 0) {
+        return;
+    }
+    len = len < DOWNLINK_BODY_MAX ? len : DOWNLINK_BODY_MAX;
+    memcpy(buf, body, len);
+    buf[len] = '\0';
+
+    downlink_t dl;
+    if (!downlink_parse(buf, &dl)) {
+        return;
+    }
+    if (!trusted) {
+        g_downlink_stats.untrusted++;
+        ESP_LOGW(DOWNLINK_TAG, "Ignoring downlink from a server that was not authenticated");
+        return;
+    }
+    g_downlink_stats.bodies++;
+    if (dl.cfg != NULL) {
+        downlink_apply_cfg(dl.cfg);
+    }
+    if (dl.cmd_count > 0) {
+        downlink_accept_cmds(&dl);
+    }
+}
+
+/**
+ * Run the commands accepted during the session that just ended (MODEM core)
+ */
+static void downlink_run_commands(void) {
+    device_config_t cfg;
+    device_config_get(&cfg);
+    for (uint8_t i = 0; i < g_downlink_pending_count; i++) {
+        const downlink_pending_t *p = &g_downlink_pending[i];
+        if (!cfg.console) {
+            g_downlink_stats.commands_refused++;
+            ESP_LOGW(DOWNLINK_TAG, "Command %lu not run, console turned off", (unsigned long)p->id);
+            continue;
+        }
+        ESP_LOGI(DOWNLINK_TAG, "Running command %lu", (unsigned long)p->id);
+        if (g_downlink_executor != NULL && g_downlink_executor(&p->cmd)) {
+            g_downlink_stats.commands_run++;
+        } else {
+            g_downlink_stats.commands_failed++;
+        }
+    }
+    g_downlink_pending_count = 0;
+}
+
+#endif // ESP_PLATFORM
+
+#endif // DOWNLINK_H
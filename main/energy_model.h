@@ -0,0 +1,294 @@
+/**
+ * Radio Energy Accounting for Walter Modem
+ *
+ * Tracks how long the modem and the MCU spend in each power state and
+ * integrates that against configurable current figures, giving charge
+ * (mAh) per power state, per activity (connect stage, upload, idle), per
+ * uploaded byte and per sample. The numbers go out with every telemetry
+ * batch so firmware changes can be compared by energy per sample.
+ *
+ * The accounting core takes explicit timestamps and has no ESP-IDF
+ * dependencies; the ESP section below feeds it esp_timer time.
+ */
+
+#ifndef ENERGY_MODEL_H
+#define ENERGY_MODEL_H
+
+#include <stdint.h>
+#include <string.h>
+#include "boot_waterfall.h"
+
+/**
+ * Modem power states
+ */
+typedef enum {
+    ENERGY_MODEM_MINIMUM = 0,   // CFUN=0, RF off
+    ENERGY_MODEM_SEARCHING,     // CFUN=1, cell search / registration
+    ENERGY_MODEM_IDLE,          // Registered, RRC idle (paging only)
+    ENERGY_MODEM_CONNECTED,     // RRC connected, no data moving
+    ENERGY_MODEM_TX,            // Uploading
+    ENERGY_MODEM_PSM,           // Power saving mode
+    ENERGY_MODEM_STATE_COUNT
+} energy_modem_state_t;
+
+/**
+ * MCU power states
+ */
+typedef enum {
+    ENERGY_MCU_ACTIVE = 0,
+    ENERGY_MCU_LIGHT_SLEEP,
+    ENERGY_MCU_DEEP_SLEEP,
+    ENERGY_MCU_STATE_COUNT
+} energy_mcu_state_t;
+
+/**
+ * What the device is doing; charge is attributed to the current activity.
+ * The first BOOT_STAGE_COUNT values are the connect stages.
+ */
+#define ENERGY_ACT_UPLOAD (BOOT_STAGE_COUNT)
+#define ENERGY_ACT_IDLE (BOOT_STAGE_COUNT + 1)
+#define ENERGY_ACT_COUNT (BOOT_STAGE_COUNT + 2)
+
+static const char *const ENERGY_MODEM_STATE_NAMES[ENERGY_MODEM_STATE_COUNT] = {
+    "minimum", "searching", "idle", "connected", "tx", "psm",
+};
+
+/**
+ * Current draw per state in µA (board level, 3.3 V rail)
+ *
+ * Defaults are typical GM02S / ESP32-S3 figures; calibrate against a
+ * power analyser for the actual board and network.
+ */
+typedef struct {
+    uint32_t modem_ua[ENERGY_MODEM_STATE_COUNT];
+    uint32_t mcu_ua[ENERGY_MCU_STATE_COUNT];
+    uint32_t rrc_tail_ms;       // Connected -> idle inactivity timer after traffic
+} energy_profile_t;
+
+static const energy_profile_t ENERGY_PROFILE_DEFAULT = {
+    { 500, 60000, 1500, 30000, 150000, 3 },
+    { 40000, 250, 10 },
+    10000,
+};
+
+/**
+ * Accumulated charge, in µA·ms (1 mAh = 3.6e9 µA·ms)
+ */
+typedef struct {
+    energy_profile_t profile;
+    energy_modem_state_t modem_state;
+    energy_mcu_state_t mcu_state;
+    int activity;
+    int64_t last_us;
+    int64_t tail_end_us;        // When CONNECTED falls back to IDLE
+    uint64_t modem_ms[ENERGY_MODEM_STATE_COUNT];
+    uint64_t modem_charge[ENERGY_MODEM_STATE_COUNT];
+    uint64_t mcu_charge[ENERGY_MCU_STATE_COUNT];
+    uint64_t activity_charge[ENERGY_ACT_COUNT];
+    uint64_t uploaded_bytes;
+    uint32_t uploads;
+} energy_account_t;
+
+#define ENERGY_UAMS_PER_MAH 3600000000.0
+
+static void energy_account_init(energy_account_t *acc, const energy_profile_t *profile,
+                                int64_t now_us) {
+    memset(acc, 0, sizeof(*acc));
+    acc->profile = profile != NULL ? *profile : ENERGY_PROFILE_DEFAULT;
+    acc->modem_state = ENERGY_MODEM_SEARCHING;
+    acc->mcu_state = ENERGY_MCU_ACTIVE;
+    acc->activity = ENERGY_ACT_IDLE;
+    acc->last_us = now_us;
+}
+
+static void energy_account_charge(energy_account_t *acc, int64_t from_us, int64_t to_us) {
+    if (to_us <= from_us) {
+        return;
+    }
+    uint64_t ms = (uint64_t)(to_us - from_us) / 1000;
+    uint64_t modem = ms * acc->profile.modem_ua[acc->modem_state];
+    uint64_t mcu = ms * acc->profile.mcu_ua[acc->mcu_state];
+    acc->modem_ms[acc->modem_state] += ms;
+    acc->modem_charge[acc->modem_state] += modem;
+    acc->mcu_charge[acc->mcu_state] += mcu;
+    acc->activity_charge[acc->activity] += modem + mcu;
+}
+
+/**
+ * Bring the account up to now (call before every state change and report)
+ */
+static void energy_account_advance(energy_account_t *acc, int64_t now_us) {
+    if (acc->modem_state == ENERGY_MODEM_CONNECTED && acc->tail_end_us != 0 &&
+        now_us > acc->tail_end_us) {
+        // RRC inactivity timer expired somewhere in this interval
+        energy_account_charge(acc, acc->last_us, acc->tail_end_us);
+        acc->last_us = acc->tail_end_us;
+        acc->modem_state = ENERGY_MODEM_IDLE;
+        acc->tail_end_us = 0;
+    }
+    energy_account_charge(acc, acc->last_us, now_us);
+    if (now_us > acc->last_us) {
+        acc->last_us = now_us;
+    }
+}
+
+static void energy_account_set_modem(energy_account_t *acc, energy_modem_state_t state,
+                                     int64_t now_us) {
+    energy_account_advance(acc, now_us);
+    acc->modem_state = state;
+    acc->tail_end_us = state == ENERGY_MODEM_CONNECTED
+                           ? now_us + (int64_t)acc->profile.rrc_tail_ms * 1000 : 0;
+}
+
+static void energy_account_set_mcu(energy_account_t *acc, energy_mcu_state_t state,
+                                   int64_t now_us) {
+    energy_account_advance(acc, now_us);
+    acc->mcu_state = state;
+}
+
+static void energy_account_set_activity(energy_account_t *acc, int activity, int64_t now_us) {
+    energy_account_advance(acc, now_us);
+    acc->activity = activity;
+}
+
+static void energy_account_record_upload(energy_account_t *acc, uint32_t bytes) {
+    acc->uploaded_bytes += bytes;
+    acc->uploads++;
+}
+
+static inline uint64_t energy_account_total(const energy_account_t *acc) {
+    uint64_t total = 0;
+    for (int i = 0; i < ENERGY_MODEM_STATE_COUNT; i++) total += acc->modem_charge[i];
+    for (int i = 0; i < ENERGY_MCU_STATE_COUNT; i++) total += acc->mcu_charge[i];
+    return total;
+}
+
+static inline double energy_to_mah(uint64_t charge_uams) {
+    return (double)charge_uams / ENERGY_UAMS_PER_MAH;
+}
+
+/**
+ * Upload charge per uploaded byte, in µAh
+ */
+static inline double energy_account_uah_per_byte(const energy_account_t *acc) {
+    if (acc->uploaded_bytes == 0) {
+        return 0;
+    }
+    return energy_to_mah(acc->activity_charge[ENERGY_ACT_UPLOAD]) * 1000.0 /
+           (double)acc->uploaded_bytes;
+}
+
+#ifdef ESP_PLATFORM
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <cJSON.h>
+#include <freertos/FreeRTOS.h>
+
+static const char *ENERGY_TAG = "energy";
+
+static energy_account_t g_energy = {};
+static portMUX_TYPE g_energy_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void energy_init(const energy_profile_t *profile) {
+    energy_account_init(&g_energy, profile, esp_timer_get_time());
+}
+
+static void energy_modem_state(energy_modem_state_t state) {
+    taskENTER_CRITICAL(&g_energy_lock);
+    energy_account_set_modem(&g_energy, state, esp_timer_get_time());
+    taskEXIT_CRITICAL(&g_energy_lock);
+}
+
+static void energy_mcu_state(energy_mcu_state_t state) {
+    taskENTER_CRITICAL(&g_energy_lock);
+    energy_account_set_mcu(&g_energy, state, esp_timer_get_time());
+    taskEXIT_CRITICAL(&g_energy_lock);
+}
+
+static void energy_activity(int activity) {
+    taskENTER_CRITICAL(&g_energy_lock);
+    energy_account_set_activity(&g_energy, activity, esp_timer_get_time());
+    taskEXIT_CRITICAL(&g_energy_lock);
+}
+
+static void energy_record_upload(uint32_t bytes) {
+    taskENTER_CRITICAL(&g_energy_lock);
+    energy_account_record_upload(&g_energy, bytes);
+    taskEXIT_CRITICAL(&g_energy_lock);
+}
+
+/**
+ * Consistent copy of the account, advanced to now
+ */
+static void energy_snapshot(energy_account_t *out) {
+    taskENTER_CRITICAL(&g_energy_lock);
+    energy_account_advance(&g_energy, esp_timer_get_time());
+    *out = g_energy;
+    taskEXIT_CRITICAL(&g_energy_lock);
+}
+
+/**
+ * Charge attributed to uploads so far, in µAh
+ */
+static uint32_t energy_upload_uah(void) {
+    taskENTER_CRITICAL(&g_energy_lock);
+    energy_account_advance(&g_energy, esp_timer_get_time());
+    uint64_t charge = g_energy.activity_charge[ENERGY_ACT_UPLOAD];
+    taskEXIT_CRITICAL(&g_energy_lock);
+    return (uint32_t)(charge / 3600000);
+}
+
+/**
+ * Add an "energy" object to a telemetry payload
+ *
+ * {"mAh": total, "uAh_B": upload µAh per byte, "uAh_smp": µAh per sample,
+ *  "s": [seconds per modem state], "act": [µAh per connect stage..., upload, idle]}
+ */
+static void energy_add_to_json(cJSON *root, uint32_t samples) {
+    energy_account_t snap;
+    energy_snapshot(&snap);
+
+    cJSON *obj = cJSON_CreateObject();
+    if (obj == NULL) {
+        return;
+    }
+    double total_mah = energy_to_mah(energy_account_total(&snap));
+    cJSON_AddNumberToObject(obj, "mAh", (double)(int64_t)(total_mah * 1000) / 1000);
+    cJSON_AddNumberToObject(obj, "uAh_B", (double)(int64_t)(energy_account_uah_per_byte(&snap) * 100) / 100);
+    cJSON_AddNumberToObject(obj, "uAh_smp",
+                            samples ? (double)(int64_t)(total_mah * 1000 / samples) : 0);
+
+    cJSON *seconds = cJSON_CreateArray();
+    for (int i = 0; i < ENERGY_MODEM_STATE_COUNT; i++) {
+        cJSON_AddItemToArray(seconds, cJSON_CreateNumber((double)(snap.modem_ms[i] / 1000)));
+    }
+    cJSON_AddItemToObject(obj, "s", seconds);
+
+    cJSON *activity = cJSON_CreateArray();
+    for (int i = 0; i < ENERGY_ACT_COUNT; i++) {
+        cJSON_AddItemToArray(activity,
+                             cJSON_CreateNumber((double)(int64_t)(energy_to_mah(snap.activity_charge[i]) * 1000)));
+    }
+    cJSON_AddItemToObject(obj, "act", activity);
+    cJSON_AddItemToObject(root, "energy", obj);
+}
+
+static void energy_log_summary(void) {
+    energy_account_t snap;
+    energy_snapshot(&snap);
+    ESP_LOGI(ENERGY_TAG, "Total %.3f mAh, %lu uploads, %llu bytes, %.2f uAh/byte",
+             energy_to_mah(energy_account_total(&snap)), (unsigned long)snap.uploads,
+             (unsigned long long)snap.uploaded_bytes, energy_account_uah_per_byte(&snap));
+    for (int i = 0; i < ENERGY_MODEM_STATE_COUNT; i++) {
+        if (snap.modem_ms[i] > 0) {
+            ESP_LOGI(ENERGY_TAG, "  %-10s %8llu s %9.3f mAh", ENERGY_MODEM_STATE_NAMES[i],
+                     (unsigned long long)(snap.modem_ms[i] / 1000),
+                     energy_to_mah(snap.modem_charge[i]));
+        }
+    }
+}
+
+#endif // ESP_PLATFORM
+
+#endif // ENERGY_MODEL_H
@@ -10,67 +10,200 @@
 #include <esp_log.h>
 #include <WalterModem.h>
 #include <cJSON.h>
+#include <sdkconfig.h>
 #include <string.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "boot_waterfall.h"
+#include "device_config.h"
+#include "dns_cache.h"
+#include "energy_model.h"
+#include "modem_deadline.h"
+#include "sensor_sampler.h"
+#include "time_service.h"
+#include "tls_profile.h"
 
 // External reference to modem instance
 extern WalterModem modem;
 
 static const char *HTTP_TAG = "http_json";
 
+#define HTTP_DEVICE_ID "walter-001"         // Device identifier in uploaded payloads
+
+#define HTTP_RESPONSE_TIMEOUT_MS 30000
+#define HTTP_RESPONSE_POLL_MS 200
+#define HTTP_SEND_COPY_MAX 1024             // send_json_http() payloads
+#define HTTP_STALE_MS 15000                 // Wait for a late ring before the profile is reused
+
+// Last request that missed its deadline: the modem may still read its data
+static modem_call_ticket_t g_http_send_pending = {};
+
+// A response timed out: its ring may still come on the profile
+static bool g_http_ring_stale = false;
+static uint32_t g_http_ring_resets = 0;     // g_modem_deadline.resets when it went stale
+
+/**
+ * Discard the ring of a request whose response timed out
+ *
+ * Otherwise the next request would take that ring for its own answer.
+ * Gives up after HTTP_STALE_MS (the answer is then taken as lost) or
+ * when the modem was reset in between.
+ */
+static void http_drain_stale(void) {
+    for (uint32_t waited = 0; g_http_ring_stale; waited += HTTP_RESPONSE_POLL_MS) {
+        static uint8_t discard[16];
+        WalterModemRsp rsp = {};
+        if (modem.httpDidRing(TLS_HTTP_PROFILE_ID, discard, sizeof(discard), &rsp)) {
+            ESP_LOGW(HTTP_TAG, "Late HTTP %u discarded", (unsigned)rsp.data.httpResponse.httpStatus);
+            g_http_ring_stale = false;
+        } else if (waited >= HTTP_STALE_MS || modem_deadline_resets() != g_http_ring_resets) {
+            g_http_ring_stale = false;
+        } else {
+            vTaskDelay(pdMS_TO_TICKS(HTTP_RESPONSE_POLL_MS));
+        }
+    }
+}
+
+static void http_mark_stale(void) {
+    g_http_ring_stale = true;
+    g_http_ring_resets = modem_deadline_resets();
+}
+
 /**
- * Send JSON data via HTTP POST
+ * POST JSON and wait for the server's response
+ * 
+ * https:// URLs go through the modem TLS profile (see tls_profile.h).
+ * Plain http:// hosts are resolved through the DNS cache (dns_cache.h)
+ * with CONFIG_WALTER_DNS_CONNECT_BY_IP; HTTPS keeps the host name, which
+ * the certificate is checked against.
+ * 
+ * If the modem does not take the request within the HTTP deadline, it may
+ * still read json_data later, so the data must stay valid until then: no
+ * new request is sent until the late answer came in or the modem was
+ * reset. The pipeline keeps a failed payload queued, so its slot stays.
+ * A response that times out leaves the profile stale: its late ring is
+ * discarded before the next request, so it is not taken for that one's.
  * 
- * @param url The URL to send data to (e.g., "http://httpbin.org/post")
+ * @param url The URL to send data to (e.g., "https://httpbin.org/post")
  * @param json_data The JSON string to send
- * @return true on success, false on error
+ * @param rsp_body Receives the response body (may be NULL)
+ * @param rsp_size Size of rsp_body
+ * @param rsp_len Receives the body length (may be NULL)
+ * @return HTTP status of the response, 0 if there was none
  */
-static bool send_json_http(const char* url, const char* json_data) {
+static uint16_t http_post_json(const char* url, const char* json_data, uint8_t* rsp_body,
+                               uint16_t rsp_size, uint16_t* rsp_len) {
     if (url == NULL || json_data == NULL) {
         ESP_LOGE(HTTP_TAG, "Invalid parameters");
-        return false;
+        return 0;
+    }
+    if (rsp_len != NULL) {
+        *rsp_len = 0;
     }
     
-    ESP_LOGI(HTTP_TAG, "Sending JSON to: %s", url);
-    ESP_LOGI(HTTP_TAG, "JSON data: %s", json_data);
+    http_url_t target;
+    if (!http_url_parse(url, &target)) {
+        ESP_LOGE(HTTP_TAG, "Unsupported URL: %s", url);
+        return 0;
+    }
     
-    WalterModemRsp rsp = {};
+    // The profile is not touched while the modem may still send on it
+    if (!modem_call_settled(&g_http_send_pending)) {
+        ESP_LOGW(HTTP_TAG, "Previous request still with the modem, not sending");
+        return 0;
+    }
+    http_drain_stale();
     
-    // Configure HTTP profile (profile 0, port 80, no auth, no SSL)
-    if (!modem.httpConfigProfile(
-        0,                      // Profile ID
-        "application/json",     // Content type
-        80,                     // Port
-        0,                      // IP version (0=IPv4)
-        false,                  // Use SSL/TLS
-        "",                     // Username
-        "",                     // Password
-        30,                     // Timeout
-        0,                      // Keep alive
-        0,                      // Flags
-        &rsp)) {
+    char server_ip[16];
+    const char *server = NULL;
+    if (!target.https && dns_resolve(target.host, server_ip, sizeof(server_ip))) {
+        server = server_ip;
+    }
+    
+    // Configure HTTP profile (only when the server changes, keeps the TLS session)
+    if (!http_profile_ensure(&target, server)) {
         ESP_LOGE(HTTP_TAG, "Failed to configure HTTP profile");
-        return false;
+        return 0;
     }
     
-    ESP_LOGI(HTTP_TAG, "HTTP profile configured");
+    uint16_t len = (uint16_t)strlen(json_data);
+    if (!modem_call(MODEM_CLASS_HTTP, "httpSend", NULL, [&](walterModemCb cb, void *arg) {
+            return modem.httpSend(TLS_HTTP_PROFILE_ID, target.path, (uint8_t *)json_data, len,
+                                  WALTER_MODEM_HTTP_SEND_CMD_POST,
+                                  WALTER_MODEM_HTTP_POST_PARAM_JSON, NULL, cb, arg);
+        }, &g_http_send_pending)) {
+        ESP_LOGE(HTTP_TAG, "HTTP POST failed");
+        if (g_http_send_pending.pending) {
+            http_mark_stale();
+        }
+        return 0;
+    }
     
-    // For now, just log that we would send the data
-    // The actual HTTP API may require different methods
-    ESP_LOGI(HTTP_TAG, "JSON prepared for transmission");
-    ESP_LOGI(HTTP_TAG, "Data size: %d bytes", strlen(json_data));
+    // The response is announced by a ring; the body comes with it.
+    // httpDidRing() has no callback form, so this loop is its deadline.
+    WalterModemRsp rsp = {};
+    static uint8_t discard[16];
+    uint8_t *buf = rsp_body != NULL ? rsp_body : discard;
+    uint16_t size = rsp_body != NULL ? rsp_size : sizeof(discard);
+    for (uint32_t waited = 0; waited < HTTP_RESPONSE_TIMEOUT_MS; waited += HTTP_RESPONSE_POLL_MS) {
+        if (modem.httpDidRing(TLS_HTTP_PROFILE_ID, buf, size, &rsp)) {
+            uint16_t status = rsp.data.httpResponse.httpStatus;
+            if (rsp_len != NULL && rsp_body != NULL) {
+                uint16_t got = rsp.data.httpResponse.contentLength;
+                *rsp_len = got < rsp_size ? got : rsp_size;
+            }
+            if (!http_status_ok(status)) {
+                ESP_LOGW(HTTP_TAG, "HTTP %u from %s", (unsigned)status, target.host);
+            }
+            return status;
+        }
+        vTaskDelay(pdMS_TO_TICKS(HTTP_RESPONSE_POLL_MS));
+    }
+    ESP_LOGW(HTTP_TAG, "No response within %d ms", HTTP_RESPONSE_TIMEOUT_MS);
+    http_mark_stale();
+    return 0;
+}
+
+/**
+ * Send JSON data via HTTP POST, ignoring the response body
+ * 
+ * @param url The URL to send data to (e.g., "https://httpbin.org/post")
+ * @param json_data The JSON string to send
+ * @return true on success, false on error
+ */
+static bool send_json_http(const char* url, const char* json_data) {
+    if (url == NULL || json_data == NULL) {
+        ESP_LOGE(HTTP_TAG, "Invalid parameters");
+        return false;
+    }
     
-    // Note: The actual HTTP POST implementation depends on the Walter library version
-    // This is a simplified example showing JSON creation
+    ESP_LOGI(HTTP_TAG, "Sending JSON to: %s", url);
+    ESP_LOGI(HTTP_TAG, "JSON data: %s", json_data);
+    ESP_LOGI(HTTP_TAG, "Data size: %u bytes", (unsigned)strlen(json_data));
     
-    return true;
+    // Callers free their JSON right away; the modem may read it later
+    static char copy[HTTP_SEND_COPY_MAX];
+    size_t len = strlen(json_data);
+    if (len >= sizeof(copy)) {
+        ESP_LOGE(HTTP_TAG, "JSON too large (%u bytes)", (unsigned)len);
+        return false;
+    }
+    if (!modem_call_settled(&g_http_send_pending)) {
+        ESP_LOGW(HTTP_TAG, "Previous request still with the modem, not sending");
+        return false;
+    }
+    memcpy(copy, json_data, len + 1);
+    return http_status_ok(http_post_json(url, copy, NULL, 0, NULL));
 }
 
+#ifdef CONFIG_WALTER_JSON_TEST
 /**
  * Create a sample JSON object with sensor data
  * 
+ * @param device_id Device identifier
  * @return JSON string (must be freed by caller using cJSON_free)
  */
-static char* create_sensor_json(void) {
+static char* create_sensor_json(const char* device_id) {
     // Create JSON object
     cJSON *root = cJSON_CreateObject();
     if (root == NULL) {
@@ -79,11 +212,11 @@ static char* create_sensor_json(void) {
     }
     
     // Add device info
-    cJSON_AddStringToObject(root, "device_id", "walter-001");
+    cJSON_AddStringToObject(root, "device_id", device_id);
     cJSON_AddStringToObject(root, "device_type", "nbiot-sensor");
     
-    // Add timestamp (you can use real RTC time if available)
-    cJSON_AddNumberToObject(root, "timestamp", esp_log_timestamp());
+    // Network-anchored time, computed locally (no modem query)
+    time_service_add_to_json(root, "timestamp", esp_timer_get_time());
     
     // Create sensor data object
     cJSON *sensors = cJSON_CreateObject();
@@ -104,6 +237,9 @@ static char* create_sensor_json(void) {
     cJSON_AddStringToObject(root, "status", "online");
     cJSON_AddNumberToObject(root, "battery_level", 85);
     
+    // First upload after connecting carries the boot waterfall
+    boot_waterfall_add_to_json(root);
+    
     // Convert to string
     char *json_string = cJSON_PrintUnformatted(root);
     
@@ -130,14 +266,82 @@ static char* create_custom_json(const char* device_id, float temperature, float
     cJSON_AddStringToObject(root, "device", device_id);
     cJSON_AddNumberToObject(root, "temp", temperature);
     cJSON_AddNumberToObject(root, "hum", humidity);
-    cJSON_AddNumberToObject(root, "time", esp_log_timestamp());
+    time_service_add_to_json(root, "time", esp_timer_get_time());
+    boot_waterfall_add_to_json(root);
     
     char *json_string = cJSON_PrintUnformatted(root);
     cJSON_Delete(root);
     
     return json_string;
 }
+#endif // CONFIG_WALTER_JSON_TEST
 
+/**
+ * Create a compact JSON batch from sampler output
+ * 
+ * "t0" is the absolute time of the first sample (see time_service_add_to_json)
+ * and each sample becomes [offset_ms_from_t0, temperature, humidity, pressure],
+ * which keeps the rows short while still giving every sample wall-clock time.
+ * 
+ * @param device_id Device identifier
+ * @param samples Samples in time order
+ * @param count Number of samples
+ * @param stats Sampler health counters to include (may be NULL)
+ * @return JSON string (must be freed by caller using cJSON_free)
+ */
+static char* create_batch_json(const char* device_id, const sensor_sample_t* samples,
+                               size_t count, const sampler_stats_t* stats) {
+    cJSON *root = cJSON_CreateObject();
+    if (root == NULL) {
+        return NULL;
+    }
+    
+    cJSON_AddStringToObject(root, "device", device_id);
+    
+    int64_t t0_ms = 0;
+    if (count > 0) {
+        time_service_add_to_json(root, "t0", samples[0].timestamp_us);
+        t0_ms = time_service_synced() ? time_service_epoch_ms(samples[0].timestamp_us)
+                                      : samples[0].timestamp_us / 1000;
+    }
+    
+    cJSON *list = cJSON_CreateArray();
+    for (size_t i = 0; i < count; i++) {
+        int64_t t_ms = time_service_synced() ? time_service_epoch_ms(samples[i].timestamp_us)
+                                             : samples[i].timestamp_us / 1000;
+        cJSON *row = cJSON_CreateArray();
+        cJSON_AddItemToArray(row, cJSON_CreateNumber((double)(t_ms - t0_ms)));
+        cJSON_AddItemToArray(row, cJSON_CreateNumber(samples[i].temperature));
+        cJSON_AddItemToArray(row, cJSON_CreateNumber(samples[i].humidity));
+        cJSON_AddItemToArray(row, cJSON_CreateNumber(samples[i].pressure));
+        cJSON_AddItemToArray(list, row);
+    }
+    cJSON_AddItemToObject(root, "samples", list);
+    
+    if (stats != NULL) {
+        cJSON *health = cJSON_CreateObject();
+        cJSON_AddNumberToObject(health, "overruns", stats->queue_overruns);
+        cJSON_AddNumberToObject(health, "dropped", stats->dropped);
+        cJSON_AddNumberToObject(health, "missed", stats->missed_ticks);
+        cJSON_AddNumberToObject(health, "jit_avg_us", sampler_stats_jitter_mean_us(stats));
+        cJSON_AddNumberToObject(health, "jit_max_us", stats->jitter_max_us);
+        cJSON_AddItemToObject(root, "sampler", health);
+    }
+    
+    energy_add_to_json(root, stats != NULL ? stats->samples : 0);
+    
+    // Config version and last downlink command, acknowledges downlinks
+    device_config_add_to_json(root);
+    
+    boot_waterfall_add_to_json(root);
+    
+    char *json_string = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    
+    return json_string;
+}
+
+#ifdef CONFIG_WALTER_JSON_TEST
 /**
  * Example: Send sensor data to a server
  * 
@@ -148,7 +352,7 @@ static bool send_sensor_data_example(const char* server_url) {
     ESP_LOGI(HTTP_TAG, "=== Sending Sensor Data Example ===");
     
     // Create JSON data
-    char* json_data = create_sensor_json();
+    char* json_data = create_sensor_json(HTTP_DEVICE_ID);
     if (json_data == NULL) {
         ESP_LOGE(HTTP_TAG, "Failed to create JSON");
         return false;
@@ -156,6 +360,9 @@ static bool send_sensor_data_example(const char* server_url) {
     
     // Send via HTTP POST
     bool success = send_json_http(server_url, json_data);
+    if (success) {
+        boot_waterfall_mark_uploaded();
+    }
     
     // Free JSON string
     cJSON_free(json_data);
@@ -181,10 +388,14 @@ static bool send_telemetry_example(void) {
     ESP_LOGI(HTTP_TAG, "Sending to test server: %s", test_url);
     
     bool success = send_json_http(test_url, json_data);
+    if (success) {
+        boot_waterfall_mark_uploaded();
+    }
     
     cJSON_free(json_data);
     
     return success;
 }
+#endif // CONFIG_WALTER_JSON_TEST
 
 #endif // HTTP_JSON_EXAMPLE_H
@@ -16,25 +16,69 @@
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include <string.h>
+#include <nvs_flash.h>
+#include <sdkconfig.h>
 #include <WalterModem.h>
-#include "debug_commands.h"
-#include "http_json_example.h"
-#include "modem_diagnostics.h"
 
-// Logging tag
-static const char *TAG = "walter_nbiot";
+// Feature switches come from the build profile (menuconfig -> Walter NB-IoT).
+// Disabled features are not compiled at all, see sdkconfig.prod/.field-debug/.lab
 
-// Enable debug mode (set to false to disable verbose debugging)
+// Verbose debug mode
 // WARNING: Debug mode uses a lot of stack memory and may cause overflow
+#ifdef CONFIG_WALTER_DEBUG_MODE
+#define DEBUG_MODE true
+#else
 #define DEBUG_MODE false
+#endif
 
-// Enable JSON test transmission (disable to save memory)
+// JSON test transmission after connecting
+#ifdef CONFIG_WALTER_JSON_TEST
+#define ENABLE_JSON_TEST true
+#else
 #define ENABLE_JSON_TEST false
+#endif
+
+// Periodic sensor uploads through the dual-core pipeline
+#ifdef CONFIG_WALTER_UPLINK_PIPELINE
+#define ENABLE_UPLINK_PIPELINE true
+#else
+#define ENABLE_UPLINK_PIPELINE false
+#endif
 
-// Enable complete diagnostics (shows all AT commands and responses)
-#define ENABLE_FULL_DIAGNOSTICS true
+// On-demand diagnostics console (diagnostics never run at boot)
+#ifdef CONFIG_WALTER_DIAG_CONSOLE
+#define ENABLE_DIAG_CONSOLE true
+#else
+#define ENABLE_DIAG_CONSOLE false
+#endif
+
+// Delta firmware updates (needs the OTA partition table)
+#ifdef CONFIG_WALTER_DELTA_OTA
+#define ENABLE_DELTA_OTA true
+#else
+#define ENABLE_DELTA_OTA false
+#endif
+
+#include "boot_waterfall.h"
+#include "energy_model.h"
+#include "modem_deadline.h"
+#include "modem_trace.h"
+#include "time_service.h"
+#include "dns_cache.h"
+#include "http_json_example.h"
+#include "uplink_pipeline.h"
+#include <esp_ota_ops.h>
+#if DEBUG_MODE
+#include "debug_commands.h"
+#endif
+#if ENABLE_DIAG_CONSOLE
+#include "diag_console.h"
+#endif
 
-// Network configuration - Soracom
+// Logging tag
+static const char *TAG = "walter_nbiot";
+
+// Network configuration - Soracom (build defaults, a downlink can change them)
 #define CELLULAR_APN "soracom.io"          // Soracom APN
 #define CELLULAR_APN_USER "sora"           // Soracom username
 #define CELLULAR_APN_PASS "sora"           // Soracom password
@@ -44,6 +88,7 @@ static const char *TAG = "walter_nbiot";
 #define NETWORK_TIMEOUT_MS 180000          // 3 minutes (increased for NB-IoT)
 #define ATTACH_TIMEOUT_MS 60000            // 1 minute
 #define CHECK_INTERVAL_MS 5000             // 5 seconds (reduced frequency)
+#define CONNECT_ATTEMPTS 3                 // A timed-out modem call fails the attempt, not the boot
 
 // UART configuration for modem
 #define MODEM_UART_NUM UART_NUM_1
@@ -87,7 +132,9 @@ static void get_signal_info(void)
 {
     WalterModemRsp rsp = {};
     
-    if (modem.getSignalQuality(&rsp)) {
+    if (modem_call(MODEM_CLASS_QUERY, "getSignalQuality", &rsp, [](walterModemCb cb, void *arg) {
+            return modem.getSignalQuality(NULL, cb, arg);
+        })) {
         // RSRP and RSRQ should be negative values
         int16_t rsrp = rsp.data.signalQuality.rsrp;
         int16_t rsrq = rsp.data.signalQuality.rsrq;
@@ -123,51 +170,71 @@ WalterModem modem;
 // Forward declarations removed - functions are defined in debug_commands.h
 
 /**
- * Main NB-IoT connection function
+ * Start a connect stage: timestamps it and attributes energy to it
  */
-static bool connect_nbiot(void)
+static void connect_stage_begin(boot_stage_t stage)
+{
+    boot_waterfall_begin(stage);
+    energy_activity(stage);
+}
+
+// Runtime configuration the current connect attempt uses (APN credentials)
+static device_config_t g_connect_cfg = {};
+
+/**
+ * Start the modem driver (once per boot; connect attempts reuse it)
+ */
+static bool init_modem(void)
 {
-    WalterModemRsp rsp = {};
-    
     ESP_LOGI(TAG, "==================================================");
     ESP_LOGI(TAG, "Walter NB-IoT Connection Test - ESP-IDF");
     ESP_LOGI(TAG, "==================================================");
     
     // Step 1: Initialize modem
     ESP_LOGI(TAG, "[1/10] Initializing modem...");
+    connect_stage_begin(BOOT_STAGE_MODEM_INIT);
     if (!WalterModem::begin(MODEM_UART_NUM)) {
         ESP_LOGE(TAG, "Failed to initialize modem");
         ESP_LOGE(TAG, "Check hardware connections and restart");
+        boot_waterfall_abort();
         return false;
     }
     ESP_LOGI(TAG, "OK: Modem initialized");
     vTaskDelay(pdMS_TO_TICKS(1000));
+    boot_waterfall_end(BOOT_STAGE_MODEM_INIT);
+    return true;
+}
+
+/**
+ * Main NB-IoT connection function (after init_modem())
+ */
+static bool connect_nbiot(void)
+{
+    WalterModemRsp rsp = {};
+    device_config_get(&g_connect_cfg);
     
     // Step 2: Check communication
     ESP_LOGI(TAG, "[2/10] Checking modem communication...");
-    if (!modem.checkComm()) {
+    connect_stage_begin(BOOT_STAGE_COMM_CHECK);
+    if (!modem_call(MODEM_CLASS_QUERY, "checkComm", NULL, [](walterModemCb cb, void *arg) {
+            return modem.checkComm(NULL, cb, arg);
+        })) {
         ESP_LOGE(TAG, "Cannot communicate with modem");
         return false;
     }
     ESP_LOGI(TAG, "Modem initialized successfully.");
     vTaskDelay(pdMS_TO_TICKS(500));
+    boot_waterfall_end(BOOT_STAGE_COMM_CHECK);
 
-    // Run complete diagnostics if enabled
-    #if ENABLE_FULL_DIAGNOSTICS
-    run_complete_diagnostics();
-    vTaskDelay(pdMS_TO_TICKS(2000));
-    #endif
-
-    // Run full diagnostics if debug mode is enabled
-    if (DEBUG_MODE) {
-        run_modem_diagnostics();
-        vTaskDelay(pdMS_TO_TICKS(1000));
-    }
+    // Diagnostics are no longer run at boot, use the console ('diag', 'diag full')
     
     // Step 3: Get modem identity
     ESP_LOGI(TAG, "[3/10] Getting modem identity...");
+    connect_stage_begin(BOOT_STAGE_IDENTITY);
     rsp = {};
-    if (modem.getIdentity(&rsp)) {
+    if (modem_call(MODEM_CLASS_QUERY, "getIdentity", &rsp, [](walterModemCb cb, void *arg) {
+            return modem.getIdentity(NULL, cb, arg);
+        })) {
         ESP_LOGI(TAG, "Modem IMEI: %s", rsp.data.identity.imei);
         ESP_LOGI(TAG, "Modem IMEISV: %s", rsp.data.identity.imeisv);
         ESP_LOGI(TAG, "Modem SVN: %s", rsp.data.identity.svn);
@@ -177,7 +244,9 @@ static bool connect_nbiot(void)
     // Step 3.5: Check current operational state
     ESP_LOGI(TAG, "[3.5/10] Checking current operational state...");
     rsp = {};
-    if (modem.getOpState(&rsp)) {
+    if (modem_call(MODEM_CLASS_QUERY, "getOpState", &rsp, [](walterModemCb cb, void *arg) {
+            return modem.getOpState(NULL, cb, arg);
+        })) {
         ESP_LOGI(TAG, "Current operational state: %d", rsp.data.opState);
     }
     vTaskDelay(pdMS_TO_TICKS(500));
@@ -185,7 +254,9 @@ static bool connect_nbiot(void)
     // Step 3.6: Check current RAT
     ESP_LOGI(TAG, "[3.6/10] Checking current RAT...");
     rsp = {};
-    if (modem.getRAT(&rsp)) {
+    if (modem_call(MODEM_CLASS_QUERY, "getRAT", &rsp, [](walterModemCb cb, void *arg) {
+            return modem.getRAT(NULL, cb, arg);
+        })) {
         ESP_LOGI(TAG, "Current RAT: %d (0=CAT-M1, 1=NB-IoT, 2=GSM)", rsp.data.rat);
     } else {
         ESP_LOGW(TAG, "Could not get current RAT");
@@ -195,15 +266,21 @@ static bool connect_nbiot(void)
     // Step 3.7: Check radio bands
     ESP_LOGI(TAG, "[3.7/10] Checking radio bands...");
     rsp = {};
-    if (modem.getRadioBands(&rsp)) {
+    if (modem_call(MODEM_CLASS_QUERY, "getRadioBands", &rsp, [](walterModemCb cb, void *arg) {
+            return modem.getRadioBands(NULL, cb, arg);
+        })) {
         ESP_LOGI(TAG, "Radio bands configured");
     }
     vTaskDelay(pdMS_TO_TICKS(500));
+    boot_waterfall_end(BOOT_STAGE_IDENTITY);
     
     // Step 7: Verify current RAT before setting
     ESP_LOGI(TAG, "[7/10] Checking current RAT...");
+    connect_stage_begin(BOOT_STAGE_RAT_CONFIG);
     rsp = {};
-    if (modem.getRAT(&rsp)) {
+    if (modem_call(MODEM_CLASS_QUERY, "getRAT", &rsp, [](walterModemCb cb, void *arg) {
+            return modem.getRAT(NULL, cb, arg);
+        })) {
         ESP_LOGI(TAG, "Current RAT before change: %d (%s)", rsp.data.rat,
                  rsp.data.rat == WALTER_MODEM_RAT_NBIOT ? "NB-IoT" :
                  rsp.data.rat == WALTER_MODEM_RAT_LTEM ? "LTE-M" :
@@ -212,28 +289,31 @@ static bool connect_nbiot(void)
     
     // Step 4: Set operational state to MINIMUM (required before changing RAT)
     ESP_LOGI(TAG, "[4/10] Setting operational state to MINIMUM...");
-    if (!modem.setOpState(WALTER_MODEM_OPSTATE_MINIMUM)) {
+    if (!modem_call(MODEM_CLASS_RADIO, "setOpState(MINIMUM)", NULL, [](walterModemCb cb, void *arg) {
+            return modem.setOpState(WALTER_MODEM_OPSTATE_MINIMUM, NULL, cb, arg);
+        })) {
         ESP_LOGE(TAG, "Failed to set operational state to MINIMUM");
         return false;
     }
     ESP_LOGI(TAG, "OK: Operational state set to MINIMUM");
+    energy_modem_state(ENERGY_MODEM_MINIMUM);
     vTaskDelay(pdMS_TO_TICKS(2000));
     
     // Step 5: Configure RAT to NB-IoT
     ESP_LOGI(TAG, "[5/10] Configuring RAT to NB-IoT...");
     
-    if (DEBUG_MODE) {
-        check_rat_support();
-    }
-    
     // Try NB-IoT first
     rsp = {};
-    if (!modem.setRAT(WALTER_MODEM_RAT_NBIOT, &rsp)) {
+    if (!modem_call(MODEM_CLASS_RADIO, "setRAT(NB-IoT)", &rsp, [](walterModemCb cb, void *arg) {
+            return modem.setRAT(WALTER_MODEM_RAT_NBIOT, NULL, cb, arg);
+        })) {
         ESP_LOGE(TAG, "Failed to set RAT to NB-IoT (error code: %d)", rsp.result);
         
         ESP_LOGI(TAG, "Trying LTE-M (CAT-M1) as fallback...");
         rsp = {};
-        if (!modem.setRAT(WALTER_MODEM_RAT_LTEM, &rsp)) {
+        if (!modem_call(MODEM_CLASS_RADIO, "setRAT(LTE-M)", &rsp, [](walterModemCb cb, void *arg) {
+                return modem.setRAT(WALTER_MODEM_RAT_LTEM, NULL, cb, arg);
+            })) {
             ESP_LOGE(TAG, "Failed to set RAT to LTE-M (error code: %d)", rsp.result);
             ESP_LOGW(TAG, "Continuing anyway - modem may use default RAT");
         } else {
@@ -246,7 +326,9 @@ static bool connect_nbiot(void)
     // Verify final RAT setting
     vTaskDelay(pdMS_TO_TICKS(1000));
     rsp = {};
-    if (modem.getRAT(&rsp)) {
+    if (modem_call(MODEM_CLASS_QUERY, "getRAT", &rsp, [](walterModemCb cb, void *arg) {
+            return modem.getRAT(NULL, cb, arg);
+        })) {
         ESP_LOGI(TAG, "Final RAT configuration: %d (%s)", rsp.data.rat,
                  rsp.data.rat == WALTER_MODEM_RAT_NBIOT ? "NB-IoT" :
                  rsp.data.rat == WALTER_MODEM_RAT_LTEM ? "LTE-M" :
@@ -257,21 +339,30 @@ static bool connect_nbiot(void)
         }
     }
     vTaskDelay(pdMS_TO_TICKS(2000));
+    boot_waterfall_end(BOOT_STAGE_RAT_CONFIG);
     
     // Step 5.5: Set operational state back to FULL
     ESP_LOGI(TAG, "[5.5/10] Setting operational state to FULL...");
-    if (!modem.setOpState(WALTER_MODEM_OPSTATE_FULL)) {
+    connect_stage_begin(BOOT_STAGE_OPSTATE_FULL);
+    if (!modem_call(MODEM_CLASS_RADIO, "setOpState(FULL)", NULL, [](walterModemCb cb, void *arg) {
+            return modem.setOpState(WALTER_MODEM_OPSTATE_FULL, NULL, cb, arg);
+        })) {
         ESP_LOGE(TAG, "Failed to set operational state to FULL");
         return false;
     }
     ESP_LOGI(TAG, "OK: Operational state set to FULL");
+    energy_modem_state(ENERGY_MODEM_SEARCHING);
     vTaskDelay(pdMS_TO_TICKS(2000));
+    boot_waterfall_end(BOOT_STAGE_OPSTATE_FULL);
     
     // Step 6: Unlock SIM card (skip if no PIN)
+    connect_stage_begin(BOOT_STAGE_SIM);
     #if SIM_PIN != NULL
     if (strlen(SIM_PIN) > 0) {
         ESP_LOGI(TAG, "[6/10] Unlocking SIM card...");
-        if (!modem.unlockSIM(SIM_PIN)) {
+        if (!modem_call(MODEM_CLASS_CONFIG, "unlockSIM", NULL, [](walterModemCb cb, void *arg) {
+                return modem.unlockSIM(SIM_PIN, NULL, cb, arg);
+            })) {
             ESP_LOGE(TAG, "Failed to unlock SIM");
             ESP_LOGE(TAG, "Check SIM card and PIN code");
             return false;
@@ -287,38 +378,46 @@ static bool connect_nbiot(void)
     // Step 6.5: Check SIM state
     ESP_LOGI(TAG, "[6.5/10] Checking SIM state...");
     rsp = {};
-    if (modem.getSIMState(&rsp)) {
+    if (modem_call(MODEM_CLASS_QUERY, "getSIMState", &rsp, [](walterModemCb cb, void *arg) {
+            return modem.getSIMState(NULL, cb, arg);
+        })) {
         ESP_LOGI(TAG, "SIM state: %d", rsp.data.simState);
     }
     vTaskDelay(pdMS_TO_TICKS(500));
+    boot_waterfall_end(BOOT_STAGE_SIM);
     
     // Step 7: Set network selection mode
     ESP_LOGI(TAG, "[7/10] Setting network selection to automatic...");
-    if (!modem.setNetworkSelectionMode(WALTER_MODEM_NETWORK_SEL_MODE_AUTOMATIC)) {
+    connect_stage_begin(BOOT_STAGE_NET_SELECT);
+    if (!modem_call(MODEM_CLASS_CONFIG, "setNetworkSelectionMode", NULL, [](walterModemCb cb, void *arg) {
+            return modem.setNetworkSelectionMode(WALTER_MODEM_NETWORK_SEL_MODE_AUTOMATIC, NULL,
+                                                 WALTER_MODEM_OPERATOR_FORMAT_LONG_ALPHANUMERIC,
+                                                 NULL, cb, arg);
+        })) {
         ESP_LOGE(TAG, "Failed to set network selection mode");
         return false;
     }
     ESP_LOGI(TAG, "OK: Network selection mode set");
     vTaskDelay(pdMS_TO_TICKS(1000));
+    boot_waterfall_end(BOOT_STAGE_NET_SELECT);
     
     // Step 8: Wait for network registration
     ESP_LOGI(TAG, "[8/10] Waiting for network registration...");
-    
-    if (DEBUG_MODE) {
-        check_network_coverage();
-    }
+    connect_stage_begin(BOOT_STAGE_REGISTRATION);
     
     if (!wait_for_network_registration(NETWORK_TIMEOUT_MS)) {
         // Get diagnostic info before failing
         ESP_LOGE(TAG, "Network registration failed - gathering diagnostic info:");
         
-        if (DEBUG_MODE) {
-            check_network_coverage();
-            check_rat_support();
-        }
+        #if DEBUG_MODE
+        check_network_coverage();
+        check_rat_support();
+        #endif
         
         rsp = {};
-        if (modem.getRAT(&rsp)) {
+        if (modem_call(MODEM_CLASS_QUERY, "getRAT", &rsp, [](walterModemCb cb, void *arg) {
+            return modem.getRAT(NULL, cb, arg);
+        })) {
             ESP_LOGE(TAG, "  Current RAT: %d (%s)", rsp.data.rat,
                  rsp.data.rat == WALTER_MODEM_RAT_NBIOT ? "NB-IoT" :
                  rsp.data.rat == WALTER_MODEM_RAT_LTEM ? "LTE-M" :
@@ -326,7 +425,9 @@ static bool connect_nbiot(void)
         }
         
         rsp = {};
-        if (modem.getSIMState(&rsp)) {
+        if (modem_call(MODEM_CLASS_QUERY, "getSIMState", &rsp, [](walterModemCb cb, void *arg) {
+            return modem.getSIMState(NULL, cb, arg);
+        })) {
             ESP_LOGE(TAG, "  SIM state: %d (%s)", rsp.data.simState,
                      rsp.data.simState == WALTER_MODEM_SIM_STATE_READY ? "Ready" :
                      rsp.data.simState == WALTER_MODEM_SIM_STATE_PIN_REQUIRED ? "PIN Required" :
@@ -346,21 +447,29 @@ static bool connect_nbiot(void)
         return false;
     }
     
+    energy_modem_state(ENERGY_MODEM_IDLE);
+    
     // Get signal quality
     get_signal_info();
     
     // Get cell information
     ESP_LOGI(TAG, "Getting cell information...");
     rsp = {};
-    if (modem.getCellInformation(WALTER_MODEM_SQNMONI_REPORTS_SERVING_CELL, &rsp)) {
+    if (modem_call(MODEM_CLASS_QUERY, "getCellInformation", &rsp, [](walterModemCb cb, void *arg) {
+            return modem.getCellInformation(WALTER_MODEM_SQNMONI_REPORTS_SERVING_CELL, NULL, cb, arg);
+        })) {
         ESP_LOGI(TAG, "Connected to network");
     }
     
     vTaskDelay(pdMS_TO_TICKS(500));
+    boot_waterfall_end(BOOT_STAGE_REGISTRATION);
     
     // Step 9: Define PDP context
     ESP_LOGI(TAG, "[9/10] Defining PDP context...");
-    if (!modem.definePDPContext(PDP_CONTEXT_ID, CELLULAR_APN)) {
+    connect_stage_begin(BOOT_STAGE_PDP_DEFINE);
+    if (!modem_call(MODEM_CLASS_CONFIG, "definePDPContext", NULL, [](walterModemCb cb, void *arg) {
+            return modem.definePDPContext(PDP_CONTEXT_ID, g_connect_cfg.apn, NULL, cb, arg);
+        })) {
         ESP_LOGE(TAG, "Failed to define PDP context");
         ESP_LOGE(TAG, "Check APN configuration");
         return false;
@@ -369,31 +478,43 @@ static bool connect_nbiot(void)
     vTaskDelay(pdMS_TO_TICKS(500));
     
     // Step 9.5: Set authentication parameters if needed
-    if (strlen(CELLULAR_APN_USER) > 0) {
+    if (strlen(g_connect_cfg.apn_user) > 0) {
         ESP_LOGI(TAG, "[9.5/10] Setting PDP authentication...");
-        if (!modem.setPDPAuthParams(
-                WALTER_MODEM_PDP_AUTH_PROTO_PAP, 
-                CELLULAR_APN_USER, 
-                CELLULAR_APN_PASS)) {
+        if (!modem_call(MODEM_CLASS_CONFIG, "setPDPAuthParams", NULL, [](walterModemCb cb, void *arg) {
+                return modem.setPDPAuthParams(
+                    WALTER_MODEM_PDP_AUTH_PROTO_PAP, 
+                    g_connect_cfg.apn_user, 
+                    g_connect_cfg.apn_pass,
+                    PDP_CONTEXT_ID, NULL, cb, arg);
+            })) {
             ESP_LOGW(TAG, "Failed to set authentication parameters");
         } else {
             ESP_LOGI(TAG, "OK: Authentication parameters set");
         }
         vTaskDelay(pdMS_TO_TICKS(500));
     }
+    boot_waterfall_end(BOOT_STAGE_PDP_DEFINE);
     
     // Step 9.6: Activate PDP context
     ESP_LOGI(TAG, "[9.6/10] Activating PDP context...");
-    if (!modem.setPDPContextActive(true)) {
+    connect_stage_begin(BOOT_STAGE_PDP_ACTIVATE);
+    if (!modem_call(MODEM_CLASS_PDP, "setPDPContextActive", NULL, [](walterModemCb cb, void *arg) {
+            return modem.setPDPContextActive(true, PDP_CONTEXT_ID, NULL, cb, arg);
+        })) {
         ESP_LOGE(TAG, "Failed to activate PDP context");
         return false;
     }
     ESP_LOGI(TAG, "OK: PDP context activated");
+    energy_modem_state(ENERGY_MODEM_CONNECTED);
     vTaskDelay(pdMS_TO_TICKS(1000));
+    boot_waterfall_end(BOOT_STAGE_PDP_ACTIVATE);
     
     // Step 10: Attach to network
     ESP_LOGI(TAG, "[10/10] Attaching to packet domain...");
-    if (!modem.setNetworkAttachmentState(true)) {
+    connect_stage_begin(BOOT_STAGE_ATTACH);
+    if (!modem_call(MODEM_CLASS_PDP, "setNetworkAttachmentState", NULL, [](walterModemCb cb, void *arg) {
+            return modem.setNetworkAttachmentState(true, NULL, cb, arg);
+        })) {
         ESP_LOGE(TAG, "Failed to attach to network");
         return false;
     }
@@ -405,7 +526,9 @@ static bool connect_nbiot(void)
     // Get PDP address
     ESP_LOGI(TAG, "Getting IP address...");
     rsp = {};
-    if (modem.getPDPAddress(&rsp)) {
+    if (modem_call(MODEM_CLASS_QUERY, "getPDPAddress", &rsp, [](walterModemCb cb, void *arg) {
+            return modem.getPDPAddress(NULL, cb, arg);
+        })) {
         ESP_LOGI(TAG, "PDP Context ID: %d", rsp.data.pdpAddressList.pdpCtxId);
         
         if (rsp.data.pdpAddressList.pdpAddress != NULL && 
@@ -422,6 +545,7 @@ static bool connect_nbiot(void)
     } else {
         ESP_LOGW(TAG, "Could not retrieve IP address");
     }
+    boot_waterfall_end(BOOT_STAGE_ATTACH);
     
     ESP_LOGI(TAG, "==================================================");
     ESP_LOGI(TAG, "CONNECTION SUCCESSFUL!");
@@ -432,10 +556,11 @@ static bool connect_nbiot(void)
 }
 
 
+#if ENABLE_JSON_TEST
 /**
  * Test JSON transmission
  */
-__attribute__((unused)) static void test_json_transmission(void)
+static void test_json_transmission(void)
 {
     ESP_LOGI(TAG, "");
     ESP_LOGI(TAG, "==================================================");
@@ -467,6 +592,7 @@ __attribute__((unused)) static void test_json_transmission(void)
     ESP_LOGI(TAG, "JSON Transmission Test Complete");
     ESP_LOGI(TAG, "==================================================");
 }
+#endif
 
 
 /**
@@ -475,6 +601,7 @@ __attribute__((unused)) static void test_json_transmission(void)
 static void monitor_task(void *pvParameters)
 {
     const TickType_t xDelay = pdMS_TO_TICKS(60000); // Check every 60 seconds
+    bool lost = false;
     
     while (1) {
         vTaskDelay(xDelay);
@@ -486,18 +613,90 @@ static void monitor_task(void *pvParameters)
             regState != WALTER_MODEM_NETWORK_REG_REGISTERED_ROAMING) {
             // Only log if there's a problem
             ESP_LOGW(TAG, "Network lost: %d", regState);
+            if (!lost) {
+                energy_modem_state(ENERGY_MODEM_SEARCHING);
+                lost = true;
+            }
+        } else if (lost) {
+            energy_modem_state(ENERGY_MODEM_IDLE);
+            lost = false;
+            time_service_sync();
         }
     }
 }
 
 
+/**
+ * Initialize NVS (used for the boot waterfall and other persisted state)
+ */
+static void init_nvs(void)
+{
+    esp_err_t err = nvs_flash_init();
+    if (err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        ESP_LOGW(TAG, "NVS partition needs erasing, reinitializing");
+        nvs_flash_erase();
+        err = nvs_flash_init();
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialize NVS: %s", esp_err_to_name(err));
+    }
+}
+
+
 /**
  * Main application entry point
  */
 extern "C" void app_main(void)
 {
-    // Connect to NB-IoT network
-    if (!connect_nbiot()) {
+    init_nvs();
+    device_config_init(CELLULAR_APN, CELLULAR_APN_USER, CELLULAR_APN_PASS);
+    modem_deadline_init();
+    modem_tap_init(MODEM_UART_NUM);
+    boot_waterfall_init();
+    energy_init(NULL);
+    time_service_init();
+    dns_cache_init();
+    tls_profile_init();
+    
+    // Connect to NB-IoT network; modem calls are deadline-bounded, so a
+    // stuck command costs one attempt instead of hanging the boot
+    bool modem_ready = init_modem();
+    bool connected = false;
+    for (int attempt = 1; modem_ready && attempt <= CONNECT_ATTEMPTS && !connected; attempt++) {
+        if (attempt > 1) {
+            ESP_LOGW(TAG, "Connect attempt %d/%d", attempt, CONNECT_ATTEMPTS);
+        }
+        boot_waterfall_attempt(attempt);
+        connected = connect_nbiot();
+        if (!connected) {
+            boot_waterfall_abort();     // Every error return leaves its stage open
+        }
+    }
+    boot_waterfall_finish(connected);
+    
+    // One network time read per connect; samples are stamped locally from it
+    if (connected) {
+        time_service_sync();
+    }
+    
+    // An updated image that gets this far is kept (no rollback on next boot).
+    // Also without delta updates: the image may have been installed by one.
+    if (connected) {
+        esp_ota_mark_app_valid_cancel_rollback();
+    }
+    energy_activity(ENERGY_ACT_IDLE);
+    
+    // Console stays available even if the connection failed; whether it
+    // runs is runtime configuration, so a downlink can turn it on later
+    #if ENABLE_DIAG_CONSOLE
+    device_config_t cfg;
+    uint32_t console_gen = device_config_get(&cfg);
+    bool console_started = false;
+    diag_console_configure(cfg.console, &console_started);
+    g_downlink_executor = diag_console_execute;
+    #endif
+    
+    if (!connected) {
         ESP_LOGE(TAG, "Connection failed. Please check configuration and restart.");
         return;
     }
@@ -509,14 +708,20 @@ extern "C" void app_main(void)
     ESP_LOGI(TAG, "JSON test disabled (ENABLE_JSON_TEST=false)");
     #endif
     
-    // Create monitoring task with adequate stack
-    BaseType_t taskCreated = xTaskCreate(
+    // Start sampling (sensor core) and uploading (modem core)
+    #if ENABLE_UPLINK_PIPELINE
+    pipeline_start();
+    #endif
+    
+    // Create monitoring task with adequate stack (modem work stays on one core)
+    BaseType_t taskCreated = xTaskCreatePinnedToCore(
         monitor_task,
         "monitor",
         4096,            // Increased stack size
         NULL,
         5,               // Normal priority
-        NULL
+        NULL,
+        PIPELINE_MODEM_CORE
     );
     
     if (taskCreated != pdPASS) {
@@ -527,12 +732,21 @@ extern "C" void app_main(void)
     while (1) {
         vTaskDelay(pdMS_TO_TICKS(10000)); // Just keep alive, don't spam
         
+        #if ENABLE_DIAG_CONSOLE
+        if (console_gen != g_device_config_gen) {
+            console_gen = device_config_get(&cfg);
+            diag_console_configure(cfg.console, &console_started);
+        }
+        #endif
+        
         // Uncomment to send periodic data:
         /*
         ESP_LOGI(TAG, "Sending periodic data...");
         char* json = create_custom_json("walter-001", 24.5, 62.0);
         if (json != NULL) {
-            send_json_http("http://httpbin.org/post", json);
+            if (send_json_http("http://httpbin.org/post", json)) {
+                boot_waterfall_mark_uploaded();
+            }
             cJSON_free(json);
         }
         */
@@ -0,0 +1,484 @@
+/**
+ * Deadline-Bounded Modem Calls for Walter Modem
+ *
+ * A blocking WalterModem call waits as long as the modem takes to answer,
+ * so one stuck command can stall connect_nbiot() (and everything else
+ * that shares the global modem). modem_call() runs the command through
+ * the library's callback interface instead and waits at most the budget
+ * of its operation class:
+ *
+ *   query    identity, state and signal reads              5 s
+ *   config   local settings (PDP define, selection mode)   10 s
+ *   radio    CFUN and RAT changes                          20 s
+ *   pdp      PDP activation and packet attach              45 s
+ *   http     HTTP/TLS profile and transfer commands        60 s
+ *
+ * A call that misses its deadline is abandoned: its late answer is
+ * dropped when it arrives and the caller sees a failure. After
+ * MODEM_DEADLINE_RESET_AFTER overruns in a row the modem is reset, since
+ * it is most likely wedged.
+ *
+ * An abandoned command may still be carried out, and may still read the
+ * buffers it was given. A caller that passes one can ask for a ticket and
+ * keep the buffer until modem_call_settled() says the late answer came in
+ * or the modem was reset.
+ *
+ * The library offers some calls only in blocking form. These cannot be
+ * bounded here:
+ *
+ *  - httpDidRing() only talks to the modem once a ring has arrived, and
+ *    its callers bound their polling loops.
+ *  - tlsWriteCredential() runs only when the CA certificate changes.
+ *  - Raw sendCmd() is used for the DNS lookup and the TLS resumption
+ *    settings. The lookup goes through modem_call() for its slot and
+ *    statistics, but only the library's own timeout bounds it.
+ *
+ * Each of them runs right after bounded calls on the same path, which
+ * catch a wedged modem first. The console's diagnostic commands
+ * (debug_commands.h, modem_diagnostics.h) run on request and are not
+ * bounded either.
+ *
+ * Each call holds one of MODEM_CALL_SLOTS slots until it is answered. An
+ * abandoned call keeps its slot until the late answer arrives; a modem
+ * reset takes every abandoned slot back, since those answers will never
+ * come. The callback argument carries the slot's generation, so an answer
+ * for a slot that was taken back and reused is dropped.
+ *
+ * Every call is recorded in a per-class latency histogram; overruns get
+ * their own bucket. The histogram and slot code has no ESP-IDF
+ * dependencies and is reused by host/connect_deadline_sim.cpp.
+ */
+
+#ifndef MODEM_DEADLINE_H
+#define MODEM_DEADLINE_H
+
+#include <stdint.h>
+#include <string.h>
+
+typedef enum {
+    MODEM_CLASS_QUERY = 0,
+    MODEM_CLASS_CONFIG,
+    MODEM_CLASS_RADIO,
+    MODEM_CLASS_PDP,
+    MODEM_CLASS_HTTP,
+    MODEM_CLASS_COUNT
+} modem_class_t;
+
+static const char *const MODEM_CLASS_NAMES[MODEM_CLASS_COUNT] = {
+    "query", "config", "radio", "pdp", "http",
+};
+
+static const uint32_t MODEM_CLASS_BUDGET_MS[MODEM_CLASS_COUNT] = {
+    5000, 10000, 20000, 45000, 60000,
+};
+
+#define MODEM_DEADLINE_RESET_AFTER 2
+
+// Latency bucket upper bounds (ms); one more bucket above, then overruns
+#define MODEM_LAT_BOUNDS 9
+static const uint32_t MODEM_LAT_BOUND_MS[MODEM_LAT_BOUNDS] = {
+    100, 200, 500, 1000, 2000, 5000, 10000, 20000, 45000,
+};
+#define MODEM_LAT_BUCKETS (MODEM_LAT_BOUNDS + 2)
+#define MODEM_LAT_OVERRUN (MODEM_LAT_BUCKETS - 1)
+
+typedef struct {
+    uint32_t calls;
+    uint32_t failures;          // Answered with an error (overruns not included)
+    uint32_t overruns;
+    uint32_t max_ms;            // Slowest answered call
+    uint32_t buckets[MODEM_LAT_BUCKETS];
+} modem_latency_t;
+
+static void modem_latency_record(modem_latency_t *lat, uint32_t ms, bool ok, bool overrun) {
+    lat->calls++;
+    if (overrun) {
+        lat->overruns++;
+        lat->buckets[MODEM_LAT_OVERRUN]++;
+        return;
+    }
+    if (!ok) {
+        lat->failures++;
+    }
+    if (ms > lat->max_ms) {
+        lat->max_ms = ms;
+    }
+    int b = 0;
+    while (b < MODEM_LAT_BOUNDS && ms > MODEM_LAT_BOUND_MS[b]) {
+        b++;
+    }
+    lat->buckets[b]++;
+}
+
+/**
+ * Upper bound of the bucket holding the given percentile
+ *
+ * @return Bucket bound in ms, max_ms for the open-ended bucket, or
+ *         UINT32_MAX if the percentile falls among the overruns
+ */
+static uint32_t modem_latency_percentile(const modem_latency_t *lat, uint32_t pct) {
+    if (lat->calls == 0) {
+        return 0;
+    }
+    uint64_t rank = ((uint64_t)lat->calls * pct + 99) / 100;
+    uint64_t seen = 0;
+    for (int b = 0; b < MODEM_LAT_BUCKETS; b++) {
+        seen += lat->buckets[b];
+        if (seen >= rank) {
+            if (b < MODEM_LAT_BOUNDS) return MODEM_LAT_BOUND_MS[b];
+            return b == MODEM_LAT_BOUNDS ? lat->max_ms : UINT32_MAX;
+        }
+    }
+    return UINT32_MAX;
+}
+
+// Calls in flight or abandoned and still waiting for their late answer
+#define MODEM_CALL_SLOTS 4
+#define MODEM_CALL_SLOT_BITS 2          // Slot index bits in a callback tag
+
+typedef enum {
+    MODEM_SLOT_FREE = 0,
+    MODEM_SLOT_PENDING,
+    MODEM_SLOT_DONE,
+    MODEM_SLOT_ABANDONED,
+} modem_slot_state_t;
+
+typedef enum {
+    MODEM_ANSWER_WAKE = 0,              // The caller is waiting: hand it the answer
+    MODEM_ANSWER_LATE,                  // The caller gave up: slot freed
+    MODEM_ANSWER_STALE,                 // The slot was taken back since: ignore
+} modem_answer_t;
+
+typedef struct {
+    uint8_t state;                      // modem_slot_state_t
+    uint32_t gen;                       // Bumped each time the slot is taken
+} modem_slot_t;
+
+/**
+ * Callback argument for a slot: its index and the generation it was taken with
+ */
+static inline uintptr_t modem_slot_tag(int index, uint32_t gen) {
+    return ((uintptr_t)gen << MODEM_CALL_SLOT_BITS) | (uintptr_t)index;
+}
+
+/**
+ * Take a free slot (the caller holds the slot lock)
+ *
+ * @return Slot index, or -1 if every slot is busy or abandoned
+ */
+static int modem_slot_take(modem_slot_t *slots) {
+    for (int i = 0; i < MODEM_CALL_SLOTS; i++) {
+        if (slots[i].state == MODEM_SLOT_FREE) {
+            slots[i].state = MODEM_SLOT_PENDING;
+            slots[i].gen++;
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * An answer came in for the given tag (the caller holds the slot lock)
+ */
+static modem_answer_t modem_slot_answer(modem_slot_t *slots, uintptr_t tag) {
+    modem_slot_t *slot = &slots[tag & (MODEM_CALL_SLOTS - 1)];
+    if (modem_slot_tag((int)(tag & (MODEM_CALL_SLOTS - 1)), slot->gen) != tag) {
+        return MODEM_ANSWER_STALE;
+    }
+    if (slot->state == MODEM_SLOT_ABANDONED) {
+        slot->state = MODEM_SLOT_FREE;
+        return MODEM_ANSWER_LATE;
+    }
+    if (slot->state != MODEM_SLOT_PENDING) {
+        return MODEM_ANSWER_STALE;
+    }
+    slot->state = MODEM_SLOT_DONE;
+    return MODEM_ANSWER_WAKE;
+}
+
+/**
+ * The modem was reset: no abandoned call will be answered, free their
+ * slots (the caller holds the slot lock)
+ *
+ * @return Slots taken back
+ */
+static uint32_t modem_slot_reclaim(modem_slot_t *slots) {
+    uint32_t freed = 0;
+    for (int i = 0; i < MODEM_CALL_SLOTS; i++) {
+        if (slots[i].state == MODEM_SLOT_ABANDONED) {
+            slots[i].state = MODEM_SLOT_FREE;
+            freed++;
+        }
+    }
+    return freed;
+}
+
+static_assert((MODEM_CALL_SLOTS & (MODEM_CALL_SLOTS - 1)) == 0 &&
+              MODEM_CALL_SLOTS == 1 << MODEM_CALL_SLOT_BITS, "slot index must fit the tag");
+
+#ifdef ESP_PLATFORM
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <WalterModem.h>
+
+extern WalterModem modem;
+
+static const char *DEADLINE_TAG = "modem_deadline";
+
+typedef struct {
+    SemaphoreHandle_t done;
+    WalterModemRsp rsp;
+} modem_call_slot_t;
+
+/**
+ * An abandoned call whose command the modem may still carry out
+ */
+typedef struct {
+    bool pending;               // false = nothing outstanding
+    uint8_t slot;
+    uint32_t gen;
+    uint32_t resets;            // g_modem_deadline.resets when it was abandoned
+} modem_call_ticket_t;
+
+// Updated from the calling tasks and the library's callback task, under g_modem_slot_lock
+typedef struct {
+    modem_latency_t latency[MODEM_CLASS_COUNT];
+    uint32_t late_answers;      // Answers that arrived after their deadline
+    uint32_t resets;
+    uint32_t consecutive_overruns;
+    uint32_t reclaimed;         // Abandoned slots taken back by a reset
+} modem_deadline_stats_t;
+
+static modem_call_slot_t g_modem_calls[MODEM_CALL_SLOTS];
+static modem_slot_t g_modem_slots[MODEM_CALL_SLOTS];      // Under g_modem_slot_lock
+static modem_deadline_stats_t g_modem_deadline = {};
+static portMUX_TYPE g_modem_slot_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void modem_deadline_init(void) {
+    for (int i = 0; i < MODEM_CALL_SLOTS; i++) {
+        g_modem_calls[i].done = xSemaphoreCreateBinary();
+        g_modem_slots[i].state = g_modem_calls[i].done != NULL ? MODEM_SLOT_FREE : MODEM_SLOT_PENDING;
+    }
+}
+
+/**
+ * @return Slot index, or -1 if none is free
+ */
+static int modem_slot_acquire(uint32_t *gen) {
+    taskENTER_CRITICAL(&g_modem_slot_lock);
+    int i = modem_slot_take(g_modem_slots);
+    if (i >= 0) {
+        *gen = g_modem_slots[i].gen;
+    }
+    taskEXIT_CRITICAL(&g_modem_slot_lock);
+    if (i >= 0) {
+        xSemaphoreTake(g_modem_calls[i].done, 0);   // Clear a give left by a raced abandon
+    }
+    return i;
+}
+
+static void modem_slot_free(int i) {
+    taskENTER_CRITICAL(&g_modem_slot_lock);
+    g_modem_slots[i].state = MODEM_SLOT_FREE;
+    taskEXIT_CRITICAL(&g_modem_slot_lock);
+}
+
+/**
+ * Library callback: hand the answer to the waiting caller, or drop it if
+ * the caller gave up or the slot was taken back by a reset
+ */
+static void modem_deadline_cb(const WalterModemRsp *rsp, void *args) {
+    uintptr_t tag = (uintptr_t)args;
+    modem_call_slot_t *call = &g_modem_calls[tag & (MODEM_CALL_SLOTS - 1)];
+    taskENTER_CRITICAL(&g_modem_slot_lock);
+    modem_answer_t answer = modem_slot_answer(g_modem_slots, tag);
+    if (answer == MODEM_ANSWER_WAKE) {
+        call->rsp = *rsp;
+    } else {
+        g_modem_deadline.late_answers++;
+    }
+    taskEXIT_CRITICAL(&g_modem_slot_lock);
+    if (answer == MODEM_ANSWER_WAKE) {
+        xSemaphoreGive(call->done);
+    }
+}
+
+/**
+ * Whether the modem is done with an abandoned call (answered late, or reset)
+ */
+static bool modem_call_settled(const modem_call_ticket_t *ticket) {
+    if (!ticket->pending) {
+        return true;
+    }
+    taskENTER_CRITICAL(&g_modem_slot_lock);
+    const modem_slot_t *slot = &g_modem_slots[ticket->slot];
+    bool settled = slot->gen != ticket->gen || slot->state != MODEM_SLOT_ABANDONED ||
+                   g_modem_deadline.resets != ticket->resets;
+    taskEXIT_CRITICAL(&g_modem_slot_lock);
+    return settled;
+}
+
+/**
+ * Modem resets so far; a change means every pending command is gone
+ */
+static uint32_t modem_deadline_resets(void) {
+    taskENTER_CRITICAL(&g_modem_slot_lock);
+    uint32_t resets = g_modem_deadline.resets;
+    taskEXIT_CRITICAL(&g_modem_slot_lock);
+    return resets;
+}
+
+/**
+ * Too many overruns in a row (or no free slot): the modem is stuck, reset it
+ *
+ * The reset drops every command the modem still holds, so the abandoned
+ * slots are taken back first; that also leaves a slot for the reset
+ * itself. The reset goes through the callback interface as well, so a
+ * modem that does not come back cannot block here either; if it times
+ * out, the next abort takes its slot back.
+ */
+static void modem_deadline_abort(void) {
+    taskENTER_CRITICAL(&g_modem_slot_lock);
+    uint32_t overruns = g_modem_deadline.consecutive_overruns;
+    uint32_t freed = modem_slot_reclaim(g_modem_slots);
+    g_modem_deadline.reclaimed += freed;
+    g_modem_deadline.resets++;
+    g_modem_deadline.consecutive_overruns = 0;
+    taskEXIT_CRITICAL(&g_modem_slot_lock);
+    ESP_LOGE(DEADLINE_TAG, "%lu modem calls in a row missed their deadline, resetting modem "
+             "(%lu abandoned calls dropped)", (unsigned long)overruns, (unsigned long)freed);
+    uint32_t gen;
+    int i = modem_slot_acquire(&gen);
+    if (i < 0) {
+        ESP_LOGE(DEADLINE_TAG, "No free call slot for the reset");
+        return;
+    }
+    if (!modem.reset(NULL, modem_deadline_cb, (void *)modem_slot_tag(i, gen)) ||
+        xSemaphoreTake(g_modem_calls[i].done, pdMS_TO_TICKS(MODEM_CLASS_BUDGET_MS[MODEM_CLASS_RADIO])) != pdTRUE) {
+        taskENTER_CRITICAL(&g_modem_slot_lock);
+        modem_slot_t *slot = &g_modem_slots[i];
+        slot->state = slot->state == MODEM_SLOT_PENDING ? MODEM_SLOT_ABANDONED : MODEM_SLOT_FREE;
+        taskEXIT_CRITICAL(&g_modem_slot_lock);
+        ESP_LOGE(DEADLINE_TAG, "Modem reset did not complete");
+        return;
+    }
+    modem_slot_free(i);
+}
+
+/**
+ * Run one modem command with its class deadline
+ *
+ * @param start Issues the command with the given callback and argument,
+ *              e.g. [](walterModemCb cb, void *arg) { return modem.setRAT(rat, NULL, cb, arg); }
+ * @param rsp Receives the answer (may be NULL)
+ * @param abandoned Set if the call missed its deadline, cleared otherwise
+ *                  (may be NULL; see modem_call_settled())
+ * @return true if the modem answered OK within the deadline
+ */
+template <typename Start>
+static bool modem_call(modem_class_t cls, const char *name, WalterModemRsp *rsp, Start start,
+                       modem_call_ticket_t *abandoned = NULL) {
+    modem_latency_t *lat = &g_modem_deadline.latency[cls];
+    if (abandoned != NULL) {
+        abandoned->pending = false;
+    }
+    uint32_t gen;
+    int i = modem_slot_acquire(&gen);
+    if (i < 0) {
+        // Every slot is held by an abandoned call: the modem is not answering
+        ESP_LOGE(DEADLINE_TAG, "%s: no free call slot", name);
+        taskENTER_CRITICAL(&g_modem_slot_lock);
+        modem_latency_record(lat, 0, false, true);
+        taskEXIT_CRITICAL(&g_modem_slot_lock);
+        modem_deadline_abort();
+        return false;
+    }
+
+    int64_t start_us = esp_timer_get_time();
+    modem_call_slot_t *call = &g_modem_calls[i];
+    modem_slot_t *slot = &g_modem_slots[i];
+    if (!start(modem_deadline_cb, (void *)modem_slot_tag(i, gen))) {
+        uint32_t ms = (uint32_t)((esp_timer_get_time() - start_us) / 1000);
+        taskENTER_CRITICAL(&g_modem_slot_lock);
+        slot->state = MODEM_SLOT_FREE;
+        modem_latency_record(lat, ms, false, false);
+        taskEXIT_CRITICAL(&g_modem_slot_lock);
+        return false;
+    }
+
+    bool answered = xSemaphoreTake(call->done, pdMS_TO_TICKS(MODEM_CLASS_BUDGET_MS[cls])) == pdTRUE;
+    uint32_t ms = (uint32_t)((esp_timer_get_time() - start_us) / 1000);
+    bool reset = false;
+    taskENTER_CRITICAL(&g_modem_slot_lock);
+    if (!answered) {
+        answered = slot->state == MODEM_SLOT_DONE;      // Answer raced the timeout
+    }
+    if (!answered) {
+        slot->state = MODEM_SLOT_ABANDONED;
+        modem_latency_record(lat, ms, false, true);
+        reset = ++g_modem_deadline.consecutive_overruns >= MODEM_DEADLINE_RESET_AFTER;
+        if (abandoned != NULL) {
+            abandoned->pending = true;
+            abandoned->slot = (uint8_t)i;
+            abandoned->gen = gen;
+            abandoned->resets = g_modem_deadline.resets;
+        }
+    }
+    taskEXIT_CRITICAL(&g_modem_slot_lock);
+
+    if (!answered) {
+        ESP_LOGE(DEADLINE_TAG, "%s: no answer within %lu ms (%s budget)", name,
+                 (unsigned long)MODEM_CLASS_BUDGET_MS[cls], MODEM_CLASS_NAMES[cls]);
+        if (reset) {
+            modem_deadline_abort();
+        }
+        return false;
+    }
+
+    bool ok = call->rsp.result == WALTER_MODEM_STATE_OK;
+    if (rsp != NULL) {
+        *rsp = call->rsp;
+    }
+    taskENTER_CRITICAL(&g_modem_slot_lock);
+    slot->state = MODEM_SLOT_FREE;
+    g_modem_deadline.consecutive_overruns = 0;
+    modem_latency_record(lat, ms, ok, false);
+    taskEXIT_CRITICAL(&g_modem_slot_lock);
+    return ok;
+}
+
+/**
+ * Copy the counters (they change under the lock)
+ */
+static void modem_deadline_snapshot(modem_deadline_stats_t *out) {
+    taskENTER_CRITICAL(&g_modem_slot_lock);
+    *out = g_modem_deadline;
+    taskEXIT_CRITICAL(&g_modem_slot_lock);
+}
+
+static void modem_deadline_log_stats(void) {
+    modem_deadline_stats_t stats;
+    modem_deadline_snapshot(&stats);
+    for (int c = 0; c < MODEM_CLASS_COUNT; c++) {
+        const modem_latency_t *lat = &stats.latency[c];
+        if (lat->calls == 0) {
+            continue;
+        }
+        uint32_t p50 = modem_latency_percentile(lat, 50);
+        uint32_t p99 = modem_latency_percentile(lat, 99);
+        ESP_LOGI(DEADLINE_TAG, "%-6s calls=%lu failed=%lu overruns=%lu p50<=%ld p99<=%ld max=%lu ms",
+                 MODEM_CLASS_NAMES[c], (unsigned long)lat->calls, (unsigned long)lat->failures,
+                 (unsigned long)lat->overruns, p50 == UINT32_MAX ? -1L : (long)p50,
+                 p99 == UINT32_MAX ? -1L : (long)p99, (unsigned long)lat->max_ms);
+    }
+    ESP_LOGI(DEADLINE_TAG, "late answers=%lu modem resets=%lu abandoned calls dropped=%lu",
+             (unsigned long)stats.late_answers, (unsigned long)stats.resets,
+             (unsigned long)stats.reclaimed);
+}
+
+#endif // ESP_PLATFORM
+
+#endif // MODEM_DEADLINE_H
@@ -0,0 +1,415 @@
+/**
+ * Modem UART Tap and Trace Recorder for Walter Modem
+ *
+ * The WalterModem library owns the modem UART, so the tap sits under it:
+ * main/CMakeLists.txt links with --wrap=uart_read_bytes and
+ * --wrap=uart_write_bytes, and the wrappers below see every byte the
+ * library exchanges with the modem. RX bytes go to g_at_tap_capture
+ * (at_response.h) for commands that need the raw response lines.
+ *
+ * With CONFIG_WALTER_MODEM_TRACE the tap also records the traffic into the
+ * "trace" flash partition in the WMT1 format:
+ *
+ *   header   "WMT1", u32 LE uptime in ms at the start of the recording
+ *   record   varint (len << 2 | kind), varint ms since the previous
+ *            record, len bytes (kind: 0 = RX, 1 = TX, 2 = mark)
+ *
+ * A record starting with 0xFF (erased flash) ends the trace. The 'trace'
+ * console command starts, stops and dumps a recording; host/modem_trace
+ * decodes and replays it. The format code has no ESP-IDF dependencies.
+ */
+
+#ifndef MODEM_TRACE_H
+#define MODEM_TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define MODEM_TRACE_MAGIC "WMT1"
+#define MODEM_TRACE_HEADER_SIZE 8
+#define MODEM_TRACE_END 0xFF            // Erased flash: no more records
+#define MODEM_TRACE_CHUNK_MAX 256       // Longer writes are split
+#define MODEM_TRACE_STAGE_SIZE 512      // Staging buffer in front of the sink
+
+typedef enum {
+    MODEM_TRACE_RX = 0,                 // Modem -> ESP32
+    MODEM_TRACE_TX,                     // ESP32 -> modem
+    MODEM_TRACE_MARK,                   // Text note (e.g. "boot", "trace start")
+} modem_trace_kind_t;
+
+static size_t modem_trace_varint_put(uint8_t *out, uint32_t value) {
+    size_t n = 0;
+    while (value >= 0x80) {
+        out[n++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = (uint8_t)value;
+    return n;
+}
+
+/**
+ * @return Bytes consumed, 0 if the varint is truncated or too long
+ */
+static size_t modem_trace_varint_get(const uint8_t *in, size_t avail, uint32_t *value) {
+    uint32_t v = 0;
+    for (size_t i = 0; i < avail && i < 5; i++) {
+        v |= (uint32_t)(in[i] & 0x7F) << (7 * i);
+        if ((in[i] & 0x80) == 0) {
+            *value = v;
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+// ----------------------------------------------------------------------------
+// Writer
+// ----------------------------------------------------------------------------
+
+/**
+ * Where a finished stage goes (flash partition on the device, a file on
+ * the host); returns false when the sink is full
+ */
+typedef bool (*modem_trace_sink_t)(void *ctx, uint32_t offset, const uint8_t *data, size_t len);
+
+typedef struct {
+    modem_trace_sink_t sink;
+    void *ctx;
+    uint32_t capacity;                  // Sink size in bytes
+    uint32_t written;                   // Bytes handed to the sink
+    uint32_t last_ms;
+    uint32_t records;
+    uint32_t dropped;                   // Records that did not fit
+    bool full;
+    uint16_t fill;
+    uint8_t stage[MODEM_TRACE_STAGE_SIZE];
+} modem_trace_writer_t;
+
+static bool modem_trace_flush(modem_trace_writer_t *w) {
+    if (w->fill == 0) {
+        return true;
+    }
+    if (!w->sink(w->ctx, w->written, w->stage, w->fill)) {
+        w->full = true;
+        return false;
+    }
+    w->written += w->fill;
+    w->fill = 0;
+    return true;
+}
+
+static void modem_trace_writer_init(modem_trace_writer_t *w, modem_trace_sink_t sink, void *ctx,
+                                    uint32_t capacity, uint32_t now_ms) {
+    memset(w, 0, sizeof(*w));
+    w->sink = sink;
+    w->ctx = ctx;
+    w->capacity = capacity;
+    w->last_ms = now_ms;
+    memcpy(w->stage, MODEM_TRACE_MAGIC, 4);
+    for (int i = 0; i < 4; i++) {
+        w->stage[4 + i] = (uint8_t)(now_ms >> (8 * i));
+    }
+    w->fill = MODEM_TRACE_HEADER_SIZE;
+}
+
+/**
+ * Append one record; long data is split into MODEM_TRACE_CHUNK_MAX pieces
+ *
+ * Once the sink is full the recording stops: the start of a session (the
+ * connect sequence) is usually what matters.
+ */
+static void modem_trace_append(modem_trace_writer_t *w, modem_trace_kind_t kind, uint32_t now_ms,
+                               const void *data, size_t len) {
+    const uint8_t *p = (const uint8_t *)data;
+    do {
+        size_t n = len < MODEM_TRACE_CHUNK_MAX ? len : MODEM_TRACE_CHUNK_MAX;
+        uint8_t head[10];
+        size_t head_len = modem_trace_varint_put(head, (uint32_t)(n << 2 | kind));
+        head_len += modem_trace_varint_put(head + head_len, now_ms - w->last_ms);
+        size_t total = head_len + n;
+        if (w->full || w->written + w->fill + total > w->capacity) {
+            w->full = true;
+            w->dropped++;
+            return;
+        }
+        if (w->fill + total > MODEM_TRACE_STAGE_SIZE && !modem_trace_flush(w)) {
+            w->dropped++;
+            return;
+        }
+        memcpy(w->stage + w->fill, head, head_len);
+        memcpy(w->stage + w->fill + head_len, p, n);
+        w->fill += (uint16_t)total;
+        w->last_ms = now_ms;
+        w->records++;
+        p += n;
+        len -= n;
+    } while (len > 0);
+}
+
+// ----------------------------------------------------------------------------
+// Reader
+// ----------------------------------------------------------------------------
+
+typedef struct {
+    modem_trace_kind_t kind;
+    uint32_t t_ms;                      // Since the start of the recording
+    const uint8_t *data;
+    uint16_t len;
+} modem_trace_record_t;
+
+typedef struct {
+    const uint8_t *data;
+    size_t len;
+    size_t pos;
+    uint32_t start_ms;                  // Uptime at the start of the recording
+    uint32_t t_ms;
+    bool truncated;                     // Stopped in the middle of a record
+} modem_trace_reader_t;
+
+static bool modem_trace_reader_init(modem_trace_reader_t *r, const uint8_t *data, size_t len) {
+    memset(r, 0, sizeof(*r));
+    if (len < MODEM_TRACE_HEADER_SIZE || memcmp(data, MODEM_TRACE_MAGIC, 4) != 0) {
+        return false;
+    }
+    r->data = data;
+    r->len = len;
+    r->pos = MODEM_TRACE_HEADER_SIZE;
+    for (int i = 0; i < 4; i++) {
+        r->start_ms |= (uint32_t)data[4 + i] << (8 * i);
+    }
+    return true;
+}
+
+static bool modem_trace_next(modem_trace_reader_t *r, modem_trace_record_t *rec) {
+    if (r->pos >= r->len || r->data[r->pos] == MODEM_TRACE_END) {
+        return false;
+    }
+    uint32_t head, dt;
+    size_t n = modem_trace_varint_get(r->data + r->pos, r->len - r->pos, &head);
+    size_t m = n ? modem_trace_varint_get(r->data + r->pos + n, r->len - r->pos - n, &dt) : 0;
+    uint32_t len = head >> 2;
+    if (n == 0 || m == 0 || (head & 3) > MODEM_TRACE_MARK || len > MODEM_TRACE_CHUNK_MAX ||
+        r->pos + n + m + len > r->len) {
+        r->truncated = true;
+        return false;
+    }
+    r->t_ms += dt;
+    rec->kind = (modem_trace_kind_t)(head & 3);
+    rec->t_ms = r->t_ms;
+    rec->data = r->data + r->pos + n + m;
+    rec->len = (uint16_t)len;
+    r->pos += n + m + len;
+    return true;
+}
+
+#ifdef ESP_PLATFORM
+
+#include <stdio.h>
+#include <driver/uart.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <sdkconfig.h>
+#include "at_response.h"
+
+static const char *TRACE_TAG = "modem_trace";
+
+// Modem UART the tap listens on (set by modem_tap_init, -1 = none)
+static volatile int g_modem_tap_port = -1;
+
+#ifdef CONFIG_WALTER_MODEM_TRACE
+
+#include <esp_partition.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+#define MODEM_TRACE_PARTITION "trace"
+#define MODEM_TRACE_PARTITION_SUBTYPE 0x40
+#define MODEM_TRACE_DUMP_LINE 32
+
+typedef struct {
+    const esp_partition_t *part;
+    SemaphoreHandle_t lock;             // RX and TX come from different tasks
+    volatile bool recording;
+    bool erasing;                       // modem_trace_start() is erasing, lock not held
+    modem_trace_writer_t writer;
+} modem_trace_state_t;
+
+static modem_trace_state_t g_modem_trace = {};
+
+static uint32_t modem_trace_now_ms(void) {
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+static bool modem_trace_partition_sink(void *ctx, uint32_t offset, const uint8_t *data, size_t len) {
+    const esp_partition_t *part = (const esp_partition_t *)ctx;
+    return esp_partition_write(part, offset, data, len) == ESP_OK;
+}
+
+static void modem_trace_record(modem_trace_kind_t kind, const void *data, size_t len) {
+    if (!g_modem_trace.recording || len == 0) {
+        return;
+    }
+    xSemaphoreTake(g_modem_trace.lock, portMAX_DELAY);
+    if (g_modem_trace.recording) {
+        modem_trace_append(&g_modem_trace.writer, kind, modem_trace_now_ms(), data, len);
+    }
+    xSemaphoreGive(g_modem_trace.lock);
+}
+
+static void modem_trace_mark(const char *note) {
+    modem_trace_record(MODEM_TRACE_MARK, note, strlen(note));
+}
+
+/**
+ * Erase the trace partition and start recording into it
+ *
+ * The erase takes a while for the whole partition, so it runs without
+ * the lock: the UART paths must not wait on it. Recording is switched off
+ * under the lock first, so nothing writes to the partition meanwhile.
+ */
+static bool modem_trace_start(void) {
+    if (g_modem_trace.part == NULL || g_modem_trace.lock == NULL) {
+        ESP_LOGE(TRACE_TAG, "No '%s' partition (see partitions.csv)", MODEM_TRACE_PARTITION);
+        return false;
+    }
+    xSemaphoreTake(g_modem_trace.lock, portMAX_DELAY);
+    bool busy = g_modem_trace.erasing;
+    g_modem_trace.erasing = true;
+    g_modem_trace.recording = false;
+    xSemaphoreGive(g_modem_trace.lock);
+    if (busy) {
+        ESP_LOGW(TRACE_TAG, "Trace partition is already being erased");
+        return false;
+    }
+
+    esp_err_t err = esp_partition_erase_range(g_modem_trace.part, 0, g_modem_trace.part->size);
+
+    xSemaphoreTake(g_modem_trace.lock, portMAX_DELAY);
+    if (err == ESP_OK) {
+        modem_trace_writer_init(&g_modem_trace.writer, modem_trace_partition_sink,
+                                (void *)g_modem_trace.part, g_modem_trace.part->size,
+                                modem_trace_now_ms());
+        g_modem_trace.recording = true;
+    }
+    g_modem_trace.erasing = false;
+    xSemaphoreGive(g_modem_trace.lock);
+    if (err != ESP_OK) {
+        ESP_LOGE(TRACE_TAG, "Erasing trace partition failed: %s", esp_err_to_name(err));
+        return false;
+    }
+    ESP_LOGI(TRACE_TAG, "Recording modem traffic (%lu KB partition)",
+             (unsigned long)(g_modem_trace.part->size / 1024));
+    return true;
+}
+
+static void modem_trace_stop(void) {
+    xSemaphoreTake(g_modem_trace.lock, portMAX_DELAY);
+    bool was_recording = g_modem_trace.recording;
+    g_modem_trace.recording = false;
+    if (was_recording) {
+        modem_trace_flush(&g_modem_trace.writer);
+    }
+    xSemaphoreGive(g_modem_trace.lock);
+    if (was_recording) {
+        ESP_LOGI(TRACE_TAG, "Trace stopped: %lu records, %lu bytes, %lu dropped",
+                 (unsigned long)g_modem_trace.writer.records,
+                 (unsigned long)g_modem_trace.writer.written,
+                 (unsigned long)g_modem_trace.writer.dropped);
+    }
+}
+
+/**
+ * Print the recorded trace as "WMT <offset> <hex>" lines
+ *
+ * host/modem_trace import turns a console log with these lines back into
+ * a trace file. Stops at the first all-erased line.
+ */
+static void modem_trace_dump(void) {
+    if (g_modem_trace.part == NULL) {
+        ESP_LOGE(TRACE_TAG, "No '%s' partition", MODEM_TRACE_PARTITION);
+        return;
+    }
+    if (g_modem_trace.recording) {
+        modem_trace_stop();
+    }
+    uint8_t line[MODEM_TRACE_DUMP_LINE];
+    char hex[2 * MODEM_TRACE_DUMP_LINE + 1];
+    for (uint32_t off = 0; off + sizeof(line) <= g_modem_trace.part->size; off += sizeof(line)) {
+        if (esp_partition_read(g_modem_trace.part, off, line, sizeof(line)) != ESP_OK) {
+            break;
+        }
+        bool erased = true;
+        for (size_t i = 0; i < sizeof(line); i++) {
+            erased = erased && line[i] == 0xFF;
+            static const char digits[] = "0123456789abcdef";
+            hex[2 * i] = digits[line[i] >> 4];
+            hex[2 * i + 1] = digits[line[i] & 0xF];
+        }
+        if (erased) {
+            break;
+        }
+        hex[2 * sizeof(line)] = '\0';
+        printf("WMT %06lx %s\n", (unsigned long)off, hex);
+    }
+    printf("WMT end\n");
+}
+
+#else
+
+static inline void modem_trace_record(modem_trace_kind_t, const void *, size_t) {}
+static inline void modem_trace_mark(const char *) {}
+
+#endif // CONFIG_WALTER_MODEM_TRACE
+
+/**
+ * Point the tap at the modem UART; with CONFIG_WALTER_MODEM_TRACE_BOOT the
+ * recording starts here, before the modem is brought up
+ */
+static void modem_tap_init(uart_port_t port) {
+    g_modem_tap_port = port;
+#ifdef CONFIG_WALTER_MODEM_TRACE
+    g_modem_trace.lock = xSemaphoreCreateMutex();
+    g_modem_trace.part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                                  (esp_partition_subtype_t)MODEM_TRACE_PARTITION_SUBTYPE,
+                                                  MODEM_TRACE_PARTITION);
+#ifdef CONFIG_WALTER_MODEM_TRACE_BOOT
+    if (modem_trace_start()) {
+        modem_trace_mark("boot");
+    }
+#endif
+#endif
+}
+
+extern "C" {
+
+int __real_uart_read_bytes(uart_port_t uart_num, void *buf, uint32_t length, TickType_t ticks_to_wait);
+int __real_uart_write_bytes(uart_port_t uart_num, const void *src, size_t size);
+
+/**
+ * Library RX path: copy what the modem sent to the tap capture and trace
+ */
+int __wrap_uart_read_bytes(uart_port_t uart_num, void *buf, uint32_t length, TickType_t ticks_to_wait) {
+    int n = __real_uart_read_bytes(uart_num, buf, length, ticks_to_wait);
+    if (n > 0 && (int)uart_num == g_modem_tap_port) {
+        at_capture_t *cap = g_at_tap_capture;
+        if (cap != NULL) {
+            at_capture_feed(cap, (const char *)buf, (size_t)n);
+        }
+        modem_trace_record(MODEM_TRACE_RX, buf, (size_t)n);
+    }
+    return n;
+}
+
+int __wrap_uart_write_bytes(uart_port_t uart_num, const void *src, size_t size) {
+    if ((int)uart_num == g_modem_tap_port) {
+        modem_trace_record(MODEM_TRACE_TX, src, size);
+    }
+    return __real_uart_write_bytes(uart_num, src, size);
+}
+
+}
+
+#endif // ESP_PLATFORM
+
+#endif // MODEM_TRACE_H
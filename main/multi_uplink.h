@@ -0,0 +1,441 @@
+/**
+ * Multi-Lane Uplink for Walter Modem
+ *
+ * Drains a backlog through several modem HTTP profiles at once instead of
+ * one POST after the other. On NB-IoT most of a POST is waiting for the
+ * network round trip, so while one profile waits for its response the
+ * next one is already sending.
+ *
+ * Payloads are handed out from the head of the uplink queue through a
+ * bounded window: at most MULTI_UPLINK_WINDOW payloads are between
+ * "started" and "released". Responses may come back in any order, but
+ * payloads are released (and their results reported) strictly in queue
+ * order, so the SPSC queue and the sensor core see the same sequence as
+ * with a single stream. A failed POST is retried on whichever lane is
+ * free next, up to MULTI_UPLINK_MAX_TRIES times. A payload the server
+ * refused for good (see uplink_window_reject()) is not retried; it is
+ * released in order like a sent one, flagged. A payload given up on
+ * stalls the window: nothing new starts, and it stays at the head of the
+ * queue for the next session together with everything behind it.
+ *
+ * The library has no way to cancel a command, so a lane that gives up
+ * keeps what the modem may still use. A send that timed out leaves the
+ * lane ABANDONED: its copy of the payload stays untouched until the send
+ * callback fires (checked against the lane's generation) or the modem is
+ * reset. A response that timed out leaves the lane STALE: the late ring is
+ * read and thrown away before the profile carries another POST, so it is
+ * never taken for the answer to the next one.
+ *
+ * The window bookkeeping has no ESP-IDF dependencies; host/uplink_drain_sim
+ * drives it against the modem simulator.
+ */
+
+#ifndef MULTI_UPLINK_H
+#define MULTI_UPLINK_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define MULTI_UPLINK_WINDOW 4           // Payloads started but not yet released
+#define MULTI_UPLINK_WINDOW_MAX 32      // Width of the window bit masks
+#define MULTI_UPLINK_MAX_TRIES 3
+
+typedef struct {
+    uint32_t base;                      // Oldest payload not yet released
+    uint32_t next;                      // Next payload never started
+    uint32_t done_mask;                 // Bit i: base + i finished (sent or given up)
+    uint32_t ok_mask;                   // Bit i: base + i was sent
+    uint32_t retry_mask;                // Bit i: base + i failed and waits for a lane
+    uint32_t rejected_mask;             // Bit i: base + i was refused for good
+    uint32_t size;                      // Window size, <= MULTI_UPLINK_WINDOW_MAX
+    uint8_t tries[MULTI_UPLINK_WINDOW_MAX]; // Indexed by payload % MULTI_UPLINK_WINDOW_MAX
+    uint32_t retries;
+    uint32_t given_up;
+    uint32_t held;                      // Finished while an older payload was still out
+    bool stalled;                       // A payload was given up on, see uplink_window_release()
+} uplink_window_t;
+
+static void uplink_window_init(uplink_window_t *w, uint32_t size = MULTI_UPLINK_WINDOW) {
+    memset(w, 0, sizeof(*w));
+    w->size = size < MULTI_UPLINK_WINDOW_MAX ? size : MULTI_UPLINK_WINDOW_MAX;
+}
+
+/**
+ * Pick the next payload for a free lane: retries first, then new ones
+ *
+ * @param available Payloads queued from base on
+ * @param id Receives the payload (queue index id - base)
+ * @return false if nothing may start now
+ */
+static bool uplink_window_take(uplink_window_t *w, uint32_t available, uint32_t *id) {
+    if (w->stalled) {
+        return false;
+    }
+    if (w->retry_mask != 0) {
+        int bit = __builtin_ctz(w->retry_mask);
+        w->retry_mask &= ~(1u << bit);
+        *id = w->base + bit;
+        return true;
+    }
+    if (w->next - w->base >= w->size || w->next - w->base >= available) {
+        return false;
+    }
+    *id = w->next++;
+    w->tries[*id % MULTI_UPLINK_WINDOW_MAX] = 0;
+    return true;
+}
+
+/**
+ * Record the outcome of one POST
+ */
+static void uplink_window_finish(uplink_window_t *w, uint32_t id, bool ok) {
+    uint32_t bit = 1u << (id - w->base);
+    if (!ok && ++w->tries[id % MULTI_UPLINK_WINDOW_MAX] < MULTI_UPLINK_MAX_TRIES) {
+        w->retry_mask |= bit;
+        w->retries++;
+        return;
+    }
+    if (!ok) {
+        w->given_up++;
+        w->stalled = true;
+    }
+    if (id != w->base) {
+        w->held++;
+    }
+    w->done_mask |= bit;
+    if (ok) {
+        w->ok_mask |= bit;
+    }
+}
+
+/**
+ * The server refused a payload for good: finish it without a retry
+ *
+ * It is released in order like a sent payload, flagged as rejected, so
+ * it does not hold up the ones behind it.
+ */
+static void uplink_window_reject(uplink_window_t *w, uint32_t id) {
+    uplink_window_finish(w, id, true);
+    w->rejected_mask |= 1u << (id - w->base);
+}
+
+/**
+ * Release the oldest payload if it was sent (or refused for good)
+ *
+ * Call until it returns false; payloads come out in queue order. A
+ * payload that was given up on is never released: release stops in
+ * front of it, and the window is stalled (see uplink_window_idle()).
+ *
+ * @param rejected Receives whether the payload was refused (may be NULL)
+ */
+static bool uplink_window_release(uplink_window_t *w, bool *rejected = NULL) {
+    if ((w->done_mask & w->ok_mask & 1u) == 0) {
+        return false;
+    }
+    if (rejected != NULL) {
+        *rejected = (w->rejected_mask & 1u) != 0;
+    }
+    w->done_mask >>= 1;
+    w->ok_mask >>= 1;
+    w->retry_mask >>= 1;
+    w->rejected_mask >>= 1;
+    w->base++;
+    return true;
+}
+
+/**
+ * Nothing left to start: either every payload was released or the window
+ * stalled on one that failed (which stays queued)
+ *
+ * @param available Payloads queued from base on
+ */
+static inline bool uplink_window_idle(const uplink_window_t *w, uint32_t available) {
+    return w->stalled || (w->retry_mask == 0 && available == 0);
+}
+
+#ifdef ESP_PLATFORM
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <WalterModem.h>
+#include "dns_cache.h"
+#include "modem_deadline.h"
+#include "tls_profile.h"
+
+extern WalterModem modem;
+
+static const char *MULTI_TAG = "multi_uplink";
+
+// HTTP profiles used as lanes (profile 1 is taken by delta OTA downloads)
+#define MULTI_UPLINK_LANES 2
+static const uint8_t MULTI_UPLINK_PROFILES[MULTI_UPLINK_LANES] = { TLS_HTTP_PROFILE_ID, 2 };
+
+#define MULTI_UPLINK_MIN_BACKLOG 3      // Below this a single stream is as fast
+#define MULTI_UPLINK_POLL_MS 200
+#define MULTI_UPLINK_RSP_MAX 256
+#define MULTI_UPLINK_PAYLOAD_MAX 2432   // Lane copy of a payload, >= PIPELINE_PAYLOAD_MAX
+#define MULTI_UPLINK_STALE_MS 15000     // Wait for a late ring before the profile is reused
+
+typedef enum {
+    MULTI_UPLINK_SENT = 0,              // Release it
+    MULTI_UPLINK_REJECTED,              // Refused for good by the server: release it
+    MULTI_UPLINK_KEPT,                  // Given up on: it stays queued, the drain stops
+} multi_uplink_outcome_t;
+
+/**
+ * Where the drain gets its payloads and reports them done
+ */
+typedef struct {
+    // Payload index places behind the oldest unreleased one, NULL if none
+    const char *(*payload)(void *ctx, uint32_t index, uint16_t *len);
+    // The oldest payload is finished, called in queue order. KEPT is
+    // called at most once, last
+    void (*release)(void *ctx, multi_uplink_outcome_t outcome);
+    // Response body of a successful POST, in arrival order (may be NULL)
+    void (*response)(void *ctx, const uint8_t *body, uint16_t len);
+    void *ctx;
+} multi_uplink_source_t;
+
+typedef enum {
+    MULTI_LANE_IDLE = 0,
+    MULTI_LANE_SENDING,                 // AT+SQNHTTPSEND issued
+    MULTI_LANE_WAITING,                 // Request sent, waiting for the response ring
+    MULTI_LANE_OFF,                     // Profile could not be configured
+    MULTI_LANE_ABANDONED,               // Send timed out, the modem may still read data
+    MULTI_LANE_STALE,                   // Response timed out, its ring may still come
+} multi_lane_state_t;
+
+/**
+ * One HTTP profile. Static, not per drain: a send callback may fire after
+ * the drain that started it has returned.
+ */
+typedef struct {
+    uint8_t profile;
+    uint8_t state;                      // multi_lane_state_t
+    volatile uint8_t send_result;       // 0 = pending, 1 = OK, 2 = error (library callback)
+    volatile uint16_t gen;              // Bumped per send; the callback ignores older ones
+    uint32_t id;
+    uint32_t resets;                    // g_modem_deadline.resets when the send started
+    int64_t started_us;
+    uint8_t data[MULTI_UPLINK_PAYLOAD_MAX]; // What the modem sends, kept until the callback
+} multi_uplink_lane_t;
+
+typedef struct {
+    uint32_t drains;
+    uint32_t sent;
+    uint32_t retries;
+    uint32_t given_up;
+    uint32_t held;                      // Responses that arrived ahead of an older one
+} multi_uplink_stats_t;
+
+static multi_uplink_stats_t g_multi_uplink_stats = {};
+static multi_uplink_lane_t g_multi_uplink_lanes[MULTI_UPLINK_LANES] = {};
+
+/**
+ * Send callback: args carries the lane index and the generation of the send
+ */
+static void multi_uplink_send_cb(const WalterModemRsp *rsp, void *args) {
+    uintptr_t tag = (uintptr_t)args;
+    multi_uplink_lane_t *lane = &g_multi_uplink_lanes[tag & 0xff];
+    if (lane->gen != (uint16_t)(tag >> 8)) {
+        return;
+    }
+    lane->send_result = rsp->result == WALTER_MODEM_STATE_OK ? 1 : 2;
+}
+
+/**
+ * Copy a payload into the lane and start its POST
+ */
+static bool multi_uplink_lane_send(multi_uplink_lane_t *lane, uint8_t index, const char *path,
+                                   const char *data, uint16_t len) {
+    if (len > sizeof(lane->data)) {
+        ESP_LOGE(MULTI_TAG, "Payload of %u bytes does not fit a lane", (unsigned)len);
+        return false;
+    }
+    memcpy(lane->data, data, len);
+    lane->send_result = 0;
+    lane->gen++;
+    lane->resets = modem_deadline_resets();
+    lane->started_us = esp_timer_get_time();
+    lane->state = MULTI_LANE_SENDING;
+    uintptr_t tag = ((uintptr_t)lane->gen << 8) | index;
+    if (!modem.httpSend(lane->profile, path, lane->data, len, WALTER_MODEM_HTTP_SEND_CMD_POST,
+                        WALTER_MODEM_HTTP_POST_PARAM_JSON, NULL, multi_uplink_send_cb,
+                        (void *)tag)) {
+        lane->state = MULTI_LANE_IDLE;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Move an abandoned or stale lane back to IDLE once the modem is done with it
+ *
+ * @return true if the lane is still held
+ */
+static bool multi_uplink_lane_settle(multi_uplink_lane_t *lane) {
+    bool reset = modem_deadline_resets() != lane->resets;
+    if (lane->state == MULTI_LANE_ABANDONED && (lane->send_result != 0 || reset)) {
+        lane->state = MULTI_LANE_IDLE;
+    } else if (lane->state == MULTI_LANE_STALE) {
+        static uint8_t discard[16];
+        WalterModemRsp rsp = {};
+        if (modem.httpDidRing(lane->profile, discard, sizeof(discard), &rsp)) {
+            ESP_LOGW(MULTI_TAG, "Profile %d: late HTTP %u discarded", lane->profile,
+                     (unsigned)rsp.data.httpResponse.httpStatus);
+            lane->state = MULTI_LANE_IDLE;
+        } else if (reset || esp_timer_get_time() - lane->started_us > MULTI_UPLINK_STALE_MS * 1000LL) {
+            lane->state = MULTI_LANE_IDLE;
+        }
+    }
+    return lane->state == MULTI_LANE_ABANDONED || lane->state == MULTI_LANE_STALE;
+}
+
+static uint32_t multi_uplink_available(const multi_uplink_source_t *src) {
+    uint16_t len;
+    uint32_t n = 0;
+    while (n < MULTI_UPLINK_WINDOW && src->payload(src->ctx, n, &len) != NULL) {
+        n++;
+    }
+    return n;
+}
+
+/**
+ * Send everything the source has over all lanes
+ *
+ * Keeps taking payloads as the source refills, until it is empty (or a
+ * payload was given up on) and every lane is idle.
+ *
+ * @return Payloads released (sent)
+ */
+static uint32_t multi_uplink_drain(const char *url_str, const multi_uplink_source_t *src) {
+    http_url_t url;
+    if (!http_url_parse(url_str, &url)) {
+        ESP_LOGE(MULTI_TAG, "Unsupported URL: %s", url_str);
+        return 0;
+    }
+    char server_ip[16];
+    const char *server = NULL;
+    if (!url.https && dns_resolve(url.host, server_ip, sizeof(server_ip))) {
+        server = server_ip;
+    }
+
+    multi_uplink_lane_t *lanes = g_multi_uplink_lanes;
+    int usable = 0;
+    for (int i = 0; i < MULTI_UPLINK_LANES; i++) {
+        lanes[i].profile = MULTI_UPLINK_PROFILES[i];
+        if (multi_uplink_lane_settle(&lanes[i])) {
+            ESP_LOGW(MULTI_TAG, "Profile %d: previous send still with the modem", lanes[i].profile);
+            continue;
+        }
+        lanes[i].state = http_profile_ensure(&url, server, lanes[i].profile) ? MULTI_LANE_IDLE
+                                                                             : MULTI_LANE_OFF;
+        usable += lanes[i].state == MULTI_LANE_IDLE;
+    }
+    if (usable == 0) {
+        ESP_LOGE(MULTI_TAG, "No HTTP profile could be configured");
+        return 0;
+    }
+
+    uplink_window_t win;
+    uplink_window_init(&win);
+    uint32_t released = 0;
+    uint32_t timeout_us = MODEM_CLASS_BUDGET_MS[MODEM_CLASS_HTTP] * 1000u;
+    g_multi_uplink_stats.drains++;
+
+    while (1) {
+        bool busy = false;
+        for (int i = 0; i < MULTI_UPLINK_LANES; i++) {
+            multi_uplink_lane_t *lane = &lanes[i];
+            if (multi_uplink_lane_settle(lane)) {
+                // Only a late ring is worth waiting for: the profile must be
+                // clean when the drain returns. A lost send callback is not.
+                busy = busy || lane->state == MULTI_LANE_STALE;
+                continue;
+            }
+            if (lane->state == MULTI_LANE_IDLE) {
+                uint16_t len;
+                const char *data;
+                if (!uplink_window_take(&win, multi_uplink_available(src), &lane->id) ||
+                    (data = src->payload(src->ctx, lane->id - win.base, &len)) == NULL) {
+                    continue;
+                }
+                if (!multi_uplink_lane_send(lane, (uint8_t)i, url.path, data, len)) {
+                    uplink_window_finish(&win, lane->id, false);
+                    continue;
+                }
+            }
+
+            bool timed_out = esp_timer_get_time() - lane->started_us > timeout_us;
+            if (lane->state == MULTI_LANE_SENDING) {
+                if (lane->send_result == 1) {
+                    lane->state = MULTI_LANE_WAITING;
+                } else if (lane->send_result == 2) {
+                    lane->state = MULTI_LANE_IDLE;
+                    uplink_window_finish(&win, lane->id, false);
+                } else if (timed_out) {
+                    ESP_LOGW(MULTI_TAG, "Profile %d: send not confirmed within %lu ms",
+                             lane->profile, (unsigned long)(timeout_us / 1000));
+                    lane->state = MULTI_LANE_ABANDONED;
+                    uplink_window_finish(&win, lane->id, false);
+                }
+            }
+            if (lane->state == MULTI_LANE_WAITING) {
+                static uint8_t body[MULTI_UPLINK_RSP_MAX];
+                WalterModemRsp rsp = {};
+                if (modem.httpDidRing(lane->profile, body, sizeof(body), &rsp)) {
+                    uint16_t status = rsp.data.httpResponse.httpStatus;
+                    bool ok = http_status_ok(status);
+                    if (ok && src->response != NULL) {
+                        uint16_t len = rsp.data.httpResponse.contentLength;
+                        src->response(src->ctx, body, len < sizeof(body) ? len : sizeof(body));
+                    }
+                    lane->state = MULTI_LANE_IDLE;
+                    if (http_status_permanent(status)) {
+                        ESP_LOGW(MULTI_TAG, "Profile %d: HTTP %u, not retried", lane->profile,
+                                 (unsigned)status);
+                        uplink_window_reject(&win, lane->id);
+                    } else {
+                        uplink_window_finish(&win, lane->id, ok);
+                    }
+                } else if (timed_out) {
+                    ESP_LOGW(MULTI_TAG, "Profile %d: no response within %lu ms", lane->profile,
+                             (unsigned long)(timeout_us / 1000));
+                    lane->state = MULTI_LANE_STALE;
+                    lane->started_us = esp_timer_get_time();
+                    uplink_window_finish(&win, lane->id, false);
+                    busy = true;
+                }
+            }
+            busy = busy || lane->state == MULTI_LANE_SENDING || lane->state == MULTI_LANE_WAITING;
+        }
+
+        bool rejected;
+        while (uplink_window_release(&win, &rejected)) {
+            src->release(src->ctx, rejected ? MULTI_UPLINK_REJECTED : MULTI_UPLINK_SENT);
+            released++;
+        }
+        if (!busy && uplink_window_idle(&win, multi_uplink_available(src))) {
+            break;
+        }
+        vTaskDelay(pdMS_TO_TICKS(MULTI_UPLINK_POLL_MS));
+    }
+    if (win.stalled) {
+        src->release(src->ctx, MULTI_UPLINK_KEPT);
+    }
+
+    g_multi_uplink_stats.retries += win.retries;
+    g_multi_uplink_stats.given_up += win.given_up;
+    g_multi_uplink_stats.held += win.held;
+    g_multi_uplink_stats.sent += released;
+    ESP_LOGI(MULTI_TAG, "Drained %lu payloads over %d lanes (%lu retries, %lu failed%s)",
+             (unsigned long)released, usable, (unsigned long)win.retries,
+             (unsigned long)win.given_up, win.stalled ? ", rest kept for the next session" : "");
+    return released;
+}
+
+#endif // ESP_PLATFORM
+
+#endif // MULTI_UPLINK_H
@@ -0,0 +1,98 @@
+/**
+ * Sensor Driver Interface for Walter Modem
+ *
+ * A driver is a small table of function pointers so the sampler does not
+ * care whether readings come from real hardware or from the synthetic
+ * driver below (used on the host and on boards without sensors).
+ *
+ * Has no ESP-IDF dependencies.
+ */
+
+#ifndef SENSOR_DRIVER_H
+#define SENSOR_DRIVER_H
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * How soon a reading has to reach the server (see upload_scheduler.h)
+ */
+typedef enum {
+    SENSOR_URGENCY_BULK = 0,    // Routine sample, may be coalesced for hours
+    SENSOR_URGENCY_NORMAL,      // Should arrive within minutes
+    SENSOR_URGENCY_URGENT,      // Alarm, send right away
+    SENSOR_URGENCY_COUNT
+} sensor_urgency_t;
+
+/**
+ * One timestamped reading
+ */
+typedef struct {
+    int64_t timestamp_us;   // Monotonic time the reading was taken
+    uint32_t seq;           // Sampler tick number (gaps = missed ticks)
+    float temperature;      // °C
+    float humidity;         // %RH
+    float pressure;         // hPa
+    uint8_t urgency;        // sensor_urgency_t, BULK unless the driver raises it
+} sensor_sample_t;
+
+/**
+ * Sensor driver vtable
+ *
+ * read() fills the measurement fields, and raises urgency if the reading
+ * is an alarm; the sampler stamps timestamp_us and seq. It runs in task
+ * context and may block briefly (e.g. on I2C) but must stay well inside
+ * one sampling period.
+ */
+typedef struct {
+    const char *name;
+    bool (*init)(void *ctx);
+    bool (*read)(void *ctx, sensor_sample_t *out);
+    void *ctx;
+} sensor_driver_t;
+
+/**
+ * Synthetic driver state
+ *
+ * Produces a deterministic slow waveform around the example values used
+ * by create_sensor_json(), so output can be compared across runs.
+ */
+typedef struct {
+    uint32_t reads;
+    uint32_t fail_every;    // Fail every Nth read (0 = never), for exercising error paths
+    uint32_t urgent_every;  // Flag every Nth read as urgent (0 = never)
+} synthetic_sensor_t;
+
+static bool synthetic_sensor_init(void *ctx) {
+    synthetic_sensor_t *s = (synthetic_sensor_t *)ctx;
+    s->reads = 0;
+    return true;
+}
+
+static bool synthetic_sensor_read(void *ctx, sensor_sample_t *out) {
+    synthetic_sensor_t *s = (synthetic_sensor_t *)ctx;
+    uint32_t n = ++s->reads;
+    if (s->fail_every != 0 && n % s->fail_every == 0) {
+        return false;
+    }
+    float phase = (float)(n % 360) * 0.0174533f;
+    out->temperature = 23.5f + 2.0f * sinf(phase);
+    out->humidity = 65.2f + 5.0f * cosf(phase);
+    out->pressure = 1013.25f + 0.5f * sinf(phase * 2.0f);
+    if (s->urgent_every != 0 && n % s->urgent_every == 0) {
+        out->urgency = SENSOR_URGENCY_URGENT;
+    }
+    return true;
+}
+
+static inline sensor_driver_t synthetic_sensor_driver(synthetic_sensor_t *state) {
+    sensor_driver_t driver;
+    driver.name = "synthetic";
+    driver.init = synthetic_sensor_init;
+    driver.read = synthetic_sensor_read;
+    driver.ctx = state;
+    return driver;
+}
+
+#endif // SENSOR_DRIVER_H
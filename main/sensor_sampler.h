@@ -0,0 +1,212 @@
+/**
+ * Fixed-Rate Sensor Sampler for Walter Modem
+ *
+ * An esp_timer fires every SAMPLER_PERIOD_MS (or the period set at
+ * runtime with sampler_set_period()) and wakes a high-priority task on
+ * the sensor core, which reads the configured sensor driver and
+ * pushes a timestamped sample into a preallocated SPSC ring. Sampling
+ * therefore keeps its cadence no matter how long modem operations take;
+ * the uplink pipeline drains the ring whenever it encodes a batch.
+ *
+ * Overruns (ring full, ticks missed) and jitter against the ideal
+ * schedule are counted in g_sampler_stats. A listener task (the uplink
+ * pipeline) is notified of every sample with its urgency class.
+ */
+
+#ifndef SENSOR_SAMPLER_H
+#define SENSOR_SAMPLER_H
+
+#include <stdint.h>
+#include "sensor_driver.h"
+#include "spsc_queue.h"
+
+#define SAMPLER_PERIOD_MS 10000
+#define SAMPLER_QUEUE_DEPTH 64
+
+typedef struct {
+    uint32_t samples;           // Samples pushed into the ring
+    uint32_t read_errors;       // Driver read() failures
+    uint32_t queue_overruns;    // Ring full, sample discarded
+    uint32_t dropped;           // Read, but lost before upload (no payload could be built)
+    uint32_t missed_ticks;      // Timer fired again before the task ran
+    uint32_t jitter_max_us;     // Worst deviation from the ideal schedule
+    uint64_t jitter_sum_us;
+    uint32_t jitter_count;
+} sampler_stats_t;
+
+/**
+ * Record the deviation of an actual sample time from its ideal slot
+ *
+ * @param first_us Time of the first sample (defines the schedule)
+ * @param tick Index of this sample on the schedule
+ */
+static inline void sampler_stats_record_jitter(sampler_stats_t *stats, int64_t now_us,
+                                               int64_t first_us, uint32_t tick,
+                                               uint32_t period_ms) {
+    int64_t ideal_us = first_us + (int64_t)tick * period_ms * 1000;
+    int64_t dev = now_us - ideal_us;
+    uint32_t jitter = (uint32_t)(dev < 0 ? -dev : dev);
+    if (jitter > stats->jitter_max_us) {
+        stats->jitter_max_us = jitter;
+    }
+    stats->jitter_sum_us += jitter;
+    stats->jitter_count++;
+}
+
+static inline uint32_t sampler_stats_jitter_mean_us(const sampler_stats_t *stats) {
+    return stats->jitter_count ? (uint32_t)(stats->jitter_sum_us / stats->jitter_count) : 0;
+}
+
+#ifdef ESP_PLATFORM
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+static const char *SAMPLER_TAG = "sampler";
+
+#define SAMPLER_TASK_STACK 3072
+#define SAMPLER_TASK_PRIORITY 10
+
+static SpscQueue<sensor_sample_t, SAMPLER_QUEUE_DEPTH> g_sample_queue;
+static sampler_stats_t g_sampler_stats = {};
+static sensor_driver_t g_sampler_driver = {};
+static synthetic_sensor_t g_synthetic_sensor = {};
+static TaskHandle_t g_sampler_task = NULL;
+static TaskHandle_t g_sampler_listener = NULL;  // Notified with 1 << urgency per sample
+static esp_timer_handle_t g_sampler_timer = NULL;
+static volatile uint32_t g_sampler_period_ms = SAMPLER_PERIOD_MS;   // See sampler_set_period()
+
+static void sampler_timer_cb(void *arg) {
+    // Runs in the esp_timer task: only wake the sampler, never touch the bus here
+    xTaskNotifyGive(g_sampler_task);
+}
+
+/**
+ * Read the driver into the next ring slot and notify the listener
+ *
+ * One tick of sampler_task(), minus the scheduling; also lets host tests
+ * drive the ring with the synthetic driver.
+ */
+static void sampler_take(int64_t now_us, uint32_t tick) {
+    sensor_sample_t *slot = g_sample_queue.claim();
+    if (slot == NULL) {
+        g_sampler_stats.queue_overruns++;
+        return;
+    }
+    slot->urgency = SENSOR_URGENCY_BULK;
+    if (!g_sampler_driver.read(g_sampler_driver.ctx, slot)) {
+        g_sampler_stats.read_errors++;
+        return;
+    }
+    slot->timestamp_us = now_us;
+    slot->seq = tick;
+    uint32_t urgency = slot->urgency < SENSOR_URGENCY_COUNT ? (uint32_t)slot->urgency
+                                                            : (uint32_t)SENSOR_URGENCY_URGENT;
+    g_sample_queue.commit();
+    g_sampler_stats.samples++;
+    if (g_sampler_listener != NULL) {
+        xTaskNotify(g_sampler_listener, 1u << urgency, eSetBits);
+    }
+}
+
+static void sampler_task(void *pvParameters) {
+    uint32_t tick = 0;
+    uint32_t first_tick = 0;
+    uint32_t period_ms = 0;
+    int64_t first_us = 0;
+
+    while (1) {
+        uint32_t pending = ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        int64_t now_us = esp_timer_get_time();
+
+        if (period_ms != g_sampler_period_ms) {
+            // First sample, or the timer was restarted: new schedule from here
+            period_ms = g_sampler_period_ms;
+            first_us = now_us;
+            first_tick = tick;
+        } else if (pending > 1) {
+            g_sampler_stats.missed_ticks += pending - 1;
+            tick += pending - 1;
+        }
+        sampler_stats_record_jitter(&g_sampler_stats, now_us, first_us, tick - first_tick,
+                                    period_ms);
+        sampler_take(now_us, tick);
+        tick++;
+    }
+}
+
+/**
+ * Start fixed-rate sampling
+ *
+ * @param driver Sensor driver, or NULL for the synthetic driver
+ * @param core Core to run the sampler task on
+ */
+static bool sampler_start(const sensor_driver_t *driver, BaseType_t core) {
+    g_sampler_driver = driver != NULL ? *driver : synthetic_sensor_driver(&g_synthetic_sensor);
+    if (g_sampler_driver.init != NULL && !g_sampler_driver.init(g_sampler_driver.ctx)) {
+        ESP_LOGE(SAMPLER_TAG, "Sensor driver '%s' failed to initialize", g_sampler_driver.name);
+        return false;
+    }
+
+    if (xTaskCreatePinnedToCore(sampler_task, "sampler", SAMPLER_TASK_STACK, NULL,
+                                SAMPLER_TASK_PRIORITY, &g_sampler_task, core) != pdPASS) {
+        ESP_LOGE(SAMPLER_TAG, "Failed to create sampler task");
+        return false;
+    }
+
+    esp_timer_create_args_t args = {};
+    args.callback = sampler_timer_cb;
+    args.dispatch_method = ESP_TIMER_TASK;
+    args.name = "sampler";
+    if (esp_timer_create(&args, &g_sampler_timer) != ESP_OK ||
+        esp_timer_start_periodic(g_sampler_timer, (uint64_t)g_sampler_period_ms * 1000) != ESP_OK) {
+        ESP_LOGE(SAMPLER_TAG, "Failed to start sampler timer");
+        return false;
+    }
+
+    ESP_LOGI(SAMPLER_TAG, "Sampling '%s' every %lu ms on core %d",
+             g_sampler_driver.name, (unsigned long)g_sampler_period_ms, (int)core);
+    return true;
+}
+
+/**
+ * Change the sampling period (runtime configuration, device_config.h)
+ *
+ * Before sampler_start() this only sets the period it starts with. A
+ * running timer is restarted, so the next sample comes one new period
+ * from now.
+ */
+static bool sampler_set_period(uint32_t period_ms) {
+    if (period_ms == g_sampler_period_ms) {
+        return true;
+    }
+    g_sampler_period_ms = period_ms;
+    if (g_sampler_timer == NULL) {
+        return true;
+    }
+    esp_timer_stop(g_sampler_timer);
+    if (esp_timer_start_periodic(g_sampler_timer, (uint64_t)period_ms * 1000) != ESP_OK) {
+        ESP_LOGE(SAMPLER_TAG, "Failed to restart sampler timer");
+        return false;
+    }
+    ESP_LOGI(SAMPLER_TAG, "Sampling every %lu ms", (unsigned long)period_ms);
+    return true;
+}
+
+static void sampler_log_stats(void) {
+    ESP_LOGI(SAMPLER_TAG, "samples=%lu overruns=%lu dropped=%lu missed=%lu errors=%lu "
+             "jitter mean=%lu max=%lu us",
+             (unsigned long)g_sampler_stats.samples,
+             (unsigned long)g_sampler_stats.queue_overruns,
+             (unsigned long)g_sampler_stats.dropped,
+             (unsigned long)g_sampler_stats.missed_ticks,
+             (unsigned long)g_sampler_stats.read_errors,
+             (unsigned long)sampler_stats_jitter_mean_us(&g_sampler_stats),
+             (unsigned long)g_sampler_stats.jitter_max_us);
+}
+
+#endif // ESP_PLATFORM
+
+#endif // SENSOR_SAMPLER_H
@@ -0,0 +1,146 @@
+/**
+ * Lock-free Single-Producer/Single-Consumer Ring Buffer
+ *
+ * Fixed-capacity queue used to hand work between the two ESP32-S3 cores
+ * without a mutex. Exactly one task may push and exactly one task may
+ * pop. Storage is inline, so a queue declared static never allocates.
+ *
+ * Has no ESP-IDF dependencies; host/spsc_bench.cpp builds it natively.
+ */
+
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+// Keep producer and consumer indices on separate cache lines
+#define SPSC_CACHE_LINE 64
+
+template <typename T, size_t Capacity>
+class SpscQueue {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                  "SpscQueue capacity must be a power of two");
+
+public:
+    SpscQueue() : head_(0), cached_tail_(0), tail_(0), cached_head_(0) {}
+
+    /**
+     * Producer side: copy an item into the queue
+     *
+     * @return false if the queue is full
+     */
+    bool push(const T &item) {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - cached_head_ == Capacity) {
+            cached_head_ = head_.load(std::memory_order_acquire);
+            if (tail - cached_head_ == Capacity) {
+                return false;
+            }
+        }
+        slots_[tail & (Capacity - 1)] = item;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Producer side: reserve the next slot to fill in place
+     *
+     * Avoids a copy for large items. Call commit() once filled.
+     *
+     * @return NULL if the queue is full
+     */
+    T *claim(void) {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - cached_head_ == Capacity) {
+            cached_head_ = head_.load(std::memory_order_acquire);
+            if (tail - cached_head_ == Capacity) {
+                return NULL;
+            }
+        }
+        return &slots_[tail & (Capacity - 1)];
+    }
+
+    void commit(void) {
+        tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    /**
+     * Consumer side: copy the oldest item out of the queue
+     *
+     * @return false if the queue is empty
+     */
+    bool pop(T *item) {
+        const T *front = peek();
+        if (front == NULL) {
+            return false;
+        }
+        *item = *front;
+        release();
+        return true;
+    }
+
+    /**
+     * Consumer side: look at the oldest item without copying it
+     *
+     * The pointer stays valid until release() is called.
+     *
+     * @return NULL if the queue is empty
+     */
+    const T *peek(void) {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        if (head == cached_tail_) {
+            cached_tail_ = tail_.load(std::memory_order_acquire);
+            if (head == cached_tail_) {
+                return NULL;
+            }
+        }
+        return &slots_[head & (Capacity - 1)];
+    }
+
+    /**
+     * Consumer side: look at the item index places behind the oldest one
+     *
+     * Lets the consumer work on several queued items before releasing
+     * them in order; peek_at(0) is peek().
+     *
+     * @return NULL if fewer than index + 1 items are queued
+     */
+    const T *peek_at(size_t index) {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        if (cached_tail_ - head <= index) {
+            cached_tail_ = tail_.load(std::memory_order_acquire);
+            if (cached_tail_ - head <= index) {
+                return NULL;
+            }
+        }
+        return &slots_[(head + index) & (Capacity - 1)];
+    }
+
+    void release(void) {
+        head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    /**
+     * Approximate number of queued items (exact only when both sides are idle)
+     */
+    size_t size(void) const {
+        // Read head_ first so a concurrent pop can never make the result negative
+        const size_t head = head_.load(std::memory_order_acquire);
+        return tail_.load(std::memory_order_acquire) - head;
+    }
+
+    static constexpr size_t capacity(void) { return Capacity; }
+
+private:
+    // Consumer line: its index plus its private snapshot of tail_
+    alignas(SPSC_CACHE_LINE) std::atomic<size_t> head_;
+    size_t cached_tail_;
+    // Producer line: its index plus its private snapshot of head_
+    alignas(SPSC_CACHE_LINE) std::atomic<size_t> tail_;
+    size_t cached_head_;
+    alignas(SPSC_CACHE_LINE) T slots_[Capacity];
+};
+
+#endif // SPSC_QUEUE_H
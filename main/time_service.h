@@ -0,0 +1,187 @@
+/**
+ * Network-Time Anchored Timestamps for Walter Modem
+ *
+ * Reads network time (AT+CCLK, NITZ-backed) once per connect and stores
+ * it as an anchor: "network epoch E was observed at monotonic time M".
+ * Absolute times are then computed locally from the monotonic clock, with
+ * a drift correction learned from successive anchors, so stamping a
+ * sample never needs a modem round-trip.
+ *
+ * The monotonic clock is the RTC-backed system time, which the firmware
+ * never sets: it counts from power-on and keeps running through deep
+ * sleep. The anchor lives in RTC memory, so it survives deep sleep too
+ * and only a power loss invalidates it.
+ *
+ * The anchor math has no ESP-IDF dependencies.
+ */
+
+#ifndef TIME_SERVICE_H
+#define TIME_SERVICE_H
+
+#include <stdint.h>
+
+#define TIME_ANCHOR_MAGIC 0x54494d45u  // "TIME"
+
+// Anchors closer together than this are too short to learn drift from
+// (CCLK has 1 s resolution)
+#define TIME_DRIFT_MIN_INTERVAL_US (6LL * 3600 * 1000000)
+#define TIME_DRIFT_MAX_PPM 500
+#define TIME_STEP_MAX_MS 60000
+
+typedef struct {
+    uint32_t magic;
+    int32_t drift_ppb;          // Local clock error, parts per billion (+ = local runs slow)
+    int64_t epoch_ms;           // Network time at the anchor
+    int64_t mono_us;            // Monotonic time at the anchor
+    uint32_t syncs;
+} time_anchor_t;
+
+static inline bool time_anchor_valid(const time_anchor_t *anchor) {
+    return anchor->magic == TIME_ANCHOR_MAGIC;
+}
+
+/**
+ * Convert a monotonic timestamp to Unix epoch milliseconds
+ */
+static inline int64_t time_anchor_to_epoch_ms(const time_anchor_t *anchor, int64_t mono_us) {
+    int64_t elapsed_us = mono_us - anchor->mono_us;
+    int64_t correction_us = elapsed_us / 1000 * anchor->drift_ppb / 1000000;
+    return anchor->epoch_ms + (elapsed_us + correction_us) / 1000;
+}
+
+/**
+ * Take a new network time reading
+ *
+ * @return Error of the previous prediction in ms (0 on first sync or
+ *         after a clock step)
+ */
+static int64_t time_anchor_update(time_anchor_t *anchor, int64_t network_epoch_ms, int64_t mono_us) {
+    int64_t error_ms = 0;
+
+    bool learn = time_anchor_valid(anchor) && mono_us >= anchor->mono_us;
+    if (learn) {
+        error_ms = network_epoch_ms - time_anchor_to_epoch_ms(anchor, mono_us);
+        // A step this large is a clock change (or a reset), not drift
+        learn = error_ms > -TIME_STEP_MAX_MS && error_ms < TIME_STEP_MAX_MS;
+    }
+
+    if (learn) {
+        int64_t elapsed_us = mono_us - anchor->mono_us;
+        if (elapsed_us >= TIME_DRIFT_MIN_INTERVAL_US) {
+            // Residual drift over this interval, folded in with a 1/4 weight
+            int64_t residual_ppb = error_ms * 1000 * 1000000000LL / elapsed_us;
+            int64_t drift = anchor->drift_ppb + residual_ppb / 4;
+            if (drift > TIME_DRIFT_MAX_PPM * 1000LL) drift = TIME_DRIFT_MAX_PPM * 1000LL;
+            if (drift < -TIME_DRIFT_MAX_PPM * 1000LL) drift = -TIME_DRIFT_MAX_PPM * 1000LL;
+            anchor->drift_ppb = (int32_t)drift;
+        } else {
+            // Too close to learn drift; keep the older anchor as the baseline
+            return error_ms;
+        }
+    } else {
+        error_ms = 0;
+        anchor->drift_ppb = 0;
+        anchor->syncs = 0;
+    }
+
+    anchor->magic = TIME_ANCHOR_MAGIC;
+    anchor->epoch_ms = network_epoch_ms;
+    anchor->mono_us = mono_us;
+    anchor->syncs++;
+    return error_ms;
+}
+
+#ifdef ESP_PLATFORM
+
+#include <esp_attr.h>
+#include <esp_log.h>
+#include <cJSON.h>
+#include <esp_timer.h>
+#include <stdio.h>
+#include <sys/time.h>
+#include <WalterModem.h>
+#include "modem_deadline.h"
+
+extern WalterModem modem;
+
+static const char *TIME_TAG = "time";
+
+// Survives deep sleep, cleared by power loss
+static RTC_DATA_ATTR time_anchor_t g_time_anchor;
+
+// System time minus esp_timer time for this boot, lets esp_timer stamps be converted
+static int64_t g_time_boot_offset_us = 0;
+
+/**
+ * Monotonic time since power-on in µs (continues through deep sleep)
+ */
+static int64_t time_service_mono_us(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static void time_service_init(void) {
+    g_time_boot_offset_us = time_service_mono_us() - esp_timer_get_time();
+    if (time_anchor_valid(&g_time_anchor)) {
+        ESP_LOGI(TIME_TAG, "Time anchor restored from RTC memory (%lu syncs, drift %ld ppb)",
+                 (unsigned long)g_time_anchor.syncs, (long)g_time_anchor.drift_ppb);
+    }
+}
+
+/**
+ * Fetch network time from the modem and re-anchor (once per connect)
+ */
+static bool time_service_sync(void) {
+    WalterModemRsp rsp = {};
+    if (!modem_call(MODEM_CLASS_QUERY, "getClock", &rsp, [](walterModemCb cb, void *arg) {
+            return modem.getClock(NULL, cb, arg);
+        }) || rsp.data.clock <= 0) {
+        ESP_LOGW(TIME_TAG, "Network time not available");
+        return false;
+    }
+    int64_t error_ms = time_anchor_update(&g_time_anchor, (int64_t)rsp.data.clock * 1000,
+                                          time_service_mono_us());
+    ESP_LOGI(TIME_TAG, "Network time %lld, prediction error %lld ms, drift %ld ppb",
+             (long long)rsp.data.clock, (long long)error_ms, (long)g_time_anchor.drift_ppb);
+    return true;
+}
+
+static inline bool time_service_synced(void) {
+    return time_anchor_valid(&g_time_anchor);
+}
+
+/**
+ * Convert an esp_timer timestamp (µs since this boot) to epoch ms
+ *
+ * @return 0 if network time has never been obtained since power-on
+ */
+static int64_t time_service_epoch_ms(int64_t esp_timer_us) {
+    if (!time_anchor_valid(&g_time_anchor)) {
+        return 0;
+    }
+    return time_anchor_to_epoch_ms(&g_time_anchor, esp_timer_us + g_time_boot_offset_us);
+}
+
+static inline int64_t time_service_now_epoch_ms(void) {
+    return time_service_epoch_ms(esp_timer_get_time());
+}
+
+/**
+ * Add a timestamp to a payload: "<key>" in epoch ms once network time is
+ * known, otherwise "<key>_up" in ms since boot so the server can tell them apart
+ */
+static void time_service_add_to_json(cJSON *root, const char *key, int64_t esp_timer_us) {
+    int64_t epoch_ms = time_service_epoch_ms(esp_timer_us);
+    if (epoch_ms != 0) {
+        cJSON_AddNumberToObject(root, key, (double)epoch_ms);
+        return;
+    }
+    char uptime_key[24];
+    snprintf(uptime_key, sizeof(uptime_key), "%s_up", key);
+    cJSON_AddNumberToObject(root, uptime_key, (double)(esp_timer_us / 1000));
+}
+
+#endif // ESP_PLATFORM
+
+#endif // TIME_SERVICE_H
@@ -0,0 +1,428 @@
+/**
+ * TLS Profile Management for Walter Modem
+ *
+ * HTTPS uploads go through the modem's own TLS stack: a TLS security
+ * profile (AT+SQNSPCFG) holds the version, validation level and the CA
+ * certificate slot, and the HTTP profile points at it. The handshake is
+ * the expensive part on NB-IoT (several KB and multiple round trips for a
+ * full handshake), so:
+ *
+ *  - the CA certificate is written to the modem only when it changes
+ *    (its hash is kept in NVS),
+ *  - the TLS and HTTP profiles are configured once and left alone, since
+ *    rewriting a profile throws away the modem's cached session,
+ *  - session resumption is enabled on the profile, so later uploads do an
+ *    abbreviated handshake. Security profiles are kept in modem NVM, and
+ *    an RTC-memory marker tells a deep sleep wake-up that the profile is
+ *    already set up. The cached session itself survives as long as the
+ *    modem stays powered (e.g. in PSM while the ESP32 sleeps), so the
+ *    marker is dropped after any other reset and after a modem reset.
+ *
+ * The CA certificate comes from UPLINK_TLS_CA_CERT or, when that is empty,
+ * from NVS (provisioned per device, see the README). The server certificate
+ * is always validated unless CONFIG_WALTER_UPLINK_TLS_NO_VERIFY is set:
+ * without a CA, HTTPS connections are refused at runtime.
+ *
+ * host/tls_handshake_bench.cpp measures full vs resumed handshakes.
+ *
+ * URL parsing, HTTP status classes and AT command formatting have no
+ * ESP-IDF dependencies.
+ */
+
+#ifndef TLS_PROFILE_H
+#define TLS_PROFILE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Modem slots (profile 0 is left for plain HTTP)
+#define TLS_PROFILE_ID 1
+#define TLS_HTTP_PROFILE_ID 0
+#define HTTP_PROFILE_COUNT 3        // Modem HTTP profiles 0..2
+#define TLS_CA_CERT_SLOT 10
+
+// Lifetime of a cached session on the modem (s)
+#define TLS_SESSION_LIFETIME_S 86400
+
+/**
+ * CA certificate (PEM) of the upload server
+ *
+ * Paste the root CA of your server here, or leave it empty and provision
+ * it into NVS (TLS_NVS_CA_PEM_KEY). Without either, HTTPS only works with
+ * CONFIG_WALTER_UPLINK_TLS_NO_VERIFY: uploads are then still encrypted
+ * but the server is not authenticated.
+ */
+#define UPLINK_TLS_CA_CERT ""
+#define TLS_CA_PEM_MAX 4000         // Longest string NVS stores
+
+#define HTTP_URL_HOST_MAX 64
+
+typedef struct {
+    bool https;
+    char host[HTTP_URL_HOST_MAX];
+    uint16_t port;
+    const char *path;       // Points into the parsed URL, "/" if none
+} http_url_t;
+
+/**
+ * Split "http[s]://host[:port][/path]"
+ *
+ * @return false for other schemes, empty or oversized hosts and bad ports
+ */
+static bool http_url_parse(const char *url, http_url_t *out) {
+    memset(out, 0, sizeof(*out));
+    const char *p;
+    if (strncmp(url, "https://", 8) == 0) {
+        out->https = true;
+        out->port = 443;
+        p = url + 8;
+    } else if (strncmp(url, "http://", 7) == 0) {
+        out->port = 80;
+        p = url + 7;
+    } else {
+        return false;
+    }
+
+    size_t host_len = strcspn(p, ":/");
+    if (host_len == 0 || host_len >= sizeof(out->host)) {
+        return false;
+    }
+    memcpy(out->host, p, host_len);
+    p += host_len;
+
+    if (*p == ':') {
+        char *end;
+        unsigned long port = strtoul(p + 1, &end, 10);
+        if (end == p + 1 || port == 0 || port > 65535 || (*end != '\0' && *end != '/')) {
+            return false;
+        }
+        out->port = (uint16_t)port;
+        p = end;
+    }
+    out->path = *p == '/' ? p : "/";
+    return true;
+}
+
+/**
+ * 2xx: the server took the request
+ */
+static inline bool http_status_ok(uint16_t status) {
+    return status >= 200 && status < 300;
+}
+
+/**
+ * The server refused the request for good, so sending it again gets the
+ * same answer: any 4xx except 408 (Request Timeout) and 429 (Too Many
+ * Requests). No response at all (0) and 5xx are worth retrying.
+ */
+static inline bool http_status_permanent(uint16_t status) {
+    return status >= 400 && status < 500 && status != 408 && status != 429;
+}
+
+/**
+ * 32-bit FNV-1a, used to notice configuration changes
+ */
+static uint32_t tls_fnv1a(const void *data, size_t len, uint32_t hash = 2166136261u) {
+    const uint8_t *bytes = (const uint8_t *)data;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * Format the security profile command with session resumption
+ *
+ * AT+SQNSPCFG=<spId>,<version>,<cipherSpecs>,<certValidLevel>,<caCertificateID>,
+ *             <clientCertificateID>,<clientPrivateKeyID>,<psk>,<pskIdentity>,
+ *             <storage>,<resume>,<lifetime>
+ * version 2 = TLS 1.2; certValidLevel 1 = validate against the CA slot.
+ */
+static int tls_format_spcfg(char *buf, size_t len, int profile_id, bool validate, int ca_slot,
+                            bool resume, uint32_t lifetime_s) {
+    char ca[8] = "";
+    if (validate) {
+        snprintf(ca, sizeof(ca), "%d", ca_slot);
+    }
+    return snprintf(buf, len, "AT+SQNSPCFG=%d,2,\"\",%d,%s,,,\"\",\"\",0,%d,%lu",
+                    profile_id, validate ? 1 : 0, ca, resume ? 1 : 0,
+                    (unsigned long)lifetime_s);
+}
+
+#ifdef ESP_PLATFORM
+
+#include <esp_attr.h>
+#include <esp_log.h>
+#include <esp_system.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <nvs.h>
+#include <sdkconfig.h>
+#include <WalterModem.h>
+#include "modem_deadline.h"
+
+extern WalterModem modem;
+
+static const char *TLS_TAG = "tls";
+
+#define TLS_NVS_NAMESPACE "walter"
+#define TLS_NVS_CA_KEY "tls_ca_h"
+#define TLS_NVS_CA_PEM_KEY "tls_ca"     // Provisioned CA certificate (string)
+
+#define TLS_RTC_MAGIC 0x544c5331u  // "TLS1"
+
+/**
+ * TLS profile settings last written to the modem; survives deep sleep
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t tls_hash;      // CA + profile settings
+} tls_rtc_state_t;
+
+static RTC_DATA_ATTR tls_rtc_state_t g_tls_rtc;
+
+// Host, port and TLS profile of each HTTP profile configured this boot
+static uint32_t g_http_profile_hash[HTTP_PROFILE_COUNT] = {};
+
+typedef struct {
+    uint32_t profile_writes;    // Profile (re)configurations, each drops the cached session
+    uint32_t ca_writes;
+    bool resumption;            // Modem accepted the resumption settings
+} tls_stats_t;
+
+static tls_stats_t g_tls_stats = {};
+static bool g_tls_boot_checked = false;
+static uint32_t g_tls_modem_resets = 0;    // g_modem_deadline.resets when last checked
+
+// CA certificate in use, set by tls_profile_init() and read-only after it
+static char g_tls_ca_pem[TLS_CA_PEM_MAX] = UPLINK_TLS_CA_CERT;
+
+// The uplink task and the console (delta OTA) both configure profiles:
+// held around everything above, including the modem calls
+static SemaphoreHandle_t g_tls_lock = NULL;
+
+/**
+ * Create the profile lock and load the CA certificate
+ *
+ * UPLINK_TLS_CA_CERT wins when set; otherwise the CA is read from NVS.
+ * Call once at startup, before any task uses the modem.
+ */
+static void tls_profile_init(void) {
+    g_tls_lock = xSemaphoreCreateMutex();
+    if (g_tls_ca_pem[0] != '\0') {
+        return;
+    }
+    nvs_handle_t handle;
+    size_t len = sizeof(g_tls_ca_pem);
+    bool loaded = false;
+    if (nvs_open(TLS_NVS_NAMESPACE, NVS_READONLY, &handle) == ESP_OK) {
+        loaded = nvs_get_str(handle, TLS_NVS_CA_PEM_KEY, g_tls_ca_pem, &len) == ESP_OK;
+        nvs_close(handle);
+    }
+    if (!loaded) {
+        g_tls_ca_pem[0] = '\0';
+#ifndef CONFIG_WALTER_UPLINK_TLS_NO_VERIFY
+        ESP_LOGW(TLS_TAG, "No CA certificate provisioned, HTTPS is refused until one is");
+#endif
+    }
+}
+
+/**
+ * Forget what this boot and earlier ones configured if the modem may have
+ * lost it
+ *
+ * Only a deep sleep wake-up leaves the modem as it was. A power cycle,
+ * any other ESP32 reset (the modem is reset at startup) or a modem reset
+ * after missed deadlines drops the cached session and the HTTP profiles.
+ */
+static void tls_check_modem_reset(void) {
+    bool reset = false;
+    if (!g_tls_boot_checked) {
+        g_tls_boot_checked = true;
+        reset = esp_reset_reason() != ESP_RST_DEEPSLEEP;
+    }
+    uint32_t resets = modem_deadline_resets();
+    if (resets != g_tls_modem_resets) {
+        g_tls_modem_resets = resets;
+        reset = true;
+    }
+    if (reset) {
+        g_tls_rtc.magic = 0;
+        memset(g_http_profile_hash, 0, sizeof(g_http_profile_hash));
+    }
+}
+
+/**
+ * Write the CA certificate to its modem slot unless it is already there
+ */
+static bool tls_provision_ca(const char *pem, uint32_t hash) {
+    nvs_handle_t handle;
+    uint32_t stored = 0;
+    bool have_nvs = nvs_open(TLS_NVS_NAMESPACE, NVS_READWRITE, &handle) == ESP_OK;
+    if (have_nvs && nvs_get_u32(handle, TLS_NVS_CA_KEY, &stored) == ESP_OK && stored == hash) {
+        nvs_close(handle);
+        return true;
+    }
+
+    ESP_LOGI(TLS_TAG, "Provisioning CA certificate into slot %d", TLS_CA_CERT_SLOT);
+    bool ok = modem.tlsWriteCredential(false, TLS_CA_CERT_SLOT, pem);
+    if (ok) {
+        g_tls_stats.ca_writes++;
+        if (have_nvs && nvs_set_u32(handle, TLS_NVS_CA_KEY, hash) == ESP_OK) {
+            nvs_commit(handle);
+        }
+    } else {
+        ESP_LOGE(TLS_TAG, "Failed to write CA certificate");
+    }
+    if (have_nvs) {
+        nvs_close(handle);
+    }
+    return ok;
+}
+
+/**
+ * Make sure the TLS profile is configured (no-op when it already is)
+ */
+static bool tls_profile_ensure_locked(void) {
+    const char *ca = g_tls_ca_pem;
+    bool validate = ca[0] != '\0';
+#ifdef CONFIG_WALTER_TLS_SESSION_RESUMPTION
+    bool resume = true;
+#else
+    bool resume = false;
+#endif
+    uint32_t ca_hash = tls_fnv1a(ca, strlen(ca));
+    uint32_t hash = tls_fnv1a(&resume, sizeof(resume), ca_hash);
+
+    tls_check_modem_reset();
+    if (g_tls_rtc.magic == TLS_RTC_MAGIC && g_tls_rtc.tls_hash == hash) {
+        return true;
+    }
+    if (!validate) {
+#ifdef CONFIG_WALTER_UPLINK_TLS_NO_VERIFY
+        ESP_LOGW(TLS_TAG, "No CA certificate set, server will not be validated");
+#else
+        ESP_LOGE(TLS_TAG, "No CA certificate provisioned, refusing unvalidated TLS");
+        return false;
+#endif
+    }
+    if (validate && !tls_provision_ca(ca, ca_hash)) {
+        return false;
+    }
+
+    char cmd[96];
+    tls_format_spcfg(cmd, sizeof(cmd), TLS_PROFILE_ID, validate, TLS_CA_CERT_SLOT, resume,
+                     TLS_SESSION_LIFETIME_S);
+    WalterModemRsp rsp = {};
+    g_tls_stats.resumption = resume && modem.sendCmd(cmd, NULL, &rsp);  // Blocking, see modem_deadline.h
+    if (resume && !g_tls_stats.resumption) {
+        // Older modem firmware: no resume/lifetime fields, configure without them
+        ESP_LOGW(TLS_TAG, "Modem rejected session resumption, every upload does a full handshake");
+    }
+    if (!g_tls_stats.resumption &&
+        !modem_call(MODEM_CLASS_HTTP, "tlsConfigProfile", NULL, [validate](walterModemCb cb, void *arg) {
+            return modem.tlsConfigProfile(TLS_PROFILE_ID,
+                                          validate ? WALTER_MODEM_TLS_VALIDATION_CA
+                                                   : WALTER_MODEM_TLS_VALIDATION_NONE,
+                                          WALTER_MODEM_TLS_VERSION_12,
+                                          validate ? TLS_CA_CERT_SLOT : 0xff, 0xff, 0xff,
+                                          NULL, cb, arg);
+        })) {
+        ESP_LOGE(TLS_TAG, "Failed to configure TLS profile %d", TLS_PROFILE_ID);
+        return false;
+    }
+
+    g_tls_stats.profile_writes++;
+    g_tls_rtc.magic = TLS_RTC_MAGIC;
+    g_tls_rtc.tls_hash = hash;
+    memset(g_http_profile_hash, 0, sizeof(g_http_profile_hash));  // HTTP profiles refer to it, redo them too
+    ESP_LOGI(TLS_TAG, "TLS profile %d configured (validation %s, resumption %s)",
+             TLS_PROFILE_ID, validate ? "CA" : "none",
+             g_tls_stats.resumption ? "on" : "off");
+    return true;
+}
+
+/**
+ * tls_profile_ensure_locked() under the profile lock
+ */
+static bool tls_profile_ensure(void) {
+    xSemaphoreTake(g_tls_lock, portMAX_DELAY);
+    bool ok = tls_profile_ensure_locked();
+    xSemaphoreGive(g_tls_lock);
+    return ok;
+}
+
+/**
+ * Whether connecting to this URL authenticates the server: HTTPS with a
+ * CA to validate against
+ */
+static bool tls_url_authenticated(const http_url_t *url) {
+    return url->https && g_tls_ca_pem[0] != '\0';
+}
+
+/**
+ * Make sure the HTTP profile points at the URL's server
+ *
+ * Only reconfigures when server, port or TLS use change, so a cached TLS
+ * session stays usable across uploads.
+ *
+ * @param server Address to connect to (e.g. a cached IP), NULL = url->host
+ * @param profile_id Modem HTTP profile to configure
+ */
+static bool http_profile_ensure_locked(const http_url_t *url, const char *server,
+                                       uint8_t profile_id) {
+    uint8_t tls_profile = 0;
+    if (url->https) {
+        if (!tls_profile_ensure_locked()) {
+            return false;
+        }
+        tls_profile = TLS_PROFILE_ID;
+    }
+
+    if (server == NULL) {
+        server = url->host;
+    }
+    tls_check_modem_reset();
+    uint32_t hash = tls_fnv1a(server, strlen(server));
+    hash = tls_fnv1a(&url->port, sizeof(url->port), hash);
+    hash = tls_fnv1a(&tls_profile, sizeof(tls_profile), hash);
+    if (g_http_profile_hash[profile_id] == hash) {
+        return true;
+    }
+
+    if (!modem_call(MODEM_CLASS_HTTP, "httpConfigProfile", NULL, [&](walterModemCb cb, void *arg) {
+            return modem.httpConfigProfile(
+                profile_id,             // Profile ID
+                server,                 // Server name (also the TLS SNI)
+                url->port,              // Port
+                tls_profile,            // TLS profile (0 = plain HTTP)
+                false,                  // Basic auth
+                "",                     // Username
+                "",                     // Password
+                30,                     // Timeout
+                0,                      // Keep alive
+                0,                      // Flags
+                NULL, cb, arg);
+        })) {
+        return false;
+    }
+    g_http_profile_hash[profile_id] = hash;
+    return true;
+}
+
+/**
+ * http_profile_ensure_locked() under the profile lock
+ */
+static bool http_profile_ensure(const http_url_t *url, const char *server,
+                                uint8_t profile_id = TLS_HTTP_PROFILE_ID) {
+    xSemaphoreTake(g_tls_lock, portMAX_DELAY);
+    bool ok = http_profile_ensure_locked(url, server, profile_id);
+    xSemaphoreGive(g_tls_lock);
+    return ok;
+}
+
+#endif // ESP_PLATFORM
+
+#endif // TLS_PROFILE_H
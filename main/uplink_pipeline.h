@@ -0,0 +1,546 @@
+/**
+ * Dual-Core Uplink Pipeline for Walter Modem
+ *
+ * Splits the application across the two ESP32-S3 cores:
+ *
+ *   core 1 (SENSOR):  timer sampler -> sample ring -> encode batch -> uplink queue
+ *   core 0 (MODEM):   uplink queue -> http_post_json -> result queue
+ *
+ * A backlog (e.g. after an outage) is drained over several modem HTTP
+ * profiles at once (multi_uplink.h); results still come back in order.
+ *
+ * A payload leaves the uplink queue only once the server answered 2xx.
+ * A failed upload ends the session and stays at the head of the queue,
+ * together with everything behind it, for the next session; the sensor
+ * core schedules that one like a normal record, no sooner than the
+ * scheduler's minimum interval, so an outage does not turn into a
+ * session per sample.
+ *
+ * The cores only talk through lock-free SPSC ring buffers (spsc_queue.h),
+ * so a slow AT exchange never delays sampling and encoding never competes
+ * with the modem UART handling. Upload results flow back on a second queue
+ * so state owned by the sensor core (e.g. the boot waterfall) is only ever
+ * touched from that core.
+ *
+ * When to upload is decided by the upload scheduler (upload_scheduler.h)
+ * on the sensor core: urgent samples start a session right away, bulk
+ * samples are encoded as batches fill and held until the scheduler calls
+ * for a session.
+ *
+ * Upload responses may carry a downlink (downlink.h). Configuration
+ * changes are picked up by each core on its next wake-up: the sensor
+ * core re-reads sampling and scheduler settings, commands run on the
+ * modem core once the session is over.
+ */
+
+#ifndef UPLINK_PIPELINE_H
+#define UPLINK_PIPELINE_H
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <string.h>
+#include "boot_waterfall.h"
+#include "device_config.h"
+#include "dns_cache.h"
+#include "downlink.h"
+#include "energy_model.h"
+#include "http_json_example.h"
+#include "modem_deadline.h"
+#include "multi_uplink.h"
+#include "sensor_sampler.h"
+#include "spsc_queue.h"
+#include "upload_scheduler.h"
+#include <WalterModem.h>
+#include <sdkconfig.h>
+
+static const char *PIPE_TAG = "pipeline";
+
+// Core assignment (app_main and the modem driver run on core 0)
+#define PIPELINE_MODEM_CORE 0
+#define PIPELINE_SENSOR_CORE 1
+
+#define PIPELINE_MAX_WAIT_MS 60000           // Re-evaluate the schedule at least this often
+#ifdef CONFIG_WALTER_UPLINK_TLS
+#define PIPELINE_UPLINK_URL "https://httpbin.org/post"
+#else
+#define PIPELINE_UPLINK_URL "http://httpbin.org/post"
+#endif
+#define PIPELINE_DEVICE_ID HTTP_DEVICE_ID
+#define PIPELINE_BATCH_MAX 16
+#define PIPELINE_QUEUE_DEPTH 8
+
+// Slot size for the widest full batch (host/pipeline_test encodes it): cJSON
+// prints a float reading with up to 17 significant digits, so a row is
+// [10-digit offset, 3 x 19 chars] = 72 bytes. The rest is the device id, t0,
+// sampler, energy and config counters at their widest and two boot waterfalls.
+#define PIPELINE_SAMPLE_JSON_MAX 72
+#define PIPELINE_HEADER_JSON_MAX 1280
+#define PIPELINE_PAYLOAD_MAX (PIPELINE_HEADER_JSON_MAX + PIPELINE_BATCH_MAX * PIPELINE_SAMPLE_JSON_MAX)
+
+// Records the pipeline can hold before sampling overruns (what "fill" is measured against)
+#define PIPELINE_BUFFER_RECORDS (SAMPLER_QUEUE_DEPTH + PIPELINE_QUEUE_DEPTH * PIPELINE_BATCH_MAX)
+
+// Sensor task notification bits: 1 << urgency from the sampler, plus this one
+#define PIPELINE_NOTIFY_SESSION_DONE (1u << SENSOR_URGENCY_COUNT)
+
+#define PIPELINE_SENSOR_STACK 6144
+#define PIPELINE_UPLINK_STACK 6144
+
+/**
+ * Encoded payload waiting for the modem core
+ */
+typedef struct {
+    uint32_t seq;
+    int64_t enqueued_us;
+    uint16_t len;
+    uint16_t samples;
+    char data[PIPELINE_PAYLOAD_MAX];
+} pipeline_payload_t;
+
+/**
+ * Upload outcome reported back to the sensor core
+ */
+typedef struct {
+    uint32_t seq;
+    bool ok;                    // Sent and released; false = still queued for the next session
+    bool rejected;              // Refused for good by the server (4xx): released, not delivered
+    uint16_t samples;
+    int16_t rsrp_dbm;           // Measured during this session, 0 = not measured
+    uint32_t charge_uah;        // Upload charge spent on this payload
+} pipeline_result_t;
+
+typedef struct {
+    uint32_t encoded;
+    uint32_t deferred_full;     // Uplink queue full, batch deferred
+    uint32_t split_too_big;     // Batch larger than a slot, encoded in smaller parts
+    uint32_t sent;
+    uint32_t failed;            // Upload attempts that failed (the payload stays queued)
+    uint32_t rejected;          // Payloads the server refused for good (released)
+    uint32_t max_queue_wait_ms; // Longest enqueue -> transmit start (-> release when drained)
+} pipeline_stats_t;
+
+static SpscQueue<pipeline_payload_t, PIPELINE_QUEUE_DEPTH> g_uplink_queue;
+static SpscQueue<pipeline_result_t, PIPELINE_QUEUE_DEPTH> g_result_queue;
+static pipeline_stats_t g_pipeline_stats = {};
+static TaskHandle_t g_uplink_task = NULL;
+static TaskHandle_t g_sensor_task = NULL;
+
+// Owned by the sensor core
+static upload_sched_t g_upload_sched = {};
+static uint32_t g_pipeline_queued_samples = 0;  // Samples encoded but not yet acknowledged
+static bool g_pipeline_session_open = false;
+static int64_t g_pipeline_retry_ms = 0;         // No non-urgent session before this (after a failure)
+
+/**
+ * Apply upload results on the sensor core
+ */
+static void pipeline_drain_results(int64_t now_ms) {
+    pipeline_result_t result;
+    while (g_result_queue.pop(&result)) {
+        if (result.ok || result.rejected) {
+            g_pipeline_queued_samples -= result.samples;
+            if (result.ok) {
+                boot_waterfall_mark_uploaded();
+            }
+        } else {
+            // Still queued: due again like a normal record, but not right away
+            upload_sched_note_record(&g_upload_sched, SENSOR_URGENCY_NORMAL, now_ms);
+            g_pipeline_retry_ms = now_ms + g_upload_sched.config.min_interval_ms;
+        }
+        if (result.rsrp_dbm != 0) {
+            upload_sched_note_signal(&g_upload_sched, result.rsrp_dbm);
+        }
+        upload_sched_note_charge(&g_upload_sched, now_ms, result.charge_uah);
+    }
+}
+
+/**
+ * Take over runtime configuration owned by the sensor core
+ */
+static void pipeline_apply_config(const device_config_t *cfg) {
+    g_upload_sched.config.normal_max_delay_ms = cfg->normal_max_delay_ms;
+    g_upload_sched.config.bulk_max_delay_ms = cfg->bulk_max_delay_ms;
+    g_upload_sched.config.daily_budget_uah = cfg->daily_budget_uah;
+    sampler_set_period(cfg->sample_period_ms);
+}
+
+static inline uint32_t pipeline_buffered_records(void) {
+    return (uint32_t)g_sample_queue.size() + g_pipeline_queued_samples;
+}
+
+static inline void pipeline_ring_release(size_t count) {
+    while (count-- > 0) {
+        g_sample_queue.release();
+    }
+}
+
+/**
+ * Encode one batch of samples straight into a free uplink slot
+ *
+ * Samples stay in the sampler ring while the uplink queue is full, so a
+ * slow modem backs up into the (larger) sample ring before anything is lost.
+ * They are only taken out of the ring once their payload is queued; if
+ * encoding fails they are tried again on the next call. A batch that does
+ * not fit a slot (which PIPELINE_PAYLOAD_MAX is sized to rule out) is cut
+ * in half until it does, and the rest stays for the next call.
+ *
+ * @param full_only Only encode if a whole batch is waiting (between sessions)
+ * @return false if there was nothing to encode or no room to encode into
+ */
+static bool pipeline_encode_batch(uint32_t seq, bool full_only) {
+    size_t waiting = g_sample_queue.size();
+    if (waiting == 0 || (full_only && waiting < PIPELINE_BATCH_MAX)) {
+        return false;
+    }
+    pipeline_payload_t *slot = g_uplink_queue.claim();
+    if (slot == NULL) {
+        g_pipeline_stats.deferred_full++;
+        ESP_LOGW(PIPE_TAG, "Uplink queue full, holding batch %lu", (unsigned long)seq);
+        return false;
+    }
+
+    sensor_sample_t batch[PIPELINE_BATCH_MAX];
+    const sensor_sample_t *sample;
+    size_t count = 0;
+    while (count < PIPELINE_BATCH_MAX && (sample = g_sample_queue.peek_at(count)) != NULL) {
+        batch[count++] = *sample;
+    }
+
+    char *json;
+    size_t len;
+    bool split = false;
+    while (true) {
+        json = create_batch_json(PIPELINE_DEVICE_ID, batch, count, &g_sampler_stats);
+        if (json == NULL) {
+            ESP_LOGW(PIPE_TAG, "Could not encode batch %lu, samples kept", (unsigned long)seq);
+            return false;
+        }
+        len = strlen(json);
+        if (len < sizeof(slot->data) || count == 1) {
+            break;
+        }
+        ESP_LOGE(PIPE_TAG, "Payload of %u bytes exceeds slot size, sending %u of %u samples",
+                 (unsigned)len, (unsigned)(count / 2), (unsigned)count);
+        cJSON_free(json);
+        count /= 2;
+        split = true;
+    }
+    if (len >= sizeof(slot->data)) {
+        // One sample that can never fit would block the ring for good
+        g_sampler_stats.dropped++;
+        ESP_LOGE(PIPE_TAG, "Payload of %u bytes for one sample exceeds slot size, sample lost",
+                 (unsigned)len);
+        cJSON_free(json);
+        pipeline_ring_release(1);
+        return false;
+    }
+
+    if (split) {
+        g_pipeline_stats.split_too_big++;
+    }
+    memcpy(slot->data, json, len + 1);
+    cJSON_free(json);
+    slot->len = (uint16_t)len;
+    slot->samples = (uint16_t)count;
+    slot->seq = seq;
+    slot->enqueued_us = esp_timer_get_time();
+    g_uplink_queue.commit();
+    pipeline_ring_release(count);
+    g_pipeline_stats.encoded++;
+    g_pipeline_queued_samples += count;
+    return true;
+}
+
+/**
+ * Start a radio session: encode what is left and wake the uplink task
+ */
+static void pipeline_flush(uint32_t *seq, int64_t now_ms, upload_reason_t reason) {
+    while (pipeline_encode_batch(*seq, false)) {
+        (*seq)++;
+    }
+    upload_sched_flushed(&g_upload_sched, now_ms, reason);
+    if (g_sample_queue.size() > 0) {
+        // Uplink queue full: the rest goes with the next session
+        upload_sched_note_record(&g_upload_sched, SENSOR_URGENCY_BULK, now_ms);
+    }
+    ESP_LOGI(PIPE_TAG, "Upload session (%s), %lu records queued, %lu sessions today",
+             UPLOAD_REASON_NAMES[reason], (unsigned long)g_pipeline_queued_samples,
+             (unsigned long)g_upload_sched.day_sessions);
+    g_pipeline_session_open = true;
+    xTaskNotifyGive(g_uplink_task);
+}
+
+/**
+ * Sensor/encode task (SENSOR core)
+ *
+ * Wakes on every sample (and when a session ends), encodes full batches
+ * as they accumulate and lets the upload scheduler decide when the modem
+ * core should start a radio session.
+ */
+static void pipeline_sensor_task(void *pvParameters) {
+    uint32_t seq = 0;
+    uint32_t wait_ms = 0;
+    uint32_t config_gen = 0;
+
+    ESP_LOGI(PIPE_TAG, "Sensor task running on core %d", (int)xPortGetCoreID());
+    upload_sched_init(&g_upload_sched, NULL, esp_timer_get_time() / 1000);
+
+    while (1) {
+        uint32_t bits = 0;
+        xTaskNotifyWait(0, UINT32_MAX, &bits, pdMS_TO_TICKS(wait_ms));
+        int64_t now_ms = esp_timer_get_time() / 1000;
+
+        if (config_gen != g_device_config_gen) {
+            device_config_t cfg;
+            config_gen = device_config_get(&cfg);
+            pipeline_apply_config(&cfg);
+        }
+
+        for (int c = 0; c < SENSOR_URGENCY_COUNT; c++) {
+            if (bits & (1u << c)) {
+                upload_sched_note_record(&g_upload_sched, (sensor_urgency_t)c, now_ms);
+            }
+        }
+        if (bits & PIPELINE_NOTIFY_SESSION_DONE) {
+            g_pipeline_session_open = false;
+            sampler_log_stats();
+        }
+        pipeline_drain_results(now_ms);
+        while (pipeline_encode_batch(seq, true)) {
+            seq++;
+        }
+
+        wait_ms = PIPELINE_MAX_WAIT_MS;
+        if (g_pipeline_session_open) {
+            continue;               // Decide again once the modem core is done
+        }
+        upload_reason_t reason;
+        int64_t next_ms = upload_sched_next_flush_ms(&g_upload_sched, now_ms,
+                                                     pipeline_buffered_records(),
+                                                     PIPELINE_BUFFER_RECORDS, &reason);
+        if (reason != UPLOAD_REASON_URGENT && next_ms < g_pipeline_retry_ms) {
+            next_ms = g_pipeline_retry_ms;
+        }
+        if (next_ms <= now_ms) {
+            pipeline_flush(&seq, now_ms, reason);
+        } else if (next_ms - now_ms < PIPELINE_MAX_WAIT_MS) {
+            wait_ms = (uint32_t)(next_ms - now_ms);
+        }
+    }
+}
+
+/**
+ * Report the outcome for the oldest queued payload (MODEM core)
+ *
+ * Its slot is released if it was sent, or if the server refused it for
+ * good (sending it again would fail the same way and hold up everything
+ * behind it). Any other failure stays at the head of the queue for the
+ * next session.
+ */
+static void pipeline_complete(pipeline_result_t *result) {
+    const pipeline_payload_t *payload = g_uplink_queue.peek();
+    result->seq = payload->seq;
+    result->samples = payload->samples;
+    if (result->ok) {
+        g_pipeline_stats.sent++;
+        energy_record_upload(payload->len);
+        g_uplink_queue.release();
+    } else if (result->rejected) {
+        g_pipeline_stats.rejected++;
+        energy_record_upload(payload->len);
+        ESP_LOGE(PIPE_TAG, "Batch %lu (%u samples) refused by the server, dropped",
+                 (unsigned long)payload->seq, (unsigned)payload->samples);
+        g_uplink_queue.release();
+    } else {
+        g_pipeline_stats.failed++;
+        ESP_LOGW(PIPE_TAG, "Upload of batch %lu failed, kept for the next session",
+                 (unsigned long)payload->seq);
+    }
+
+    if (!g_result_queue.push(*result)) {
+        ESP_LOGW(PIPE_TAG, "Result queue full, dropping result %lu",
+                 (unsigned long)result->seq);
+    }
+}
+
+#ifdef CONFIG_WALTER_DOWNLINK
+/**
+ * Whether upload responses come from an authenticated server (downlink.h)
+ */
+static bool pipeline_downlink_trusted(void) {
+    http_url_t url;
+    return http_url_parse(PIPELINE_UPLINK_URL, &url) && tls_url_authenticated(&url);
+}
+#endif
+
+#ifdef CONFIG_WALTER_MULTI_UPLINK
+static_assert(PIPELINE_PAYLOAD_MAX <= MULTI_UPLINK_PAYLOAD_MAX, "a payload must fit a lane's copy");
+
+/**
+ * Per-drain state for the multi_uplink.h source callbacks
+ */
+typedef struct {
+    uint32_t charge_mark;       // Upload charge when the previous payload was released
+    int16_t rsrp_dbm;           // Reported with the first result, then cleared
+    bool failed;                // A payload was given up on: the session is over
+} pipeline_drain_t;
+
+static const char *pipeline_drain_payload(void *ctx, uint32_t index, uint16_t *len) {
+    const pipeline_payload_t *payload = g_uplink_queue.peek_at(index);
+    if (payload == NULL) {
+        return NULL;
+    }
+    *len = payload->len;
+    return payload->data;
+}
+
+static void pipeline_drain_release(void *ctx, multi_uplink_outcome_t outcome) {
+    pipeline_drain_t *drain = (pipeline_drain_t *)ctx;
+    drain->failed = drain->failed || outcome == MULTI_UPLINK_KEPT;
+    const pipeline_payload_t *payload = g_uplink_queue.peek();
+    uint32_t wait_ms = (uint32_t)((esp_timer_get_time() - payload->enqueued_us) / 1000);
+    if (wait_ms > g_pipeline_stats.max_queue_wait_ms) {
+        g_pipeline_stats.max_queue_wait_ms = wait_ms;
+    }
+
+    pipeline_result_t result = {};
+    result.ok = outcome == MULTI_UPLINK_SENT;
+    result.rejected = outcome == MULTI_UPLINK_REJECTED;
+    result.rsrp_dbm = drain->rsrp_dbm;
+    drain->rsrp_dbm = 0;
+    uint32_t charge = energy_upload_uah();
+    result.charge_uah = charge - drain->charge_mark;
+    drain->charge_mark = charge;
+    pipeline_complete(&result);
+}
+
+#ifdef CONFIG_WALTER_DOWNLINK
+static void pipeline_drain_response(void *ctx, const uint8_t *body, uint16_t len) {
+    downlink_feed(body, len, pipeline_downlink_trusted());
+}
+#endif
+#endif
+
+/**
+ * Measure signal quality once per session, while the radio is up anyway
+ */
+static bool pipeline_signal_quality(WalterModemRsp *rsp) {
+    return modem_call(MODEM_CLASS_QUERY, "getSignalQuality", rsp, [](walterModemCb cb, void *arg) {
+        return modem.getSignalQuality(NULL, cb, arg);
+    });
+}
+
+/**
+ * Uplink task (MODEM core)
+ *
+ * One wake-up is one radio session: everything queued goes out back to
+ * back, over several lanes when there is a backlog.
+ */
+static void pipeline_uplink_task(void *pvParameters) {
+    ESP_LOGI(PIPE_TAG, "Uplink task running on core %d", (int)xPortGetCoreID());
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        bool measured = false;
+        bool failed = false;
+#ifdef CONFIG_WALTER_MULTI_UPLINK
+        if (g_uplink_queue.size() >= MULTI_UPLINK_MIN_BACKLOG) {
+            pipeline_drain_t drain = {};
+            WalterModemRsp rsp = {};
+            if (pipeline_signal_quality(&rsp)) {
+                drain.rsrp_dbm = rsp.data.signalQuality.rsrp;
+            }
+            measured = true;
+            multi_uplink_source_t src = { pipeline_drain_payload, pipeline_drain_release, NULL,
+                                          &drain };
+#ifdef CONFIG_WALTER_DOWNLINK
+            src.response = pipeline_drain_response;
+#endif
+            drain.charge_mark = energy_upload_uah();
+            energy_activity(ENERGY_ACT_UPLOAD);
+            energy_modem_state(ENERGY_MODEM_TX);
+            multi_uplink_drain(PIPELINE_UPLINK_URL, &src);
+            energy_modem_state(ENERGY_MODEM_CONNECTED);
+            energy_activity(ENERGY_ACT_IDLE);
+            failed = drain.failed;
+        }
+#endif
+        const pipeline_payload_t *payload;
+        while (!failed && (payload = g_uplink_queue.peek()) != NULL) {
+            uint32_t wait_ms = (uint32_t)((esp_timer_get_time() - payload->enqueued_us) / 1000);
+            if (wait_ms > g_pipeline_stats.max_queue_wait_ms) {
+                g_pipeline_stats.max_queue_wait_ms = wait_ms;
+            }
+
+            pipeline_result_t result = {};
+            static uint8_t body[DOWNLINK_BODY_MAX];
+            uint16_t body_len = 0;
+            uint32_t charge_before = energy_upload_uah();
+            energy_activity(ENERGY_ACT_UPLOAD);
+            energy_modem_state(ENERGY_MODEM_TX);
+            uint16_t status = http_post_json(PIPELINE_UPLINK_URL, payload->data, body, sizeof(body),
+                                             &body_len);
+            result.ok = http_status_ok(status);
+            result.rejected = http_status_permanent(status);
+            energy_modem_state(ENERGY_MODEM_CONNECTED);
+            energy_activity(ENERGY_ACT_IDLE);
+            result.charge_uah = energy_upload_uah() - charge_before;
+#ifdef CONFIG_WALTER_DOWNLINK
+            if (result.ok) {
+                downlink_feed(body, body_len, pipeline_downlink_trusted());
+            }
+#endif
+
+            WalterModemRsp rsp = {};
+            if (!measured && pipeline_signal_quality(&rsp)) {
+                result.rsrp_dbm = rsp.data.signalQuality.rsrp;
+                measured = true;
+            }
+            pipeline_complete(&result);
+            failed = !result.ok && !result.rejected;   // The rest waits behind it for the next session
+        }
+        // Radio is still up and answering: renew cached addresses for the
+        // next session
+        if (!failed) {
+            dns_cache_refresh();
+        }
+        xTaskNotify(g_sensor_task, PIPELINE_NOTIFY_SESSION_DONE, eSetBits);
+#ifdef CONFIG_WALTER_DOWNLINK
+        downlink_run_commands();
+#endif
+    }
+}
+
+/**
+ * Start both pipeline tasks pinned to their cores
+ *
+ * @return true if both tasks were created
+ */
+static bool pipeline_start(void) {
+    device_config_t cfg;
+    device_config_get(&cfg);
+    sampler_set_period(cfg.sample_period_ms);   // Before the timer starts
+
+    if (xTaskCreatePinnedToCore(pipeline_uplink_task, "uplink", PIPELINE_UPLINK_STACK,
+                                NULL, 5, &g_uplink_task, PIPELINE_MODEM_CORE) != pdPASS) {
+        ESP_LOGE(PIPE_TAG, "Failed to create uplink task");
+        return false;
+    }
+    if (xTaskCreatePinnedToCore(pipeline_sensor_task, "sensor", PIPELINE_SENSOR_STACK,
+                                NULL, 5, &g_sensor_task, PIPELINE_SENSOR_CORE) != pdPASS) {
+        ESP_LOGE(PIPE_TAG, "Failed to create sensor task");
+        return false;
+    }
+    g_sampler_listener = g_sensor_task;
+    if (!sampler_start(NULL, PIPELINE_SENSOR_CORE)) {
+        return false;
+    }
+    ESP_LOGI(PIPE_TAG, "Pipeline started (sensor core %d, modem core %d)",
+             PIPELINE_SENSOR_CORE, PIPELINE_MODEM_CORE);
+    return true;
+}
+
+#endif // UPLINK_PIPELINE_H
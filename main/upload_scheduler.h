@@ -0,0 +1,234 @@
+/**
+ * Adaptive Upload Scheduler for Walter Modem
+ *
+ * Decides when the next radio session should happen instead of uploading
+ * on a fixed period. Inputs are the buffer fill level, recent signal
+ * quality, a daily energy budget and the urgency class of the records
+ * waiting to go out:
+ *
+ *   urgent  sent right away
+ *   normal  sent within UPLOAD_NORMAL_MAX_DELAY_MS
+ *   bulk    coalesced for UPLOAD_BULK_MAX_DELAY_MS, or until the buffer
+ *           fills. The energy budget only ever delays a bulk session:
+ *           with little budget left it can hold bulk records past
+ *           UPLOAD_BULK_MAX_DELAY_MS, until the spacing that fits the
+ *           budget has passed or the buffer fills. It never starts one
+ *           early.
+ *
+ * Time is passed in explicitly and nothing here reads a clock, so the
+ * scheduler is deterministic and can be driven with simulated time
+ * (host/upload_sched_sim.cpp). No ESP-IDF dependencies.
+ */
+
+#ifndef UPLOAD_SCHEDULER_H
+#define UPLOAD_SCHEDULER_H
+
+#include <stdint.h>
+#include <string.h>
+#include "sensor_driver.h"
+
+#define UPLOAD_MIN_INTERVAL_MS (5 * 60 * 1000)          // Floor between non-urgent sessions
+#define UPLOAD_NORMAL_MAX_DELAY_MS (15 * 60 * 1000)
+#define UPLOAD_BULK_MAX_DELAY_MS (6 * 60 * 60 * 1000)
+#define UPLOAD_FILL_HIGH_PCT 75                          // Flush before the buffer overflows
+#define UPLOAD_DAILY_BUDGET_UAH 50000                    // Radio charge allowed per day
+#define UPLOAD_SESSION_COST_UAH 300                      // Estimated charge of one session at good signal
+#define UPLOAD_RSRP_GOOD_DBM (-100)                      // At or above: base session cost
+#define UPLOAD_RSRP_POOR_DBM (-120)                      // At or below: UPLOAD_POOR_COST_FACTOR x cost
+#define UPLOAD_POOR_COST_FACTOR 4
+
+#define UPLOAD_DAY_MS (24LL * 60 * 60 * 1000)
+
+/**
+ * Why a session was (or will be) started
+ */
+typedef enum {
+    UPLOAD_REASON_NONE = 0,     // Nothing pending
+    UPLOAD_REASON_URGENT,
+    UPLOAD_REASON_FILL,         // Buffer reached UPLOAD_FILL_HIGH_PCT
+    UPLOAD_REASON_NORMAL,       // Oldest normal record reached its deadline
+    UPLOAD_REASON_BULK,         // Oldest bulk record reached its deadline
+    UPLOAD_REASON_COUNT
+} upload_reason_t;
+
+static const char *const UPLOAD_REASON_NAMES[UPLOAD_REASON_COUNT] = {
+    "none", "urgent", "fill", "normal", "bulk",
+};
+
+typedef struct {
+    uint32_t min_interval_ms;
+    uint32_t normal_max_delay_ms;
+    uint32_t bulk_max_delay_ms;
+    uint32_t fill_high_pct;
+    uint32_t daily_budget_uah;
+    uint32_t session_cost_uah;
+} upload_sched_config_t;
+
+static const upload_sched_config_t UPLOAD_SCHED_DEFAULT = {
+    UPLOAD_MIN_INTERVAL_MS,
+    UPLOAD_NORMAL_MAX_DELAY_MS,
+    UPLOAD_BULK_MAX_DELAY_MS,
+    UPLOAD_FILL_HIGH_PCT,
+    UPLOAD_DAILY_BUDGET_UAH,
+    UPLOAD_SESSION_COST_UAH,
+};
+
+typedef struct {
+    upload_sched_config_t config;
+    int64_t last_flush_ms;
+    int64_t oldest_ms[SENSOR_URGENCY_COUNT];    // Oldest unsent record per class, -1 = none
+    bool has_signal;
+    int16_t rsrp_dbm;                           // Smoothed RSRP from recent sessions
+    int64_t day_start_ms;
+    uint32_t day_spent_uah;
+    uint32_t day_sessions;
+    uint32_t sessions;
+    uint32_t sessions_by_reason[UPLOAD_REASON_COUNT];
+} upload_sched_t;
+
+static void upload_sched_init(upload_sched_t *s, const upload_sched_config_t *config,
+                              int64_t now_ms) {
+    memset(s, 0, sizeof(*s));
+    s->config = config != NULL ? *config : UPLOAD_SCHED_DEFAULT;
+    s->last_flush_ms = now_ms;
+    s->day_start_ms = now_ms;
+    for (int i = 0; i < SENSOR_URGENCY_COUNT; i++) {
+        s->oldest_ms[i] = -1;
+    }
+}
+
+static void upload_sched_roll_day(upload_sched_t *s, int64_t now_ms) {
+    if (now_ms - s->day_start_ms >= UPLOAD_DAY_MS) {
+        s->day_start_ms += (now_ms - s->day_start_ms) / UPLOAD_DAY_MS * UPLOAD_DAY_MS;
+        s->day_spent_uah = 0;
+        s->day_sessions = 0;
+    }
+}
+
+/**
+ * A record of the given class was buffered
+ */
+static inline void upload_sched_note_record(upload_sched_t *s, sensor_urgency_t urgency,
+                                            int64_t now_ms) {
+    if (s->oldest_ms[urgency] < 0) {
+        s->oldest_ms[urgency] = now_ms;
+    }
+}
+
+/**
+ * Signal quality measured during a session
+ */
+static inline void upload_sched_note_signal(upload_sched_t *s, int16_t rsrp_dbm) {
+    s->rsrp_dbm = s->has_signal ? (int16_t)((3 * s->rsrp_dbm + rsrp_dbm) / 4) : rsrp_dbm;
+    s->has_signal = true;
+}
+
+/**
+ * Charge actually spent on uploads (counts against today's budget)
+ */
+static inline void upload_sched_note_charge(upload_sched_t *s, int64_t now_ms, uint32_t uah) {
+    upload_sched_roll_day(s, now_ms);
+    s->day_spent_uah += uah;
+}
+
+/**
+ * Expected charge of one session at the current signal level
+ *
+ * Poor coverage means more repetitions and longer time on air.
+ */
+static uint32_t upload_sched_session_cost(const upload_sched_t *s) {
+    uint32_t cost = s->config.session_cost_uah;
+    if (!s->has_signal || s->rsrp_dbm >= UPLOAD_RSRP_GOOD_DBM) {
+        return cost;
+    }
+    if (s->rsrp_dbm <= UPLOAD_RSRP_POOR_DBM) {
+        return cost * UPLOAD_POOR_COST_FACTOR;
+    }
+    uint32_t span = UPLOAD_RSRP_GOOD_DBM - UPLOAD_RSRP_POOR_DBM;
+    uint32_t below = UPLOAD_RSRP_GOOD_DBM - s->rsrp_dbm;
+    return cost + cost * (UPLOAD_POOR_COST_FACTOR - 1) * below / span;
+}
+
+/**
+ * Minimum spacing between bulk sessions that keeps today within budget
+ */
+static int64_t upload_sched_budget_gap_ms(const upload_sched_t *s, int64_t now_ms) {
+    int64_t left_ms = s->day_start_ms + UPLOAD_DAY_MS - now_ms;
+    if (left_ms <= 0) {
+        return 0;
+    }
+    uint32_t left_uah = s->day_spent_uah < s->config.daily_budget_uah
+                            ? s->config.daily_budget_uah - s->day_spent_uah : 0;
+    uint32_t affordable = left_uah / upload_sched_session_cost(s);
+    if (affordable == 0) {
+        return left_ms;             // Budget spent: bulk waits for tomorrow (or a full buffer)
+    }
+    return left_ms / affordable;
+}
+
+/**
+ * When the next session should start
+ *
+ * Urgent records and a buffer at fill_high_pct flush now, regardless of
+ * the budget. A bulk session is due at the later of its deadline, the
+ * minimum interval and the budget spacing (upload_sched_budget_gap_ms()).
+ *
+ * @param pending Records currently buffered
+ * @param capacity Records the buffer can hold
+ * @param reason Set to what drives the returned time (may be NULL)
+ * @return Absolute time in ms; <= now_ms means flush now
+ */
+static int64_t upload_sched_next_flush_ms(upload_sched_t *s, int64_t now_ms, uint32_t pending,
+                                          uint32_t capacity, upload_reason_t *reason) {
+    upload_reason_t why = UPLOAD_REASON_NONE;
+    int64_t next = now_ms + s->config.bulk_max_delay_ms;
+
+    upload_sched_roll_day(s, now_ms);
+
+    if (s->oldest_ms[SENSOR_URGENCY_URGENT] >= 0) {
+        why = UPLOAD_REASON_URGENT;
+        next = now_ms;
+    } else if (capacity > 0 && pending * 100 >= capacity * s->config.fill_high_pct) {
+        // Losing data is worse than overspending, so this ignores the budget
+        why = UPLOAD_REASON_FILL;
+        next = now_ms;
+    } else {
+        int64_t floor_ms = s->last_flush_ms + s->config.min_interval_ms;
+        if (s->oldest_ms[SENSOR_URGENCY_NORMAL] >= 0) {
+            int64_t due = s->oldest_ms[SENSOR_URGENCY_NORMAL] + s->config.normal_max_delay_ms;
+            why = UPLOAD_REASON_NORMAL;
+            next = due > floor_ms ? due : floor_ms;
+        }
+        if (s->oldest_ms[SENSOR_URGENCY_BULK] >= 0) {
+            int64_t due = s->oldest_ms[SENSOR_URGENCY_BULK] + s->config.bulk_max_delay_ms;
+            int64_t gap_floor = s->last_flush_ms + upload_sched_budget_gap_ms(s, now_ms);
+            if (gap_floor > due) due = gap_floor;
+            if (floor_ms > due) due = floor_ms;
+            if (why == UPLOAD_REASON_NONE || due < next) {
+                why = UPLOAD_REASON_BULK;
+                next = due;
+            }
+        }
+    }
+
+    if (reason != NULL) {
+        *reason = why;
+    }
+    return next;
+}
+
+/**
+ * A session was started; everything buffered so far goes out with it
+ */
+static void upload_sched_flushed(upload_sched_t *s, int64_t now_ms, upload_reason_t reason) {
+    upload_sched_roll_day(s, now_ms);
+    s->last_flush_ms = now_ms;
+    for (int i = 0; i < SENSOR_URGENCY_COUNT; i++) {
+        s->oldest_ms[i] = -1;
+    }
+    s->sessions++;
+    s->day_sessions++;
+    s->sessions_by_reason[reason]++;
+}
+
+#endif // UPLOAD_SCHEDULER_H